@@ -0,0 +1,254 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "c.h"
+#include "postgres.h"
+
+#include "catalog/pg_namespace.h"
+#include "catalog/pg_type_d.h"
+#include "nodes/pathnodes.h"
+#include "nodes/pg_list.h"
+#include "nodes/primnodes.h"
+#include "optimizer/pathnode.h"
+#include "optimizer/tlist.h"
+#include "utils/lsyscache.h"
+#include "utils/pg_locale.h"
+
+#include "aggregate.h"
+#include "condition.h"
+#include "cost.h"
+#include "pathkeys.h"
+#include "scalardb.h"
+#include "scalardb_fdw.h"
+
+static bool is_remote_aggregate(Aggref *aggref, RelOptInfo *input_rel,
+				ScalarDbFdwAggregateType *type,
+				String **column_name, List **sort_column_names,
+				List **sort_orders);
+
+/*
+ * Add a path that computes the aggregates of the query on the ScalarDB side.
+ *
+ * Only aggregates without GROUP BY are supported, and all of them must be
+ * computable remotely:
+ * - COUNT(*) is computed by counting the records of the scan without
+ *   transferring them to PostgreSQL.
+ * - MIN and MAX on the first clustering key that is not fixed by equality
+ *   conditions are computed by reading the first record of the partition key
+ *   scan ordered by that key.
+ */
+extern void add_foreign_grouping_paths(PlannerInfo *root, RelOptInfo *input_rel,
+				       RelOptInfo *grouped_rel)
+{
+	Query *parse = root->parse;
+	ScalarDbFdwPlanState *input_fdw_private =
+		(ScalarDbFdwPlanState *)input_rel->fdw_private;
+	ScalarDbFdwPlanState *grouped_fdw_private;
+	ListCell *lc;
+
+	List *aggregate_types = NIL;
+	List *aggregate_column_names = NIL;
+	List *aggregate_sort_column_names = NIL;
+	List *aggregate_sort_orders = NIL;
+	List *fdw_private_for_path;
+
+	double rows;
+	Cost scan_startup_cost;
+	Cost scan_total_cost;
+	Cost startup_cost;
+	Cost total_cost;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (!parse->hasAggs || parse->groupClause != NIL ||
+	    parse->groupingSets != NIL || root->hasHavingQual)
+		return;
+
+	/*
+	 * Pseudoconstant quals are evaluated by a gating Result node above the
+	 * scan, which does not exist when the aggregates are pushed down.
+	 */
+	if (root->hasPseudoConstantQuals)
+		return;
+
+	/*
+	 * The aggregates must be computed over the records that satisfy all the
+	 * conditions, so no condition can be left to be evaluated locally.
+	 */
+	if (input_fdw_private->local_conds != NIL)
+		return;
+
+	/*
+	 * The aggregates are computed for each entry of the scan tlist, in
+	 * which the same aggregates appearing more than once are merged into
+	 * one, as it is built in scalardbGetForeignPlan.
+	 */
+	foreach(lc, add_to_flat_tlist(NIL, grouped_rel->reltarget->exprs)) {
+		Expr *expr = ((TargetEntry *)lfirst(lc))->expr;
+		ScalarDbFdwAggregateType type;
+		String *column_name;
+		List *sort_column_names = NIL;
+		List *sort_orders = NIL;
+
+		if (!IsA(expr, Aggref))
+			return;
+
+		if (!is_remote_aggregate((Aggref *)expr, input_rel, &type,
+					 &column_name, &sort_column_names,
+					 &sort_orders))
+			return;
+
+		aggregate_types = lappend_int(aggregate_types, type);
+		aggregate_column_names =
+			lappend(aggregate_column_names, column_name);
+		aggregate_sort_column_names =
+			lappend(aggregate_sort_column_names, sort_column_names);
+		aggregate_sort_orders =
+			lappend(aggregate_sort_orders, sort_orders);
+	}
+
+	if (aggregate_types == NIL)
+		return;
+
+	/*
+	 * The plan for the upper relation is built from the conditions of the
+	 * input relation, so keep a reference to it.
+	 */
+	grouped_fdw_private = palloc0(sizeof(ScalarDbFdwPlanState));
+	*grouped_fdw_private = *input_fdw_private;
+	grouped_fdw_private->input_rel = input_rel;
+	grouped_rel->fdw_private = grouped_fdw_private;
+
+	estimate_costs(root, input_rel, input_fdw_private->remote_conds, &rows,
+		       &scan_startup_cost, &scan_total_cost);
+	estimate_aggregate_costs(aggregate_types, scan_startup_cost,
+				 scan_total_cost, &startup_cost, &total_cost);
+
+	fdw_private_for_path =
+		list_make4(aggregate_types, aggregate_column_names,
+			   aggregate_sort_column_names, aggregate_sort_orders);
+
+	add_path(grouped_rel,
+		 (Path *)create_foreign_upper_path(
+			 root, grouped_rel, grouped_rel->reltarget,
+			 1, /* aggregates without GROUP BY return a single row */
+			 startup_cost, total_cost, NIL, /* no pathkeys */
+			 NULL, /* no extra plan */
+			 fdw_private_for_path));
+}
+
+/*
+ * Returns true if the given aggregate can be computed on the ScalarDB side.
+ *
+ * If true, the type of the aggregate and the column used to compute it are
+ * returned in type and column_name. For MIN and MAX, the orderings of the scan
+ * whose first record has the result are pushed in sort_column_names and
+ * sort_orders.
+ */
+static bool is_remote_aggregate(Aggref *aggref, RelOptInfo *input_rel,
+				ScalarDbFdwAggregateType *type,
+				String **column_name, List **sort_column_names,
+				List **sort_orders)
+{
+	ScalarDbFdwPlanState *fdw_private =
+		(ScalarDbFdwPlanState *)input_rel->fdw_private;
+	ScalarDbFdwColumnMetadata *column_metadata =
+		&fdw_private->column_metadata;
+	char *func_name;
+	TargetEntry *tle;
+	Var *var;
+	int num_fixed_keys;
+	ScalarDbFdwClusteringKeyOrder order;
+	bool same_order;
+
+	if (aggref->aggkind != AGGKIND_NORMAL ||
+	    aggref->aggsplit != AGGSPLIT_SIMPLE || aggref->agglevelsup != 0 ||
+	    aggref->aggfilter != NULL || aggref->aggdistinct != NIL ||
+	    aggref->aggorder != NIL)
+		return false;
+
+	if (get_func_namespace(aggref->aggfnoid) != PG_CATALOG_NAMESPACE)
+		return false;
+
+	func_name = get_func_name(aggref->aggfnoid);
+
+	if (strcmp(func_name, "count") == 0 && aggref->aggstar) {
+		*type = SCALARDB_AGGREGATE_COUNT;
+		/* Only the first partition key is retrieved to count the records */
+		*column_name = linitial(column_metadata->partition_key_names);
+		return true;
+	}
+
+	if (strcmp(func_name, "min") == 0)
+		*type = SCALARDB_AGGREGATE_MIN;
+	else if (strcmp(func_name, "max") == 0)
+		*type = SCALARDB_AGGREGATE_MAX;
+	else
+		return false;
+
+	/* Only partition key scan can be sorted on the ScalarDB side */
+	if (fdw_private->scan_type != SCALARDB_SCAN_PARTITION_KEY)
+		return false;
+
+	if (list_length(aggref->args) != 1)
+		return false;
+
+	tle = linitial_node(TargetEntry, aggref->args);
+	if (!is_foreign_table_var(tle->expr, input_rel))
+		return false;
+	var = (Var *)tle->expr;
+
+	/*
+	 * The first record of the scan has the minimum or maximum value only for
+	 * the first clustering key whose value is not fixed by the equality
+	 * conditions.
+	 */
+	num_fixed_keys = get_num_fixed_clustering_keys(&fdw_private->boundary);
+	if (num_fixed_keys >=
+		    list_length(column_metadata->clustering_key_attnums) ||
+	    list_nth_int(column_metadata->clustering_key_attnums,
+			 num_fixed_keys) != var->varattno)
+		return false;
+
+	/* The storage compares text values in binary order */
+	if (var->vartype == TEXTOID && !lc_collate_is_c(aggref->inputcollid))
+		return false;
+
+	*column_name = list_nth(column_metadata->clustering_key_names,
+				num_fixed_keys);
+
+	/* Read the smallest value first for MIN and the largest one for MAX */
+	order = (ScalarDbFdwClusteringKeyOrder)list_nth_int(
+		column_metadata->clustering_key_orders, num_fixed_keys);
+	same_order = (order == SCALARDB_CLUSTERING_KEY_ORDER_ASC) ==
+		     (*type == SCALARDB_AGGREGATE_MIN);
+
+	/* Orderings of ScalarDB must start from the first clustering key */
+	for (int i = 0; i <= num_fixed_keys; i++) {
+		*sort_column_names =
+			lappend(*sort_column_names,
+				list_nth(column_metadata->clustering_key_names,
+					 i));
+		*sort_orders = lappend_int(
+			*sort_orders,
+			get_sort_order(
+				(ScalarDbFdwClusteringKeyOrder)list_nth_int(
+					column_metadata->clustering_key_orders,
+					i),
+				same_order));
+	}
+
+	return true;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SCALARDB_FDW_AGGREGATE_H
+#define SCALARDB_FDW_AGGREGATE_H
+
+#include "c.h"
+#include "postgres.h"
+#include "optimizer/pathnode.h"
+
+/*
+ * Type of aggregates computed on the ScalarDB side
+ */
+typedef enum {
+	SCALARDB_AGGREGATE_COUNT,
+	SCALARDB_AGGREGATE_MIN,
+	SCALARDB_AGGREGATE_MAX,
+} ScalarDbFdwAggregateType;
+
+/*
+ * Index of fdw_private of ForeignPath for upper relations
+ */
+enum ScanFdwUpperPathPrivateIndex {
+	/* Integer list of ScalarDbFdwAggregateType */
+	ScanFdwUpperPathPrivateAggregateTypes,
+	/* List of String that contains the column name used by each aggregate */
+	ScanFdwUpperPathPrivateAggregateColumnNames,
+	/* List of List of String that contains column names to sort the scan of each aggregate */
+	ScanFdwUpperPathPrivateAggregateSortColumnNames,
+	/* List of List of ScalarDbFdwClusteringKeyOrder to sort the scan of each aggregate */
+	ScanFdwUpperPathPrivateAggregateSortOrders
+};
+
+extern void add_foreign_grouping_paths(PlannerInfo *root, RelOptInfo *input_rel,
+				       RelOptInfo *grouped_rel);
+
+#endif
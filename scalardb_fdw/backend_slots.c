@@ -0,0 +1,191 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "c.h"
+#include "postgres.h"
+
+#include "miscadmin.h"
+#include "postmaster/autovacuum.h"
+#include "replication/walsender.h"
+#include "storage/ipc.h"
+#include "storage/shmem.h"
+#include "utils/memutils.h"
+
+#include "backend_slots.h"
+
+/* Maximum number of the arrays of slots defined by the modules */
+#define MAX_BACKEND_SLOTS 4
+
+/* Header of an array of slots in the shared memory */
+typedef struct {
+	LWLock *lock;
+} ScalarDbFdwBackendSlotsHeader;
+
+#define BACKEND_SLOTS_OFFSET MAXALIGN(sizeof(ScalarDbFdwBackendSlotsHeader))
+
+static ScalarDbFdwBackendSlots *defined_slots[MAX_BACKEND_SLOTS];
+static int num_defined_slots = 0;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void request_backend_slots_shmem(void);
+static void startup_backend_slots_shmem(void);
+static Size backend_slots_shmem_size(ScalarDbFdwBackendSlots *slots);
+static int get_max_backends(void);
+static void clear_own_backend_slot(int code, Datum arg);
+
+/*
+ * Define an array of slots of slot_size bytes, one for each backend, and
+ * request the shared memory for it. Must be called while the module is loaded
+ * by shared_preload_libraries. The slot of a backend is cleared by
+ * clear_own_slot when the backend exits, if it has used the slot.
+ */
+extern ScalarDbFdwBackendSlots *
+define_backend_slots(const char *name, Size slot_size,
+		     void (*clear_own_slot)(void *slot))
+{
+	ScalarDbFdwBackendSlots *slots;
+
+	Assert(process_shared_preload_libraries_in_progress);
+	if (num_defined_slots >= MAX_BACKEND_SLOTS)
+		elog(ERROR, "too many arrays of backend slots");
+
+	if (num_defined_slots == 0) {
+#if PG_VERSION_NUM >= 150000
+		prev_shmem_request_hook = shmem_request_hook;
+		shmem_request_hook = request_backend_slots_shmem;
+#endif
+		prev_shmem_startup_hook = shmem_startup_hook;
+		shmem_startup_hook = startup_backend_slots_shmem;
+	}
+
+	slots = MemoryContextAllocZero(TopMemoryContext,
+				       sizeof(ScalarDbFdwBackendSlots));
+	slots->name = name;
+	slots->slot_size = slot_size;
+	slots->clear_own_slot = clear_own_slot;
+	defined_slots[num_defined_slots++] = slots;
+
+#if PG_VERSION_NUM < 150000
+	RequestAddinShmemSpace(backend_slots_shmem_size(slots));
+	RequestNamedLWLockTranche(name, 1);
+#endif
+	return slots;
+}
+
+/*
+ * Return the slot of the backend, or NULL if the shared memory is not attached
+ * or the BackendId is out of the range of the slots.
+ */
+extern void *get_backend_slot(ScalarDbFdwBackendSlots *slots,
+			      BackendId backend_id)
+{
+	if (slots == NULL || slots->lock == NULL ||
+	    backend_id == InvalidBackendId || backend_id > slots->num_slots)
+		return NULL;
+
+	return slots->slots + slots->slot_size * (backend_id - 1);
+}
+
+/*
+ * Return the slot of this backend, or NULL if there is no shared memory. The
+ * slot is cleared when the backend exits.
+ */
+extern void *get_own_backend_slot(ScalarDbFdwBackendSlots *slots)
+{
+	void *slot = get_backend_slot(slots, MyBackendId);
+
+	if (slot != NULL && !slots->exit_callback_registered) {
+		before_shmem_exit(clear_own_backend_slot, PointerGetDatum(slots));
+		slots->exit_callback_registered = true;
+	}
+	return slot;
+}
+
+static void request_backend_slots_shmem(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+
+	for (int i = 0; i < num_defined_slots; i++) {
+		RequestAddinShmemSpace(
+			backend_slots_shmem_size(defined_slots[i]));
+		RequestNamedLWLockTranche(defined_slots[i]->name, 1);
+	}
+#endif
+}
+
+static void startup_backend_slots_shmem(void)
+{
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	for (int i = 0; i < num_defined_slots; i++) {
+		ScalarDbFdwBackendSlots *slots = defined_slots[i];
+		ScalarDbFdwBackendSlotsHeader *header;
+		bool found;
+
+		slots->num_slots = get_max_backends();
+		header = ShmemInitStruct(slots->name,
+					 backend_slots_shmem_size(slots),
+					 &found);
+		if (!found) {
+			header->lock =
+				&(GetNamedLWLockTranche(slots->name))->lock;
+			memset((char *)header + BACKEND_SLOTS_OFFSET, 0,
+			       slots->slot_size * slots->num_slots);
+		}
+		slots->lock = header->lock;
+		slots->slots = (char *)header + BACKEND_SLOTS_OFFSET;
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+static Size backend_slots_shmem_size(ScalarDbFdwBackendSlots *slots)
+{
+	return add_size(BACKEND_SLOTS_OFFSET,
+			mul_size(slots->slot_size, get_max_backends()));
+}
+
+/*
+ * Return MaxBackends, which is not computed yet when the shared memory is
+ * requested before PostgreSQL 15.
+ */
+static int get_max_backends(void)
+{
+#if PG_VERSION_NUM >= 150000
+	return MaxBackends;
+#else
+	return MaxConnections + autovacuum_max_workers + 1 +
+	       max_worker_processes + max_wal_senders;
+#endif
+}
+
+static void clear_own_backend_slot(int code, Datum arg)
+{
+	ScalarDbFdwBackendSlots *slots =
+		(ScalarDbFdwBackendSlots *)DatumGetPointer(arg);
+
+	LWLockAcquire(slots->lock, LW_EXCLUSIVE);
+	slots->clear_own_slot(get_backend_slot(slots, MyBackendId));
+	LWLockRelease(slots->lock);
+}
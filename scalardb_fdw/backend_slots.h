@@ -0,0 +1,52 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SCALARDB_FDW_BACKEND_SLOTS_H
+#define SCALARDB_FDW_BACKEND_SLOTS_H
+
+#include "c.h"
+#include "postgres.h"
+#include "storage/backendid.h"
+#include "storage/lwlock.h"
+
+/*
+ * An array of slots in the shared memory, one for each backend, indexed by
+ * BackendId - 1, and a lock that protects all of them. The slots are
+ * available only if the module is loaded by shared_preload_libraries.
+ */
+typedef struct {
+	/* name of the shared memory and the tranche of the lock */
+	const char *name;
+	Size slot_size;
+	/* clears the slot of this backend on exit, called with the lock held */
+	void (*clear_own_slot)(void *slot);
+
+	/* NULL until the shared memory is attached */
+	LWLock *lock;
+	char *slots;
+	int num_slots;
+	bool exit_callback_registered;
+} ScalarDbFdwBackendSlots;
+
+extern ScalarDbFdwBackendSlots *
+define_backend_slots(const char *name, Size slot_size,
+		     void (*clear_own_slot)(void *slot));
+
+extern void *get_backend_slot(ScalarDbFdwBackendSlots *slots,
+			      BackendId backend_id);
+
+extern void *get_own_backend_slot(ScalarDbFdwBackendSlots *slots);
+
+#endif
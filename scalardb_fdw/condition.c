@@ -25,8 +25,12 @@
 #include "nodes/pg_list.h"
 #include "nodes/nodes.h"
 #include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
 #include "optimizer/clauses.h"
+#include "optimizer/optimizer.h"
 #include "optimizer/planmain.h"
+#include "utils/array.h"
+#include "utils/lsyscache.h"
 #include "utils/syscache.h"
 
 #include "condition.h"
@@ -34,6 +38,12 @@
 
 #define UnsupportedConitionType -1
 
+/*
+ * Maximum number of partitions read by a Scan with partition key IN lists.
+ * Each combination of the values is read by its own Scan.
+ */
+#define MAX_PARTITION_KEY_SCANS 1000
+
 /*
  * Type of the condition target column
  */
@@ -49,6 +59,8 @@ typedef enum {
 	SCALARDB_OP_LT,
 	SCALARDB_OP_GE,
 	SCALARDB_OP_GT,
+	/* "= ANY (array)", whose expr is an array of the values */
+	SCALARDB_OP_IN,
 } ScalarDbFdwOperator;
 
 /*
@@ -71,7 +83,8 @@ typedef struct {
 #endif
 	/* Expression that is compared with the column.
 	 * This expression will be evaluated in the executor phase.
-	 * This must be a pseudo constant */
+	 * This must not refer to the foreign table. It refers to the other
+	 * relations only in the join clauses of parameterized paths */
 	Expr *expr;
 } ScalarDbFdwShippableCondition;
 
@@ -83,7 +96,15 @@ static ScalarDbFdwShippableCondition *
 is_shippable_condition(RelOptInfo *baserel,
 		       ScalarDbFdwColumnMetadata *column_metadata, Expr *expr);
 
-static ScalarDbFdwOperator get_operator_type(OpExpr *op);
+static List *choose_partition_key_conds(List *partition_key_conds,
+					List *partition_key_shippable_conds,
+					int num_partition_keys);
+
+static ScalarDbFdwOperator get_operator_type(Oid opno);
+
+static ScalarDbFdwOperator commute_operator_type(ScalarDbFdwOperator op_type);
+
+static bool is_condition_value(Node *node, RelOptInfo *baserel);
 
 static Const *make_boolean_const(bool val);
 
@@ -98,20 +119,25 @@ static Const *make_boolean_const(bool val);
  *
  * If remote_conds contain the partition key conditions, remote_conds may contain zero or more the clustring key conditions.
  *
+ * A partition key condition may also be "key IN (...)" with constant values, in which case the partitions of all the
+ * values are read by separate Scans.
+ *
  * If input_conds contains multiple secondary index condtiions, only the first condition found is appended to remote_conds.
+ * All of them are returned in secondary_index_conds so that the caller can choose the one to be used for Scan.
  */
 extern void determine_remote_conds(RelOptInfo *baserel, List *input_conds,
 				   ScalarDbFdwColumnMetadata *column_metadata,
 				   List **remote_conds, List **local_conds,
 				   ScalarDbFdwClusteringKeyBoundary *boundary,
-				   ScalarDbFdwScanType *scan_type)
+				   ScalarDbFdwScanType *scan_type,
+				   List **secondary_index_conds)
 {
 	ListCell *lc;
 	ScalarDbFdwShippableCondition *shippable_condition;
 	List *partition_key_conds = NIL;
+	List *partition_key_shippable_conds = NIL;
 	List *clustering_key_conds = NIL;
 	List *clustering_key_shippable_conds = NIL;
-	RestrictInfo *secondary_index_cond = NULL;
 
 	ereport(DEBUG3, errmsg("entering function %s", __func__));
 
@@ -124,7 +150,9 @@ extern void determine_remote_conds(RelOptInfo *baserel, List *input_conds,
 			case SCALARDB_PARTITION_KEY: {
 				partition_key_conds =
 					lappend(partition_key_conds, ri);
-				pfree(shippable_condition);
+				partition_key_shippable_conds =
+					lappend(partition_key_shippable_conds,
+						shippable_condition);
 				break;
 			}
 			case SCALARDB_CLUSTERING_KEY: {
@@ -139,10 +167,8 @@ extern void determine_remote_conds(RelOptInfo *baserel, List *input_conds,
 				break;
 			}
 			case SCALARDB_SECONDARY_INDEX: {
-				/* Use only the first condition on the secondary index */
-				if (secondary_index_cond == NULL) {
-					secondary_index_cond = ri;
-				}
+				*secondary_index_conds =
+					lappend(*secondary_index_conds, ri);
 				pfree(shippable_condition);
 				break;
 			}
@@ -150,8 +176,11 @@ extern void determine_remote_conds(RelOptInfo *baserel, List *input_conds,
 		}
 	}
 
-	if (list_length(partition_key_conds) ==
-	    list_length(column_metadata->partition_key_attnums)) {
+	partition_key_conds = choose_partition_key_conds(
+		partition_key_conds, partition_key_shippable_conds,
+		list_length(column_metadata->partition_key_attnums));
+
+	if (partition_key_conds != NIL) {
 		*scan_type = SCALARDB_SCAN_PARTITION_KEY;
 		*remote_conds = partition_key_conds;
 		*local_conds = list_difference(input_conds, *remote_conds);
@@ -165,9 +194,10 @@ extern void determine_remote_conds(RelOptInfo *baserel, List *input_conds,
 			*local_conds =
 				list_difference(*local_conds, boundary->conds);
 		}
-	} else if (secondary_index_cond != NULL) {
+	} else if (*secondary_index_conds != NIL) {
 		*scan_type = SCALARDB_SCAN_SECONDARY_INDEX;
-		*remote_conds = list_make1(secondary_index_cond);
+		/* Use the first condition on the secondary index by default */
+		*remote_conds = list_make1(linitial(*secondary_index_conds));
 		*local_conds = list_difference(input_conds, *remote_conds);
 	} else {
 		*scan_type = SCALARDB_SCAN_ALL;
@@ -200,6 +230,76 @@ extern void split_condition_expr(RelOptInfo *baserel,
 	*right = cond->expr;
 }
 
+/*
+ * Return true if the given shippable condition can also be evaluated on the
+ * ScalarDB side by comparing the column of each record with the value.
+ *
+ * The result must be the same as the one of PostgreSQL, so floating point
+ * types (whose equality differs for signed zeros and NaN) and text with a
+ * non-deterministic collation are excluded. The value must also have the same
+ * type as the column.
+ */
+extern bool is_filterable_condition(RelOptInfo *baserel,
+				    ScalarDbFdwColumnMetadata *column_metadata,
+				    Expr *expr)
+{
+	Var *left;
+	String *left_name;
+	Expr *right;
+
+	split_condition_expr(baserel, column_metadata, expr, &left, &left_name,
+			     &right);
+
+	if (exprType((Node *)right) != left->vartype)
+		return false;
+
+	switch (left->vartype) {
+	case BOOLOID:
+	case INT4OID:
+	case INT8OID:
+	case BYTEAOID:
+		return true;
+	case TEXTOID:
+		return IsA(expr, OpExpr) &&
+		       get_collation_isdeterministic(
+			       ((OpExpr *)expr)->inputcollid);
+	default:
+		return false;
+	}
+}
+
+/*
+ * Return true if the given join clause can be pushed down to ScalarDB with a
+ * parameterized path. That is, it is an equality condition on a partition key
+ * or a secondary index whose value is computed from the other relations.
+ */
+extern bool is_shippable_join_condition(
+	RelOptInfo *baserel, ScalarDbFdwColumnMetadata *column_metadata,
+	RestrictInfo *rinfo)
+{
+	ScalarDbFdwShippableCondition *cond;
+	bool ret;
+
+	if (bms_is_subset(rinfo->clause_relids, baserel->relids))
+		return false;
+
+	cond = is_shippable_condition(baserel, column_metadata, rinfo->clause);
+	if (cond == NULL)
+		return false;
+
+	/*
+	 * The value is used as a key as is, so its type must match the column.
+	 * IN lists are not parameterized since their values are constants.
+	 */
+	ret = (cond->key == SCALARDB_PARTITION_KEY ||
+	       cond->key == SCALARDB_SECONDARY_INDEX) &&
+	      cond->op == SCALARDB_OP_EQ &&
+	      exprType((Node *)cond->expr) == cond->column->vartype;
+
+	pfree(cond);
+	return ret;
+}
+
 /*
  * Return true if the given expr is Var belonging to the given baserel.
  */
@@ -318,6 +418,9 @@ static void determine_clustering_key_boundary(
 						/* Try to find end boundary condition */
 						continue;
 					}
+				case SCALARDB_OP_IN:
+					/* IN lists are only on partition keys */
+					continue;
 				}
 			}
 		}
@@ -361,6 +464,60 @@ FINISH:
 	return;
 }
 
+/*
+ * Choose a condition for each partition key from the given ones, preferring
+ * an equality condition to an IN list. Returns NIL if any of the partition
+ * keys has no condition or the IN lists would read too many partitions.
+ * Otherwise, the conditions are returned in the given order.
+ */
+static List *choose_partition_key_conds(List *partition_key_conds,
+					List *partition_key_shippable_conds,
+					int num_partition_keys)
+{
+	ScalarDbFdwShippableCondition **chosen;
+	List *ret = NIL;
+	double num_scans = 1;
+	ListCell *lc, *lc2;
+
+	if (num_partition_keys == 0)
+		return NIL;
+
+	chosen = palloc0(sizeof(ScalarDbFdwShippableCondition *) *
+			 num_partition_keys);
+	foreach(lc, partition_key_shippable_conds) {
+		ScalarDbFdwShippableCondition *cond = lfirst(lc);
+
+		if (chosen[cond->key_index] == NULL ||
+		    (chosen[cond->key_index]->op == SCALARDB_OP_IN &&
+		     cond->op == SCALARDB_OP_EQ))
+			chosen[cond->key_index] = cond;
+	}
+
+	for (int i = 0; i < num_partition_keys; i++) {
+		ArrayType *array;
+
+		if (chosen[i] == NULL)
+			return NIL;
+		if (chosen[i]->op != SCALARDB_OP_IN)
+			continue;
+
+		array = DatumGetArrayTypeP(
+			((Const *)chosen[i]->expr)->constvalue);
+		num_scans *= ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array));
+	}
+	if (num_scans > MAX_PARTITION_KEY_SCANS)
+		return NIL;
+
+	forboth(lc, partition_key_conds, lc2, partition_key_shippable_conds)
+	{
+		ScalarDbFdwShippableCondition *cond = lfirst(lc2);
+
+		if (chosen[cond->key_index] == cond)
+			ret = lappend(ret, lfirst(lc));
+	}
+	return ret;
+}
+
 static ScalarDbFdwShippableCondition *
 check_keys_for_var(Var *var, List *key_attnums, List *key_names,
 		   ScalarDbFdwConditionKeyType key_type, ScalarDbFdwOperator op,
@@ -475,23 +632,32 @@ is_shippable_condition(RelOptInfo *baserel,
 		Var *left;
 		Node *right;
 		OpExpr *op = (OpExpr *)expr;
-		ScalarDbFdwOperator op_type = get_operator_type(op);
+		ScalarDbFdwOperator op_type;
 
-		if (op_type == UnsupportedConitionType)
+		if (list_length(op->args) != 2)
 			return NULL;
 
-		if (list_length(op->args) != 2)
+		op_type = get_operator_type(op->opno);
+		if (op_type == UnsupportedConitionType)
 			return NULL;
 
 		left_expr = linitial_node(Expr, op->args);
 		right = lsecond(op->args);
 
+		/* Join clauses may have the column on the right side */
+		if (!is_foreign_table_var(left_expr, baserel) &&
+		    is_foreign_table_var((Expr *)right, baserel)) {
+			left_expr = (Expr *)right;
+			right = linitial(op->args);
+			op_type = commute_operator_type(op_type);
+		}
+
 		if (!is_foreign_table_var(left_expr, baserel))
 			return NULL;
 
 		left = (Var *)left_expr;
 
-		if (!is_pseudo_constant_clause(right))
+		if (!is_condition_value(right, baserel))
 			return NULL;
 
 		if (op_type == SCALARDB_OP_EQ) {
@@ -525,24 +691,45 @@ is_shippable_condition(RelOptInfo *baserel,
 		}
 		return NULL;
 	}
+	case T_ScalarArrayOpExpr: {
+		/* Only "key IN (...)" on a partition key with constant values */
+		ScalarArrayOpExpr *op = (ScalarArrayOpExpr *)expr;
+		Expr *left_expr;
+		Node *right;
+
+		if (!op->useOr || list_length(op->args) != 2 ||
+		    get_operator_type(op->opno) != SCALARDB_OP_EQ)
+			return NULL;
+
+		left_expr = linitial_node(Expr, op->args);
+		right = lsecond(op->args);
+
+		if (!is_foreign_table_var(left_expr, baserel) ||
+		    !IsA(right, Const) || ((Const *)right)->constisnull ||
+		    get_element_type(((Const *)right)->consttype) !=
+			    ((Var *)left_expr)->vartype)
+			return NULL;
+
+		return check_keys_for_var(
+			(Var *)left_expr, column_metadata->partition_key_attnums,
+			column_metadata->partition_key_names,
+			SCALARDB_PARTITION_KEY, SCALARDB_OP_IN, (Expr *)right);
+	}
 	default:
 		return NULL;
 	}
 }
 
-static ScalarDbFdwOperator get_operator_type(OpExpr *op)
+static ScalarDbFdwOperator get_operator_type(Oid opno)
 {
 	HeapTuple tuple;
 	Form_pg_operator form;
 	ScalarDbFdwOperator ret = UnsupportedConitionType;
 
-	if (list_length(op->args) != 2)
-		return ret;
-
 	/* Retrieve information about the operator from system catalog. */
-	tuple = SearchSysCache1(OPEROID, ObjectIdGetDatum(op->opno));
+	tuple = SearchSysCache1(OPEROID, ObjectIdGetDatum(opno));
 	if (!HeapTupleIsValid(tuple))
-		elog(ERROR, "cache lookup failed for operator %u", op->opno);
+		elog(ERROR, "cache lookup failed for operator %u", opno);
 	form = (Form_pg_operator)GETSTRUCT(tuple);
 
 	if (strcmp(NameStr(form->oprname), "=") == 0)
@@ -560,6 +747,55 @@ static ScalarDbFdwOperator get_operator_type(OpExpr *op)
 	return ret;
 }
 
+/*
+ * Return the operator type with the operands swapped, e.g. "1 < ck" is
+ * equivalent to "ck > 1".
+ */
+static ScalarDbFdwOperator commute_operator_type(ScalarDbFdwOperator op_type)
+{
+	switch (op_type) {
+	case SCALARDB_OP_LE:
+		return SCALARDB_OP_GE;
+	case SCALARDB_OP_LT:
+		return SCALARDB_OP_GT;
+	case SCALARDB_OP_GE:
+		return SCALARDB_OP_LE;
+	case SCALARDB_OP_GT:
+		return SCALARDB_OP_LT;
+	default:
+		return op_type;
+	}
+}
+
+/*
+ * Return true if the given node can be evaluated as a value compared with a
+ * column in the executor phase. It must not refer to the foreign table itself,
+ * but it may refer to the other relations, which are supplied as parameters by
+ * the outer relation of a nested loop.
+ */
+static bool is_condition_value(Node *node, RelOptInfo *baserel)
+{
+	List *vars;
+	ListCell *lc;
+	bool ret = true;
+
+	if (contain_volatile_functions(node))
+		return false;
+
+	vars = pull_var_clause(node, PVC_RECURSE_AGGREGATES |
+					     PVC_RECURSE_WINDOWFUNCS |
+					     PVC_RECURSE_PLACEHOLDERS);
+	foreach(lc, vars) {
+		if (bms_is_member(((Var *)lfirst(lc))->varno,
+				  baserel->relids)) {
+			ret = false;
+			break;
+		}
+	}
+	list_free(vars);
+	return ret;
+}
+
 static Const *make_boolean_const(bool val)
 {
 	return makeConst(BOOLOID, -1, InvalidOid, 1, BoolGetDatum(val), false,
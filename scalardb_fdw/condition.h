@@ -63,13 +63,22 @@ extern void determine_remote_conds(RelOptInfo *baserel, List *input_conds,
 				   ScalarDbFdwColumnMetadata *column_metadata,
 				   List **remote_conds, List **local_conds,
 				   ScalarDbFdwClusteringKeyBoundary *boundary,
-				   ScalarDbFdwScanType *scan_type);
+				   ScalarDbFdwScanType *scan_type,
+				   List **secondary_index_conds);
 
 extern void split_condition_expr(RelOptInfo *baserel,
 				 ScalarDbFdwColumnMetadata *column_metadata,
 				 Expr *expr, Var **left, String **left_name,
 				 Expr **right);
 
+extern bool is_shippable_join_condition(
+	RelOptInfo *baserel, ScalarDbFdwColumnMetadata *column_metadata,
+	RestrictInfo *rinfo);
+
+extern bool is_filterable_condition(RelOptInfo *baserel,
+				    ScalarDbFdwColumnMetadata *column_metadata,
+				    Expr *expr);
+
 extern bool is_foreign_table_var(Expr *expr, RelOptInfo *baserel);
 
 #endif
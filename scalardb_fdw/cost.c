@@ -13,24 +13,146 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <math.h>
+
 #include "c.h"
 #include "postgres.h"
 
+#include "access/htup_details.h"
+#include "catalog/pg_class.h"
+#include "common/hashfn.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
 #include "optimizer/cost.h"
 #include "optimizer/optimizer.h"
+#include "parser/parsetree.h"
+#include "portability/instr_time.h"
+#include "utils/acl.h"
+#include "utils/array.h"
+#include "utils/attoptcache.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/selfuncs.h"
+#include "utils/timestamp.h"
 
+#include "aggregate.h"
 #include "cost.h"
+#include "partition_stats.h"
+#include "scalardb.h"
 #include "scalardb_fdw.h"
 
 #define DEFAULT_ROWS_FOR_PARTITION_KEY_SCAN 10
 
+/*
+ * Maximum number of records counted by a remote estimate. Larger partitions
+ * are estimated to have this number of records, which is enough to make the
+ * planner avoid treating them as small lookups.
+ */
+#define REMOTE_ESTIMATE_ROW_LIMIT 10000
+
+/*
+ * Default cost parameters for each storage of ScalarDB. A cost of 1.0 roughly
+ * corresponds to 0.1 ms, which is the default cost_unit_ms of
+ * scalardb_fdw_calibrate_costs().
+ */
+static const struct {
+	const char *storage;
+	ScalarDbFdwScanCosts scan_costs;
+} default_scan_costs[] = {
+	/* storage, startup, round trip, tuple, rows per round trip */
+	{ "cassandra", { 1.0, 10.0, 0.005, 5000 } },
+	{ "cosmos", { 1.0, 50.0, 0.008, 100 } },
+	{ "dynamo", { 1.0, 50.0, 0.008, 1000 } },
+	{ "jdbc", { 1.0, 5.0, 0.0012, 1000 } },
+
+	/* Sentinel, used for unknown storages */
+	{ NULL, { 1.0, 10.0, 0.005, 1000 } }
+};
+
+/*
+ * Multiplier applied to the cost of sorting on the remote storage relative to
+ * the comparison cost of a local in-memory sort. The storage sorts the rows
+ * close to the data (often by using its own indexes), so this is less than 1.
+ */
+#define REMOTE_SORT_COST_MULTIPLIER 0.5
+
+/*
+ * Fraction of the cost of scanning the records that remains when they are
+ * counted on the ScalarDB side. The records are still read by the storage, but
+ * they are neither converted nor passed to PostgreSQL.
+ */
+#define REMOTE_COUNT_COST_FRACTION 0.1
+
+/*
+ * Entry of the cache of remote estimates, which lives for the session.
+ *
+ * Entries are looked up by the hash of the key that consists of the table and
+ * the condition values, and the key is compared to resolve hash collisions.
+ */
+typedef struct {
+	uint32 hash; /* hash key; must be first */
+	char *key;
+	double rows;
+	TimestampTz estimated_at;
+} RemoteEstimateCacheEntry;
+
+static HTAB *remote_estimate_cache = NULL;
+
+static void estimate_scan_costs(RelOptInfo *baserel, double rows_read,
+				double *rows, Cost *startup_cost,
+				Cost *total_cost);
+static double estimate_remote_rows(PlannerInfo *root, RelOptInfo *baserel,
+				   List *remote_conds, bool is_index);
+static double estimate_partition_rows(PlannerInfo *root, RelOptInfo *baserel,
+				      List *remote_conds);
+static double count_partition_scans(RelOptInfo *baserel, List *remote_conds);
+static Selectivity other_conds_selectivity(PlannerInfo *root,
+					   RelOptInfo *baserel,
+					   List *remote_conds);
+static double sampled_rows(RelOptInfo *baserel, double rows);
+
+PG_FUNCTION_INFO_V1(scalardb_fdw_calibrate_costs);
+
+/*
+ * Get the cost parameters of the scans on the given storage. The defaults of
+ * the storage are overridden by the options of the foreign server and table.
+ */
+void get_scan_costs(char *storage, ScalarDbFdwOptions *opts,
+		    ScalarDbFdwScanCosts *scan_costs)
+{
+	int i;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	for (i = 0; default_scan_costs[i].storage != NULL; i++) {
+		if (strcmp(default_scan_costs[i].storage, storage) == 0)
+			break;
+	}
+	*scan_costs = default_scan_costs[i].scan_costs;
+
+	if (opts->fdw_startup_cost >= 0)
+		scan_costs->startup_cost = opts->fdw_startup_cost;
+	if (opts->fdw_round_trip_cost >= 0)
+		scan_costs->round_trip_cost = opts->fdw_round_trip_cost;
+	if (opts->fdw_tuple_cost >= 0)
+		scan_costs->tuple_cost = opts->fdw_tuple_cost;
+}
+
 /*
  * Estimate the size of a foreign table.
  *
- * The main result is returned in baserel->rows.
+ * The main result is returned in baserel->rows. If use_remote_estimate is
+ * enabled, it is computed from the number of records counted on the storage.
+ * Otherwise, the rows of a partition key scan are computed from the partition
+ * statistics saved by ANALYZE, if any.
  */
 void estimate_size(PlannerInfo *root, RelOptInfo *baserel)
 {
+	ScalarDbFdwPlanState *fdw_private =
+		(ScalarDbFdwPlanState *)baserel->fdw_private;
+
 	ereport(DEBUG3, errmsg("entering function %s", __func__));
 	/*
 	 * If the foreign table has never been ANALYZEd, it will have
@@ -48,13 +170,33 @@ void estimate_size(PlannerInfo *root, RelOptInfo *baserel)
 		baserel->tuples =
 			(10.0 * BLCKSZ) / (baserel->reltarget->width +
 					   sizeof(HeapTupleHeaderData));
-	} else {
-		ereport(ERROR,
-			errmsg("foreign table of scalardb_fdw should not be ANALYZEd"));
 	}
 
 	/* Estimate baserel size as best we can with local statistics. */
 	set_baserel_size_estimates(root, baserel);
+
+	/*
+	 * Replace the estimate with the number of records of the partition or
+	 * the index key if the Scan reads one.
+	 */
+	if (fdw_private->scan_type != SCALARDB_SCAN_ALL) {
+		double rows_read =
+			fdw_private->scan_type == SCALARDB_SCAN_PARTITION_KEY ?
+				estimate_partition_rows(
+					root, baserel,
+					fdw_private->remote_conds) :
+				estimate_remote_rows(root, baserel,
+						     fdw_private->remote_conds,
+						     true);
+
+		if (rows_read >= 0)
+			baserel->rows = clamp_row_est(
+				rows_read *
+				other_conds_selectivity(
+					root, baserel, fdw_private->remote_conds));
+	}
+
+	baserel->rows = sampled_rows(baserel, baserel->rows);
 }
 
 /*
@@ -65,21 +207,65 @@ void estimate_size(PlannerInfo *root, RelOptInfo *baserel)
 void estimate_costs(PlannerInfo *root, RelOptInfo *baserel, List *remote_conds,
 		    double *rows, Cost *startup_cost, Cost *total_cost)
 {
-	Cost run_cost = 0;
-	Cost cpu_per_tuple;
-	ScalarDbFdwPlanState *fdw_private =
-		(ScalarDbFdwPlanState *)baserel->fdw_private;
+	double rows_read;
 
 	ereport(DEBUG3, errmsg("entering function %s", __func__));
 
-	*rows = list_length(fdw_private->remote_conds) > 0 ?
-			DEFAULT_ROWS_FOR_PARTITION_KEY_SCAN :
-			baserel->rows;
+	/*
+	 * Scan with the partition key reads a single partition, while Scan
+	 * (all) reads all the records of the table.
+	 */
+	if (list_length(remote_conds) > 0) {
+		rows_read =
+			estimate_partition_rows(root, baserel, remote_conds);
+		if (rows_read >= 0) {
+			*rows = clamp_row_est(
+				rows_read * other_conds_selectivity(
+						    root, baserel, remote_conds));
+		} else {
+			rows_read = DEFAULT_ROWS_FOR_PARTITION_KEY_SCAN *
+				    count_partition_scans(baserel,
+							  remote_conds);
+			*rows = rows_read;
+		}
+		*rows = sampled_rows(baserel, *rows);
+	} else {
+		rows_read = baserel->tuples;
+		*rows = baserel->rows;
+	}
+
+	estimate_scan_costs(baserel, rows_read, rows, startup_cost,
+			    total_cost);
+}
 
-	*startup_cost = 0;
+/*
+ * Estimate costs of a Scan that reads rows_read records from the storage.
+ *
+ * Starting a Scan costs the startup cost and the first round trip to the
+ * storage. The records are then transferred in round trips of
+ * rows_per_round_trip records, and each of them is evaluated against the local
+ * conditions.
+ */
+static void estimate_scan_costs(RelOptInfo *baserel, double rows_read,
+				double *rows, Cost *startup_cost,
+				Cost *total_cost)
+{
+	ScalarDbFdwScanCosts *scan_costs =
+		&((ScalarDbFdwPlanState *)baserel->fdw_private)->scan_costs;
+	double round_trips;
+	Cost run_cost;
+	Cost cpu_per_tuple;
+
+	round_trips = ceil(rows_read / scan_costs->rows_per_round_trip);
+	if (round_trips < 1)
+		round_trips = 1;
+
+	*startup_cost = scan_costs->startup_cost + scan_costs->round_trip_cost;
 	*startup_cost += baserel->baserestrictcost.startup;
-	cpu_per_tuple = cpu_tuple_cost + baserel->baserestrictcost.per_tuple;
-	run_cost += cpu_per_tuple * baserel->tuples;
+	run_cost = scan_costs->round_trip_cost * (round_trips - 1);
+	cpu_per_tuple = scan_costs->tuple_cost + cpu_tuple_cost +
+			baserel->baserestrictcost.per_tuple;
+	run_cost += cpu_per_tuple * rows_read;
 
 	/* Add in tlist eval cost for each output row */
 	*startup_cost += baserel->reltarget->cost.startup;
@@ -87,3 +273,520 @@ void estimate_costs(PlannerInfo *root, RelOptInfo *baserel, List *remote_conds,
 
 	*total_cost = *startup_cost + run_cost;
 }
+
+/*
+ * Scale the estimated rows of a Scan by sample_percent. The records of the
+ * partitions that are not sampled are still read from the storage, so only the
+ * rows passed to PostgreSQL are scaled.
+ */
+static double sampled_rows(RelOptInfo *baserel, double rows)
+{
+	ScalarDbFdwPlanState *fdw_private =
+		(ScalarDbFdwPlanState *)baserel->fdw_private;
+
+	return clamp_row_est(rows * fdw_private->options.sample_percent / 100);
+}
+
+/*
+ * Estimate the number of records of the partition read by the Scan with the
+ * given partition key conditions.
+ *
+ * The records are counted on the storage if use_remote_estimate is enabled.
+ * Otherwise, the number is taken from the partition statistics saved by
+ * ANALYZE. Returns a negative value if neither is available or any of the
+ * partition key values is not a plan-time constant or is an IN list.
+ */
+static double estimate_partition_rows(PlannerInfo *root, RelOptInfo *baserel,
+				      List *remote_conds)
+{
+	ScalarDbFdwPlanState *fdw_private =
+		(ScalarDbFdwPlanState *)baserel->fdw_private;
+	List *partition_key_names =
+		fdw_private->column_metadata.partition_key_names;
+	RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
+	double rows;
+	char **values;
+	ListCell *lc;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	rows = estimate_remote_rows(root, baserel, remote_conds, false);
+	if (rows >= 0)
+		return rows;
+
+	/* The values are ordered as the partition key of the table */
+	values = palloc0(sizeof(char *) * list_length(partition_key_names));
+	foreach(lc, remote_conds) {
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		Var *var;
+		String *name;
+		Expr *value;
+		Oid typoutput;
+		bool typisvarlena;
+		ListCell *lc2;
+
+		split_condition_expr(baserel, &fdw_private->column_metadata,
+				     rinfo->clause, &var, &name, &value);
+		if (!IsA(value, Const) || ((Const *)value)->constisnull ||
+		    type_is_array(((Const *)value)->consttype))
+			return -1;
+
+		getTypeOutputInfo(((Const *)value)->consttype, &typoutput,
+				  &typisvarlena);
+		foreach(lc2, partition_key_names) {
+			if (strcmp(strVal(lfirst(lc2)), strVal(name)) == 0)
+				values[foreach_current_index(lc2)] =
+					OidOutputFunctionCall(
+						typoutput,
+						((Const *)value)->constvalue);
+		}
+	}
+
+	foreach(lc, partition_key_names) {
+		if (values[foreach_current_index(lc)] == NULL)
+			return -1;
+	}
+
+	return get_partition_rows(rte->relid, values,
+				  list_length(partition_key_names));
+}
+
+/*
+ * Estimate the number of records read by the Scan with the given partition key
+ * conditions, or the secondary index condition if is_index is true, by
+ * counting them on the storage up to REMOTE_ESTIMATE_ROW_LIMIT.
+ *
+ * The counts are cached for remote_estimate_cache_ttl seconds. Returns a
+ * negative value if use_remote_estimate is disabled or any of the condition
+ * values is not a plan-time constant or is an IN list.
+ */
+static double estimate_remote_rows(PlannerInfo *root, RelOptInfo *baserel,
+				   List *remote_conds, bool is_index)
+{
+	ScalarDbFdwPlanState *fdw_private =
+		(ScalarDbFdwPlanState *)baserel->fdw_private;
+	ScalarDbFdwOptions *opts = &fdw_private->options;
+	RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
+	ScalarDbFdwScanCondition *conds;
+	StringInfoData key;
+	uint32 hash;
+	RemoteEstimateCacheEntry *entry;
+	bool found;
+	TimestampTz now;
+	jobject scan;
+	double rows;
+	ListCell *lc;
+	int i = 0;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (!opts->use_remote_estimate || remote_conds == NIL)
+		return -1;
+
+	conds = palloc(sizeof(ScalarDbFdwScanCondition) *
+		       list_length(remote_conds));
+	initStringInfo(&key);
+	appendStringInfo(&key, "%u %d", rte->relid, is_index);
+
+	foreach(lc, remote_conds) {
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		Var *var;
+		String *name;
+		Expr *value;
+		Oid typoutput;
+		bool typisvarlena;
+
+		split_condition_expr(baserel, &fdw_private->column_metadata,
+				     rinfo->clause, &var, &name, &value);
+		if (!IsA(value, Const) || ((Const *)value)->constisnull ||
+		    type_is_array(((Const *)value)->consttype))
+			return -1;
+
+		conds[i].name = strVal(name);
+		conds[i].value = ((Const *)value)->constvalue;
+		conds[i].value_type = ((Const *)value)->consttype;
+
+		getTypeOutputInfo(conds[i].value_type, &typoutput,
+				  &typisvarlena);
+		appendStringInfo(&key, " %s=%s", conds[i].name,
+				 OidOutputFunctionCall(typoutput,
+						       conds[i].value));
+		i++;
+	}
+
+	if (remote_estimate_cache == NULL) {
+		HASHCTL ctl;
+
+		ctl.keysize = sizeof(uint32);
+		ctl.entrysize = sizeof(RemoteEstimateCacheEntry);
+		remote_estimate_cache =
+			hash_create("scalardb_fdw remote estimates", 64, &ctl,
+				    HASH_ELEM | HASH_BLOBS);
+	}
+
+	hash = hash_bytes((unsigned char *)key.data, key.len);
+	entry = hash_search(remote_estimate_cache, &hash, HASH_FIND, NULL);
+	now = GetCurrentTimestamp();
+	/*
+	 * TimestampDifferenceExceeds() takes the milliseconds as int, which
+	 * overflows for a TTL longer than about 24 days.
+	 */
+	if (entry != NULL && strcmp(entry->key, key.data) == 0 &&
+	    now < TimestampTzPlusMilliseconds(
+			  entry->estimated_at,
+			  (int64)opts->remote_estimate_cache_ttl * 1000))
+		return entry->rows;
+
+	if (is_index) {
+		scan = scalardb_scan_with_index(opts->namespace,
+						opts->table_name, NIL, conds,
+						i, REMOTE_ESTIMATE_ROW_LIMIT);
+	} else {
+		ScalarDbFdwScanBoundary boundary = { 0 };
+
+		scan = scalardb_scan(opts->namespace, opts->table_name, NIL,
+				     conds, i, &boundary, NIL, NIL,
+				     REMOTE_ESTIMATE_ROW_LIMIT);
+	}
+	rows = Min(scalardb_count(scan, 100, false), REMOTE_ESTIMATE_ROW_LIMIT);
+	scalardb_release_scan(scan);
+
+	entry = hash_search(remote_estimate_cache, &hash, HASH_ENTER, &found);
+	if (found)
+		pfree(entry->key);
+	entry->key = MemoryContextStrdup(TopMemoryContext, key.data);
+	entry->rows = rows;
+	entry->estimated_at = now;
+
+	return rows;
+}
+
+/*
+ * Return the number of partitions read by the Scans with the given partition
+ * key conditions, which is the product of the lengths of their IN lists.
+ */
+static double count_partition_scans(RelOptInfo *baserel, List *remote_conds)
+{
+	ScalarDbFdwPlanState *fdw_private =
+		(ScalarDbFdwPlanState *)baserel->fdw_private;
+	double num_scans = 1;
+	ListCell *lc;
+
+	foreach(lc, remote_conds) {
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		Var *var;
+		String *name;
+		Expr *value;
+		ArrayType *array;
+
+		split_condition_expr(baserel, &fdw_private->column_metadata,
+				     rinfo->clause, &var, &name, &value);
+		if (!IsA(value, Const) ||
+		    !type_is_array(((Const *)value)->consttype))
+			continue;
+
+		array = DatumGetArrayTypeP(((Const *)value)->constvalue);
+		num_scans *= ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array));
+	}
+	return num_scans;
+}
+
+/*
+ * Return the selectivity of the restriction clauses of the relation other than
+ * the ones pushed down as the given remote_conds.
+ */
+static Selectivity other_conds_selectivity(PlannerInfo *root,
+					   RelOptInfo *baserel,
+					   List *remote_conds)
+{
+	return clauselist_selectivity(root,
+				      list_difference_ptr(
+					      baserel->baserestrictinfo,
+					      remote_conds),
+				      baserel->relid, JOIN_INNER, NULL);
+}
+
+/*
+ * Estimate the selectivity of the given equality condition on a secondary
+ * index.
+ *
+ * The number of distinct values of the column is taken from its n_distinct
+ * attribute option, which can be set with ALTER FOREIGN TABLE ... ALTER COLUMN
+ * ... SET (n_distinct = ...), or from the statistics if the foreign table has
+ * been ANALYZEd. As with ANALYZE, a negative value of the option is the ratio
+ * to the number of rows. Returns a negative value if the number of distinct
+ * values is unknown.
+ */
+Selectivity estimate_index_selectivity(PlannerInfo *root, RelOptInfo *baserel,
+				       RestrictInfo *index_cond)
+{
+	ScalarDbFdwPlanState *fdw_private =
+		(ScalarDbFdwPlanState *)baserel->fdw_private;
+	RangeTblEntry *rte = planner_rt_fetch(baserel->relid, root);
+	AttributeOpts *aopt;
+	Var *var;
+	String *name;
+	Expr *value;
+	double ndistinct;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	split_condition_expr(baserel, &fdw_private->column_metadata,
+			     index_cond->clause, &var, &name, &value);
+
+	aopt = get_attribute_options(rte->relid, var->varattno);
+	if (aopt != NULL && aopt->n_distinct != 0) {
+		ndistinct = aopt->n_distinct > 0 ?
+				    aopt->n_distinct :
+				    clamp_row_est(-aopt->n_distinct *
+						  baserel->tuples);
+	} else {
+		VariableStatData vardata;
+		bool isdefault;
+
+		examine_variable(root, (Node *)var, 0, &vardata);
+		if (!HeapTupleIsValid(vardata.statsTuple)) {
+			ReleaseVariableStats(vardata);
+			return -1;
+		}
+		ndistinct = get_variable_numdistinct(&vardata, &isdefault);
+		ReleaseVariableStats(vardata);
+	}
+
+	return 1.0 / ndistinct;
+}
+
+/*
+ * Estimate costs of a Scan with the given secondary index condition whose
+ * records are filtered by filter_conds on the ScalarDB side.
+ *
+ * Each record read by the index has to be fetched from the storage and checked
+ * against the filter conditions, while only the records that pass the filter
+ * are passed to PostgreSQL.
+ */
+void estimate_index_scan_costs(PlannerInfo *root, RelOptInfo *baserel,
+			       RestrictInfo *index_cond, List *filter_conds,
+			       double *rows, Cost *startup_cost,
+			       Cost *total_cost)
+{
+	Selectivity selectivity;
+	double fetched_rows;
+	ListCell *lc;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	fetched_rows = estimate_remote_rows(root, baserel,
+					    list_make1(index_cond), true);
+	if (fetched_rows < 0) {
+		selectivity =
+			estimate_index_selectivity(root, baserel, index_cond);
+		fetched_rows =
+			selectivity >= 0 ?
+				clamp_row_est(selectivity * baserel->tuples) :
+				DEFAULT_ROWS_FOR_PARTITION_KEY_SCAN;
+	}
+
+	*rows = fetched_rows;
+	foreach(lc, filter_conds) {
+		RestrictInfo *filter_cond = lfirst_node(RestrictInfo, lc);
+
+		selectivity =
+			estimate_index_selectivity(root, baserel, filter_cond);
+		*rows *= selectivity >= 0 ? selectivity : DEFAULT_EQ_SEL;
+	}
+	*rows = sampled_rows(baserel, *rows);
+
+	estimate_scan_costs(baserel, fetched_rows, rows, startup_cost,
+			    total_cost);
+
+	*total_cost += cpu_operator_cost * list_length(filter_conds) *
+		       fetched_rows;
+}
+
+/*
+ * Add the cost of sorting the results of a Scan (all) on the remote storage to
+ * the given costs.
+ *
+ * The storage has to sort all rows before it returns the first one, so the
+ * sort cost is charged to the startup cost as well. Unlike a local sort, this
+ * never spills to disk on the PostgreSQL side.
+ */
+void estimate_remote_sort_cost(double rows, Cost *startup_cost,
+			       Cost *total_cost)
+{
+	Cost sort_cost;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (rows < 2.0)
+		rows = 2.0;
+
+	sort_cost = REMOTE_SORT_COST_MULTIPLIER * 2.0 * cpu_operator_cost *
+		    rows * log2(rows);
+
+	*startup_cost += sort_cost;
+	*total_cost += sort_cost;
+}
+
+/*
+ * Estimate costs of computing aggregates on the ScalarDB side over a scan with
+ * the given costs.
+ *
+ * Each COUNT(*) reads the records of the scan remotely, while MIN and MAX read
+ * a single record with an ordered scan. Either way, only a single row is
+ * returned.
+ */
+void estimate_aggregate_costs(List *aggregate_types, Cost scan_startup_cost,
+			      Cost scan_total_cost, Cost *startup_cost,
+			      Cost *total_cost)
+{
+	ListCell *lc;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	*startup_cost = scan_startup_cost;
+	foreach(lc, aggregate_types) {
+		switch ((ScalarDbFdwAggregateType)lfirst_int(lc)) {
+		case SCALARDB_AGGREGATE_COUNT:
+			*startup_cost += REMOTE_COUNT_COST_FRACTION *
+					 (scan_total_cost - scan_startup_cost);
+			break;
+		case SCALARDB_AGGREGATE_MIN:
+		case SCALARDB_AGGREGATE_MAX:
+			*startup_cost += cpu_tuple_cost;
+			break;
+		}
+	}
+	*total_cost = *startup_cost + cpu_tuple_cost;
+}
+
+/*
+ * Measure the cost parameters of the scans on the given foreign table against
+ * the live storage.
+ *
+ * The startup cost is measured as the time to build a Scan (all), the round
+ * trip cost as the time to receive its first record, and the tuple cost as the
+ * time per record to read the rest of the records. Each of them is the
+ * shortest one of the given number of samples, converted to the cost units by
+ * cost_unit_ms, the time in milliseconds that corresponds to a cost of 1.0.
+ *
+ * Each sample reads all records of the table, so a call costs as many full
+ * table scans as the number of samples, and it is meant to be run by hand on
+ * a table of moderate size. The scan is closed if the call is canceled or
+ * fails.
+ */
+Datum scalardb_fdw_calibrate_costs(PG_FUNCTION_ARGS)
+{
+	Oid relid = PG_GETARG_OID(0);
+	double cost_unit_ms = PG_GETARG_FLOAT8(1);
+	int32 samples = PG_GETARG_INT32(2);
+	ScalarDbFdwOptions opts;
+	AclResult aclresult;
+	double startup_ms = -1;
+	double round_trip_ms = -1;
+	double tuple_ms = -1;
+	TupleDesc tupdesc;
+	Datum values[3];
+	bool nulls[3] = { false, false, false };
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (get_rel_relkind(relid) != RELKIND_FOREIGN_TABLE)
+		ereport(ERROR,
+			(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+			 errmsg("\"%s\" is not a foreign table",
+				get_rel_name(relid))));
+
+	aclresult = pg_class_aclcheck(relid, GetUserId(), ACL_SELECT);
+	if (aclresult != ACLCHECK_OK)
+		aclcheck_error(aclresult, OBJECT_FOREIGN_TABLE,
+			       get_rel_name(relid));
+
+	if (cost_unit_ms <= 0)
+		ereport(ERROR,
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("cost_unit_ms must be greater than zero")));
+	if (samples < 1)
+		ereport(ERROR,
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("samples must be greater than zero")));
+
+	get_scalardb_fdw_options(relid, &opts);
+	if (opts.namespace == NULL || opts.table_name == NULL)
+		ereport(ERROR,
+			(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+			 errmsg("\"%s\" is not a foreign table of scalardb_fdw",
+				get_rel_name(relid))));
+
+	scalardb_initialize(&opts);
+
+	for (int i = 0; i < samples; i++) {
+		instr_time start;
+		instr_time built;
+		instr_time first;
+		instr_time end;
+		jobject volatile scan = NULL;
+		jobject volatile scanner = NULL;
+		double rows = 0;
+		double elapsed;
+
+		CHECK_FOR_INTERRUPTS();
+
+		PG_TRY();
+		{
+			INSTR_TIME_SET_CURRENT(start);
+			scan = scalardb_scan_all(opts.namespace,
+						 opts.table_name, NIL, NIL,
+						 NIL);
+			INSTR_TIME_SET_CURRENT(built);
+			scanner = scalardb_start_scan(scan, 100, false, 0,
+						      false);
+			for (;;) {
+				bool is_present = scalardb_optional_is_present(
+					scalardb_scanner_one(scanner));
+
+				scalardb_scanner_release_result();
+				if (rows == 0)
+					INSTR_TIME_SET_CURRENT(first);
+				if (!is_present)
+					break;
+				rows++;
+				CHECK_FOR_INTERRUPTS();
+			}
+			INSTR_TIME_SET_CURRENT(end);
+		}
+		PG_FINALLY();
+		{
+			if (scanner != NULL)
+				scalardb_scanner_close(scanner);
+			if (scan != NULL)
+				scalardb_release_scan(scan);
+		}
+		PG_END_TRY();
+
+		INSTR_TIME_SUBTRACT(end, first);
+		INSTR_TIME_SUBTRACT(first, built);
+		INSTR_TIME_SUBTRACT(built, start);
+
+		elapsed = INSTR_TIME_GET_MILLISEC(built);
+		if (startup_ms < 0 || elapsed < startup_ms)
+			startup_ms = elapsed;
+		elapsed = INSTR_TIME_GET_MILLISEC(first);
+		if (round_trip_ms < 0 || elapsed < round_trip_ms)
+			round_trip_ms = elapsed;
+		elapsed = rows > 1 ? INSTR_TIME_GET_MILLISEC(end) / (rows - 1) :
+				     0;
+		if (tuple_ms < 0 || elapsed < tuple_ms)
+			tuple_ms = elapsed;
+	}
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	values[0] = Float8GetDatum(startup_ms / cost_unit_ms);
+	values[1] = Float8GetDatum(round_trip_ms / cost_unit_ms);
+	values[2] = Float8GetDatum(tuple_ms / cost_unit_ms);
+
+	PG_RETURN_DATUM(
+		HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
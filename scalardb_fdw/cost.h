@@ -20,10 +20,46 @@
 #include "postgres.h"
 #include "optimizer/pathnode.h"
 
+#include "option.h"
+
+/*
+ * Cost parameters of the scans on the storage of a foreign table.
+ */
+typedef struct {
+	/* cost of starting a Scan on the ScalarDB side */
+	Cost startup_cost;
+	/* cost of a round trip to the storage */
+	Cost round_trip_cost;
+	/* cost of transferring a record from the storage */
+	Cost tuple_cost;
+	/* number of records the storage returns in a round trip */
+	double rows_per_round_trip;
+} ScalarDbFdwScanCosts;
+
+extern void get_scan_costs(char *storage, ScalarDbFdwOptions *opts,
+			   ScalarDbFdwScanCosts *scan_costs);
+
 extern void estimate_size(PlannerInfo *root, RelOptInfo *baserel);
 
 extern void estimate_costs(PlannerInfo *root, RelOptInfo *baserel,
 			   List *remote_conds, double *rows, Cost *startup_cost,
 			   Cost *total_cost);
 
+extern Selectivity estimate_index_selectivity(PlannerInfo *root,
+					      RelOptInfo *baserel,
+					      RestrictInfo *index_cond);
+
+extern void estimate_index_scan_costs(PlannerInfo *root, RelOptInfo *baserel,
+				      RestrictInfo *index_cond,
+				      List *filter_conds, double *rows,
+				      Cost *startup_cost, Cost *total_cost);
+
+extern void estimate_remote_sort_cost(double rows, Cost *startup_cost,
+				      Cost *total_cost);
+
+extern void estimate_aggregate_costs(List *aggregate_types,
+				     Cost scan_startup_cost,
+				     Cost scan_total_cost, Cost *startup_cost,
+				     Cost *total_cost);
+
 #endif
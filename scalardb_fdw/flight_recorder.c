@@ -0,0 +1,377 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <time.h>
+
+#include "c.h"
+#include "postgres.h"
+
+#include "access/xact.h"
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "pgtime.h"
+#include "storage/fd.h"
+#include "storage/proc.h"
+#include "storage/procarray.h"
+#include "utils/builtins.h"
+#include "utils/timestamp.h"
+
+#include "backend_slots.h"
+#include "flight_recorder.h"
+#include "scalardb.h"
+
+/* Directory under the data directory where the recordings are written */
+#define FLIGHT_RECORDING_DIRECTORY "scalardb_fdw_jfr"
+
+typedef enum {
+	FLIGHT_RECORDING_REQUEST_NONE = 0,
+	FLIGHT_RECORDING_REQUEST_START,
+	FLIGHT_RECORDING_REQUEST_STOP,
+} ScalarDbFdwFlightRecordingRequest;
+
+/* A request from another backend and the file of the last recording */
+typedef struct {
+	/* the backend the request is for, 0 if the slot is not used */
+	int pid;
+	ScalarDbFdwFlightRecordingRequest request;
+	char settings[NAMEDATALEN];
+	char filename[MAXPGPATH];
+} ScalarDbFdwFlightRecorderSlot;
+
+static ScalarDbFdwBackendSlots *flight_recorder_slots = NULL;
+
+/* The file of the recording in progress in this backend, or NULL */
+static char *recording_filename = NULL;
+
+static char *start_recording(char *settings, char *filename);
+static char *stop_recording(void);
+static char *make_recording_filename(int pid);
+static void validate_settings(char *settings);
+static char *send_request(int pid, ScalarDbFdwFlightRecordingRequest request,
+			  char *settings, char *filename);
+static void clear_flight_recorder_slot(void *slot);
+
+PG_FUNCTION_INFO_V1(scalardb_fdw_start_flight_recording);
+PG_FUNCTION_INFO_V1(scalardb_fdw_stop_flight_recording);
+
+/*
+ * Request the shared memory through which the backends send the requests of
+ * the recordings to each other. The recordings of the other backends are
+ * available only if the module is loaded by shared_preload_libraries.
+ */
+extern void init_flight_recorder(void)
+{
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	flight_recorder_slots =
+		define_backend_slots("scalardb_fdw_flight_recorder",
+				     sizeof(ScalarDbFdwFlightRecorderSlot),
+				     clear_flight_recorder_slot);
+}
+
+/*
+ * Start or stop the recording of this backend if another backend has requested
+ * it. This is called at the points where the JVM is used by the foreign scans,
+ * so the request is handled while a long scan is running. A failure is
+ * reported as a warning so that the scan is not affected. The request is
+ * handled in a subtransaction, which cannot be started in parallel mode, so
+ * it is left pending until a foreign scan runs outside of a parallel query.
+ */
+extern void process_flight_recording_request(void)
+{
+	ScalarDbFdwFlightRecorderSlot *slot;
+	ScalarDbFdwFlightRecordingRequest request;
+	char settings[NAMEDATALEN];
+	char filename[MAXPGPATH];
+	MemoryContext oldcontext = CurrentMemoryContext;
+	ResourceOwner oldowner = CurrentResourceOwner;
+
+	slot = get_own_backend_slot(flight_recorder_slots);
+	/* Checked without the lock, since this is called for every tuple */
+	if (slot == NULL || slot->request == FLIGHT_RECORDING_REQUEST_NONE ||
+	    IsInParallelMode())
+		return;
+
+	LWLockAcquire(flight_recorder_slots->lock, LW_EXCLUSIVE);
+	request = slot->pid == MyProcPid ? slot->request :
+					   FLIGHT_RECORDING_REQUEST_NONE;
+	slot->request = FLIGHT_RECORDING_REQUEST_NONE;
+	strlcpy(settings, slot->settings, sizeof(settings));
+	strlcpy(filename, slot->filename, sizeof(filename));
+	LWLockRelease(flight_recorder_slots->lock);
+
+	if (request == FLIGHT_RECORDING_REQUEST_NONE)
+		return;
+
+	/* The requests that would fail anyway do not need a subtransaction */
+	if (request == FLIGHT_RECORDING_REQUEST_START &&
+	    recording_filename != NULL) {
+		ereport(WARNING,
+			errmsg("could not start the flight recording requested by another backend: a flight recording to \"%s\" is already in progress",
+			       recording_filename));
+		return;
+	}
+	if (request == FLIGHT_RECORDING_REQUEST_STOP &&
+	    recording_filename == NULL) {
+		ereport(WARNING,
+			errmsg("could not stop the flight recording requested by another backend: no flight recording is in progress"));
+		return;
+	}
+
+	/*
+	 * The JVM may fail to start or stop the recording, and the error is
+	 * rolled back with a subtransaction so that the scan can continue.
+	 */
+	BeginInternalSubTransaction(NULL);
+	MemoryContextSwitchTo(oldcontext);
+
+	PG_TRY();
+	{
+		if (request == FLIGHT_RECORDING_REQUEST_START)
+			start_recording(settings, filename);
+		else
+			stop_recording();
+
+		ReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcontext);
+		CurrentResourceOwner = oldowner;
+	}
+	PG_CATCH();
+	{
+		ErrorData *edata;
+
+		MemoryContextSwitchTo(oldcontext);
+		edata = CopyErrorData();
+		FlushErrorState();
+
+		RollbackAndReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcontext);
+		CurrentResourceOwner = oldowner;
+
+		ereport(WARNING,
+			errmsg("could not %s the flight recording requested by another backend: %s",
+			       request == FLIGHT_RECORDING_REQUEST_START ?
+				       "start" :
+				       "stop",
+			       edata->message));
+		FreeErrorData(edata);
+	}
+	PG_END_TRY();
+}
+
+/*
+ * Start a recording of the JVM of the backend with the given pid, or of this
+ * backend if pid is NULL, and return the file the recording is written to when
+ * it is stopped.
+ *
+ * The request to another backend is asynchronous. The backend starts the
+ * recording when it next uses a ScalarDB foreign table, and only reports the
+ * outcome to its server log, so the file is returned even if the recording is
+ * never started.
+ */
+Datum scalardb_fdw_start_flight_recording(PG_FUNCTION_ARGS)
+{
+	int pid;
+	char *settings;
+	char *filename;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	pid = PG_ARGISNULL(0) ? MyProcPid : PG_GETARG_INT32(0);
+	if (PG_ARGISNULL(1))
+		ereport(ERROR, errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+			errmsg("settings must not be NULL"));
+	settings = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	validate_settings(settings);
+
+	filename = make_recording_filename(pid);
+	if (pid == MyProcPid)
+		start_recording(settings, filename);
+	else
+		send_request(pid, FLIGHT_RECORDING_REQUEST_START, settings,
+			     filename);
+
+	PG_RETURN_TEXT_P(cstring_to_text(filename));
+}
+
+/*
+ * Stop the recording of the JVM of the backend with the given pid, or of this
+ * backend if pid is NULL, and return the file the recording is written to.
+ *
+ * The request to another backend is asynchronous like the one to start a
+ * recording. The file of the last recording requested of the backend is
+ * returned, which is written only after the backend handles the request, or
+ * NULL if no recording has been requested of it.
+ */
+Datum scalardb_fdw_stop_flight_recording(PG_FUNCTION_ARGS)
+{
+	int pid;
+	char *filename;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	pid = PG_ARGISNULL(0) ? MyProcPid : PG_GETARG_INT32(0);
+	if (pid == MyProcPid)
+		filename = stop_recording();
+	else
+		filename = send_request(pid, FLIGHT_RECORDING_REQUEST_STOP,
+					NULL, NULL);
+
+	if (filename == NULL)
+		PG_RETURN_NULL();
+	PG_RETURN_TEXT_P(cstring_to_text(filename));
+}
+
+/*
+ * Start the recording of this backend and remember its file, which is also
+ * published to the shared memory for the backend that stops it.
+ */
+static char *start_recording(char *settings, char *filename)
+{
+	ScalarDbFdwFlightRecorderSlot *slot;
+	char *output;
+
+	if (recording_filename != NULL)
+		ereport(ERROR,
+			errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			errmsg("a flight recording to \"%s\" is already in progress",
+			       recording_filename));
+
+	output = scalardb_start_flight_recording(settings, filename);
+	recording_filename = MemoryContextStrdup(TopMemoryContext, filename);
+	ereport(LOG, errmsg("started the flight recording to \"%s\"", filename),
+		errdetail_internal("%s", output));
+
+	slot = get_own_backend_slot(flight_recorder_slots);
+	if (slot != NULL) {
+		LWLockAcquire(flight_recorder_slots->lock, LW_EXCLUSIVE);
+		slot->pid = MyProcPid;
+		strlcpy(slot->filename, filename, sizeof(slot->filename));
+		LWLockRelease(flight_recorder_slots->lock);
+	}
+	return recording_filename;
+}
+
+/* Stop the recording of this backend and return its file */
+static char *stop_recording(void)
+{
+	char *filename = recording_filename;
+	char *output;
+
+	if (filename == NULL)
+		ereport(ERROR,
+			errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			errmsg("no flight recording is in progress"));
+
+	output = scalardb_stop_flight_recording();
+	recording_filename = NULL;
+	ereport(LOG, errmsg("stopped the flight recording to \"%s\"", filename),
+		errdetail_internal("%s", output));
+	return filename;
+}
+
+/*
+ * Return the absolute path of a new recording of the backend with the given
+ * pid, named by the pid and the current time, creating the directory of the
+ * recordings if it does not exist.
+ */
+static char *make_recording_filename(int pid)
+{
+	char *directory;
+	char timestamp[32];
+	pg_time_t now = (pg_time_t)time(NULL);
+
+	directory = psprintf("%s/%s", DataDir, FLIGHT_RECORDING_DIRECTORY);
+	if (MakePGDirectory(directory) < 0 && errno != EEXIST)
+		ereport(ERROR, errcode_for_file_access(),
+			errmsg("could not create directory \"%s\": %m",
+			       directory));
+
+	pg_strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S",
+		    pg_localtime(&now, log_timezone));
+	return psprintf("%s/%d_%s.jfr", directory, pid, timestamp);
+}
+
+/*
+ * Only the settings shipped with the JVM are accepted, since the name is passed
+ * to the diagnostic command of the JVM as is.
+ */
+static void validate_settings(char *settings)
+{
+	if (strcmp(settings, "default") != 0 &&
+	    strcmp(settings, "profile") != 0)
+		ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			errmsg("invalid flight recording settings \"%s\"",
+			       settings),
+			errhint("Valid settings are \"default\" and \"profile\"."));
+}
+
+/*
+ * Send the request to the backend with the given pid through its slot, which
+ * the backend checks when it next uses a ScalarDB foreign table. An idle
+ * backend is not woken up, since it does not check the slot until it runs a
+ * query. Returns the file of the last recording requested of the backend.
+ */
+static char *send_request(int pid, ScalarDbFdwFlightRecordingRequest request,
+			  char *settings, char *filename)
+{
+	PGPROC *proc;
+	ScalarDbFdwFlightRecorderSlot *slot;
+	char *last_filename = NULL;
+
+	if (flight_recorder_slots == NULL ||
+	    flight_recorder_slots->lock == NULL)
+		ereport(ERROR,
+			errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			errmsg("flight recordings of other backends require scalardb_fdw in shared_preload_libraries"));
+
+	proc = BackendPidGetProc(pid);
+	slot = proc != NULL ? get_backend_slot(flight_recorder_slots,
+					       proc->backendId) :
+			      NULL;
+	if (slot == NULL)
+		ereport(ERROR, errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			errmsg("PID %d is not a PostgreSQL backend process",
+			       pid));
+
+	LWLockAcquire(flight_recorder_slots->lock, LW_EXCLUSIVE);
+	if (slot->pid != pid) {
+		slot->pid = pid;
+		slot->filename[0] = '\0';
+	}
+	slot->request = request;
+	if (settings != NULL)
+		strlcpy(slot->settings, settings, sizeof(slot->settings));
+	if (filename != NULL)
+		strlcpy(slot->filename, filename, sizeof(slot->filename));
+	if (slot->filename[0] != '\0')
+		last_filename = pstrdup(slot->filename);
+	LWLockRelease(flight_recorder_slots->lock);
+
+	return last_filename;
+}
+
+/* Clear the slot unless another backend has taken it over */
+static void clear_flight_recorder_slot(void *slot)
+{
+	ScalarDbFdwFlightRecorderSlot *own_slot =
+		(ScalarDbFdwFlightRecorderSlot *)slot;
+
+	if (own_slot->pid == MyProcPid) {
+		own_slot->pid = 0;
+		own_slot->request = FLIGHT_RECORDING_REQUEST_NONE;
+	}
+}
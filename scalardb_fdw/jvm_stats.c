@@ -0,0 +1,222 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "c.h"
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+#include "backend_slots.h"
+#include "jvm_stats.h"
+#include "scalardb.h"
+
+/* Minimum interval between the reports of a backend in milliseconds */
+#define JVM_STATS_REPORT_INTERVAL 1000
+
+/*
+ * Number of the columns of scalardb_fdw_jvm_stats(), the pid followed by the
+ * statistics
+ */
+#define JVM_STATS_COLS (SCALARDB_JVM_STATS_NUM + 1)
+
+/* Statistics of the JVM of a backend, last reported by the backend */
+typedef struct {
+	/* 0 if the slot is not used */
+	int pid;
+	TimestampTz reported_at;
+	int64 stats[SCALARDB_JVM_STATS_NUM];
+} ScalarDbFdwJvmStatsSlot;
+
+static ScalarDbFdwBackendSlots *jvm_stats_slots = NULL;
+static TimestampTz last_reported_at = 0;
+
+static void clear_jvm_stats_slot(void *slot);
+static void put_jvm_stats_values(Datum *values, bool *nulls, int pid,
+				 int64 *stats);
+
+PG_FUNCTION_INFO_V1(scalardb_fdw_jvm_stats);
+PG_FUNCTION_INFO_V1(scalardb_fdw_jvm_stats_all);
+
+/*
+ * Request the shared memory where the backends report the statistics of their
+ * JVMs. The statistics of the other backends are available only if the module
+ * is loaded by shared_preload_libraries.
+ */
+extern void init_jvm_stats(void)
+{
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	jvm_stats_slots =
+		define_backend_slots("scalardb_fdw_jvm_stats",
+				     sizeof(ScalarDbFdwJvmStatsSlot),
+				     clear_jvm_stats_slot);
+}
+
+/*
+ * Report the statistics of the JVM of this backend to the shared memory. The
+ * reports are throttled to one per JVM_STATS_REPORT_INTERVAL unless force is
+ * true. Nothing is reported if the JVM has not been started.
+ */
+extern void report_jvm_stats(bool force)
+{
+	TimestampTz now;
+	int64 stats[SCALARDB_JVM_STATS_NUM];
+	ScalarDbFdwJvmStatsSlot *slot;
+
+	if (get_backend_slot(jvm_stats_slots, MyBackendId) == NULL)
+		return;
+
+	now = GetCurrentTimestamp();
+	if (!force && !TimestampDifferenceExceeds(last_reported_at, now,
+						  JVM_STATS_REPORT_INTERVAL))
+		return;
+
+	if (!scalardb_get_jvm_stats(stats))
+		return;
+	last_reported_at = now;
+
+	slot = get_own_backend_slot(jvm_stats_slots);
+	LWLockAcquire(jvm_stats_slots->lock, LW_EXCLUSIVE);
+	slot->pid = MyProcPid;
+	slot->reported_at = now;
+	memcpy(slot->stats, stats, sizeof(stats));
+	LWLockRelease(jvm_stats_slots->lock);
+}
+
+/*
+ * Return the statistics of the JVM of this backend, or no row if the JVM has
+ * not been started.
+ */
+Datum scalardb_fdw_jvm_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	int64 stats[SCALARDB_JVM_STATS_NUM];
+	Datum values[JVM_STATS_COLS];
+	bool nulls[JVM_STATS_COLS];
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) ||
+	    !(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("materialize mode required, but it is not allowed in this context")));
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	oldcontext =
+		MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(oldcontext);
+
+	if (scalardb_get_jvm_stats(stats)) {
+		put_jvm_stats_values(values, nulls, MyProcPid, stats);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		report_jvm_stats(true);
+	}
+
+	return (Datum)0;
+}
+
+/*
+ * Return the statistics of the JVMs last reported by the backends, including
+ * this one, with the time of the reports. No row is returned if the module is
+ * not loaded by shared_preload_libraries.
+ */
+Datum scalardb_fdw_jvm_stats_all(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	Datum values[JVM_STATS_COLS + 1];
+	bool nulls[JVM_STATS_COLS + 1];
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) ||
+	    !(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("materialize mode required, but it is not allowed in this context")));
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	oldcontext =
+		MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(oldcontext);
+
+	if (jvm_stats_slots == NULL || jvm_stats_slots->lock == NULL)
+		return (Datum)0;
+
+	report_jvm_stats(true);
+
+	LWLockAcquire(jvm_stats_slots->lock, LW_SHARED);
+	for (int i = 1; i <= jvm_stats_slots->num_slots; i++) {
+		ScalarDbFdwJvmStatsSlot *slot =
+			get_backend_slot(jvm_stats_slots, i);
+
+		if (slot->pid == 0)
+			continue;
+
+		put_jvm_stats_values(values, nulls, slot->pid, slot->stats);
+		values[JVM_STATS_COLS] = TimestampTzGetDatum(slot->reported_at);
+		nulls[JVM_STATS_COLS] = false;
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	LWLockRelease(jvm_stats_slots->lock);
+
+	return (Datum)0;
+}
+
+/*
+ * Set the pid and the statistics to the columns of scalardb_fdw_jvm_stats().
+ * The maximum heap size is NULL if it is undefined.
+ */
+static void put_jvm_stats_values(Datum *values, bool *nulls, int pid,
+				 int64 *stats)
+{
+	values[0] = Int32GetDatum(pid);
+	nulls[0] = false;
+	for (int i = 0; i < SCALARDB_JVM_STATS_NUM; i++) {
+		values[i + 1] = Int64GetDatum(stats[i]);
+		nulls[i + 1] = false;
+	}
+	/* heap_max */
+	nulls[3] = stats[2] < 0;
+}
+
+static void clear_jvm_stats_slot(void *slot)
+{
+	((ScalarDbFdwJvmStatsSlot *)slot)->pid = 0;
+}
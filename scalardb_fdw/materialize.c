@@ -0,0 +1,305 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "c.h"
+#include "postgres.h"
+
+#include "access/table.h"
+#include "catalog/namespace.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_type_d.h"
+#include "datatype/timestamp.h"
+#include "executor/spi.h"
+#include "fmgr.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
+#include "utils/guc.h"
+#include "utils/relcache.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+
+#include "materialize.h"
+#include "option.h"
+#include "partition_stats.h"
+
+#define MATERIALIZATIONS_TABLE_NAME "scalardb_fdw_materializations"
+
+/*
+ * Time in milliseconds before the start of a copy from which the next
+ * incremental copy reads the changes
+ */
+static int watermark_margin = 60000;
+
+static char *get_column_list(Relation rel, const char *prefix);
+static int64 get_current_epoch_ms(void);
+static Oid get_materializations_owner(const char *schema_name);
+static int execute_as_owner(Oid owner, const char *sql, int nargs,
+			    Oid *argtypes, Datum *values, long count);
+
+/*
+ * Define the parameters of the incremental copies.
+ */
+extern void init_materialize(void)
+{
+	DefineCustomIntVariable(
+		"scalardb_fdw.materialize_watermark_margin",
+		"Sets how long before the start of a copy the next incremental copy reads the changes from.",
+		"The commit times of ScalarDB are taken by the clocks of its clients, so this must exceed the clock skew between them and PostgreSQL. The records committed within the margin are upserted again.",
+		&watermark_margin, 60000, 0, INT_MAX, PGC_USERSET, GUC_UNIT_MS,
+		NULL, NULL, NULL);
+}
+
+PG_FUNCTION_INFO_V1(scalardb_fdw_materialize);
+
+/*
+ * Copy the records of a foreign table into a local table.
+ *
+ * The first call copies all the records. For a transaction-aware foreign
+ * table, the time at which the copy started minus
+ * scalardb_fdw.materialize_watermark_margin is saved as the watermark, and the
+ * later incremental calls upsert only the records committed after the
+ * watermark, which are identified by the primary key of the local table. The
+ * watermarks are read and saved as the owner of their table, so the caller
+ * needs only the privileges on the foreign and the local tables.
+ * Records deleted from ScalarDB are not removed from the local table until a
+ * full copy is made with incremental => false. Returns the number of the
+ * copied records.
+ */
+Datum scalardb_fdw_materialize(PG_FUNCTION_ARGS)
+{
+	Oid foreign_relid = PG_GETARG_OID(0);
+	Oid local_relid = PG_GETARG_OID(1);
+	bool incremental = PG_GETARG_BOOL(2);
+	ScalarDbFdwOptions opts;
+	Relation foreign_rel;
+	Relation local_rel;
+	char *schema_name;
+	char *foreign_table_name;
+	char *local_table_name;
+	char *materializations_table_name;
+	char *columns;
+	Oid materializations_owner;
+	int64 started_at;
+	int64 watermark = 0;
+	bool has_watermark = false;
+	Oid argtypes[3] = { OIDOID, OIDOID, INT8OID };
+	Datum values[3];
+	StringInfoData sql;
+	uint64 rows;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (get_rel_relkind(foreign_relid) != RELKIND_FOREIGN_TABLE)
+		ereport(ERROR,
+			(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+			 errmsg("\"%s\" is not a foreign table",
+				get_rel_name(foreign_relid))));
+
+	get_scalardb_fdw_options(foreign_relid, &opts);
+	if (opts.namespace == NULL || opts.table_name == NULL)
+		ereport(ERROR,
+			(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+			 errmsg("\"%s\" is not a foreign table of scalardb_fdw",
+				get_rel_name(foreign_relid))));
+
+	if (get_rel_relkind(local_relid) != RELKIND_RELATION &&
+	    get_rel_relkind(local_relid) != RELKIND_PARTITIONED_TABLE)
+		ereport(ERROR,
+			(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+			 errmsg("\"%s\" is not a table",
+				get_rel_name(local_relid))));
+
+	/*
+	 * The records committed while they are copied are copied again by the
+	 * next incremental call, so the watermark is taken before the copy. The
+	 * commit times are taken by the clocks of the ScalarDB clients, which
+	 * may be behind the clock of PostgreSQL, so the watermark is moved back
+	 * by the margin.
+	 */
+	started_at = get_current_epoch_ms() - watermark_margin;
+
+	foreign_rel = table_open(foreign_relid, AccessShareLock);
+	local_rel = table_open(local_relid, RowExclusiveLock);
+
+	SPI_connect();
+
+	schema_name = get_extension_schema();
+	foreign_table_name = quote_qualified_identifier(
+		get_namespace_name(RelationGetNamespace(foreign_rel)),
+		RelationGetRelationName(foreign_rel));
+	local_table_name = quote_qualified_identifier(
+		get_namespace_name(RelationGetNamespace(local_rel)),
+		RelationGetRelationName(local_rel));
+	materializations_table_name = quote_qualified_identifier(
+		schema_name, MATERIALIZATIONS_TABLE_NAME);
+	materializations_owner = get_materializations_owner(schema_name);
+	columns = get_column_list(foreign_rel, NULL);
+
+	values[0] = ObjectIdGetDatum(foreign_relid);
+	values[1] = ObjectIdGetDatum(local_relid);
+
+	initStringInfo(&sql);
+
+	/* Concurrent calls for the same tables wait for each other here */
+	if (opts.transaction_aware && incremental) {
+		appendStringInfo(
+			&sql,
+			"SELECT committed_at FROM %s WHERE foreign_table = $1 AND local_table = $2 FOR UPDATE",
+			materializations_table_name);
+		if (execute_as_owner(materializations_owner, sql.data, 2,
+				     argtypes, values, 1) == SPI_OK_SELECT &&
+		    SPI_processed == 1) {
+			bool isnull;
+			Datum datum = SPI_getbinval(SPI_tuptable->vals[0],
+						    SPI_tuptable->tupdesc, 1,
+						    &isnull);
+
+			if (!isnull) {
+				watermark = DatumGetInt64(datum);
+				has_watermark = true;
+			}
+		}
+	}
+
+	resetStringInfo(&sql);
+	if (has_watermark) {
+		Oid pk_index = RelationGetPrimaryKeyIndex(local_rel);
+
+		if (!OidIsValid(pk_index))
+			ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("\"%s\" has no primary key",
+					RelationGetRelationName(local_rel)),
+				 errhint("Incremental refresh upserts the changed records by the primary key of the local table. Use incremental => false to copy all the records.")));
+
+		values[2] = Int64GetDatum(watermark);
+		appendStringInfo(
+			&sql,
+			"INSERT INTO %s (%s) SELECT %s FROM %s.scalardb_fdw_changes(NULL::%s, $3) ON CONFLICT ON CONSTRAINT %s DO UPDATE SET (%s) = ROW(%s)",
+			local_table_name, columns, columns,
+			quote_identifier(schema_name), foreign_table_name,
+			quote_identifier(get_rel_name(pk_index)), columns,
+			get_column_list(foreign_rel, "EXCLUDED."));
+		SPI_execute_with_args(sql.data, 3, argtypes, values, NULL,
+				      false, 0);
+	} else {
+		appendStringInfo(&sql, "DELETE FROM %s", local_table_name);
+		SPI_execute(sql.data, false, 0);
+
+		resetStringInfo(&sql);
+		appendStringInfo(&sql, "INSERT INTO %s (%s) SELECT %s FROM %s",
+				 local_table_name, columns, columns,
+				 foreign_table_name);
+		SPI_execute(sql.data, false, 0);
+	}
+	rows = SPI_processed;
+
+	if (opts.transaction_aware) {
+		values[2] = Int64GetDatum(started_at);
+		resetStringInfo(&sql);
+		appendStringInfo(
+			&sql,
+			"INSERT INTO %s VALUES ($1, $2, $3) ON CONFLICT (foreign_table, local_table) DO UPDATE SET committed_at = EXCLUDED.committed_at",
+			materializations_table_name);
+		execute_as_owner(materializations_owner, sql.data, 3, argtypes,
+				 values, 0);
+	}
+
+	SPI_finish();
+
+	table_close(local_rel, NoLock);
+	table_close(foreign_rel, NoLock);
+
+	PG_RETURN_INT64((int64)rows);
+}
+
+/*
+ * Return the comma-separated list of the columns of the relation, each of
+ * which is qualified by prefix if it is not NULL.
+ */
+static char *get_column_list(Relation rel, const char *prefix)
+{
+	TupleDesc tupdesc = RelationGetDescr(rel);
+	StringInfoData columns;
+
+	initStringInfo(&columns);
+	for (int i = 0; i < tupdesc->natts; i++) {
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+		if (attr->attisdropped)
+			continue;
+		appendStringInfo(&columns, "%s%s%s", columns.len > 0 ? ", " : "",
+				 prefix ? prefix : "",
+				 quote_identifier(NameStr(attr->attname)));
+	}
+	return columns.data;
+}
+
+/*
+ * Return the current time in milliseconds since the Unix epoch, which is the
+ * unit of tx_committed_at of ScalarDB.
+ */
+static int64 get_current_epoch_ms(void)
+{
+	return GetCurrentTimestamp() / 1000 +
+	       (int64)(POSTGRES_EPOCH_JDATE - UNIX_EPOCH_JDATE) * SECS_PER_DAY *
+		       1000;
+}
+
+/*
+ * Return the owner of the table of the watermarks in the schema of the
+ * extension.
+ */
+static Oid get_materializations_owner(const char *schema_name)
+{
+	Oid relid = get_relname_relid(MATERIALIZATIONS_TABLE_NAME,
+				      get_namespace_oid(schema_name, false));
+	HeapTuple tuple;
+	Oid owner;
+
+	tuple = SearchSysCache1(RELOID, ObjectIdGetDatum(relid));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for relation %u", relid);
+	owner = ((Form_pg_class)GETSTRUCT(tuple))->relowner;
+	ReleaseSysCache(tuple);
+
+	return owner;
+}
+
+/*
+ * Execute the SQL on the table of the watermarks as its owner. The user is
+ * restored on error by the abort of the transaction.
+ */
+static int execute_as_owner(Oid owner, const char *sql, int nargs,
+			    Oid *argtypes, Datum *values, long count)
+{
+	Oid save_userid;
+	int save_sec_context;
+	int ret;
+
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+	SetUserIdAndSecContext(owner, save_sec_context |
+					      SECURITY_LOCAL_USERID_CHANGE |
+					      SECURITY_RESTRICTED_OPERATION);
+	ret = SPI_execute_with_args(sql, nargs, argtypes, values, NULL, false,
+				    count);
+	SetUserIdAndSecContext(save_userid, save_sec_context);
+
+	return ret;
+}
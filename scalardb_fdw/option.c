@@ -27,10 +27,13 @@
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "utils/acl.h"
+#include "utils/guc.h"
 #include "utils/rel.h"
 
 #include "option.h"
 
+#define DEFAULT_REMOTE_ESTIMATE_CACHE_TTL 60
+
 /*
  * Describes the valid options for objects that use this wrapper.
  */
@@ -45,15 +48,33 @@ struct OptionEntry {
 static struct OptionEntry valid_options[] = {
 	{ "config_file_path", ForeignServerRelationId },
 	{ "max_heap_size", ForeignServerRelationId },
+	{ "fdw_startup_cost", ForeignServerRelationId },
+	{ "fdw_round_trip_cost", ForeignServerRelationId },
+	{ "fdw_tuple_cost", ForeignServerRelationId },
+	{ "use_remote_estimate", ForeignServerRelationId },
+	{ "remote_estimate_cache_ttl", ForeignServerRelationId },
 
 	{ "namespace", ForeignTableRelationId },
 	{ "table_name", ForeignTableRelationId },
+	{ "fdw_startup_cost", ForeignTableRelationId },
+	{ "fdw_round_trip_cost", ForeignTableRelationId },
+	{ "fdw_tuple_cost", ForeignTableRelationId },
+	{ "use_remote_estimate", ForeignTableRelationId },
+	{ "remote_estimate_cache_ttl", ForeignTableRelationId },
+	{ "sample_percent", ForeignTableRelationId },
+	{ "transaction_aware", ForeignTableRelationId },
+	{ "result_cache_ttl", ForeignTableRelationId },
+	{ "late_materialization", ForeignTableRelationId },
+	{ "scan_all_splits", ForeignTableRelationId },
+	{ "fetch_size", ForeignTableRelationId },
+	{ "adaptive_fetch", ForeignTableRelationId },
 
 	/* Sentinel */
 	{ NULL, InvalidOid }
 };
 
 static bool is_valid_option(const char *option, Oid context);
+static bool is_cost_option(const char *option);
 
 PG_FUNCTION_INFO_V1(scalardb_fdw_validator);
 
@@ -126,6 +147,60 @@ Datum scalardb_fdw_validator(PG_FUNCTION_ARGS)
 			namespace = defGetString(def);
 		} else if (strcmp(def->defname, "table_name") == 0) {
 			table_name = defGetString(def);
+		} else if (is_cost_option(def->defname)) {
+			char *value = defGetString(def);
+			double real_val;
+
+			if (!parse_real(value, &real_val, 0, NULL))
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("invalid value for floating point option \"%s\": %s",
+						def->defname, value)));
+			if (real_val < 0)
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("\"%s\" must be a floating point value greater than or equal to zero",
+						def->defname)));
+		} else if (strcmp(def->defname, "use_remote_estimate") == 0) {
+			/* just check the syntax */
+			(void)defGetBoolean(def);
+		} else if (strcmp(def->defname, "remote_estimate_cache_ttl") ==
+				   0 ||
+			   strcmp(def->defname, "result_cache_ttl") == 0 ||
+			   strcmp(def->defname, "scan_all_splits") == 0 ||
+			   strcmp(def->defname, "fetch_size") == 0) {
+			char *value = defGetString(def);
+			int int_val;
+
+			if (!parse_int(value, &int_val, 0, NULL))
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("invalid value for integer option \"%s\": %s",
+						def->defname, value)));
+			if (int_val < 0)
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("\"%s\" must be an integer value greater than or equal to zero",
+						def->defname)));
+		} else if (strcmp(def->defname, "sample_percent") == 0) {
+			char *value = defGetString(def);
+			double real_val;
+
+			if (!parse_real(value, &real_val, 0, NULL))
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("invalid value for floating point option \"%s\": %s",
+						def->defname, value)));
+			if (real_val <= 0 || real_val > 100)
+				ereport(ERROR,
+					(errcode(ERRCODE_SYNTAX_ERROR),
+					 errmsg("\"%s\" must be a floating point value greater than zero and less than or equal to 100",
+						def->defname)));
+		} else if (strcmp(def->defname, "transaction_aware") == 0 ||
+			   strcmp(def->defname, "late_materialization") == 0 ||
+			   strcmp(def->defname, "adaptive_fetch") == 0) {
+			/* just check the syntax */
+			(void)defGetBoolean(def);
 		}
 	}
 
@@ -169,9 +244,20 @@ static bool is_valid_option(const char *option, Oid context)
 	return false;
 }
 
+/*
+ * Check if the provided option is one of the options for the cost parameters.
+ */
+static bool is_cost_option(const char *option)
+{
+	return strcmp(option, "fdw_startup_cost") == 0 ||
+	       strcmp(option, "fdw_round_trip_cost") == 0 ||
+	       strcmp(option, "fdw_tuple_cost") == 0;
+}
+
 /*
  * Fetch all options for the foreign table.
  *
+ * Options of the foreign table override the ones of the foreign server.
  */
 void get_scalardb_fdw_options(Oid foreigntableid, ScalarDbFdwOptions *opts)
 {
@@ -185,6 +271,18 @@ void get_scalardb_fdw_options(Oid foreigntableid, ScalarDbFdwOptions *opts)
 	opts->max_heap_size = NULL;
 	opts->namespace = NULL;
 	opts->table_name = NULL;
+	opts->fdw_startup_cost = -1;
+	opts->fdw_round_trip_cost = -1;
+	opts->fdw_tuple_cost = -1;
+	opts->use_remote_estimate = false;
+	opts->remote_estimate_cache_ttl = DEFAULT_REMOTE_ESTIMATE_CACHE_TTL;
+	opts->sample_percent = 100;
+	opts->transaction_aware = false;
+	opts->result_cache_ttl = 0;
+	opts->late_materialization = false;
+	opts->scan_all_splits = 0;
+	opts->fetch_size = 0;
+	opts->adaptive_fetch = false;
 
 	table = GetForeignTable(foreigntableid);
 	server = GetForeignServer(table->serverid);
@@ -206,6 +304,40 @@ void get_scalardb_fdw_options(Oid foreigntableid, ScalarDbFdwOptions *opts)
 			opts->namespace = defGetString(def);
 		} else if (strcmp(def->defname, "table_name") == 0) {
 			opts->table_name = defGetString(def);
+		} else if (strcmp(def->defname, "fdw_startup_cost") == 0) {
+			(void)parse_real(defGetString(def),
+					 &opts->fdw_startup_cost, 0, NULL);
+		} else if (strcmp(def->defname, "fdw_round_trip_cost") == 0) {
+			(void)parse_real(defGetString(def),
+					 &opts->fdw_round_trip_cost, 0, NULL);
+		} else if (strcmp(def->defname, "fdw_tuple_cost") == 0) {
+			(void)parse_real(defGetString(def),
+					 &opts->fdw_tuple_cost, 0, NULL);
+		} else if (strcmp(def->defname, "use_remote_estimate") == 0) {
+			opts->use_remote_estimate = defGetBoolean(def);
+		} else if (strcmp(def->defname, "remote_estimate_cache_ttl") ==
+			   0) {
+			(void)parse_int(defGetString(def),
+					&opts->remote_estimate_cache_ttl, 0,
+					NULL);
+		} else if (strcmp(def->defname, "sample_percent") == 0) {
+			(void)parse_real(defGetString(def),
+					 &opts->sample_percent, 0, NULL);
+		} else if (strcmp(def->defname, "transaction_aware") == 0) {
+			opts->transaction_aware = defGetBoolean(def);
+		} else if (strcmp(def->defname, "result_cache_ttl") == 0) {
+			(void)parse_int(defGetString(def),
+					&opts->result_cache_ttl, 0, NULL);
+		} else if (strcmp(def->defname, "late_materialization") == 0) {
+			opts->late_materialization = defGetBoolean(def);
+		} else if (strcmp(def->defname, "scan_all_splits") == 0) {
+			(void)parse_int(defGetString(def),
+					&opts->scan_all_splits, 0, NULL);
+		} else if (strcmp(def->defname, "fetch_size") == 0) {
+			(void)parse_int(defGetString(def), &opts->fetch_size, 0,
+					NULL);
+		} else if (strcmp(def->defname, "adaptive_fetch") == 0) {
+			opts->adaptive_fetch = defGetBoolean(def);
 		}
 	}
 }
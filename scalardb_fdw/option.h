@@ -26,6 +26,52 @@ typedef struct {
 
 	char *namespace;
 	char *table_name;
+
+	/* Cost parameters of the scans. Negative if not specified */
+	double fdw_startup_cost;
+	double fdw_round_trip_cost;
+	double fdw_tuple_cost;
+
+	/* Whether the rows of a Scan are estimated by counting them remotely */
+	bool use_remote_estimate;
+	/* Seconds for which the remote estimates are cached */
+	int remote_estimate_cache_ttl;
+
+	/* Percentage of the partitions returned by the Scans */
+	double sample_percent;
+
+	/*
+	 * Whether the table is a Consensus Commit table whose committed values
+	 * are resolved on the ScalarDB side
+	 */
+	bool transaction_aware;
+
+	/* Seconds for which the results of partition key scans are cached */
+	int result_cache_ttl;
+
+	/*
+	 * Whether the local conditions are evaluated on the columns they refer
+	 * to before the other columns of each record are retrieved
+	 */
+	bool late_materialization;
+
+	/*
+	 * Number of ranges that Scan (all) is split into to be read
+	 * concurrently. 0 or 1 disables the split
+	 */
+	int scan_all_splits;
+
+	/*
+	 * Maximum number of records read by each remote request of a scan. 0
+	 * reads all the records of the scan with a single request
+	 */
+	int fetch_size;
+
+	/*
+	 * Whether the number of records of each remote request is adjusted to
+	 * the width of the records and the rate at which they are consumed
+	 */
+	bool adaptive_fetch;
 } ScalarDbFdwOptions;
 
 void get_scalardb_fdw_options(Oid foreigntableid, ScalarDbFdwOptions *opts);
@@ -0,0 +1,433 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "c.h"
+#include "postgres.h"
+
+#include "access/genam.h"
+#include "access/htup_details.h"
+#include "access/stratnum.h"
+#include "access/table.h"
+#include "catalog/namespace.h"
+#include "catalog/pg_type_d.h"
+#include "common/hashfn.h"
+#include "executor/spi.h"
+#include "miscadmin.h"
+#include "utils/acl.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/inval.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/syscache.h"
+
+#include "partition_stats.h"
+
+#define PARTITION_STATS_TABLE_NAME "scalardb_fdw_partition_statistic"
+/* Attribute numbers of the table of the partition statistics */
+#define Anum_partition_stats_relid 1
+#define Anum_partition_stats_partition_key 2
+#define Anum_partition_stats_row_count 3
+
+/*
+ * Maximum number of partitions whose number of records is saved. The other
+ * partitions are saved as the average number of records of them.
+ */
+#define MAX_PARTITION_STATS 1000
+
+typedef struct {
+	/* encoded partition key values; hash key, must be first */
+	char *key;
+	/* text representations of the partition key values */
+	char **values;
+	/* number of records of the partition */
+	double rows;
+} ScalarDbFdwPartitionCount;
+
+/*
+ * The table of the partition statistics in the schema of the extension, cached
+ * until a relation is created, dropped or moved.
+ */
+static bool partition_stats_looked_up = false;
+static Oid partition_stats_relid = InvalidOid;
+static char *partition_stats_table_name = NULL;
+
+static uint32 partition_key_hash(const void *key, Size keysize);
+static int partition_key_compare(const void *key1, const void *key2,
+				 Size keysize);
+static int partition_count_cmp(const void *a, const void *b);
+static char *encode_partition_key(char **values, int num_keys);
+static Datum make_partition_key_array(char **values, int num_keys);
+static void lookup_partition_stats_relation(void);
+static void invalidate_partition_stats_relation(Datum arg, int cacheid,
+						uint32 hashvalue);
+static bool partition_key_equal(Datum key, char **values, int num_keys);
+
+/*
+ * Start counting the records of each partition of a foreign table.
+ */
+extern ScalarDbFdwPartitionStats *begin_partition_stats(int num_keys)
+{
+	ScalarDbFdwPartitionStats *stats;
+	HASHCTL ctl;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	ctl.keysize = sizeof(char *);
+	ctl.entrysize = sizeof(ScalarDbFdwPartitionCount);
+	ctl.hash = partition_key_hash;
+	ctl.match = partition_key_compare;
+	ctl.hcxt = CurrentMemoryContext;
+
+	stats = palloc0(sizeof(ScalarDbFdwPartitionStats));
+	stats->counts = hash_create("scalardb_fdw partition counts", 1024,
+				    &ctl,
+				    HASH_ELEM | HASH_FUNCTION | HASH_COMPARE |
+					    HASH_CONTEXT);
+	stats->num_keys = num_keys;
+	return stats;
+}
+
+/*
+ * Count a record of the partition with the given partition key values.
+ */
+extern void count_partition(ScalarDbFdwPartitionStats *stats, char **values)
+{
+	char *key = encode_partition_key(values, stats->num_keys);
+	ScalarDbFdwPartitionCount *entry;
+	bool found;
+
+	entry = hash_search(stats->counts, &key, HASH_ENTER, &found);
+	if (!found) {
+		entry->key = key;
+		entry->values = palloc(sizeof(char *) * stats->num_keys);
+		for (int i = 0; i < stats->num_keys; i++)
+			entry->values[i] = pstrdup(values[i]);
+		entry->rows = 0;
+	} else {
+		pfree(key);
+	}
+	entry->rows++;
+	stats->total_rows++;
+}
+
+/*
+ * Replace the partition statistics of the foreign table with the counted ones.
+ *
+ * The partitions that have more records than the average are saved
+ * individually, up to MAX_PARTITION_STATS of the largest ones, so that the
+ * skewed partitions are estimated with their own numbers of records. The
+ * others are saved as a single entry without the partition key values that
+ * has the average number of records of them.
+ */
+extern void save_partition_stats(Oid relid, ScalarDbFdwPartitionStats *stats)
+{
+	ScalarDbFdwPartitionCount **counts;
+	long num_partitions = hash_get_num_entries(stats->counts);
+	long num_saved = 0;
+	double saved_rows = 0;
+	HASH_SEQ_STATUS status;
+	ScalarDbFdwPartitionCount *entry;
+	StringInfoData sql;
+	Oid argtypes[3] = { OIDOID, TEXTARRAYOID, FLOAT8OID };
+	Datum values[3];
+	char nulls[3] = { ' ', ' ', ' ' };
+	long i = 0;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	lookup_partition_stats_relation();
+	if (!OidIsValid(partition_stats_relid)) {
+		ereport(WARNING,
+			(errmsg("skipping saving partition statistics of \"%s\"",
+				get_rel_name(relid)),
+			 errdetail("Table %s does not exist.",
+				   partition_stats_table_name),
+			 errhint("Update the extension with ALTER EXTENSION scalardb_fdw UPDATE.")));
+		return;
+	}
+	if (pg_class_aclcheck(partition_stats_relid, GetUserId(),
+			      ACL_INSERT) != ACLCHECK_OK ||
+	    pg_class_aclcheck(partition_stats_relid, GetUserId(),
+			      ACL_DELETE) != ACLCHECK_OK) {
+		ereport(WARNING,
+			(errmsg("skipping saving partition statistics of \"%s\"",
+				get_rel_name(relid)),
+			 errdetail("Permission denied for table %s.",
+				   partition_stats_table_name)));
+		return;
+	}
+
+	counts = palloc(sizeof(ScalarDbFdwPartitionCount *) *
+			Max(num_partitions, 1));
+	hash_seq_init(&status, stats->counts);
+	while ((entry = hash_seq_search(&status)) != NULL)
+		counts[i++] = entry;
+	qsort(counts, num_partitions, sizeof(ScalarDbFdwPartitionCount *),
+	      partition_count_cmp);
+
+	SPI_connect();
+
+	values[0] = ObjectIdGetDatum(relid);
+
+	initStringInfo(&sql);
+	appendStringInfo(&sql, "DELETE FROM %s WHERE relid = $1",
+			 partition_stats_table_name);
+	SPI_execute_with_args(sql.data, 1, argtypes, values, nulls, false, 0);
+
+	resetStringInfo(&sql);
+	appendStringInfo(&sql, "INSERT INTO %s VALUES ($1, $2, $3)",
+			 partition_stats_table_name);
+
+	for (; num_saved < Min(num_partitions, MAX_PARTITION_STATS);
+	     num_saved++) {
+		entry = counts[num_saved];
+		if (entry->rows <= stats->total_rows / num_partitions)
+			break;
+
+		values[1] = make_partition_key_array(entry->values,
+						     stats->num_keys);
+		values[2] = Float8GetDatum(entry->rows);
+		SPI_execute_with_args(sql.data, 3, argtypes, values, nulls,
+				      false, 0);
+		saved_rows += entry->rows;
+	}
+
+	if (num_saved < num_partitions) {
+		values[1] = (Datum)0;
+		nulls[1] = 'n';
+		values[2] = Float8GetDatum((stats->total_rows - saved_rows) /
+					   (num_partitions - num_saved));
+		SPI_execute_with_args(sql.data, 3, argtypes, values, nulls,
+				      false, 0);
+	}
+
+	SPI_finish();
+}
+
+/*
+ * Get the number of records of the partition with the given partition key
+ * values from the statistics saved by ANALYZE.
+ *
+ * The average number of records of the other partitions is returned if the
+ * partition is not saved individually. Returns a negative value if the foreign
+ * table has no partition statistics, or if the user cannot read the table.
+ *
+ * This is called to plan every scan of constant partition key values, so the
+ * table of the statistics is read directly with its index on relid, as the
+ * planner reads pg_statistic, instead of querying the view with SPI.
+ */
+extern double get_partition_rows(Oid relid, char **values, int num_keys)
+{
+	Relation rel;
+	List *indexes;
+	Oid index_relid;
+	Snapshot snapshot;
+	SysScanDesc scan;
+	ScanKeyData key;
+	HeapTuple tuple;
+	double rows = -1;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	/* The statistics are the data of the table, as the view checks */
+	if (pg_class_aclcheck(relid, GetUserId(), ACL_SELECT) != ACLCHECK_OK)
+		return -1;
+
+	lookup_partition_stats_relation();
+	if (!OidIsValid(partition_stats_relid))
+		return -1;
+
+	rel = table_open(partition_stats_relid, AccessShareLock);
+	indexes = RelationGetIndexList(rel);
+	index_relid = list_length(indexes) == 1 ? linitial_oid(indexes) :
+						  InvalidOid;
+	snapshot = RegisterSnapshot(GetLatestSnapshot());
+
+	ScanKeyInit(&key, Anum_partition_stats_relid, BTEqualStrategyNumber,
+		    F_OIDEQ, ObjectIdGetDatum(relid));
+	scan = systable_beginscan(rel, index_relid, OidIsValid(index_relid),
+				  snapshot, 1, &key);
+	while (HeapTupleIsValid(tuple = systable_getnext(scan))) {
+		bool is_average;
+		bool isnull;
+		Datum partition_key =
+			heap_getattr(tuple, Anum_partition_stats_partition_key,
+				     RelationGetDescr(rel), &is_average);
+
+		if (!is_average &&
+		    !partition_key_equal(partition_key, values, num_keys))
+			continue;
+
+		rows = DatumGetFloat8(
+			heap_getattr(tuple, Anum_partition_stats_row_count,
+				     RelationGetDescr(rel), &isnull));
+
+		/* The entry of the partition takes precedence over the average */
+		if (!is_average)
+			break;
+	}
+	systable_endscan(scan);
+
+	UnregisterSnapshot(snapshot);
+	list_free(indexes);
+	table_close(rel, AccessShareLock);
+
+	return rows;
+}
+
+static uint32 partition_key_hash(const void *key, Size keysize)
+{
+	const char *str = *(const char *const *)key;
+
+	return hash_bytes((const unsigned char *)str, strlen(str));
+}
+
+static int partition_key_compare(const void *key1, const void *key2,
+				 Size keysize)
+{
+	return strcmp(*(const char *const *)key1, *(const char *const *)key2);
+}
+
+/*
+ * Sort the partitions in descending order of the number of records.
+ */
+static int partition_count_cmp(const void *a, const void *b)
+{
+	double rows_a = (*(ScalarDbFdwPartitionCount *const *)a)->rows;
+	double rows_b = (*(ScalarDbFdwPartitionCount *const *)b)->rows;
+
+	if (rows_a > rows_b)
+		return -1;
+	if (rows_a < rows_b)
+		return 1;
+	return 0;
+}
+
+/*
+ * Encode the partition key values into a string that identifies the
+ * partition. Each value is prefixed with its length to keep it unambiguous.
+ */
+static char *encode_partition_key(char **values, int num_keys)
+{
+	StringInfoData key;
+
+	initStringInfo(&key);
+	for (int i = 0; i < num_keys; i++)
+		appendStringInfo(&key, "%zu:%s", strlen(values[i]), values[i]);
+	return key.data;
+}
+
+static Datum make_partition_key_array(char **values, int num_keys)
+{
+	Datum *elems = palloc(sizeof(Datum) * num_keys);
+
+	for (int i = 0; i < num_keys; i++)
+		elems[i] = CStringGetTextDatum(values[i]);
+
+	return PointerGetDatum(construct_array(elems, num_keys, TEXTOID, -1,
+					       false, TYPALIGN_INT));
+}
+
+/*
+ * Return the name of the schema that the extension is installed in. The
+ * extension is relocatable, so its objects are looked up in the schema. Must
+ * be called in an SPI connection.
+ */
+extern char *get_extension_schema(void)
+{
+	if (SPI_execute(
+		    "SELECT n.nspname FROM pg_catalog.pg_extension e JOIN pg_catalog.pg_namespace n ON n.oid = e.extnamespace WHERE e.extname = 'scalardb_fdw'",
+		    true, 1) != SPI_OK_SELECT ||
+	    SPI_processed != 1)
+		elog(ERROR, "could not find the schema of scalardb_fdw");
+
+	return SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1);
+}
+
+/*
+ * Look up the table of the partition statistics in the schema of the
+ * extension, unless it has been looked up since the relations last changed.
+ * The OID is left invalid if the extension has not been updated to the
+ * version that has the table.
+ */
+static void lookup_partition_stats_relation(void)
+{
+	static bool callback_registered = false;
+	char *schema_name;
+
+	if (partition_stats_looked_up)
+		return;
+
+	if (!callback_registered) {
+		CacheRegisterSyscacheCallback(
+			RELNAMENSP, invalidate_partition_stats_relation,
+			(Datum)0);
+		callback_registered = true;
+	}
+
+	if (partition_stats_table_name != NULL) {
+		pfree(partition_stats_table_name);
+		partition_stats_table_name = NULL;
+	}
+
+	SPI_connect();
+	schema_name = get_extension_schema();
+	partition_stats_relid =
+		get_relname_relid(PARTITION_STATS_TABLE_NAME,
+				  get_namespace_oid(schema_name, false));
+	partition_stats_table_name = MemoryContextStrdup(
+		TopMemoryContext,
+		quote_qualified_identifier(schema_name,
+					   PARTITION_STATS_TABLE_NAME));
+	SPI_finish();
+
+	partition_stats_looked_up = true;
+}
+
+/*
+ * Forget the table of the partition statistics when any relation is created,
+ * dropped, renamed or moved to another schema, e.g. by ALTER EXTENSION.
+ */
+static void invalidate_partition_stats_relation(Datum arg, int cacheid,
+						uint32 hashvalue)
+{
+	partition_stats_looked_up = false;
+}
+
+/*
+ * Return true if the partition key saved in the statistics has the given
+ * partition key values.
+ */
+static bool partition_key_equal(Datum key, char **values, int num_keys)
+{
+	Datum *elems;
+	bool *nulls;
+	int num_elems;
+
+	deconstruct_array(DatumGetArrayTypeP(key), TEXTOID, -1, false,
+			  TYPALIGN_INT, &elems, &nulls, &num_elems);
+	if (num_elems != num_keys)
+		return false;
+	for (int i = 0; i < num_keys; i++) {
+		if (nulls[i] ||
+		    strcmp(TextDatumGetCString(elems[i]), values[i]) != 0)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SCALARDB_FDW_PARTITION_STATS_H
+#define SCALARDB_FDW_PARTITION_STATS_H
+
+#include "c.h"
+#include "postgres.h"
+#include "utils/hsearch.h"
+
+/*
+ * Number of records of each partition counted while a foreign table is
+ * ANALYZEd. Partitions are identified by the text representations of their
+ * partition key values.
+ */
+typedef struct {
+	/* hash table of ScalarDbFdwPartitionCount */
+	HTAB *counts;
+	/* number of partition key columns */
+	int num_keys;
+	/* total number of records counted */
+	double total_rows;
+} ScalarDbFdwPartitionStats;
+
+extern ScalarDbFdwPartitionStats *begin_partition_stats(int num_keys);
+
+extern void count_partition(ScalarDbFdwPartitionStats *stats, char **values);
+
+extern void save_partition_stats(Oid relid, ScalarDbFdwPartitionStats *stats);
+
+extern double get_partition_rows(Oid relid, char **values, int num_keys);
+
+extern char *get_extension_schema(void);
+
+#endif
@@ -19,10 +19,15 @@
 #include "postgres.h"
 
 #include "access/stratnum.h"
+#include "access/table.h"
+#include "catalog/pg_type_d.h"
 #include "nodes/pg_list.h"
 #include "optimizer/pathnode.h"
 #include "optimizer/paths.h"
 #include "nodes/pathnodes.h"
+#include "parser/parsetree.h"
+#include "utils/pg_locale.h"
+#include "utils/rel.h"
 
 #include "pathkeys.h"
 #include "condition.h"
@@ -34,24 +39,45 @@
 static void add_path_with_pathkeys(PlannerInfo *root, RelOptInfo *rel,
 				   List *pathkeys, List *fdw_private_for_path);
 
-static bool is_clustering_key_sort(List *query_pathkeys, RelOptInfo *rel,
+static bool is_remote_sort(PlannerInfo *root, List *pathkeys, RelOptInfo *rel,
+			   ScalarDbFdwColumnMetadata *column_metadata,
+			   List **sort_column_names, List **sort_orders);
+
+static List *get_useful_ecs_for_relation(PlannerInfo *root, RelOptInfo *rel);
+
+static bool is_clustering_key_sort(List *pathkeys, RelOptInfo *rel,
 				   ScalarDbFdwColumnMetadata *column_metadata,
-				   List **sort_column_names,
+				   int num_fixed_keys, List **sort_column_names,
 				   List **sort_orders);
 
+static bool is_column_sort(PlannerInfo *root, List *query_pathkeys,
+			   RelOptInfo *rel,
+			   ScalarDbFdwColumnMetadata *column_metadata,
+			   List **sort_column_names, List **sort_orders);
+
+static bool is_key_column(int attnum,
+			  ScalarDbFdwColumnMetadata *column_metadata);
+
 static EquivalenceMember *find_em_for_rel(EquivalenceClass *ec,
 					  RelOptInfo *rel);
 
 static bool is_same_order(PathKey *pathkey,
 			  ScalarDbFdwClusteringKeyOrder order);
 
-static ScalarDbFdwClusteringKeyOrder
-get_sort_order(ScalarDbFdwClusteringKeyOrder order, bool same_order);
-
+/*
+ * Add paths whose results are sorted on the ScalarDB side.
+ *
+ * For partition key scan, the results can be sorted by the clustering keys.
+ * For Scan (all), the results can be sorted by any non-null column if the
+ * storage supports cross-partition scan orderings.
+ */
 extern void
 add_paths_with_pathkeys_for_rel(PlannerInfo *root, RelOptInfo *rel,
 				ScalarDbFdwColumnMetadata *column_metadata)
 {
+	List *useful_ecs;
+	ListCell *lc;
+
 	ereport(DEBUG3, errmsg("entering function %s", __func__));
 
 	/*
@@ -61,16 +87,138 @@ add_paths_with_pathkeys_for_rel(PlannerInfo *root, RelOptInfo *rel,
 	if (root->query_pathkeys) {
 		List *sort_column_names = NIL;
 		List *sort_orders = NIL;
-		if (is_clustering_key_sort(root->query_pathkeys, rel,
-					   column_metadata, &sort_column_names,
-					   &sort_orders)) {
+
+		if (is_remote_sort(root, root->query_pathkeys, rel,
+				   column_metadata, &sort_column_names,
+				   &sort_orders)) {
 			List *fdw_private_for_path =
 				list_make2(sort_column_names, sort_orders);
 			add_path_with_pathkeys(root, rel, root->query_pathkeys,
 					       fdw_private_for_path);
 		}
 	}
-	/* TODO: consider userful orderings for mergejoin */
+
+	/*
+	 * Consider orderings that are useful for merge joins. If the relation
+	 * can be sorted remotely by a join column, the planner can choose a
+	 * merge join that streams this side without a local sort or hash.
+	 */
+	useful_ecs = get_useful_ecs_for_relation(root, rel);
+	foreach(lc, useful_ecs) {
+		EquivalenceClass *ec = (EquivalenceClass *)lfirst(lc);
+		PathKey *pathkey;
+		List *pathkeys;
+		List *sort_column_names = NIL;
+		List *sort_orders = NIL;
+
+		/* The EC must be sortable and must not be a constant */
+		if (ec->ec_has_volatile || ec->ec_has_const ||
+		    ec->ec_opfamilies == NIL)
+			continue;
+
+		if (find_em_for_rel(ec, rel) == NULL)
+			continue;
+
+		pathkey = make_canonical_pathkey(root, ec,
+						 linitial_oid(ec->ec_opfamilies),
+						 BTLessStrategyNumber, false);
+
+		/* Skip if the same ordering has already been considered */
+		if (list_length(root->query_pathkeys) == 1 &&
+		    linitial(root->query_pathkeys) == pathkey)
+			continue;
+
+		pathkeys = list_make1(pathkey);
+		if (is_remote_sort(root, pathkeys, rel, column_metadata,
+				   &sort_column_names, &sort_orders)) {
+			List *fdw_private_for_path =
+				list_make2(sort_column_names, sort_orders);
+			add_path_with_pathkeys(root, rel, pathkeys,
+					       fdw_private_for_path);
+		}
+	}
+}
+
+/*
+ * Returns true if the given pathkeys can be represented as orderings of Scan
+ * executed on the ScalarDB side for the given relation.
+ *
+ * If true, the column names and the sort orders are pushed in sort_column_names
+ * and sort_orders.
+ */
+static bool is_remote_sort(PlannerInfo *root, List *pathkeys, RelOptInfo *rel,
+			   ScalarDbFdwColumnMetadata *column_metadata,
+			   List **sort_column_names, List **sort_orders)
+{
+	ScalarDbFdwPlanState *fdw_private =
+		(ScalarDbFdwPlanState *)rel->fdw_private;
+
+	switch (fdw_private->scan_type) {
+	case SCALARDB_SCAN_PARTITION_KEY:
+		return is_clustering_key_sort(
+			pathkeys, rel, column_metadata,
+			get_num_fixed_clustering_keys(&fdw_private->boundary),
+			sort_column_names, sort_orders);
+	case SCALARDB_SCAN_ALL:
+		return fdw_private->can_order_scan_all &&
+		       is_column_sort(root, pathkeys, rel, column_metadata,
+				      sort_column_names, sort_orders);
+	case SCALARDB_SCAN_SECONDARY_INDEX:
+		/* Sorting is not supported for secondary index scan */
+		return false;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Returns a List of EquivalenceClasses that are useful for merge joins of the
+ * given relation, i.e., ECs that appear in join clauses of the relation.
+ */
+static List *get_useful_ecs_for_relation(PlannerInfo *root, RelOptInfo *rel)
+{
+	List *useful_ecs = NIL;
+	ListCell *lc;
+
+	/*
+	 * First, consider whether any active EC is potentially useful for a
+	 * merge join against this relation.
+	 */
+	if (rel->has_eclass_joins) {
+		foreach(lc, root->eq_classes) {
+			EquivalenceClass *ec = (EquivalenceClass *)lfirst(lc);
+
+			if (eclass_useful_for_merging(root, ec, rel))
+				useful_ecs = list_append_unique_ptr(useful_ecs,
+								    ec);
+		}
+	}
+
+	/*
+	 * Next, consider whether there are any non-EC derivable join clauses
+	 * that are merge-joinable.
+	 */
+	foreach(lc, rel->joininfo) {
+		RestrictInfo *restrictinfo = (RestrictInfo *)lfirst(lc);
+
+		/* Consider only mergejoinable clauses */
+		if (restrictinfo->mergeopfamilies == NIL)
+			continue;
+
+		/* Make sure we've got canonical ECs. */
+		update_mergeclause_eclasses(root, restrictinfo);
+
+		/* Consider ordering by the side of the clause that refers to this rel */
+		if (bms_overlap(rel->relids, restrictinfo->right_ec->ec_relids))
+			useful_ecs = list_append_unique_ptr(
+				useful_ecs, restrictinfo->right_ec);
+		else if (bms_overlap(rel->relids,
+				     restrictinfo->left_ec->ec_relids))
+			useful_ecs = list_append_unique_ptr(
+				useful_ecs, restrictinfo->left_ec);
+	}
+
+	return useful_ecs;
 }
 
 static void add_path_with_pathkeys(PlannerInfo *root, RelOptInfo *rel,
@@ -86,6 +234,13 @@ static void add_path_with_pathkeys(PlannerInfo *root, RelOptInfo *rel,
 	estimate_costs(root, rel, fdw_private->remote_conds, &rows,
 		       &startup_cost, &total_cost);
 
+	/*
+	 * Partition key scan returns the results in the clustering order without
+	 * extra work, but Scan (all) needs to sort the whole results remotely.
+	 */
+	if (fdw_private->scan_type == SCALARDB_SCAN_ALL)
+		estimate_remote_sort_cost(rows, &startup_cost, &total_cost);
+
 	add_path(rel, (Path *)create_foreignscan_path(
 			      root, rel, NULL, rows, startup_cost, total_cost,
 			      pathkeys, rel->lateral_relids, NULL,
@@ -93,39 +248,42 @@ static void add_path_with_pathkeys(PlannerInfo *root, RelOptInfo *rel,
 }
 
 /*
- * Returns true if query_pathkeys (i.e., final output ordering) can be represented as a sort 
+ * Returns true if pathkeys (e.g., final output ordering) can be represented as a sort
  * based on clustering keys of the given foreign ScalarDb relation.
  *
+ * The first num_fixed_keys clustering keys are fixed by equality conditions, so
+ * pathkeys are matched against the clustering keys that follow them. PostgreSQL
+ * drops pathkeys for such constant columns, e.g., `ck1 = 1 ORDER BY ck2`
+ * results in pathkeys only for ck2.
+ *
+ * ScalarDB orders the TEXT clustering keys by their bytes in all the storages,
+ * so text pathkeys are accepted only with the "C" collation.
+ *
  * If true, the column names used to sort the given relation are pushed in sort_column_names,
  * and the sort orders for each column are pushed into sort_orders.
  */
-static bool is_clustering_key_sort(List *query_pathkeys, RelOptInfo *rel,
+static bool is_clustering_key_sort(List *pathkeys, RelOptInfo *rel,
 				   ScalarDbFdwColumnMetadata *column_metadata,
-				   List **sort_column_names, List **sort_orders)
+				   int num_fixed_keys, List **sort_column_names,
+				   List **sort_orders)
 {
-	ListCell *lc_pk;
-	ListCell *lc_attnum;
-	ListCell *lc_name;
-	ListCell *lc_order;
-
+	ListCell *lc;
+	int num_sort_keys = num_fixed_keys + list_length(pathkeys);
 	bool same_order = false;
 
-	/* The entire query_pathkeys must be represented by sorting using some or all of the clustering keys */
-	if (list_length(query_pathkeys) >
-	    list_length(column_metadata->clustering_key_attnums))
+	/* The entire pathkeys must be represented by sorting using some or all of the clustering keys */
+	if (num_sort_keys > list_length(column_metadata->clustering_key_attnums))
 		return false;
 
-	forfour(lc_pk, query_pathkeys, lc_attnum,
-		column_metadata->clustering_key_attnums, lc_name,
-		column_metadata->clustering_key_names, lc_order,
-		column_metadata->clustering_key_orders)
-	{
-		PathKey *pathkey = (PathKey *)lfirst(lc_pk);
-		int attnum = lfirst_int(lc_attnum);
-		String *name = lfirst_node(String, lc_name);
+	foreach(lc, pathkeys) {
+		PathKey *pathkey = (PathKey *)lfirst(lc);
+		int index = num_fixed_keys + foreach_current_index(lc);
+		int attnum =
+			list_nth_int(column_metadata->clustering_key_attnums,
+				     index);
 		ScalarDbFdwClusteringKeyOrder order =
-			(ScalarDbFdwClusteringKeyOrder)lfirst_int(lc_order);
-		int index = foreach_current_index(lc_pk);
+			(ScalarDbFdwClusteringKeyOrder)list_nth_int(
+				column_metadata->clustering_key_orders, index);
 
 		EquivalenceMember *em;
 		Var *var;
@@ -141,14 +299,29 @@ static bool is_clustering_key_sort(List *query_pathkeys, RelOptInfo *rel,
 		if (var->varattno != attnum)
 			return false;
 
+		if (var->vartype == TEXTOID &&
+		    !lc_collate_is_c(pathkey->pk_eclass->ec_collation))
+			return false;
+
 		/* pathkeys and clustering key orders must all be in the same order or all in reverse order */
-		if (index == 0) {
+		if (foreach_current_index(lc) == 0) {
 			same_order = is_same_order(pathkey, order);
 		} else {
 			if (same_order != is_same_order(pathkey, order))
 				return false;
 		}
-		*sort_column_names = lappend(*sort_column_names, name);
+	}
+
+	/* Orderings of ScalarDB must start from the first clustering key */
+	for (int i = 0; i < num_sort_keys; i++) {
+		ScalarDbFdwClusteringKeyOrder order =
+			(ScalarDbFdwClusteringKeyOrder)list_nth_int(
+				column_metadata->clustering_key_orders, i);
+
+		*sort_column_names =
+			lappend(*sort_column_names,
+				list_nth(column_metadata->clustering_key_names,
+					 i));
 		*sort_orders = lappend_int(*sort_orders,
 					   get_sort_order(order, same_order));
 	}
@@ -156,6 +329,136 @@ static bool is_clustering_key_sort(List *query_pathkeys, RelOptInfo *rel,
 	return true;
 }
 
+/*
+ * Returns the number of leading clustering keys whose values are fixed by
+ * equality conditions pushed down as the clustering key boundary.
+ */
+extern int
+get_num_fixed_clustering_keys(ScalarDbFdwClusteringKeyBoundary *boundary)
+{
+	ListCell *lc;
+	int num_fixed_keys = 0;
+
+	foreach(lc, boundary->is_equals) {
+		if (!boolVal(lfirst(lc)))
+			break;
+		num_fixed_keys++;
+	}
+	return num_fixed_keys;
+}
+
+/*
+ * Returns true if query_pathkeys can be represented as orderings of Scan (all)
+ * across partitions.
+ *
+ * Any column can be used as long as it never contains NULLs (i.e., it is a key
+ * column or is declared as NOT NULL), because the storage may place NULLs
+ * differently from PostgreSQL.
+ *
+ * Text columns can be used only if they are key columns and sorted with the
+ * "C" collation. This assumes that the JDBC storage orders the key columns by
+ * their bytes, as ScalarDB creates them with a binary collation so that the
+ * clustering order is the same in all the storages. The other text columns
+ * are sorted by the collation of the underlying database, which may differ
+ * from any collation of PostgreSQL.
+ *
+ * If true, the column names and the sort orders are pushed in sort_column_names
+ * and sort_orders.
+ */
+static bool is_column_sort(PlannerInfo *root, List *query_pathkeys,
+			   RelOptInfo *rel,
+			   ScalarDbFdwColumnMetadata *column_metadata,
+			   List **sort_column_names, List **sort_orders)
+{
+	RangeTblEntry *rte;
+	Relation relation;
+	TupleDesc tupdesc;
+	ListCell *lc;
+	bool ret = true;
+
+	rte = planner_rt_fetch(rel->relid, root);
+
+	/*
+	 * Core code already has some lock on each rel being planned, so we can
+	 * use NoLock here.
+	 */
+	relation = table_open(rte->relid, NoLock);
+	tupdesc = RelationGetDescr(relation);
+
+	foreach(lc, query_pathkeys) {
+		PathKey *pathkey = (PathKey *)lfirst(lc);
+		EquivalenceMember *em;
+		Var *var;
+		Form_pg_attribute attr;
+
+		if (pathkey->pk_eclass->ec_has_volatile) {
+			ret = false;
+			break;
+		}
+
+		em = find_em_for_rel(pathkey->pk_eclass, rel);
+		if (em == NULL) {
+			ret = false;
+			break;
+		}
+		var = (Var *)em->em_expr;
+
+		if (var->varattno <= 0) {
+			ret = false;
+			break;
+		}
+		attr = TupleDescAttr(tupdesc, var->varattno - 1);
+
+		if (!attr->attnotnull &&
+		    !is_key_column(var->varattno, column_metadata)) {
+			ret = false;
+			break;
+		}
+
+		if (attr->atttypid == TEXTOID &&
+		    (!is_key_column(var->varattno, column_metadata) ||
+		     !lc_collate_is_c(pathkey->pk_eclass->ec_collation))) {
+			ret = false;
+			break;
+		}
+
+		switch (pathkey->pk_strategy) {
+		case BTLessStrategyNumber:
+			*sort_orders = lappend_int(
+				*sort_orders, SCALARDB_CLUSTERING_KEY_ORDER_ASC);
+			break;
+		case BTGreaterStrategyNumber:
+			*sort_orders = lappend_int(
+				*sort_orders, SCALARDB_CLUSTERING_KEY_ORDER_DESC);
+			break;
+		default:
+			ret = false;
+			break;
+		}
+		if (!ret)
+			break;
+
+		*sort_column_names =
+			lappend(*sort_column_names,
+				makeString(pstrdup(NameStr(attr->attname))));
+	}
+	table_close(relation, NoLock);
+
+	return ret;
+}
+
+/*
+ * Returns true if the given attribute is one of the partition keys or the
+ * clustering keys, which never contain NULLs.
+ */
+static bool is_key_column(int attnum,
+			  ScalarDbFdwColumnMetadata *column_metadata)
+{
+	return list_member_int(column_metadata->partition_key_attnums,
+			       attnum) ||
+	       list_member_int(column_metadata->clustering_key_attnums, attnum);
+}
+
 /*
  * Given an EquivalenceClass and a foreign relation, find an EC member
  * that can be used to sort the relation remotely according to a pathkey
@@ -197,7 +500,11 @@ static bool is_same_order(PathKey *pathkey, ScalarDbFdwClusteringKeyOrder order)
 		order == SCALARDB_CLUSTERING_KEY_ORDER_DESC);
 }
 
-static ScalarDbFdwClusteringKeyOrder
+/*
+ * Returns the sort order of a clustering key for the scan that follows the
+ * clustering order (same_order) or its reverse.
+ */
+extern ScalarDbFdwClusteringKeyOrder
 get_sort_order(ScalarDbFdwClusteringKeyOrder order, bool same_order)
 {
 	switch (order) {
@@ -21,9 +21,17 @@
 #include "optimizer/pathnode.h"
 
 #include "column_metadata.h"
+#include "condition.h"
+#include "scalardb.h"
 
 extern void
 add_paths_with_pathkeys_for_rel(PlannerInfo *root, RelOptInfo *rel,
 				ScalarDbFdwColumnMetadata *column_metadata);
 
+extern int
+get_num_fixed_clustering_keys(ScalarDbFdwClusteringKeyBoundary *boundary);
+
+extern ScalarDbFdwClusteringKeyOrder
+get_sort_order(ScalarDbFdwClusteringKeyOrder order, bool same_order);
+
 #endif
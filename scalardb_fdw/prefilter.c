@@ -0,0 +1,310 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "c.h"
+#include "postgres.h"
+
+#include "access/stratnum.h"
+#include "catalog/pg_opfamily_d.h"
+#include "catalog/pg_type_d.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/pathnodes.h"
+#include "nodes/pg_list.h"
+#include "nodes/primnodes.h"
+#include "nodes/value.h"
+#include "utils/float.h"
+#include "utils/lsyscache.h"
+
+#include "prefilter.h"
+
+static List *make_comparison_prefilter(RelOptInfo *baserel, OpExpr *expr);
+static bool is_column_of_rel(RelOptInfo *baserel, Expr *expr);
+static bool compare_int(int64 value1, int64 value2, int strategy);
+static bool compare_float(float8 value1, float8 value2, int strategy);
+
+/*
+ * Extract the local conditions that can be evaluated on the columns of a
+ * result before the tuple is formed, so that the results that do not satisfy
+ * them are skipped without retrieving the other columns or forming tuples:
+ * - comparisons of integer and floating-point columns with constants
+ * - IS NULL and IS NOT NULL of columns
+ * - boolean columns and their negations
+ *
+ * Each condition is returned as a List of the type, the attribute number, the
+ * btree strategy number and the constant. The rows that fail a prefilter are
+ * dropped, and the others are still checked by the executor, so a prefilter
+ * may pass rows that the original condition rejects, but must never be false
+ * for a row for which the original condition is true.
+ */
+extern List *extract_prefilters(RelOptInfo *baserel, List *local_conds)
+{
+	List *prefilters = NIL;
+	ListCell *lc;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	foreach(lc, local_conds) {
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		Expr *clause = rinfo->clause;
+		List *prefilter = NIL;
+
+		if (IsA(clause, OpExpr)) {
+			prefilter = make_comparison_prefilter(baserel,
+							      (OpExpr *)clause);
+		} else if (IsA(clause, NullTest)) {
+			NullTest *test = (NullTest *)clause;
+
+			if (!test->argisrow &&
+			    is_column_of_rel(baserel, test->arg))
+				prefilter = list_make4(
+					makeInteger(test->nulltesttype ==
+								    IS_NULL ?
+							    SCALARDB_PREFILTER_IS_NULL :
+							    SCALARDB_PREFILTER_IS_NOT_NULL),
+					makeInteger(((Var *)test->arg)->varattno),
+					makeInteger(InvalidStrategy), NULL);
+		} else if (IsA(clause, Var)) {
+			if (is_column_of_rel(baserel, clause) &&
+			    ((Var *)clause)->vartype == BOOLOID)
+				prefilter = list_make4(
+					makeInteger(SCALARDB_PREFILTER_IS_TRUE),
+					makeInteger(((Var *)clause)->varattno),
+					makeInteger(InvalidStrategy), NULL);
+		} else if (is_notclause(clause)) {
+			Expr *arg = get_notclausearg(clause);
+
+			if (is_column_of_rel(baserel, arg) &&
+			    ((Var *)arg)->vartype == BOOLOID)
+				prefilter = list_make4(
+					makeInteger(SCALARDB_PREFILTER_IS_FALSE),
+					makeInteger(((Var *)arg)->varattno),
+					makeInteger(InvalidStrategy), NULL);
+		}
+
+		if (prefilter != NIL)
+			prefilters = lappend(prefilters, prefilter);
+	}
+	return prefilters;
+}
+
+/*
+ * Convert the conditions extracted by extract_prefilters into an array for the
+ * executor.
+ */
+extern ScalarDbFdwPrefilter *make_prefilters(List *prefilter_list,
+					     TupleDesc tupdesc,
+					     int *num_prefilters)
+{
+	ScalarDbFdwPrefilter *prefilters;
+	ListCell *lc;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	*num_prefilters = list_length(prefilter_list);
+	if (*num_prefilters == 0)
+		return NULL;
+
+	prefilters = palloc0(sizeof(ScalarDbFdwPrefilter) * *num_prefilters);
+	foreach(lc, prefilter_list) {
+		List *list = (List *)lfirst(lc);
+		ScalarDbFdwPrefilter *prefilter =
+			&prefilters[foreach_current_index(lc)];
+		Const *value = (Const *)lfourth(list);
+
+		prefilter->type = intVal(linitial(list));
+		prefilter->attnum = intVal(lsecond(list));
+		prefilter->atttypid =
+			TupleDescAttr(tupdesc, prefilter->attnum - 1)->atttypid;
+		prefilter->strategy = intVal(lthird(list));
+
+		if (value == NULL)
+			continue;
+
+		switch (value->consttype) {
+		case INT2OID:
+			prefilter->int_value = DatumGetInt16(value->constvalue);
+			break;
+		case INT4OID:
+			prefilter->int_value = DatumGetInt32(value->constvalue);
+			break;
+		case INT8OID:
+			prefilter->int_value = DatumGetInt64(value->constvalue);
+			break;
+		case FLOAT4OID:
+			prefilter->float_value =
+				DatumGetFloat4(value->constvalue);
+			break;
+		case FLOAT8OID:
+			prefilter->float_value =
+				DatumGetFloat8(value->constvalue);
+			break;
+		default:
+			elog(ERROR, "unexpected constant type: %u",
+			     value->consttype);
+		}
+	}
+	return prefilters;
+}
+
+/*
+ * Return true if the value of the column satisfies the condition. A NULL
+ * value satisfies only IS NULL, as the condition is NULL otherwise.
+ */
+extern bool evaluate_prefilter(ScalarDbFdwPrefilter *prefilter, Datum value,
+			       bool isnull)
+{
+	if (prefilter->type == SCALARDB_PREFILTER_IS_NULL)
+		return isnull;
+	if (isnull)
+		return false;
+
+	switch (prefilter->type) {
+	case SCALARDB_PREFILTER_INT_COMPARISON:
+		return compare_int(prefilter->atttypid == INT8OID ?
+					   DatumGetInt64(value) :
+					   DatumGetInt32(value),
+				   prefilter->int_value, prefilter->strategy);
+	case SCALARDB_PREFILTER_FLOAT_COMPARISON:
+		return compare_float(prefilter->atttypid == FLOAT8OID ?
+					     DatumGetFloat8(value) :
+					     DatumGetFloat4(value),
+				     prefilter->float_value,
+				     prefilter->strategy);
+	case SCALARDB_PREFILTER_IS_NOT_NULL:
+		return true;
+	case SCALARDB_PREFILTER_IS_TRUE:
+		return DatumGetBool(value);
+	case SCALARDB_PREFILTER_IS_FALSE:
+		return !DatumGetBool(value);
+	default:
+		elog(ERROR, "unexpected prefilter type: %d", prefilter->type);
+	}
+}
+
+/*
+ * Make a prefilter of a comparison of a column with a constant by the
+ * operators of the integer or float btree operator family, which are the ones
+ * whose semantics are reproduced by compare_int and compare_float.
+ */
+static List *make_comparison_prefilter(RelOptInfo *baserel, OpExpr *expr)
+{
+	Expr *left;
+	Expr *right;
+	Oid opno = expr->opno;
+	Var *var;
+	Const *value;
+	Oid opfamily;
+	ScalarDbFdwPrefilterType type;
+	int strategy;
+
+	if (list_length(expr->args) != 2)
+		return NIL;
+
+	left = linitial(expr->args);
+	right = lsecond(expr->args);
+
+	if (is_column_of_rel(baserel, left) && IsA(right, Const)) {
+		var = (Var *)left;
+		value = (Const *)right;
+	} else if (is_column_of_rel(baserel, right) && IsA(left, Const)) {
+		/* const op column is evaluated as column commuted-op const */
+		var = (Var *)right;
+		value = (Const *)left;
+		opno = get_commutator(opno);
+		if (!OidIsValid(opno))
+			return NIL;
+	} else {
+		return NIL;
+	}
+
+	if (value->constisnull)
+		return NIL;
+
+	switch (var->vartype) {
+	case INT4OID:
+	case INT8OID:
+		if (value->consttype != INT2OID &&
+		    value->consttype != INT4OID && value->consttype != INT8OID)
+			return NIL;
+		opfamily = INTEGER_BTREE_FAM_OID;
+		type = SCALARDB_PREFILTER_INT_COMPARISON;
+		break;
+	case FLOAT4OID:
+	case FLOAT8OID:
+		if (value->consttype != FLOAT4OID &&
+		    value->consttype != FLOAT8OID)
+			return NIL;
+		opfamily = FLOAT_BTREE_FAM_OID;
+		type = SCALARDB_PREFILTER_FLOAT_COMPARISON;
+		break;
+	default:
+		return NIL;
+	}
+
+	strategy = get_op_opfamily_strategy(opno, opfamily);
+	if (strategy == InvalidStrategy)
+		return NIL;
+
+	return list_make4(makeInteger(type), makeInteger(var->varattno),
+			  makeInteger(strategy), value);
+}
+
+static bool is_column_of_rel(RelOptInfo *baserel, Expr *expr)
+{
+	Var *var = (Var *)expr;
+
+	return IsA(expr, Var) && var->varno == baserel->relid &&
+	       var->varlevelsup == 0 && var->varattno > 0;
+}
+
+static bool compare_int(int64 value1, int64 value2, int strategy)
+{
+	switch (strategy) {
+	case BTLessStrategyNumber:
+		return value1 < value2;
+	case BTLessEqualStrategyNumber:
+		return value1 <= value2;
+	case BTEqualStrategyNumber:
+		return value1 == value2;
+	case BTGreaterEqualStrategyNumber:
+		return value1 >= value2;
+	case BTGreaterStrategyNumber:
+		return value1 > value2;
+	default:
+		elog(ERROR, "unexpected strategy number: %d", strategy);
+	}
+}
+
+/*
+ * Compare the values in the same way as the float operators, which regard NaN
+ * as equal to itself and greater than any other value.
+ */
+static bool compare_float(float8 value1, float8 value2, int strategy)
+{
+	switch (strategy) {
+	case BTLessStrategyNumber:
+		return float8_lt(value1, value2);
+	case BTLessEqualStrategyNumber:
+		return float8_le(value1, value2);
+	case BTEqualStrategyNumber:
+		return float8_eq(value1, value2);
+	case BTGreaterEqualStrategyNumber:
+		return float8_ge(value1, value2);
+	case BTGreaterStrategyNumber:
+		return float8_gt(value1, value2);
+	default:
+		elog(ERROR, "unexpected strategy number: %d", strategy);
+	}
+}
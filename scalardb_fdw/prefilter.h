@@ -0,0 +1,66 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SCALARDB_FDW_PREFILTER_H
+#define SCALARDB_FDW_PREFILTER_H
+
+#include "c.h"
+#include "postgres.h"
+#include "access/attnum.h"
+#include "nodes/pathnodes.h"
+
+/*
+ * Type of the local conditions evaluated on the columns of a result before
+ * the tuple is formed
+ */
+typedef enum {
+	/* comparison of an integer column with a constant */
+	SCALARDB_PREFILTER_INT_COMPARISON,
+	/* comparison of a floating-point column with a constant */
+	SCALARDB_PREFILTER_FLOAT_COMPARISON,
+	SCALARDB_PREFILTER_IS_NULL,
+	SCALARDB_PREFILTER_IS_NOT_NULL,
+	/* boolean column */
+	SCALARDB_PREFILTER_IS_TRUE,
+	/* NOT boolean column */
+	SCALARDB_PREFILTER_IS_FALSE,
+} ScalarDbFdwPrefilterType;
+
+/*
+ * Represents a local condition evaluated in the executor phase.
+ */
+typedef struct {
+	ScalarDbFdwPrefilterType type;
+	/* attribute number of the column */
+	AttrNumber attnum;
+	/* type of the column */
+	Oid atttypid;
+	/* btree strategy number of the comparison */
+	int strategy;
+	/* constant compared with the column */
+	int64 int_value;
+	double float_value;
+} ScalarDbFdwPrefilter;
+
+extern List *extract_prefilters(RelOptInfo *baserel, List *local_conds);
+
+extern ScalarDbFdwPrefilter *make_prefilters(List *prefilter_list,
+					     TupleDesc tupdesc,
+					     int *num_prefilters);
+
+extern bool evaluate_prefilter(ScalarDbFdwPrefilter *prefilter, Datum value,
+			       bool isnull);
+
+#endif
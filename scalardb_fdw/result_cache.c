@@ -0,0 +1,332 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "c.h"
+#include "postgres.h"
+
+#include "common/hashfn.h"
+#include "lib/ilist.h"
+#include "miscadmin.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/dsa.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include "result_cache.h"
+
+/* Maximum number of the scans whose results are cached */
+#define RESULT_CACHE_MAX_ENTRIES 4096
+
+/*
+ * Identifies a cached scan. The text of the scan, which is saved with the
+ * results, is compared on lookup in case the hashes collide. The cache is
+ * shared by all databases, in which the same OID can be given to different
+ * foreign tables, so the database is also part of the key.
+ */
+typedef struct {
+	Oid dbid;
+	Oid relid;
+	uint32 hash_hi;
+	uint32 hash_lo;
+} ScalarDbFdwResultCacheKey;
+
+typedef struct {
+	/* hash key, must be first */
+	ScalarDbFdwResultCacheKey key;
+	/* node in the LRU list */
+	dlist_node lru_node;
+	/* key text followed by the results, in the DSA area */
+	dsa_pointer data;
+	Size key_len;
+	Size data_len;
+	TimestampTz expires_at;
+} ScalarDbFdwResultCacheEntry;
+
+typedef struct {
+	/* protects all the fields and the entries */
+	LWLock *lock;
+	int dsa_tranche_id;
+	/* the DSA area is created when the first result is cached */
+	dsa_handle area;
+	/* total size of the cached data */
+	Size used;
+	/* entries ordered from the most recently used one */
+	dlist_head lru;
+} ScalarDbFdwResultCacheShared;
+
+/* Size of the result cache in kilobytes */
+static int result_cache_size = 65536;
+
+static ScalarDbFdwResultCacheShared *shared = NULL;
+static HTAB *entries = NULL;
+static dsa_area *area = NULL;
+
+#if PG_VERSION_NUM >= 150000
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+#endif
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void request_result_cache_shmem(void);
+static void startup_result_cache_shmem(void);
+static Size result_cache_shmem_size(void);
+static dsa_area *get_result_cache_area(void);
+static void make_result_cache_key(Oid relid, const char *key,
+				  ScalarDbFdwResultCacheKey *cache_key);
+static void evict_result_cache_entry(ScalarDbFdwResultCacheEntry *entry);
+
+/*
+ * Define the parameters of the result cache and request the shared memory for
+ * it. The cache is available only if the module is loaded by
+ * shared_preload_libraries.
+ */
+extern void init_result_cache(void)
+{
+	DefineCustomIntVariable(
+		"scalardb_fdw.result_cache_size",
+		"Sets the maximum size of the results of the scans cached in shared memory.",
+		"Only the foreign tables with result_cache_ttl use the cache. A scan whose results exceed a quarter of the size is not cached.",
+		&result_cache_size, 65536, 0, MAX_KILOBYTES, PGC_SIGHUP,
+		GUC_UNIT_KB, NULL, NULL, NULL);
+
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+#if PG_VERSION_NUM >= 150000
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = request_result_cache_shmem;
+#else
+	request_result_cache_shmem();
+#endif
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = startup_result_cache_shmem;
+}
+
+/*
+ * Return the maximum size of the results of a scan that can be cached, or 0
+ * if the cache is not available.
+ */
+extern Size get_result_cache_max_entry_size(void)
+{
+	if (shared == NULL)
+		return 0;
+	/* The results are also buffered in a palloc'ed chunk in the backend */
+	return Min((Size)result_cache_size * 1024 / 4, MaxAllocSize / 2);
+}
+
+/*
+ * Look up the cached results of the scan identified by key on the foreign
+ * table. If they are cached and not expired, a copy of them is returned in
+ * data and len.
+ */
+extern bool lookup_result_cache(Oid relid, const char *key, char **data,
+				Size *len)
+{
+	ScalarDbFdwResultCacheKey cache_key;
+	ScalarDbFdwResultCacheEntry *entry;
+	Size key_len = strlen(key) + 1;
+	dsa_area *cache_area;
+	bool found = false;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (get_result_cache_max_entry_size() == 0)
+		return false;
+
+	make_result_cache_key(relid, key, &cache_key);
+	cache_area = get_result_cache_area();
+
+	LWLockAcquire(shared->lock, LW_EXCLUSIVE);
+	entry = hash_search(entries, &cache_key, HASH_FIND, NULL);
+	if (entry != NULL && entry->expires_at <= GetCurrentTimestamp()) {
+		evict_result_cache_entry(entry);
+		entry = NULL;
+	}
+	if (entry != NULL) {
+		char *cached = dsa_get_address(cache_area, entry->data);
+
+		if (entry->key_len == key_len &&
+		    memcmp(cached, key, key_len) == 0) {
+			*len = entry->data_len - key_len;
+			*data = palloc(*len);
+			memcpy(*data, cached + key_len, *len);
+			dlist_move_head(&shared->lru, &entry->lru_node);
+			found = true;
+		}
+	}
+	LWLockRelease(shared->lock);
+
+	return found;
+}
+
+/*
+ * Cache the results of the scan identified by key on the foreign table for ttl
+ * seconds. The least recently used entries are evicted to make room for them.
+ */
+extern void store_result_cache(Oid relid, const char *key, const char *data,
+			       Size len, int ttl)
+{
+	ScalarDbFdwResultCacheKey cache_key;
+	ScalarDbFdwResultCacheEntry *entry;
+	Size key_len = strlen(key) + 1;
+	Size data_len = key_len + len;
+	dsa_area *cache_area;
+	dsa_pointer dp;
+	bool found;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (data_len > get_result_cache_max_entry_size())
+		return;
+
+	make_result_cache_key(relid, key, &cache_key);
+	cache_area = get_result_cache_area();
+
+	LWLockAcquire(shared->lock, LW_EXCLUSIVE);
+
+	entry = hash_search(entries, &cache_key, HASH_FIND, NULL);
+	if (entry != NULL)
+		evict_result_cache_entry(entry);
+
+	while (!dlist_is_empty(&shared->lru) &&
+	       (shared->used + data_len > (Size)result_cache_size * 1024 ||
+		hash_get_num_entries(entries) >= RESULT_CACHE_MAX_ENTRIES))
+		evict_result_cache_entry(dlist_tail_element(
+			ScalarDbFdwResultCacheEntry, lru_node, &shared->lru));
+
+	dp = dsa_allocate_extended(cache_area, data_len, DSA_ALLOC_NO_OOM);
+	if (!DsaPointerIsValid(dp)) {
+		LWLockRelease(shared->lock);
+		return;
+	}
+	memcpy(dsa_get_address(cache_area, dp), key, key_len);
+	memcpy((char *)dsa_get_address(cache_area, dp) + key_len, data, len);
+
+	entry = hash_search(entries, &cache_key, HASH_ENTER, &found);
+	entry->data = dp;
+	entry->key_len = key_len;
+	entry->data_len = data_len;
+	entry->expires_at = TimestampTzPlusMilliseconds(GetCurrentTimestamp(),
+							 (int64)ttl * 1000);
+	dlist_push_head(&shared->lru, &entry->lru_node);
+	shared->used += data_len;
+
+	LWLockRelease(shared->lock);
+}
+
+static void request_result_cache_shmem(void)
+{
+#if PG_VERSION_NUM >= 150000
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+#endif
+	RequestAddinShmemSpace(result_cache_shmem_size());
+	RequestNamedLWLockTranche("scalardb_fdw", 1);
+}
+
+static void startup_result_cache_shmem(void)
+{
+	HASHCTL ctl;
+	bool found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	shared = ShmemInitStruct("scalardb_fdw result cache",
+				 sizeof(ScalarDbFdwResultCacheShared), &found);
+	if (!found) {
+		shared->lock = &(GetNamedLWLockTranche("scalardb_fdw"))->lock;
+		shared->dsa_tranche_id = LWLockNewTrancheId();
+		shared->area = DSM_HANDLE_INVALID;
+		shared->used = 0;
+		dlist_init(&shared->lru);
+	}
+
+	ctl.keysize = sizeof(ScalarDbFdwResultCacheKey);
+	ctl.entrysize = sizeof(ScalarDbFdwResultCacheEntry);
+	entries = ShmemInitHash("scalardb_fdw result cache entries",
+				RESULT_CACHE_MAX_ENTRIES,
+				RESULT_CACHE_MAX_ENTRIES, &ctl,
+				HASH_ELEM | HASH_BLOBS);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+static Size result_cache_shmem_size(void)
+{
+	return add_size(MAXALIGN(sizeof(ScalarDbFdwResultCacheShared)),
+			hash_estimate_size(RESULT_CACHE_MAX_ENTRIES,
+					   sizeof(ScalarDbFdwResultCacheEntry)));
+}
+
+/*
+ * Attach to the DSA area of the cached results, creating it if this is the
+ * first backend that uses it.
+ */
+static dsa_area *get_result_cache_area(void)
+{
+	MemoryContext oldcontext;
+
+	if (area != NULL)
+		return area;
+
+	LWLockRegisterTranche(shared->dsa_tranche_id,
+			      "scalardb_fdw_result_cache");
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	LWLockAcquire(shared->lock, LW_EXCLUSIVE);
+	if (shared->area == DSM_HANDLE_INVALID) {
+		area = dsa_create(shared->dsa_tranche_id);
+		dsa_pin(area);
+		shared->area = dsa_get_handle(area);
+	} else {
+		area = dsa_attach(shared->area);
+	}
+	dsa_pin_mapping(area);
+	LWLockRelease(shared->lock);
+	MemoryContextSwitchTo(oldcontext);
+
+	return area;
+}
+
+static void make_result_cache_key(Oid relid, const char *key,
+				  ScalarDbFdwResultCacheKey *cache_key)
+{
+	uint64 hash = hash_bytes_extended((const unsigned char *)key,
+					  strlen(key), 0);
+
+	memset(cache_key, 0, sizeof(ScalarDbFdwResultCacheKey));
+	cache_key->dbid = MyDatabaseId;
+	cache_key->relid = relid;
+	cache_key->hash_hi = (uint32)(hash >> 32);
+	cache_key->hash_lo = (uint32)hash;
+}
+
+/*
+ * Remove the entry and free its data. The caller must hold the lock and be
+ * attached to the DSA area.
+ */
+static void evict_result_cache_entry(ScalarDbFdwResultCacheEntry *entry)
+{
+	dsa_free(area, entry->data);
+	shared->used -= entry->data_len;
+	dlist_delete(&entry->lru_node);
+	hash_search(entries, &entry->key, HASH_REMOVE, NULL);
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import com.scalar.db.api.Result;
+import com.scalar.db.api.Scanner;
+import com.scalar.db.exception.storage.ExecutionException;
+import java.util.ArrayList;
+import java.util.Iterator;
+import java.util.List;
+import java.util.NoSuchElementException;
+import java.util.Optional;
+
+/**
+ * A scanner whose {@link #all()} and {@link #iterator()} read the results with {@link #one()}.
+ * Subclasses implement {@link #one()} and {@link #close()}.
+ */
+abstract class AbstractScanner implements Scanner {
+  @Override
+  public List<Result> all() throws ExecutionException {
+    List<Result> results = new ArrayList<>();
+    Optional<Result> result;
+    while ((result = one()).isPresent()) {
+      results.add(result.get());
+    }
+    return results;
+  }
+
+  @Override
+  public Iterator<Result> iterator() {
+    return new Iterator<Result>() {
+      private Optional<Result> next;
+
+      @Override
+      public boolean hasNext() {
+        if (next == null) {
+          try {
+            next = one();
+          } catch (ExecutionException e) {
+            throw new RuntimeException(e);
+          }
+        }
+        return next.isPresent();
+      }
+
+      @Override
+      public Result next() {
+        if (!hasNext()) {
+          throw new NoSuchElementException();
+        }
+        Result result = next.get();
+        next = null;
+        return result;
+      }
+    };
+  }
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import com.scalar.db.api.DistributedStorage;
+import com.scalar.db.api.Get;
+import com.scalar.db.api.GetBuilder;
+import com.scalar.db.api.Result;
+import com.scalar.db.api.Scan;
+import com.scalar.db.api.TableMetadata;
+import com.scalar.db.common.ResultImpl;
+import com.scalar.db.exception.storage.ExecutionException;
+import com.scalar.db.io.Column;
+import com.scalar.db.io.Key;
+import com.scalar.db.transaction.consensuscommit.Attribute;
+import com.scalar.db.transaction.consensuscommit.ConsensusCommitUtils;
+import com.scalar.db.transaction.consensuscommit.TransactionState;
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.LinkedHashSet;
+import java.util.List;
+import java.util.Map;
+import java.util.Optional;
+import java.util.Set;
+
+/**
+ * A scanner that returns the committed values of the records of a Consensus Commit table. The
+ * records are read as they are stored, and only the ones written by in-flight transactions are
+ * read again with their before images. The records that have never been committed are skipped.
+ */
+class CommittedScanner extends ForwardingScanner {
+  private static final int COMMITTED = TransactionState.COMMITTED.get();
+
+  private final DistributedStorage storage;
+  private final Scan scan;
+  private final TableMetadata metadata;
+  private final int limit;
+  private int count;
+
+  CommittedScanner(DistributedStorage storage, Scan scan, TableMetadata metadata)
+      throws ExecutionException {
+    this(storage, scan, metadata, storage::scan);
+  }
+
+  /** The records are read with the scanner opened by the opener, e.g., in pages. */
+  CommittedScanner(
+      DistributedStorage storage, Scan scan, TableMetadata metadata, MergedScanner.Opener opener)
+      throws ExecutionException {
+    // The limit is applied after the uncommitted records are skipped
+    super(opener.open(prepare(scan, metadata)));
+    this.storage = storage;
+    this.scan = scan;
+    this.metadata = metadata;
+    this.limit = scan.getLimit();
+  }
+
+  /**
+   * Returns the scan that also retrieves the transaction state and the keys, which are needed to
+   * read the before images of the records.
+   */
+  private static Scan prepare(Scan scan, TableMetadata metadata) {
+    if (scan.getProjections().isEmpty()) {
+      return Scan.newBuilder(scan).limit(0).build();
+    }
+
+    Set<String> names = new LinkedHashSet<>();
+    if (metadata.getColumnNames().contains(Attribute.STATE)) {
+      names.add(Attribute.STATE);
+    }
+    names.addAll(metadata.getPartitionKeyNames());
+    names.addAll(metadata.getClusteringKeyNames());
+    names.removeAll(scan.getProjections());
+    return Scan.newBuilder(scan).projections(names).limit(0).build();
+  }
+
+  @Override
+  public Optional<Result> one() throws ExecutionException {
+    if (limit > 0 && count >= limit) {
+      return Optional.empty();
+    }
+
+    Optional<Result> result;
+    while ((result = scanner.one()).isPresent()) {
+      Result committed = isCommitted(result.get()) ? result.get() : readCommitted(result.get());
+      if (committed != null) {
+        count++;
+        return Optional.of(committed);
+      }
+    }
+    return Optional.empty();
+  }
+
+  private static boolean isCommitted(Result result) {
+    return !result.contains(Attribute.STATE)
+        || result.isNull(Attribute.STATE)
+        || result.getInt(Attribute.STATE) == COMMITTED;
+  }
+
+  /**
+   * Returns the committed values of the record written by an in-flight transaction, or null if the
+   * record has never been committed. The record is read again since the transaction may have been
+   * committed after it was scanned.
+   */
+  private Result readCommitted(Result result) throws ExecutionException {
+    List<String> names = getColumnNames();
+    Key partitionKey = getKey(result, metadata.getPartitionKeyNames());
+
+    GetBuilder.BuildableGet builder =
+        Get.newBuilder()
+            .namespace(scan.forNamespace().get())
+            .table(scan.forTable().get())
+            .partitionKey(partitionKey);
+    if (!metadata.getClusteringKeyNames().isEmpty()) {
+      builder = builder.clusteringKey(getKey(result, metadata.getClusteringKeyNames()));
+    }
+    if (!scan.getProjections().isEmpty()) {
+      Set<String> projections = new LinkedHashSet<>();
+      projections.add(Attribute.STATE);
+      projections.add(Attribute.BEFORE_STATE);
+      projections.addAll(metadata.getPartitionKeyNames());
+      projections.addAll(metadata.getClusteringKeyNames());
+      for (String name : names) {
+        projections.add(name);
+        projections.add(Attribute.BEFORE_PREFIX + name);
+      }
+      builder = builder.projections(projections);
+    }
+
+    Optional<Result> latest = storage.get(builder.build());
+    if (!latest.isPresent()) {
+      return null;
+    }
+    if (isCommitted(latest.get())) {
+      return latest.get();
+    }
+    if (latest.get().isNull(Attribute.BEFORE_STATE)
+        || latest.get().getInt(Attribute.BEFORE_STATE) != COMMITTED) {
+      return null;
+    }
+
+    // The keys are never changed by transactions, so only the other columns are read from the
+    // before image
+    Map<String, Column<?>> latestColumns = latest.get().getColumns();
+    Map<String, Column<?>> columns = new HashMap<>();
+    for (String name : names) {
+      Column<?> column =
+          metadata.getPartitionKeyNames().contains(name)
+                  || metadata.getClusteringKeyNames().contains(name)
+              ? latestColumns.get(name)
+              : latestColumns.get(Attribute.BEFORE_PREFIX + name);
+      if (column != null) {
+        columns.put(name, column.copyWith(name));
+      }
+    }
+    return new ResultImpl(columns, metadata);
+  }
+
+  /** Returns the names of the columns of the table that are retrieved by the scan. */
+  private List<String> getColumnNames() {
+    if (!scan.getProjections().isEmpty()) {
+      return scan.getProjections();
+    }
+
+    List<String> names = new ArrayList<>();
+    for (String name : metadata.getColumnNames()) {
+      if (!ConsensusCommitUtils.isTransactionMetaColumn(name, metadata)) {
+        names.add(name);
+      }
+    }
+    return names;
+  }
+
+  private static Key getKey(Result result, Set<String> names) {
+    Key.Builder builder = Key.newBuilder();
+    Map<String, Column<?>> columns = result.getColumns();
+    for (String name : names) {
+      builder.add(columns.get(name));
+    }
+    return builder.build();
+  }
+}
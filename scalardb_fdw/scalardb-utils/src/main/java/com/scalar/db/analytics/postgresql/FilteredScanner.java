@@ -0,0 +1,68 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import com.scalar.db.api.Result;
+import com.scalar.db.api.Scanner;
+import com.scalar.db.exception.storage.ExecutionException;
+import com.scalar.db.io.Column;
+import com.scalar.db.io.Key;
+import java.util.List;
+import java.util.Map;
+import java.util.Optional;
+import java.util.function.Predicate;
+
+/**
+ * A scanner that returns only the results that satisfy the predicate. This is used to filter the
+ * results of a scan with an index by the conditions on the other indexes, and to sample the
+ * results of a scan by their partitions.
+ */
+class FilteredScanner extends ForwardingScanner {
+  private final Predicate<Result> predicate;
+
+  FilteredScanner(Scanner scanner, Predicate<Result> predicate) {
+    super(scanner);
+    this.predicate = predicate;
+  }
+
+  /**
+   * Returns a predicate that matches the results whose columns are equal to all the columns of the
+   * filter.
+   */
+  static Predicate<Result> matching(Key filter) {
+    List<Column<?>> columns = filter.getColumns();
+    return result -> matches(result, columns);
+  }
+
+  @Override
+  public Optional<Result> one() throws ExecutionException {
+    Optional<Result> result;
+    do {
+      result = scanner.one();
+    } while (result.isPresent() && !predicate.test(result.get()));
+    return result;
+  }
+
+  private static boolean matches(Result result, List<Column<?>> filter) {
+    Map<String, Column<?>> columns = result.getColumns();
+    for (Column<?> column : filter) {
+      if (!column.equals(columns.get(column.getName()))) {
+        return false;
+      }
+    }
+    return true;
+  }
+}
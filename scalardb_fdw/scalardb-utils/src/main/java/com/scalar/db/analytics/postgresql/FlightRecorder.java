@@ -0,0 +1,66 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import java.lang.management.ManagementFactory;
+import javax.management.JMException;
+import javax.management.MBeanServer;
+import javax.management.ObjectName;
+
+/**
+ * Starts and stops a Java Flight Recorder recording of the JVM embedded in the backend. The
+ * recording is controlled by the diagnostic commands of the JVM, which are available without
+ * compiling against the jdk.jfr module.
+ */
+final class FlightRecorder {
+  private static final String RECORDING_NAME = "scalardb_fdw";
+  private static final String DIAGNOSTIC_COMMAND = "com.sun.management:type=DiagnosticCommand";
+
+  private FlightRecorder() {}
+
+  /**
+   * Starts the recording with the given settings, e.g., "default" or "profile". The recording is
+   * written to the file when it is stopped. Returns the output of the command.
+   */
+  static String start(String settings, String filename) throws JMException {
+    return execute(
+        "jfrStart",
+        "name=" + RECORDING_NAME,
+        "settings=" + settings,
+        "filename=" + quote(filename));
+  }
+
+  /** Stops the recording and writes it to the file. Returns the output of the command. */
+  static String stop() throws JMException {
+    return execute("jfrStop", "name=" + RECORDING_NAME);
+  }
+
+  private static String execute(String command, String... args) throws JMException {
+    MBeanServer server = ManagementFactory.getPlatformMBeanServer();
+    Object output =
+        server.invoke(
+            new ObjectName(DIAGNOSTIC_COMMAND),
+            command,
+            new Object[] {args},
+            new String[] {String[].class.getName()});
+    return output == null ? "" : output.toString().trim();
+  }
+
+  /** Quotes the value so that the command does not split it at spaces. */
+  private static String quote(String value) {
+    return "\"" + value + "\"";
+  }
+}
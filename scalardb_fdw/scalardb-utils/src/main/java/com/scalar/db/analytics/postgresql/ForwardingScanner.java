@@ -0,0 +1,36 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import com.scalar.db.api.Scanner;
+import java.io.IOException;
+
+/**
+ * A scanner that reads the results from another scanner. Subclasses implement {@link #one()} to
+ * drop or transform the results of the underlying scanner before they are passed through JNI.
+ */
+abstract class ForwardingScanner extends AbstractScanner {
+  protected final Scanner scanner;
+
+  ForwardingScanner(Scanner scanner) {
+    this.scanner = scanner;
+  }
+
+  @Override
+  public void close() throws IOException {
+    scanner.close();
+  }
+}
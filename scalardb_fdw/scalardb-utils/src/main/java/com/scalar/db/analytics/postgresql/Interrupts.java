@@ -0,0 +1,103 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import com.scalar.db.exception.storage.ExecutionException;
+import java.util.concurrent.CancellationException;
+import java.util.concurrent.Future;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.TimeoutException;
+
+/**
+ * Waits for the remote operations run on other threads while the interrupts of the backend, e.g.,
+ * a query cancel or statement_timeout, are checked. The backend cannot handle its interrupts while
+ * it is in a call to the JVM, so the calls that may block on the storage run on the thread pool of
+ * {@link MergedScanner} and the backend waits for them here.
+ */
+final class Interrupts {
+  private static final long POLL_MILLIS = 10;
+
+  private Interrupts() {}
+
+  /**
+   * Returns true if the backend has an interrupt to handle. This is implemented in scalardb.c and
+   * must be called on the thread of the backend.
+   */
+  static native boolean isPending();
+
+  /**
+   * Returns the result of the future. If the backend has an interrupt to handle while it waits, the
+   * future is canceled with its thread interrupted, and {@link ScalarDbFdwCanceledException} is
+   * thrown.
+   */
+  static <T> T await(Future<T> future) throws ExecutionException {
+    return await(future, () -> {});
+  }
+
+  /**
+   * Same as {@link #await(Future)}, but onCancel is also run when the future is canceled. It stops
+   * the blocking calls that are not stopped by the interrupt of the thread, e.g., a JDBC query.
+   */
+  static <T> T await(Future<T> future, Runnable onCancel) throws ExecutionException {
+    try {
+      while (true) {
+        try {
+          return future.get(POLL_MILLIS, TimeUnit.MILLISECONDS);
+        } catch (TimeoutException e) {
+          if (isPending()) {
+            future.cancel(true);
+            onCancel.run();
+            throw new ScalarDbFdwCanceledException();
+          }
+        }
+      }
+    } catch (InterruptedException e) {
+      Thread.currentThread().interrupt();
+      throw new RuntimeException(e);
+    } catch (java.util.concurrent.ExecutionException e) {
+      Throwable cause = e.getCause();
+      if (cause instanceof ExecutionException) {
+        throw (ExecutionException) cause;
+      }
+      if (cause instanceof RuntimeException) {
+        throw (RuntimeException) cause;
+      }
+      throw new RuntimeException(cause);
+    }
+  }
+
+  /**
+   * Waits until the future completes, normally or not, without canceling it. Returns false if the
+   * backend has an interrupt to handle before the future completes.
+   */
+  static boolean awaitCompletion(Future<?> future) {
+    while (true) {
+      try {
+        future.get(POLL_MILLIS, TimeUnit.MILLISECONDS);
+        return true;
+      } catch (TimeoutException e) {
+        if (isPending()) {
+          return false;
+        }
+      } catch (CancellationException | java.util.concurrent.ExecutionException e) {
+        return true;
+      } catch (InterruptedException e) {
+        Thread.currentThread().interrupt();
+        return false;
+      }
+    }
+  }
+}
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import com.scalar.db.api.Scan;
+import com.scalar.db.api.ScanAll;
+import com.scalar.db.io.Column;
+import com.scalar.db.io.Key;
+import java.sql.Connection;
+import java.sql.DriverManager;
+import java.sql.PreparedStatement;
+import java.sql.ResultSet;
+import java.sql.SQLException;
+import java.sql.Statement;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * Counts the records retrieved by a Scan with a native COUNT(*) query on the underlying JDBC
+ * database, so that the records themselves are never read into the JVM. The range of the values
+ * of a column is also taken with a native query.
+ *
+ * <p>The queries share one connection, so they are serialized. A running query can be canceled
+ * from another thread with {@link #cancel}, since interrupting the thread does not stop a blocking
+ * JDBC call.
+ *
+ * <p>The connection is opened with {@link DriverManager} from the contact points, username, and
+ * password of the storage, outside the connection pool of ScalarDB. So the other JDBC settings of
+ * ScalarDB, e.g., the pool sizes and the isolation level, do not apply to it, and the driver
+ * properties such as SSL must be given in the URL of the contact points.
+ */
+class JdbcCounter implements AutoCloseable {
+  private final String url;
+  private final String username;
+  private final String password;
+  private Connection connection;
+  private volatile Statement running;
+
+  JdbcCounter(String url, String username, String password) {
+    this.url = url;
+    this.username = username;
+    this.password = password;
+  }
+
+  synchronized long count(Scan scan) throws SQLException {
+    List<String> conditions = new ArrayList<>();
+    List<Column<?>> values = new ArrayList<>();
+
+    if (!(scan instanceof ScanAll)) {
+      // The partition key holds the index key for Scan (indexKey)
+      for (Column<?> column : scan.getPartitionKey().getColumns()) {
+        conditions.add(enclose(column.getName()) + " = ?");
+        values.add(column);
+      }
+      if (scan.getStartClusteringKey().isPresent()) {
+        addBoundary(
+            scan.getStartClusteringKey().get(),
+            scan.getStartInclusive() ? " >= ?" : " > ?",
+            conditions,
+            values);
+      }
+      if (scan.getEndClusteringKey().isPresent()) {
+        addBoundary(
+            scan.getEndClusteringKey().get(),
+            scan.getEndInclusive() ? " <= ?" : " < ?",
+            conditions,
+            values);
+      }
+    }
+
+    StringBuilder sql =
+        new StringBuilder(" FROM ")
+            .append(tableName(scan.forNamespace().get(), scan.forTable().get()));
+    if (!conditions.isEmpty()) {
+      sql.append(" WHERE ").append(String.join(" AND ", conditions));
+    }
+    if (scan.getLimit() > 0) {
+      // Count at most the given number of records in a subquery
+      limit(sql, scan.getLimit());
+      sql.insert(0, "SELECT COUNT(*) FROM (").append(") t");
+    } else {
+      sql.insert(0, "SELECT COUNT(*)");
+    }
+
+    try (PreparedStatement statement = getConnection().prepareStatement(sql.toString())) {
+      for (int i = 0; i < values.size(); i++) {
+        bind(statement, i + 1, values.get(i));
+      }
+      running = statement;
+      try (ResultSet resultSet = statement.executeQuery()) {
+        resultSet.next();
+        return resultSet.getLong(1);
+      } finally {
+        running = null;
+      }
+    }
+  }
+
+  /**
+   * Returns the minimum and maximum values of the given integer column of the table, or null if the
+   * table is empty.
+   */
+  synchronized long[] range(String namespace, String table, String column) throws SQLException {
+    String sql =
+        "SELECT MIN("
+            + enclose(column)
+            + "), MAX("
+            + enclose(column)
+            + ") FROM "
+            + tableName(namespace, table);
+    try (PreparedStatement statement = getConnection().prepareStatement(sql)) {
+      running = statement;
+      try (ResultSet resultSet = statement.executeQuery()) {
+        resultSet.next();
+        long min = resultSet.getLong(1);
+        if (resultSet.wasNull()) {
+          return null;
+        }
+        return new long[] {min, resultSet.getLong(2)};
+      } finally {
+        running = null;
+      }
+    }
+  }
+
+  /** Cancels the running query, if any, which then fails with SQLException. */
+  void cancel() {
+    Statement statement = running;
+    if (statement != null) {
+      try {
+        statement.cancel();
+      } catch (SQLException e) {
+        // The query has finished or the driver cannot cancel it
+      }
+    }
+  }
+
+  @Override
+  public synchronized void close() throws SQLException {
+    if (connection != null) {
+      connection.close();
+      connection = null;
+    }
+  }
+
+  private Connection getConnection() throws SQLException {
+    if (connection == null || connection.isClosed()) {
+      connection = DriverManager.getConnection(url, username, password);
+    }
+    return connection;
+  }
+
+  /**
+   * A clustering key boundary fixes all but the last column with equality and bounds the last
+   * column with the given operator, in the same way as ScalarDB does.
+   */
+  private void addBoundary(
+      Key key, String lastOperator, List<String> conditions, List<Column<?>> values) {
+    List<Column<?>> columns = key.getColumns();
+    for (int i = 0; i < columns.size(); i++) {
+      Column<?> column = columns.get(i);
+      String operator = i == columns.size() - 1 ? lastOperator : " = ?";
+      conditions.add(enclose(column.getName()) + operator);
+      values.add(column);
+    }
+  }
+
+  private void limit(StringBuilder fromClause, int limit) {
+    if (url.startsWith("jdbc:sqlserver:")) {
+      fromClause.insert(0, "SELECT TOP " + limit + " 1");
+    } else if (url.startsWith("jdbc:postgresql:")
+        || url.startsWith("jdbc:mysql:")
+        || url.startsWith("jdbc:mariadb:")
+        || url.startsWith("jdbc:sqlite:")) {
+      fromClause.insert(0, "SELECT 1").append(" LIMIT ").append(limit);
+    } else {
+      fromClause.insert(0, "SELECT 1").append(" FETCH FIRST ").append(limit).append(" ROWS ONLY");
+    }
+  }
+
+  private void bind(PreparedStatement statement, int index, Column<?> column)
+      throws SQLException {
+    switch (column.getDataType()) {
+      case BOOLEAN:
+        statement.setBoolean(index, column.getBooleanValue());
+        break;
+      case INT:
+        statement.setInt(index, column.getIntValue());
+        break;
+      case BIGINT:
+        statement.setLong(index, column.getBigIntValue());
+        break;
+      case FLOAT:
+        statement.setFloat(index, column.getFloatValue());
+        break;
+      case DOUBLE:
+        statement.setDouble(index, column.getDoubleValue());
+        break;
+      case TEXT:
+        statement.setString(index, column.getTextValue());
+        break;
+      case BLOB:
+        statement.setBytes(index, column.getBlobValueAsBytes());
+        break;
+      default:
+        throw new AssertionError("Unsupported data type: " + column.getDataType());
+    }
+  }
+
+  private String tableName(String namespace, String table) {
+    // SQLite has no schemas, so ScalarDB prefixes the table name with the namespace
+    if (url.startsWith("jdbc:sqlite:")) {
+      return enclose(namespace + "$" + table);
+    }
+    return enclose(namespace) + "." + enclose(table);
+  }
+
+  private String enclose(String name) {
+    if (url.startsWith("jdbc:mysql:") || url.startsWith("jdbc:mariadb:")) {
+      return "`" + name + "`";
+    }
+    if (url.startsWith("jdbc:sqlserver:")) {
+      return "[" + name + "]";
+    }
+    return "\"" + name + "\"";
+  }
+}
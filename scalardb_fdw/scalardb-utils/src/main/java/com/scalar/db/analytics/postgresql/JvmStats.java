@@ -0,0 +1,65 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import java.lang.management.GarbageCollectorMXBean;
+import java.lang.management.ManagementFactory;
+import java.lang.management.MemoryMXBean;
+import java.lang.management.MemoryUsage;
+import java.lang.management.ThreadMXBean;
+import java.util.concurrent.atomic.AtomicInteger;
+
+/** Statistics of the JVM embedded in the backend, which are read by scalardb_fdw_jvm_stats(). */
+final class JvmStats {
+  /** Number of the scanners returned to the backend that have not been closed */
+  static final AtomicInteger openScanners = new AtomicInteger();
+
+  private JvmStats() {}
+
+  /**
+   * Returns the heap used, committed and max, the non-heap used and committed in bytes, the total
+   * number and time in milliseconds of the garbage collections, the number of live, daemon and
+   * peak threads, and the number of open scanners, in this order. The max is -1 if undefined.
+   */
+  static long[] collect() {
+    MemoryMXBean memory = ManagementFactory.getMemoryMXBean();
+    MemoryUsage heap = memory.getHeapMemoryUsage();
+    MemoryUsage nonHeap = memory.getNonHeapMemoryUsage();
+
+    long gcCount = 0;
+    long gcTime = 0;
+    for (GarbageCollectorMXBean gc : ManagementFactory.getGarbageCollectorMXBeans()) {
+      // -1 if undefined for the collector
+      gcCount += Math.max(gc.getCollectionCount(), 0);
+      gcTime += Math.max(gc.getCollectionTime(), 0);
+    }
+
+    ThreadMXBean threads = ManagementFactory.getThreadMXBean();
+    return new long[] {
+      heap.getUsed(),
+      heap.getCommitted(),
+      heap.getMax(),
+      nonHeap.getUsed(),
+      nonHeap.getCommitted(),
+      gcCount,
+      gcTime,
+      threads.getThreadCount(),
+      threads.getDaemonThreadCount(),
+      threads.getPeakThreadCount(),
+      openScanners.get()
+    };
+  }
+}
@@ -0,0 +1,372 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import com.scalar.db.api.Result;
+import com.scalar.db.api.Scan;
+import com.scalar.db.api.Scanner;
+import com.scalar.db.exception.storage.ExecutionException;
+import com.scalar.db.io.Column;
+import java.io.IOException;
+import java.util.ArrayDeque;
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.Comparator;
+import java.util.List;
+import java.util.Optional;
+import java.util.PriorityQueue;
+import java.util.concurrent.Callable;
+import java.util.concurrent.Future;
+import java.util.concurrent.FutureTask;
+import java.util.concurrent.LinkedBlockingQueue;
+import java.util.concurrent.ThreadPoolExecutor;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.atomic.AtomicInteger;
+
+/**
+ * A scanner that runs several scans concurrently and merges their results in the order of the
+ * orderings of the scans. The scans must have the same orderings. If they have no orderings, the
+ * results are returned scan by scan.
+ *
+ * <p>The results of each scan are fetched in batches on a thread pool shared by all the merged
+ * scanners, so at most {@link #THREADS} scans are read at once. The batches grow from {@link
+ * #FIRST_BATCH_SIZE} to {@link #BATCH_SIZE} results. If several scans are merged, the next batch
+ * of each scan is fetched while the current one is merged. A single scan fetches its next batch
+ * only when the current one has been consumed, so that a query that stops early, e.g., with LIMIT,
+ * does not read a batch ahead, which would undo the bounded pages of {@link PagedScanner}. The
+ * fetches never wait for each other, so a merge never stalls on a full pool.
+ *
+ * <p>The backend waits for the batches with {@link Interrupts#await}, so a canceled query stops
+ * waiting for the storage at once. The pending fetches are then interrupted and the scanners are
+ * closed to release their remote resources. A canceled task that does not stop, e.g., one blocked
+ * in a call to the storage that ignores the interrupt, still holds its thread, so a thread is added
+ * to the pool for each such task until it finishes. At most {@link #MAX_ABANDONED} threads are
+ * added, after which the abandoned tasks delay the others.
+ */
+class MergedScanner extends AbstractScanner {
+  private static final int THREADS = 8;
+  private static final int MAX_ABANDONED = 32;
+  private static final int FIRST_BATCH_SIZE = 16;
+  private static final int BATCH_SIZE = 256;
+  private static final ThreadPoolExecutor executor =
+      new ThreadPoolExecutor(
+          THREADS,
+          THREADS + MAX_ABANDONED,
+          60,
+          TimeUnit.SECONDS,
+          new LinkedBlockingQueue<>(),
+          runnable -> {
+            Thread thread = new Thread(runnable, "scalardb-fdw-scan");
+            thread.setDaemon(true);
+            return thread;
+          });
+  // The number of the canceled tasks that are still running. Guarded by MergedScanner.class
+  private static int abandoned;
+
+  /** Opens the scanner of each scan on the thread pool. */
+  @FunctionalInterface
+  interface Opener {
+    Scanner open(Scan scan) throws ExecutionException;
+  }
+
+  private final List<Source> sources = new ArrayList<>();
+  private final PriorityQueue<Source> heads;
+  private boolean started;
+  private boolean closed;
+
+  MergedScanner(List<Scan> scans, Opener opener) {
+    Comparator<Result> comparator =
+        comparator(scans.isEmpty() ? Collections.emptyList() : scans.get(0).getOrderings());
+    heads =
+        new PriorityQueue<>(
+            Math.max(scans.size(), 1),
+            (a, b) -> {
+              int c = comparator.compare(a.peek(), b.peek());
+              return c != 0 ? c : Integer.compare(a.index, b.index);
+            });
+    for (Scan scan : scans) {
+      sources.add(new Source(sources.size(), scan, opener, scans.size() > 1));
+    }
+    JvmStats.openScanners.incrementAndGet();
+  }
+
+  /** Runs the task on the thread pool, e.g., to wait for it with {@link Interrupts#await}. */
+  static <T> Future<T> submit(Callable<T> callable) {
+    Task<T> task = new Task<>(callable);
+    executor.execute(task);
+    return task;
+  }
+
+  /**
+   * Adds the given number of abandoned tasks, which may be negative, and resizes the pool so that
+   * they do not take the threads of the others. The threads above the core size are terminated
+   * when they become idle.
+   */
+  private static synchronized void addAbandoned(int delta) {
+    abandoned += delta;
+    executor.setCorePoolSize(THREADS + Math.min(abandoned, MAX_ABANDONED));
+  }
+
+  @Override
+  public Optional<Result> one() throws ExecutionException {
+    try {
+      return next();
+    } catch (ScalarDbFdwCanceledException e) {
+      for (Source source : sources) {
+        source.cancel();
+      }
+      throw e;
+    }
+  }
+
+  private Optional<Result> next() throws ExecutionException {
+    if (!started) {
+      started = true;
+      for (Source source : sources) {
+        source.prefetch();
+      }
+      for (Source source : sources) {
+        if (source.fill()) {
+          heads.add(source);
+        }
+      }
+    }
+
+    Source source = heads.poll();
+    if (source == null) {
+      return Optional.empty();
+    }
+    Result result = source.batch.poll();
+    if (source.fill()) {
+      heads.add(source);
+    }
+    return Optional.of(result);
+  }
+
+  @Override
+  public void close() throws IOException {
+    if (!closed) {
+      closed = true;
+      JvmStats.openScanners.decrementAndGet();
+    }
+    IOException exception = null;
+    for (Source source : sources) {
+      try {
+        source.close();
+      } catch (IOException e) {
+        if (exception == null) {
+          exception = e;
+        } else {
+          exception.addSuppressed(e);
+        }
+      }
+    }
+    if (exception != null) {
+      throw exception;
+    }
+  }
+
+  private static Comparator<Result> comparator(List<Scan.Ordering> orderings) {
+    Comparator<Result> comparator = (a, b) -> 0;
+    for (Scan.Ordering ordering : orderings) {
+      String name = ordering.getColumnName();
+      Comparator<Result> byColumn =
+          (a, b) -> compare(a.getColumns().get(name), b.getColumns().get(name));
+      comparator =
+          comparator.thenComparing(
+              ordering.getOrder() == Scan.Ordering.Order.DESC ? byColumn.reversed() : byColumn);
+    }
+    return comparator;
+  }
+
+  /** Compares the values of the columns. NULL is smaller than any other value. */
+  @SuppressWarnings("unchecked")
+  private static int compare(Column<?> column1, Column<?> column2) {
+    Object value1 = column1 == null ? null : column1.getValueAsObject();
+    Object value2 = column2 == null ? null : column2.getValueAsObject();
+    if (value1 == null || value2 == null) {
+      return value1 == null ? (value2 == null ? 0 : -1) : 1;
+    }
+    if (value1 instanceof byte[]) {
+      byte[] bytes1 = (byte[]) value1;
+      byte[] bytes2 = (byte[]) value2;
+      for (int i = 0; i < Math.min(bytes1.length, bytes2.length); i++) {
+        int c = Integer.compare(bytes1[i] & 0xff, bytes2[i] & 0xff);
+        if (c != 0) {
+          return c;
+        }
+      }
+      return Integer.compare(bytes1.length, bytes2.length);
+    }
+    return ((Comparable<Object>) value1).compareTo(value2);
+  }
+
+  /**
+   * A scan whose results are fetched in batches. At most one fetch of a scan is pending at a time,
+   * so its scanner is used by one thread at a time.
+   */
+  private static class Source {
+    private final int index;
+    private final Scan scan;
+    private final Opener opener;
+    // Whether the next batch is fetched while the current one is consumed
+    private final boolean readAhead;
+    private final ArrayDeque<Result> batch = new ArrayDeque<>();
+    private Future<List<Result>> next;
+    // Set by the fetches and read after they complete, or when they are canceled
+    private volatile Scanner scanner;
+    private boolean exhausted;
+    // The first batches are small so that the first results are returned early
+    private int batchSize = FIRST_BATCH_SIZE;
+
+    Source(int index, Scan scan, Opener opener, boolean readAhead) {
+      this.index = index;
+      this.scan = scan;
+      this.opener = opener;
+      this.readAhead = readAhead;
+    }
+
+    Result peek() {
+      return batch.peek();
+    }
+
+    void prefetch() {
+      next = submit(this::fetch);
+    }
+
+    /**
+     * Waits for the next batch if the current one has been consumed, and returns false if there
+     * are no more results.
+     */
+    boolean fill() throws ExecutionException {
+      while (batch.isEmpty()) {
+        if (next == null) {
+          if (exhausted) {
+            return false;
+          }
+          prefetch();
+        }
+        List<Result> results = Interrupts.await(next);
+        next = null;
+        batch.addAll(results);
+        if (readAhead && !exhausted) {
+          prefetch();
+        }
+      }
+      return true;
+    }
+
+    private List<Result> fetch() throws ExecutionException, IOException {
+      if (scanner == null) {
+        Scanner opened = opener.open(scan);
+        // The fetch has been canceled while the scanner was opened
+        if (Thread.currentThread().isInterrupted()) {
+          opened.close();
+          throw new ScalarDbFdwCanceledException();
+        }
+        scanner = opened;
+      }
+      List<Result> results = new ArrayList<>(batchSize);
+      while (results.size() < batchSize) {
+        Optional<Result> result = scanner.one();
+        if (!result.isPresent()) {
+          exhausted = true;
+          scanner.close();
+          scanner = null;
+          break;
+        }
+        results.add(result.get());
+      }
+      batchSize = Math.min(batchSize * 2, BATCH_SIZE);
+      return results;
+    }
+
+    /**
+     * Interrupts the pending fetch and closes the scanner, which may be in use by the fetch, so
+     * that the storage stops reading the results.
+     */
+    void cancel() {
+      if (next != null) {
+        next.cancel(true);
+        next = null;
+      }
+      Scanner current = scanner;
+      scanner = null;
+      exhausted = true;
+      if (current != null) {
+        try {
+          current.close();
+        } catch (IOException | RuntimeException e) {
+          // The results are discarded
+        }
+      }
+    }
+
+    /**
+     * Waits for the pending fetch to finish before closing the scanner, since canceling the fetch
+     * does not stop it from using the scanner or from setting a newly opened one. The pending batch
+     * is discarded. If the query is canceled while waiting, the fetch is abandoned as in {@link
+     * #cancel}.
+     */
+    void close() throws IOException {
+      if (next != null) {
+        if (!Interrupts.awaitCompletion(next)) {
+          cancel();
+          return;
+        }
+        next = null;
+      }
+      if (scanner != null) {
+        scanner.close();
+        scanner = null;
+      }
+    }
+  }
+
+  /** A task of the pool that is counted as abandoned if it is canceled while it runs. */
+  private static class Task<T> extends FutureTask<T> {
+    private static final int PENDING = 0;
+    private static final int RUNNING = 1;
+    private static final int ABANDONED = 2;
+    private static final int DONE = 3;
+    private final AtomicInteger state = new AtomicInteger(PENDING);
+
+    Task(Callable<T> callable) {
+      super(callable);
+    }
+
+    @Override
+    public void run() {
+      state.set(RUNNING);
+      try {
+        super.run();
+      } finally {
+        if (state.getAndSet(DONE) == ABANDONED) {
+          addAbandoned(-1);
+        }
+      }
+    }
+
+    @Override
+    public boolean cancel(boolean mayInterruptIfRunning) {
+      boolean canceled = super.cancel(mayInterruptIfRunning);
+      if (canceled && state.compareAndSet(RUNNING, ABANDONED)) {
+        addAbandoned(1);
+      }
+      return canceled;
+    }
+  }
+}
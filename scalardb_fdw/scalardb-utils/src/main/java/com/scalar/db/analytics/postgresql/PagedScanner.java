@@ -0,0 +1,242 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import com.scalar.db.api.Result;
+import com.scalar.db.api.Scan;
+import com.scalar.db.api.ScanAll;
+import com.scalar.db.api.ScanBuilder;
+import com.scalar.db.api.ScanWithIndex;
+import com.scalar.db.api.Scanner;
+import com.scalar.db.api.TableMetadata;
+import com.scalar.db.exception.storage.ExecutionException;
+import com.scalar.db.io.Column;
+import com.scalar.db.io.Key;
+import java.io.IOException;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.Map;
+import java.util.Optional;
+
+/**
+ * A scanner that reads the records of a partition key scan in pages, each of which is read by a
+ * separate scan with a limit that starts after the last record of the previous page. The storage
+ * never buffers more than a page of the records, however many of them are consumed.
+ *
+ * <p>If the page size is adaptive, the first page is small so that the first record is returned
+ * early. The following pages are doubled while reading a page takes longer than consuming it, and
+ * they are bounded by {@link #MAX_PAGE_BYTES} for the observed width of the records.
+ */
+class PagedScanner extends AbstractScanner {
+  private static final int MIN_PAGE_SIZE = 32;
+  private static final int MAX_ADAPTIVE_PAGE_SIZE = 65536;
+  private static final long MAX_PAGE_BYTES = 8L * 1024 * 1024;
+  // The estimated bytes of a column besides the value of TEXT and BLOB columns
+  private static final int COLUMN_OVERHEAD = 16;
+
+  private final Scan scan;
+  private final TableMetadata metadata;
+  private final MergedScanner.Opener opener;
+  private final int fetchSize;
+  private final boolean adaptive;
+  private final boolean forward;
+
+  private Scanner page;
+  private int pageSize;
+  private int pageCount;
+  private int remaining;
+  private boolean exhausted;
+  private Key lastKey;
+
+  private long totalCount;
+  private long totalBytes;
+  private long fetchNanos;
+  private long consumeNanos;
+  private long returnedAt;
+
+  /**
+   * The scan is read with pages of at most fetchSize records, or of an adaptive size up to
+   * fetchSize if adaptive is true. If fetchSize is 0, adaptive pages have no upper bound other than
+   * their bytes.
+   */
+  PagedScanner(
+      Scan scan,
+      TableMetadata metadata,
+      int fetchSize,
+      boolean adaptive,
+      MergedScanner.Opener opener) {
+    this.scan = withClusteringKeyColumns(scan, metadata);
+    this.metadata = metadata;
+    this.opener = opener;
+    this.fetchSize = fetchSize;
+    this.adaptive = adaptive;
+    this.forward = isForward(scan, metadata);
+    this.remaining = scan.getLimit() > 0 ? scan.getLimit() : Integer.MAX_VALUE;
+    this.pageSize =
+        adaptive ? (fetchSize > 0 ? Math.min(MIN_PAGE_SIZE, fetchSize) : MIN_PAGE_SIZE) : fetchSize;
+  }
+
+  /**
+   * Returns true if the scan can be read in pages. Only the records of a partition key scan of a
+   * table with clustering keys are returned in an order from which the next page can be started.
+   *
+   * <p>The table must have a single clustering key, since ScalarDB treats the columns of a
+   * clustering key boundary other than the last one as equalities. A page that starts after (a, b)
+   * would return only the records of a, and there is no boundary after (a, b) in the order of the
+   * whole key.
+   */
+  static boolean canPage(Scan scan, TableMetadata metadata) {
+    return !(scan instanceof ScanAll)
+        && !(scan instanceof ScanWithIndex)
+        && metadata.getClusteringKeyNames().size() == 1;
+  }
+
+  @Override
+  public Optional<Result> one() throws ExecutionException {
+    long start = System.nanoTime();
+    if (returnedAt > 0) {
+      consumeNanos += start - returnedAt;
+    }
+
+    try {
+      while (remaining > 0) {
+        if (page == null) {
+          if (exhausted) {
+            break;
+          }
+          page = opener.open(nextPage());
+          pageCount = 0;
+        }
+
+        Optional<Result> result = page.one();
+        if (result.isPresent()) {
+          pageCount++;
+          remaining--;
+          lastKey = getKey(result.get(), metadata.getClusteringKeyNames());
+          if (adaptive) {
+            totalCount++;
+            totalBytes += estimateBytes(result.get());
+          }
+          return result;
+        }
+
+        closePage();
+        // A page with fewer records than its limit is the last one
+        exhausted = pageCount < pageSize;
+        if (adaptive) {
+          resize();
+        }
+      }
+      return Optional.empty();
+    } finally {
+      returnedAt = System.nanoTime();
+      fetchNanos += returnedAt - start;
+    }
+  }
+
+  @Override
+  public void close() throws IOException {
+    closePage();
+  }
+
+  private Scan nextPage() {
+    ScanBuilder.BuildableScanOrScanAllFromExisting builder =
+        Scan.newBuilder(scan).limit(Math.min(pageSize, remaining));
+    if (lastKey != null) {
+      builder = forward ? builder.start(lastKey, false) : builder.end(lastKey, false);
+    }
+    return builder.build();
+  }
+
+  private void closePage() throws IOException {
+    if (page != null) {
+      Scanner scanner = page;
+      page = null;
+      scanner.close();
+    }
+  }
+
+  /**
+   * Doubles the page size if reading the page took longer than consuming it, and bounds it by the
+   * bytes of a page and fetchSize.
+   */
+  private void resize() {
+    int size = fetchNanos > consumeNanos ? pageSize * 2 : pageSize;
+    if (totalCount > 0) {
+      long width = Math.max(totalBytes / totalCount, 1);
+      size = (int) Math.min(size, MAX_PAGE_BYTES / width);
+    }
+    size = Math.min(size, fetchSize > 0 ? fetchSize : MAX_ADAPTIVE_PAGE_SIZE);
+    pageSize = Math.max(size, 1);
+    fetchNanos = 0;
+    consumeNanos = 0;
+  }
+
+  private static long estimateBytes(Result result) {
+    long bytes = 0;
+    for (Column<?> column : result.getColumns().values()) {
+      bytes += COLUMN_OVERHEAD;
+      if (column.hasNullValue()) {
+        continue;
+      }
+      switch (column.getDataType()) {
+        case TEXT:
+          bytes += column.getTextValue().length();
+          break;
+        case BLOB:
+          bytes += column.getBlobValueAsByteBuffer().remaining();
+          break;
+        default:
+          break;
+      }
+    }
+    return bytes;
+  }
+
+  /**
+   * Returns true if the records are returned in the clustering order of the table, in which case
+   * the next page starts after the last record. Otherwise, the next page ends before it.
+   */
+  private static boolean isForward(Scan scan, TableMetadata metadata) {
+    if (scan.getOrderings().isEmpty()) {
+      return true;
+    }
+    Scan.Ordering ordering = scan.getOrderings().get(0);
+    return ordering.getOrder() == metadata.getClusteringOrder(ordering.getColumnName());
+  }
+
+  /** Returns the scan that also retrieves the clustering keys, which start the next page. */
+  private static Scan withClusteringKeyColumns(Scan scan, TableMetadata metadata) {
+    if (scan.getProjections().isEmpty()) {
+      return scan;
+    }
+    List<String> missingNames = new ArrayList<>(metadata.getClusteringKeyNames());
+    missingNames.removeAll(scan.getProjections());
+    if (missingNames.isEmpty()) {
+      return scan;
+    }
+    return Scan.newBuilder(scan).projections(missingNames).build();
+  }
+
+  private static Key getKey(Result result, Iterable<String> names) {
+    Key.Builder builder = Key.newBuilder();
+    Map<String, Column<?>> columns = result.getColumns();
+    for (String name : names) {
+      builder.add(columns.get(name));
+    }
+    return builder.build();
+  }
+}
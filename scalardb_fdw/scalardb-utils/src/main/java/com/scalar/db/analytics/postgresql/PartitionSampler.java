@@ -0,0 +1,72 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import com.scalar.db.api.Result;
+import com.scalar.db.io.Column;
+import java.util.Arrays;
+import java.util.Collection;
+import java.util.Map;
+import java.util.Objects;
+import java.util.function.Predicate;
+
+/**
+ * A predicate that samples the results by their partitions. A partition is sampled if the hash of
+ * its partition key values falls within the given percentage of the hash space, so the same
+ * partitions are always sampled, and all or none of the records of a partition are sampled.
+ */
+class PartitionSampler implements Predicate<Result> {
+  private static final double HASH_SPACE = 4294967296.0; // 2^32
+
+  private final Collection<String> partitionKeyNames;
+  private final long threshold;
+
+  PartitionSampler(Collection<String> partitionKeyNames, double samplePercent) {
+    this.partitionKeyNames = partitionKeyNames;
+    this.threshold = (long) (HASH_SPACE * samplePercent / 100);
+  }
+
+  @Override
+  public boolean test(Result result) {
+    Map<String, Column<?>> columns = result.getColumns();
+    int hash = 1;
+    for (String name : partitionKeyNames) {
+      hash = 31 * hash + hash(columns.get(name));
+    }
+    return (mix(hash) & 0xffffffffL) < threshold;
+  }
+
+  private static int hash(Column<?> column) {
+    Object value = column.getValueAsObject();
+    if (value instanceof byte[]) {
+      return Arrays.hashCode((byte[]) value);
+    }
+    return Objects.hashCode(value);
+  }
+
+  /**
+   * Spreads the bits of the hash with the finalizer of MurmurHash3 so that the partitions with
+   * similar key values are sampled independently.
+   */
+  private static int mix(int hash) {
+    hash ^= hash >>> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >>> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >>> 16;
+    return hash;
+  }
+}
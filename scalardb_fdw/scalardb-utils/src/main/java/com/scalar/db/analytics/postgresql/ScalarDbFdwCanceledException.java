@@ -0,0 +1,27 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+/**
+ * Thrown when the backend is waiting for a remote operation and the query is canceled, e.g., by
+ * pg_cancel_backend() or statement_timeout. The backend handles the pending interrupt when it
+ * catches this exception.
+ */
+public class ScalarDbFdwCanceledException extends RuntimeException {
+  public ScalarDbFdwCanceledException() {
+    super("the remote operation was canceled");
+  }
+}
@@ -22,14 +22,52 @@ import com.scalar.db.api.Scan;
 import com.scalar.db.api.ScanBuilder;
 import com.scalar.db.api.Scanner;
 import com.scalar.db.api.TableMetadata;
+import com.scalar.db.config.DatabaseConfig;
 import com.scalar.db.exception.storage.ExecutionException;
 import com.scalar.db.io.Key;
 import com.scalar.db.service.StorageFactory;
+import com.scalar.db.transaction.consensuscommit.Attribute;
 import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.CharBuffer;
+import java.nio.charset.CharsetEncoder;
+import java.nio.charset.CoderResult;
+import java.nio.charset.CodingErrorAction;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.Paths;
+import java.sql.SQLException;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Collections;
+import java.util.List;
+import java.util.Map;
+import java.util.Properties;
+import java.util.Set;
+import java.util.concurrent.ConcurrentHashMap;
 
 public class ScalarDbUtils {
+  private static final String PREFIX = "scalar.db.";
+  private static final String STORAGE = PREFIX + "storage";
+  private static final String MULTI_STORAGE = "multi-storage";
+  private static final String MULTI_STORAGE_PREFIX = "scalar.db.multi_storage.";
+  private static final String CROSS_PARTITION_SCAN_ENABLED =
+      "scalar.db.cross_partition_scan.enabled";
+  private static final String CROSS_PARTITION_SCAN_ORDERING_ENABLED =
+      "scalar.db.cross_partition_scan.ordering.enabled";
+  private static final String CROSS_PARTITION_SCAN_FILTERING_ENABLED =
+      "scalar.db.cross_partition_scan.filtering.enabled";
+
   static DistributedStorage storage;
   static DistributedStorageAdmin storageAdmin;
+  static Properties properties;
+  static final Map<String, JdbcCounter> jdbcCounters = new ConcurrentHashMap<>();
+  // The last failure of the native queries, reported by the backend as a warning
+  private static volatile String jdbcCounterFailure;
+  private static final CharsetEncoder utf8Encoder =
+      StandardCharsets.UTF_8
+          .newEncoder()
+          .onMalformedInput(CodingErrorAction.REPLACE)
+          .onUnmappableCharacter(CodingErrorAction.REPLACE);
 
   static void initialize(String configFilePath) throws IOException {
     // We don't need to synchronize here because only single postgres worker call
@@ -38,11 +76,294 @@ public class ScalarDbUtils {
       StorageFactory storageFactory = StorageFactory.create(configFilePath);
       storage = storageFactory.getStorage();
       storageAdmin = storageFactory.getStorageAdmin();
+      properties = new DatabaseConfig(Paths.get(configFilePath)).getProperties();
+    }
+  }
+
+  /**
+   * Returns a scanner of the given scan. If samplePercent is less than 100, only the results of the
+   * partitions sampled with the percentage are returned. If transactionAware is true, the committed
+   * values of the records of a Consensus Commit table are returned. If fetchSize is greater than 0
+   * or adaptiveFetch is true, the records are read in pages. See {@link PagedScanner}.
+   *
+   * <p>The results are read on the thread pool of {@link MergedScanner} so that the query can be
+   * canceled while the storage is read. The same applies to the other scanners returned to the
+   * backend.
+   */
+  static Scanner scan(
+      Scan scan,
+      double samplePercent,
+      boolean transactionAware,
+      int fetchSize,
+      boolean adaptiveFetch) {
+    return new MergedScanner(
+        Collections.singletonList(scan),
+        s -> startScan(s, samplePercent, transactionAware, fetchSize, adaptiveFetch));
+  }
+
+  /**
+   * Returns a scanner that returns only the results of the given scan whose columns are equal to
+   * all the columns of the filter. The other results are dropped before they are passed through
+   * JNI.
+   */
+  static Scanner scanWithFilter(
+      Scan scan,
+      Key filter,
+      double samplePercent,
+      boolean transactionAware,
+      int fetchSize,
+      boolean adaptiveFetch) {
+    return new MergedScanner(
+        Collections.singletonList(scan),
+        s ->
+            new FilteredScanner(
+                startScan(s, samplePercent, transactionAware, fetchSize, adaptiveFetch),
+                FilteredScanner.matching(filter)));
+  }
+
+  /**
+   * Returns a scanner that runs the given scans concurrently and merges their results in the order
+   * of their orderings, which must be the same. See {@link MergedScanner}. The columns of the
+   * orderings are added to the projections since the results are merged by their values.
+   */
+  static Scanner scanMerged(
+      Scan[] scans,
+      double samplePercent,
+      boolean transactionAware,
+      int fetchSize,
+      boolean adaptiveFetch) {
+    return new MergedScanner(
+        withOrderingColumns(scans),
+        scan -> startScan(scan, samplePercent, transactionAware, fetchSize, adaptiveFetch));
+  }
+
+  /**
+   * Returns a scanner that merges the results of the given scans like {@link #scanMerged} and
+   * returns only the ones whose columns are equal to all the columns of the filter. The results
+   * of each scan are filtered before they are merged.
+   */
+  static Scanner scanMergedWithFilter(
+      Scan[] scans,
+      Key filter,
+      double samplePercent,
+      boolean transactionAware,
+      int fetchSize,
+      boolean adaptiveFetch) {
+    return new MergedScanner(
+        withOrderingColumns(scans),
+        scan ->
+            new FilteredScanner(
+                startScan(scan, samplePercent, transactionAware, fetchSize, adaptiveFetch),
+                FilteredScanner.matching(filter)));
+  }
+
+  /** Returns the total number of records retrieved by the given scans. See {@link #count}. */
+  static long countMerged(Scan[] scans, double samplePercent, boolean transactionAware)
+      throws ExecutionException {
+    long count = 0;
+    for (Scan scan : scans) {
+      count += count(scan, samplePercent, transactionAware);
+    }
+    return count;
+  }
+
+  static String toString(Scan[] scans) {
+    return Arrays.toString(scans);
+  }
+
+  private static List<Scan> withOrderingColumns(Scan[] scans) {
+    List<Scan> ret = new ArrayList<>(scans.length);
+    for (Scan scan : scans) {
+      if (!scan.getProjections().isEmpty()) {
+        List<String> missingNames = new ArrayList<>();
+        for (Scan.Ordering ordering : scan.getOrderings()) {
+          if (!scan.getProjections().contains(ordering.getColumnName())) {
+            missingNames.add(ordering.getColumnName());
+          }
+        }
+        if (!missingNames.isEmpty()) {
+          scan = Scan.newBuilder(scan).projections(missingNames).build();
+        }
+      }
+      ret.add(scan);
     }
+    return ret;
   }
 
-  static Scanner scan(Scan scan) throws ExecutionException {
-    return storage.scan(scan);
+  /**
+   * Returns the boundaries that split Scan (all) of the given table into at most numSplits ranges
+   * of its first partition key column, evenly between its current minimum and maximum values. See
+   * {@link ScanSplitter}. An empty array is returned if the scan cannot be split.
+   *
+   * <p>Only the tables of JDBC storages are split, since the other storages read all the records to
+   * evaluate the conditions of a cross-partition scan. ScalarDB does not expose the token ranges of
+   * Cassandra or the parallel scan segments of DynamoDB.
+   */
+  static long[] getScanAllSplitBoundaries(String namespace, String tableName, int numSplits)
+      throws ExecutionException {
+    if (numSplits < 2 || !canSplitScanAll(namespace, tableName)) {
+      return new long[0];
+    }
+    TableMetadata metadata = storageAdmin.getTableMetadata(namespace, tableName);
+
+    String prefix = getStoragePropertyPrefix(namespace);
+    long[] range;
+    try {
+      range =
+          getJdbcCounter(prefix).range(namespace, tableName, ScanSplitter.splitColumn(metadata));
+    } catch (SQLException e) {
+      jdbcCounterFailure =
+          "failed to take the range of " + namespace + "." + tableName + ": " + e.getMessage();
+      closeJdbcCounter(prefix);
+      return new long[0];
+    }
+    if (range == null) {
+      return new long[0];
+    }
+    return ScanSplitter.boundaries(range[0], range[1], numSplits);
+  }
+
+  /**
+   * Returns true if Scan (all) of the table can be split into ranges of its first partition key
+   * column. This does not read the table, so it is cheap enough to be called for each query.
+   */
+  static boolean canSplitScanAll(String namespace, String tableName) throws ExecutionException {
+    if (!canFilterScanAll(namespace)) {
+      return false;
+    }
+    TableMetadata metadata = storageAdmin.getTableMetadata(namespace, tableName);
+    return metadata != null && ScanSplitter.canSplit(metadata);
+  }
+
+  /** Returns the Scans of all the ranges of Scan (all) made by the given boundaries. */
+  static Scan[] splitScanAll(Scan scan, long[] boundaries) throws ExecutionException {
+    TableMetadata metadata =
+        storageAdmin.getTableMetadata(scan.forNamespace().get(), scan.forTable().get());
+    return ScanSplitter.split(scan, metadata, boundaries);
+  }
+
+  /** Returns the Scan of the index-th range of Scan (all) made by the given boundaries. */
+  static Scan getScanAllSplit(Scan scan, long[] boundaries, int index) throws ExecutionException {
+    TableMetadata metadata =
+        storageAdmin.getTableMetadata(scan.forNamespace().get(), scan.forTable().get());
+    return ScanSplitter.split(scan, metadata, boundaries, index);
+  }
+
+  /**
+   * Returns a scanner that returns the committed values of only the records of the given scan of a
+   * Consensus Commit table that were committed after committedAt, in milliseconds since the epoch.
+   * The scan must retrieve the tx_committed_at column. The records that have been committed
+   * without transactions have no commit time and are never returned.
+   */
+  static Scanner scanCommittedAfter(Scan scan, long committedAt) {
+    return new MergedScanner(
+        Collections.singletonList(scan),
+        s ->
+            new FilteredScanner(
+                startScan(s, 100, true, 0, false),
+                result ->
+                    !result.isNull(Attribute.COMMITTED_AT)
+                        && result.getBigInt(Attribute.COMMITTED_AT) > committedAt));
+  }
+
+  /**
+   * Returns the number of records retrieved by the given scan. For JDBC storages, the records are
+   * counted with a native COUNT(*) query unless they are sampled or their committed values are
+   * resolved. Otherwise, they are counted on the JVM side so that only the count is passed through
+   * JNI. The records are counted on the thread pool of {@link MergedScanner} so that the query can
+   * be canceled meanwhile.
+   */
+  static long count(Scan scan, double samplePercent, boolean transactionAware)
+      throws ExecutionException {
+    String prefix = getStoragePropertyPrefix(scan.forNamespace().get());
+    return Interrupts.await(
+        MergedScanner.submit(() -> countRecords(scan, samplePercent, transactionAware)),
+        () -> {
+          // The native COUNT(*) query is not stopped by interrupting its thread
+          JdbcCounter counter = jdbcCounters.get(prefix);
+          if (counter != null) {
+            counter.cancel();
+          }
+        });
+  }
+
+  private static long countRecords(Scan scan, double samplePercent, boolean transactionAware)
+      throws ExecutionException, IOException {
+    String prefix = getStoragePropertyPrefix(scan.forNamespace().get());
+    if (samplePercent >= 100
+        && !transactionAware
+        && properties.getProperty(prefix + "storage", "").equals("jdbc")) {
+      try {
+        return getJdbcCounter(prefix).count(scan);
+      } catch (SQLException e) {
+        // The query has been canceled since the count is abandoned
+        if (Thread.currentThread().isInterrupted()) {
+          throw new ScalarDbFdwCanceledException();
+        }
+        // Fall back to counting on the JVM side, e.g., if the JDBC driver is not available
+        jdbcCounterFailure =
+            "failed to count the records of "
+                + scan.forNamespace().get()
+                + "."
+                + scan.forTable().get()
+                + ": "
+                + e.getMessage();
+        closeJdbcCounter(prefix);
+      }
+    }
+
+    long count = 0;
+    try (Scanner scanner = startScan(scan, samplePercent, transactionAware, 0, false)) {
+      while (scanner.one().isPresent()) {
+        if (Thread.currentThread().isInterrupted()) {
+          throw new ScalarDbFdwCanceledException();
+        }
+        count++;
+      }
+    }
+    return count;
+  }
+
+  /**
+   * Returns a scanner of the given scan. The results of the partitions that are not sampled are
+   * dropped before they are passed through JNI, and the partition key columns are added to the
+   * projections since the partitions are sampled by their values. The committed values are read
+   * before the results are sampled, and the records are read in pages before both.
+   */
+  private static Scanner startScan(
+      Scan scan,
+      double samplePercent,
+      boolean transactionAware,
+      int fetchSize,
+      boolean adaptiveFetch)
+      throws ExecutionException {
+    if (samplePercent >= 100 && !transactionAware && fetchSize <= 0 && !adaptiveFetch) {
+      return storage.scan(scan);
+    }
+
+    TableMetadata metadata =
+        storageAdmin.getTableMetadata(scan.forNamespace().get(), scan.forTable().get());
+    MergedScanner.Opener opener = storage::scan;
+    if ((fetchSize > 0 || adaptiveFetch) && PagedScanner.canPage(scan, metadata)) {
+      opener = s -> new PagedScanner(s, metadata, fetchSize, adaptiveFetch, storage::scan);
+    }
+    if (samplePercent >= 100) {
+      return transactionAware
+          ? new CommittedScanner(storage, scan, metadata, opener)
+          : opener.open(scan);
+    }
+
+    Set<String> partitionKeyNames = metadata.getPartitionKeyNames();
+    if (!scan.getProjections().isEmpty()) {
+      List<String> missingNames = new ArrayList<>(partitionKeyNames);
+      missingNames.removeAll(scan.getProjections());
+      scan = Scan.newBuilder(scan).projections(missingNames).build();
+    }
+    Scanner scanner =
+        transactionAware
+            ? new CommittedScanner(storage, scan, metadata, opener)
+            : opener.open(scan);
+    return new FilteredScanner(scanner, new PartitionSampler(partitionKeyNames, samplePercent));
   }
 
   static ScanBuilder.BuildableScan buildableScan(String namespace, String tableName, Key key) {
@@ -66,6 +387,65 @@ public class ScalarDbUtils {
     return result.getColumns().size();
   }
 
+  /**
+   * Writes the value of the TEXT column of the result into the buffer as standard UTF-8, not the
+   * modified UTF-8 of JNI, and returns the number of bytes written. If the buffer is too small, the
+   * negated number of bytes required is returned.
+   */
+  static int writeText(Result result, String columnName, ByteBuffer buffer) {
+    String value = result.getText(columnName);
+    if (value == null) {
+      return 0;
+    }
+    buffer.clear();
+    CoderResult coderResult = utf8Encoder.reset().encode(CharBuffer.wrap(value), buffer, true);
+    if (coderResult.isOverflow()) {
+      return -utf8Length(value);
+    }
+    utf8Encoder.flush(buffer);
+    return buffer.position();
+  }
+
+  /**
+   * Copies the value of the BLOB column of the result into the buffer and returns the number of
+   * bytes written. If the buffer is too small, the negated number of bytes required is returned.
+   */
+  static int writeBlob(Result result, String columnName, ByteBuffer buffer) {
+    ByteBuffer value = result.getBlobAsByteBuffer(columnName);
+    if (value == null) {
+      return 0;
+    }
+    if (value.remaining() > buffer.capacity()) {
+      return -value.remaining();
+    }
+    buffer.clear();
+    buffer.put(value.duplicate());
+    return buffer.position();
+  }
+
+  private static int utf8Length(String value) {
+    int length = 0;
+    for (int i = 0; i < value.length(); i++) {
+      char c = value.charAt(i);
+      if (c < 0x80) {
+        length += 1;
+      } else if (c < 0x800) {
+        length += 2;
+      } else if (Character.isHighSurrogate(c)
+          && i + 1 < value.length()
+          && Character.isLowSurrogate(value.charAt(i + 1))) {
+        length += 4;
+        i++;
+      } else if (Character.isSurrogate(c)) {
+        // A lone surrogate is replaced with '?'
+        length += 1;
+      } else {
+        length += 3;
+      }
+    }
+    return length;
+  }
+
   static String[] getPartitionKeyNames(String namespace, String tableName)
       throws ExecutionException, ScalarDbFdwException {
     TableMetadata metadata = storageAdmin.getTableMetadata(namespace, tableName);
@@ -102,10 +482,100 @@ public class ScalarDbUtils {
     return metadata.getClusteringOrder(clusteringKeyName).ordinal();
   }
 
+  /**
+   * Returns the storage name (e.g., "cassandra", "jdbc") that actually stores the tables in the
+   * given namespace. For multi-storage, the namespace mapping is resolved to the underlying
+   * storage.
+   */
+  static String getStorage(String namespace) {
+    return properties.getProperty(getStoragePropertyPrefix(namespace) + "storage", "cassandra");
+  }
+
+  /**
+   * Returns the prefix of the properties (e.g., "scalar.db.contact_points") of the storage that
+   * stores the tables in the given namespace.
+   */
+  private static String getStoragePropertyPrefix(String namespace) {
+    if (!properties.getProperty(STORAGE, "cassandra").equals(MULTI_STORAGE)) {
+      return PREFIX;
+    }
+
+    String target = properties.getProperty(MULTI_STORAGE_PREFIX + "default_storage");
+    String mapping = properties.getProperty(MULTI_STORAGE_PREFIX + "namespace_mapping", "");
+    for (String entry : mapping.split(",")) {
+      String[] namespaceAndStorage = entry.trim().split(":");
+      if (namespaceAndStorage.length == 2 && namespaceAndStorage[0].trim().equals(namespace)) {
+        target = namespaceAndStorage[1].trim();
+        break;
+      }
+    }
+    return MULTI_STORAGE_PREFIX + "storages." + target + ".";
+  }
+
+  private static JdbcCounter getJdbcCounter(String prefix) {
+    return jdbcCounters.computeIfAbsent(
+        prefix,
+        p ->
+            new JdbcCounter(
+                properties.getProperty(p + "contact_points"),
+                properties.getProperty(p + "username"),
+                properties.getProperty(p + "password")));
+  }
+
+  /**
+   * Returns the message of the last failure of the native queries on the JDBC storages and clears
+   * it, or null if none has failed since the last call. The failures are not thrown, since the
+   * callers fall back to counting the records with ScalarDB or to scanning the table without
+   * splitting it, but the fallbacks can be much slower.
+   */
+  static String takeJdbcCounterFailure() {
+    String failure = jdbcCounterFailure;
+    jdbcCounterFailure = null;
+    return failure;
+  }
+
+  private static void closeJdbcCounter(String prefix) {
+    JdbcCounter counter = jdbcCounters.remove(prefix);
+    if (counter != null) {
+      try {
+        counter.close();
+      } catch (SQLException e) {
+        // Ignore since the connection is no longer used
+      }
+    }
+  }
+
+  /**
+   * Returns true if Scan (all) with orderings can be executed for the tables in the given
+   * namespace. Only JDBC storages support cross-partition scan orderings, and they must be enabled
+   * in the config.
+   */
+  static boolean canOrderScanAll(String namespace) {
+    return getStorage(namespace).equals("jdbc")
+        && Boolean.parseBoolean(properties.getProperty(CROSS_PARTITION_SCAN_ENABLED, "false"))
+        && Boolean.parseBoolean(
+            properties.getProperty(CROSS_PARTITION_SCAN_ORDERING_ENABLED, "false"));
+  }
+
+  /**
+   * Returns true if Scan (all) with conditions is evaluated by the storage of the tables in the
+   * given namespace. Only JDBC storages evaluate the conditions remotely, and they must be enabled
+   * in the config.
+   */
+  private static boolean canFilterScanAll(String namespace) {
+    return getStorage(namespace).equals("jdbc")
+        && Boolean.parseBoolean(properties.getProperty(CROSS_PARTITION_SCAN_ENABLED, "false"))
+        && Boolean.parseBoolean(
+            properties.getProperty(CROSS_PARTITION_SCAN_FILTERING_ENABLED, "false"));
+  }
+
   static void closeStorage() {
     if (storage != null) {
       storage.close();
       storageAdmin.close();
     }
+    for (String prefix : jdbcCounters.keySet().toArray(new String[0])) {
+      closeJdbcCounter(prefix);
+    }
   }
 }
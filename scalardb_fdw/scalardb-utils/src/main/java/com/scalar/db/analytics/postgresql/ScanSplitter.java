@@ -0,0 +1,110 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import com.scalar.db.api.ConditionBuilder;
+import com.scalar.db.api.ConditionalExpression;
+import com.scalar.db.api.Scan;
+import com.scalar.db.api.ScanBuilder;
+import com.scalar.db.api.TableMetadata;
+import com.scalar.db.io.DataType;
+
+/**
+ * Splits Scan (all) into Scans of disjoint ranges of the first partition key column, so that the
+ * ranges can be read concurrently or by different processes. The ranges are given as boundaries
+ * b_1 < ... < b_n, which make the n + 1 ranges (-inf, b_1), [b_1, b_2), ..., [b_n, +inf), so the
+ * Scans cover all the records even if the boundaries are out of date.
+ *
+ * <p>The ranges are applied as the conditions of cross-partition scans, which JDBC storages
+ * evaluate as range predicates on the primary key. Only INT and BIGINT columns are split.
+ */
+class ScanSplitter {
+  private ScanSplitter() {}
+
+  /** Returns true if the records of the table can be split by the first partition key column. */
+  static boolean canSplit(TableMetadata metadata) {
+    DataType type = metadata.getColumnDataType(splitColumn(metadata));
+    return type == DataType.INT || type == DataType.BIGINT;
+  }
+
+  static String splitColumn(TableMetadata metadata) {
+    return metadata.getPartitionKeyNames().iterator().next();
+  }
+
+  /**
+   * Returns the boundaries that divide the values between min and max into at most numSplits
+   * ranges of the same width.
+   */
+  static long[] boundaries(long min, long max, int numSplits) {
+    double width = ((double) max - (double) min) / numSplits;
+    long[] boundaries = new long[numSplits - 1];
+    int n = 0;
+    for (int i = 1; i < numSplits; i++) {
+      long boundary = min + (long) Math.ceil(width * i);
+      if (boundary > min && boundary <= max && (n == 0 || boundary > boundaries[n - 1])) {
+        boundaries[n++] = boundary;
+      }
+    }
+    long[] ret = new long[n];
+    System.arraycopy(boundaries, 0, ret, 0, n);
+    return ret;
+  }
+
+  /** Returns the Scans of all the ranges made by the boundaries. */
+  static Scan[] split(Scan scan, TableMetadata metadata, long[] boundaries) {
+    Scan[] scans = new Scan[boundaries.length + 1];
+    for (int i = 0; i < scans.length; i++) {
+      scans[i] = split(scan, metadata, boundaries, i);
+    }
+    return scans;
+  }
+
+  /** Returns the Scan of the index-th range made by the boundaries. */
+  static Scan split(Scan scan, TableMetadata metadata, long[] boundaries, int index) {
+    String column = splitColumn(metadata);
+    boolean isInt = metadata.getColumnDataType(column) == DataType.INT;
+    ConditionalExpression lower = index == 0 ? null : atLeast(column, boundaries[index - 1], isInt);
+    ConditionalExpression upper =
+        index == boundaries.length ? null : lessThan(column, boundaries[index], isInt);
+
+    // The builders return new builders with the conditions, so each Scan is built from them
+    ScanBuilder.BuildableScanOrScanAllFromExisting builder = Scan.newBuilder(scan);
+    if (lower != null && upper != null) {
+      return builder.where(lower).and(upper).build();
+    } else if (lower != null) {
+      return builder.where(lower).build();
+    } else if (upper != null) {
+      return builder.where(upper).build();
+    }
+    return builder.build();
+  }
+
+  /*
+   * The boundaries of an INT column are between the minimum and maximum values of the column, so
+   * they fit in int.
+   */
+  private static ConditionalExpression atLeast(String column, long value, boolean isInt) {
+    return isInt
+        ? ConditionBuilder.column(column).isGreaterThanOrEqualToInt((int) value)
+        : ConditionBuilder.column(column).isGreaterThanOrEqualToBigInt(value);
+  }
+
+  private static ConditionalExpression lessThan(String column, long value, boolean isInt) {
+    return isInt
+        ? ConditionBuilder.column(column).isLessThanInt((int) value)
+        : ConditionBuilder.column(column).isLessThanBigInt(value);
+  }
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2023 Scalar, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.scalar.db.analytics.postgresql;
+
+import com.scalar.db.api.Result;
+import java.util.HashMap;
+import java.util.Map;
+
+/**
+ * Codes of the distinct values of a TEXT column read by a scan. Each distinct value is passed to
+ * PostgreSQL once with a new code, and then only its code is passed for the following results.
+ * The values longer than {@link #MAX_VALUE_LENGTH} are not added to the dictionary.
+ */
+class TextDictionary {
+  /** Returned by {@link #lookup} if a new value cannot be added since the dictionary is full. */
+  static final int FULL = -1;
+  /** Returned by {@link #lookup} if a new value is longer than {@link #MAX_VALUE_LENGTH}. */
+  static final int TOO_LONG = -2;
+
+  private static final int MAX_SIZE = 1024;
+  private static final int MAX_VALUE_LENGTH = 256;
+
+  private final Map<String, Integer> codes = new HashMap<>();
+
+  /**
+   * Looks up the value of the TEXT column of the result, which must not be null, and returns its
+   * code. If the value is not in the dictionary, it is added with a new code {@code c} and {@code
+   * -c - 3} is returned, or {@link #TOO_LONG} or {@link #FULL} is returned if it cannot be added.
+   */
+  int lookup(Result result, String columnName) {
+    String value = result.getText(columnName);
+    Integer code = codes.get(value);
+    if (code != null) {
+      return code;
+    }
+    if (value.length() > MAX_VALUE_LENGTH) {
+      return TOO_LONG;
+    }
+    if (codes.size() >= MAX_SIZE) {
+      return FULL;
+    }
+    code = codes.size();
+    codes.put(value, code);
+    return -code - 3;
+  }
+}
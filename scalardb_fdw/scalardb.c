@@ -15,8 +15,11 @@
  */
 #include "scalardb.h"
 
+#include "common/hashfn.h"
 #include "condition.h"
 #include "jni.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
 #include "nodes/pg_list.h"
 #include "nodes/value.h"
 #include "postgres.h"
@@ -24,6 +27,9 @@
 #include "utils/builtins.h"
 #include "utils/elog.h"
 #include "utils/errcodes.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
 
 #define JNI_VERSION JNI_VERSION_1_8
 
@@ -44,8 +50,101 @@
 
 #define DEFAULT_MAX_HEAP_SIZE "1g"
 
+/* Initial size of the buffer that TEXT and BLOB values are written into */
+#define INITIAL_VALUE_BUFFER_SIZE (64 * 1024)
+
 #define LOCAL_FRAME_CAPACITY 128
 
+/* Initial number of the values that a text dictionary can hold */
+#define INITIAL_TEXT_DICTIONARY_SIZE 16
+
+/*
+ * Codes returned by TextDictionary.lookup() for the values that cannot be
+ * added to the dictionary
+ */
+#define TEXT_DICTIONARY_FULL (-1)
+#define TEXT_DICTIONARY_TOO_LONG (-2)
+
+/* Maximum number of the cached Scan templates */
+#define SCAN_TEMPLATE_CACHE_SIZE 256
+
+/*
+ * Holds the parts of Scan objects that depend only on the shape of the scan,
+ * so that only the key values are bound when the same scan is built again,
+ * e.g. on each execution of a prepared statement. All Java objects are global
+ * references.
+ *
+ * Templates are looked up by the hash of the key that consists of the scan
+ * type, the table, and the names of the columns, and the key is compared to
+ * resolve hash collisions.
+ */
+typedef struct {
+	uint32 hash; /* hash key; must be first */
+	char *key;
+	jstring namespace_str;
+	jstring table_name_str;
+	/* projections. NULL if all columns are retrieved */
+	jobjectArray projections;
+	/* orderings. NULL if the records are not sorted */
+	jobjectArray orderings;
+	/* names of the partition key or the index key */
+	jstring *key_names;
+	int num_key_names;
+	/* names of the clustering key columns of the boundary */
+	jstring *boundary_names;
+	int num_boundary_names;
+} ScalarDbFdwScanTemplate;
+
+static HTAB *scan_templates = NULL;
+
+/*
+ * Buffer shared with the JVM as a direct ByteBuffer, which TEXT and BLOB
+ * values are written into to be copied into varlenas.
+ */
+static char *value_buffer = NULL;
+static Size value_buffer_size = 0;
+static jobject value_buffer_obj = NULL;
+
+struct ScalarDbTextDictionary {
+	/* Java instance of TextDictionary. NULL if the dictionary is not used */
+	jobject dictionary;
+	/* Values indexed by their codes, allocated in cxt */
+	text **values;
+	int num_values;
+	int max_values;
+	MemoryContext cxt;
+	/*
+	 * Numbers of the values found in the dictionary and the ones that
+	 * could not be added to it since it was full. The values too long to be
+	 * added are not counted, since they say nothing about how often the
+	 * other values repeat.
+	 */
+	long hits;
+	long misses;
+};
+
+/*
+ * A Scanner that has been started and not closed yet, which is closed when the
+ * resource owner that was current when it was started is released on abort,
+ * e.g., by a query cancel or any other error raised outside
+ * scalardb_scanner_close(), so that the remote scanner and the connection it
+ * holds are not kept until the backend exits.
+ */
+typedef struct {
+	jobject scanner; /* global reference */
+	ResourceOwner owner;
+} ScalarDbFdwOpenScanner;
+
+/* List of ScalarDbFdwOpenScanner, allocated in TopMemoryContext */
+static List *open_scanners = NIL;
+static bool resource_release_callback_registered = false;
+
+/*
+ * Number of the local frames pushed by scalardb_scanner_one() and not popped
+ * by scalardb_scanner_release_result() yet
+ */
+static int num_result_frames = 0;
+
 static __thread JNIEnv *env = NULL;
 static JavaVM *jvm;
 
@@ -73,15 +172,31 @@ static jclass ScalarDbUtils_class;
 static jmethodID ScalarDbUtils_initialize;
 static jmethodID ScalarDbUtils_closeStorage;
 static jmethodID ScalarDbUtils_scan;
+static jmethodID ScalarDbUtils_scanWithFilter;
+static jmethodID ScalarDbUtils_scanMerged;
+static jmethodID ScalarDbUtils_scanMergedWithFilter;
+static jmethodID ScalarDbUtils_countMerged;
+static jmethodID ScalarDbUtils_toString;
+static jmethodID ScalarDbUtils_scanCommittedAfter;
+static jmethodID ScalarDbUtils_count;
 static jmethodID ScalarDbUtils_buildableScan;
 static jmethodID ScalarDbUtils_buildableScanWithIndex;
 static jmethodID ScalarDbUtils_buildableScanAll;
 static jmethodID ScalarDbUtils_keyBuilder;
 static jmethodID ScalarDbUtils_getResultColumnsSize;
+static jmethodID ScalarDbUtils_writeText;
+static jmethodID ScalarDbUtils_writeBlob;
 static jmethodID ScalarDbUtils_getPartitionKeyNames;
 static jmethodID ScalarDbUtils_getClusteringKeyNames;
 static jmethodID ScalarDbUtils_getSecondaryIndexNames;
 static jmethodID ScalarDbUtils_getClusteringOrder;
+static jmethodID ScalarDbUtils_getStorage;
+static jmethodID ScalarDbUtils_canOrderScanAll;
+static jmethodID ScalarDbUtils_canSplitScanAll;
+static jmethodID ScalarDbUtils_getScanAllSplitBoundaries;
+static jmethodID ScalarDbUtils_splitScanAll;
+static jmethodID ScalarDbUtils_getScanAllSplit;
+static jmethodID ScalarDbUtils_takeJdbcCounterFailure;
 
 static jclass Result_class;
 static jmethodID Result_isNull;
@@ -90,25 +205,43 @@ static jmethodID Result_getInt;
 static jmethodID Result_getBigInt;
 static jmethodID Result_getFloat;
 static jmethodID Result_getDouble;
-static jmethodID Result_getText;
-static jmethodID Result_getBlobAsBytes;
 
 static jclass Scanner_class;
 static jmethodID Scanner_one;
 
+static jclass Scan_class;
+static jclass ScanArray_class;
+
+static jclass JvmStats_class;
+static jmethodID JvmStats_collect;
+
+static jclass FlightRecorder_class;
+static jmethodID FlightRecorder_start;
+static jmethodID FlightRecorder_stop;
+
+static jclass Interrupts_class;
+static jclass ScalarDbFdwCanceledException_class;
+
+static jclass TextDictionary_class;
+static jmethodID TextDictionary_init;
+static jmethodID TextDictionary_lookup;
+
 static jclass BuildableScan_class;
 static jmethodID BuildableScan_projections;
 static jmethodID BuildableScan_start;
 static jmethodID BuildableScan_end;
 static jmethodID BuildableScan_orderings;
+static jmethodID BuildableScan_limit;
 static jmethodID BuildableScan_build;
 
 static jclass BuildableScanWithIndex_class;
 static jmethodID BuildableScanWithIndex_projections;
+static jmethodID BuildableScanWithIndex_limit;
 static jmethodID BuildableScanWithIndex_build;
 
 static jclass BuildableScanAll_class;
 static jmethodID BuildableScanAll_projections;
+static jmethodID BuildableScanAll_orderings;
 static jmethodID BuildableScanAll_build;
 
 static jclass KeyBuilder_class;
@@ -133,27 +266,45 @@ static void initialize_standard_references(void);
 static void initialize_scalardb_references(void);
 static void add_classpath_to_system_class_loader(char *classpath);
 
-static jobject get_key_from_conds(ScalarDbFdwScanCondition *scan_conds,
+static ScalarDbFdwScanTemplate *
+get_scan_template(char scan_type, char *namespace, char *table_name,
+		  List *attnames, ScalarDbFdwScanCondition *scan_conds,
+		  size_t num_scan_conds, List *boundary_names,
+		  List *sort_column_names, List *sort_orders);
+static void release_scan_template(ScalarDbFdwScanTemplate *template);
+static bool is_merged_scan(jobject scan);
+static void reset_scan_templates(void);
+static jstring *make_global_names(List *names);
+static jobject get_key_from_conds(jstring *names,
+				  ScalarDbFdwScanCondition *scan_conds,
 				  size_t num_scan_conds);
-static jobject get_key_for_boundary(List *names, Datum *values,
+static jobject get_key_for_boundary(jstring *names, Datum *values,
 				    List *value_types, size_t num_values);
 static void add_datum_value_to_key(jobject key_builder, jstring name,
 				   Datum value, Oid value_type);
-static void apply_column_pruning(jobject buildable_scan, List *attnames,
-				 jmethodID projections_method);
 static void apply_clustering_key_boundary(jobject buildable_scan,
-					  ScalarDbFdwScanBoundary *boundary);
-static void apply_orderings(jobject buildable_scan, List *sort_column_names,
-			    List *sort_orders);
+					  ScalarDbFdwScanBoundary *boundary,
+					  jstring *names);
+static jobjectArray make_orderings(List *sort_column_names, List *sort_orders);
 
 static void clear_exception(void);
 static void catch_exception(void);
+static jboolean JNICALL interrupts_is_pending(JNIEnv *jni_env, jclass class);
 
 static char *convert_string_to_cstring(jobject java_cstring);
-static text *convert_string_to_text(jobject java_cstring);
-static bytea *convert_jbyteArray_to_bytea(jbyteArray bytes);
+static struct varlena *read_varlena_from_result(jobject result, char *attname,
+						jmethodID write_method);
+static void enlarge_value_buffer(Size size);
+static void free_value_buffer(void);
+static void report_jdbc_counter_failure(void);
 static jobjectArray convert_string_list_to_jarray_of_string(List *strings);
 
+static jobject register_scanner(jobject scanner);
+static void unregister_scanner(jobject scanner);
+static void release_scanners(ResourceReleasePhase phase, bool isCommit,
+			     bool isTopLevel, void *arg);
+static void close_scanner_quietly(jobject scanner);
+
 static void on_proc_exit_cb(int code, Datum arg);
 
 static char *get_class_name(jclass class);
@@ -227,26 +378,37 @@ void scalardb_initialize(ScalarDbFdwOptions *opts)
  * If `attnames` is specified, only the columns with the names in `attnames`
  * will be returned. (i.e. calls projections())
  * The type of `attnames` must be a List of String.
+ *
+ * If `sort_column_names` is specified, the results are sorted across
+ * partitions on the storage side. It is caller's responsibility to ensure that
+ * the storage supports the orderings (see scalardb_can_order_scan_all()).
  */
 extern jobject scalardb_scan_all(char *namespace, char *table_name,
-				 List *attnames)
+				 List *attnames, List *sort_column_names,
+				 List *sort_orders)
 {
-	jstring namespace_str;
-	jstring table_name_str;
+	ScalarDbFdwScanTemplate *template;
 	jobject buildable_scan;
 	jobject scan;
 
 	ereport(DEBUG5, errmsg("entering function %s", __func__));
 
-	namespace_str = (*env)->NewStringUTF(env, namespace);
-	table_name_str = (*env)->NewStringUTF(env, table_name);
+	template = get_scan_template('a', namespace, table_name, attnames, NULL,
+				     0, NIL, sort_column_names, sort_orders);
 
 	buildable_scan = (*env)->CallStaticObjectMethod(
 		env, ScalarDbUtils_class, ScalarDbUtils_buildableScanAll,
-		namespace_str, table_name_str);
+		template->namespace_str, template->table_name_str);
+
+	if (template->projections != NULL)
+		buildable_scan = (*env)->CallObjectMethod(
+			env, buildable_scan, BuildableScanAll_projections,
+			template->projections);
 
-	apply_column_pruning(buildable_scan, attnames,
-			     BuildableScanAll_projections);
+	if (template->orderings != NULL)
+		buildable_scan = (*env)->CallObjectMethod(
+			env, buildable_scan, BuildableScanAll_orderings,
+			template->orderings);
 
 	scan = (*env)->CallObjectMethod(env, buildable_scan,
 					BuildableScanAll_build);
@@ -262,36 +424,51 @@ extern jobject scalardb_scan_all(char *namespace, char *table_name,
  * If `attnames` is specified, only the columns with the names in `attnames`
  * will be returned. (i.e. calls projections())
  * The type of `attnames` must be a List of String.
+ *
+ * If `limit` is greater than 0, at most `limit` records are returned.
  */
 extern jobject scalardb_scan(char *namespace, char *table_name, List *attnames,
 			     ScalarDbFdwScanCondition *scan_conds,
 			     size_t num_scan_conds,
 			     ScalarDbFdwScanBoundary *boundary,
-			     List *sort_column_names, List *sort_orders)
+			     List *sort_column_names, List *sort_orders,
+			     int limit)
 {
-	jstring namespace_str;
-	jstring table_name_str;
+	ScalarDbFdwScanTemplate *template;
 	jobject buildable_scan;
 	jobject scan;
 	jobject key;
 
 	ereport(DEBUG5, errmsg("entering function %s", __func__));
 
-	namespace_str = (*env)->NewStringUTF(env, namespace);
-	table_name_str = (*env)->NewStringUTF(env, table_name);
+	template = get_scan_template('p', namespace, table_name, attnames,
+				     scan_conds, num_scan_conds,
+				     boundary->names, sort_column_names,
+				     sort_orders);
 
-	key = get_key_from_conds(scan_conds, num_scan_conds);
+	key = get_key_from_conds(template->key_names, scan_conds,
+				 num_scan_conds);
 
 	buildable_scan = (*env)->CallStaticObjectMethod(
 		env, ScalarDbUtils_class, ScalarDbUtils_buildableScan,
-		namespace_str, table_name_str, key);
+		template->namespace_str, template->table_name_str, key);
 
-	apply_column_pruning(buildable_scan, attnames,
-			     BuildableScan_projections);
+	if (template->projections != NULL)
+		buildable_scan = (*env)->CallObjectMethod(
+			env, buildable_scan, BuildableScan_projections,
+			template->projections);
 
-	apply_clustering_key_boundary(buildable_scan, boundary);
+	apply_clustering_key_boundary(buildable_scan, boundary,
+				      template->boundary_names);
 
-	apply_orderings(buildable_scan, sort_column_names, sort_orders);
+	if (template->orderings != NULL)
+		buildable_scan = (*env)->CallObjectMethod(
+			env, buildable_scan, BuildableScan_orderings,
+			template->orderings);
+
+	if (limit > 0)
+		buildable_scan = (*env)->CallObjectMethod(
+			env, buildable_scan, BuildableScan_limit, (jint)limit);
 
 	scan = (*env)->CallObjectMethod(env, buildable_scan,
 					BuildableScan_build);
@@ -307,38 +484,226 @@ extern jobject scalardb_scan(char *namespace, char *table_name, List *attnames,
  * If `attnames` is specified, only the columns with the names in `attnames`
  * will be returned. (i.e. calls projections())
  * The type of `attnames` must be a List of String.
+ *
+ * If `limit` is greater than 0, at most `limit` records are returned.
  */
 extern jobject scalardb_scan_with_index(char *namespace, char *table_name,
 					List *attnames,
 					ScalarDbFdwScanCondition *scan_conds,
-					size_t num_scan_conds)
+					size_t num_scan_conds, int limit)
 {
-	jstring namespace_str;
-	jstring table_name_str;
+	ScalarDbFdwScanTemplate *template;
 	jobject buildable_scan;
 	jobject scan;
 	jobject key;
 
 	ereport(DEBUG5, errmsg("entering function %s", __func__));
 
-	namespace_str = (*env)->NewStringUTF(env, namespace);
-	table_name_str = (*env)->NewStringUTF(env, table_name);
+	template = get_scan_template('i', namespace, table_name, attnames,
+				     scan_conds, num_scan_conds, NIL, NIL,
+				     NIL);
 
-	key = get_key_from_conds(scan_conds, num_scan_conds);
+	key = get_key_from_conds(template->key_names, scan_conds,
+				 num_scan_conds);
 
 	buildable_scan = (*env)->CallStaticObjectMethod(
 		env, ScalarDbUtils_class, ScalarDbUtils_buildableScanWithIndex,
-		namespace_str, table_name_str, key);
+		template->namespace_str, template->table_name_str, key);
 
-	apply_column_pruning(buildable_scan, attnames,
-			     BuildableScanWithIndex_projections);
+	if (template->projections != NULL)
+		buildable_scan = (*env)->CallObjectMethod(
+			env, buildable_scan, BuildableScanWithIndex_projections,
+			template->projections);
+
+	if (limit > 0)
+		buildable_scan = (*env)->CallObjectMethod(
+			env, buildable_scan, BuildableScanWithIndex_limit,
+			(jint)limit);
 
 	scan = (*env)->CallObjectMethod(env, buildable_scan,
 					BuildableScanWithIndex_build);
 	return (*env)->NewGlobalRef(env, scan);
 }
 
-static jobject get_key_from_conds(ScalarDbFdwScanCondition *scan_conds,
+/*
+ * Return the Scan template for the scan of the given shape, creating and
+ * caching it if it is not cached. scan_type is 'a' for a Scan (all), 'p' for a
+ * Scan (partitionKey), and 'i' for a Scan (indexKey).
+ */
+static ScalarDbFdwScanTemplate *
+get_scan_template(char scan_type, char *namespace, char *table_name,
+		  List *attnames, ScalarDbFdwScanCondition *scan_conds,
+		  size_t num_scan_conds, List *boundary_names,
+		  List *sort_column_names, List *sort_orders)
+{
+	StringInfoData key;
+	uint32 hash;
+	ScalarDbFdwScanTemplate *template;
+	ScalarDbFdwScanTemplate new_template;
+	List *key_names = NIL;
+	MemoryContext oldcontext;
+	ListCell *lc;
+	bool found;
+
+	/* Names are prefixed with their lengths to make the key unambiguous */
+	initStringInfo(&key);
+	appendStringInfo(&key, "%c %zu:%s %zu:%s p", scan_type,
+			 strlen(namespace), namespace, strlen(table_name),
+			 table_name);
+	foreach(lc, attnames) {
+		char *name = strVal(lfirst(lc));
+
+		appendStringInfo(&key, " %zu:%s", strlen(name), name);
+	}
+	appendStringInfoString(&key, " k");
+	for (size_t i = 0; i < num_scan_conds; i++) {
+		appendStringInfo(&key, " %zu:%s", strlen(scan_conds[i].name),
+				 scan_conds[i].name);
+		key_names = lappend(key_names, makeString(scan_conds[i].name));
+	}
+	appendStringInfoString(&key, " b");
+	foreach(lc, boundary_names) {
+		char *name = strVal(lfirst(lc));
+
+		appendStringInfo(&key, " %zu:%s", strlen(name), name);
+	}
+	appendStringInfoString(&key, " o");
+	foreach(lc, sort_column_names) {
+		char *name = strVal(lfirst(lc));
+
+		appendStringInfo(&key, " %zu:%s:%d", strlen(name), name,
+				 list_nth_int(sort_orders,
+					      foreach_current_index(lc)));
+	}
+
+	if (scan_templates == NULL) {
+		HASHCTL ctl;
+
+		ctl.keysize = sizeof(uint32);
+		ctl.entrysize = sizeof(ScalarDbFdwScanTemplate);
+		scan_templates = hash_create("scalardb_fdw scan templates",
+					     SCAN_TEMPLATE_CACHE_SIZE, &ctl,
+					     HASH_ELEM | HASH_BLOBS);
+	}
+
+	hash = hash_bytes((unsigned char *)key.data, key.len);
+	template = hash_search(scan_templates, &hash, HASH_FIND, NULL);
+	if (template != NULL && strcmp(template->key, key.data) == 0) {
+		pfree(key.data);
+		list_free_deep(key_names);
+		return template;
+	}
+
+	/*
+	 * Create the template before entering it, so that an error in the JVM
+	 * does not leave a half-initialized entry.
+	 */
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	new_template.key = pstrdup(key.data);
+	new_template.namespace_str =
+		(*env)->NewGlobalRef(env, (*env)->NewStringUTF(env, namespace));
+	new_template.table_name_str = (*env)->NewGlobalRef(
+		env, (*env)->NewStringUTF(env, table_name));
+	new_template.projections =
+		attnames == NIL ?
+			NULL :
+			(*env)->NewGlobalRef(
+				env, convert_string_list_to_jarray_of_string(
+					     attnames));
+	new_template.orderings =
+		sort_column_names == NIL ?
+			NULL :
+			(*env)->NewGlobalRef(env,
+					     make_orderings(sort_column_names,
+							    sort_orders));
+	new_template.key_names = make_global_names(key_names);
+	new_template.num_key_names = list_length(key_names);
+	new_template.boundary_names = make_global_names(boundary_names);
+	new_template.num_boundary_names = list_length(boundary_names);
+	MemoryContextSwitchTo(oldcontext);
+	pfree(key.data);
+	list_free_deep(key_names);
+
+	if (template != NULL) {
+		/* Hash collision. The template of the other shape is replaced */
+		release_scan_template(template);
+	} else if (hash_get_num_entries(scan_templates) >=
+		   SCAN_TEMPLATE_CACHE_SIZE) {
+		reset_scan_templates();
+	}
+
+	template = hash_search(scan_templates, &hash, HASH_ENTER, &found);
+	new_template.hash = hash;
+	*template = new_template;
+	return template;
+}
+
+/*
+ * Release the Java objects and the memory held by the Scan template.
+ */
+static void release_scan_template(ScalarDbFdwScanTemplate *template)
+{
+	(*env)->DeleteGlobalRef(env, template->namespace_str);
+	(*env)->DeleteGlobalRef(env, template->table_name_str);
+	if (template->projections != NULL)
+		(*env)->DeleteGlobalRef(env, template->projections);
+	if (template->orderings != NULL)
+		(*env)->DeleteGlobalRef(env, template->orderings);
+	for (int i = 0; i < template->num_key_names; i++)
+		(*env)->DeleteGlobalRef(env, template->key_names[i]);
+	for (int i = 0; i < template->num_boundary_names; i++)
+		(*env)->DeleteGlobalRef(env, template->boundary_names[i]);
+	if (template->key_names != NULL)
+		pfree(template->key_names);
+	if (template->boundary_names != NULL)
+		pfree(template->boundary_names);
+	pfree(template->key);
+}
+
+/*
+ * Release all cached Scan templates. The cache is simply cleared when it is
+ * full, since the number of the scan shapes used by a backend is usually
+ * small.
+ */
+static void reset_scan_templates(void)
+{
+	HASH_SEQ_STATUS status;
+	ScalarDbFdwScanTemplate *template;
+
+	hash_seq_init(&status, scan_templates);
+	while ((template = hash_seq_search(&status)) != NULL) {
+		release_scan_template(template);
+		hash_search(scan_templates, &template->hash, HASH_REMOVE, NULL);
+	}
+}
+
+/*
+ * Return an array of global references to Java Strings of the names. The
+ * array is allocated in the current memory context. NULL if names is empty.
+ */
+static jstring *make_global_names(List *names)
+{
+	jstring *ret;
+
+	if (names == NIL)
+		return NULL;
+
+	ret = palloc(sizeof(jstring) * list_length(names));
+	for (int i = 0; i < list_length(names); i++) {
+		jstring str =
+			(*env)->NewStringUTF(env, strVal(list_nth(names, i)));
+		ret[i] = (*env)->NewGlobalRef(env, str);
+		(*env)->DeleteLocalRef(env, str);
+	}
+	return ret;
+}
+
+/*
+ * Build a Key from the conditions. If names is NULL, Java Strings of the
+ * names of the conditions are created.
+ */
+static jobject get_key_from_conds(jstring *names,
+				  ScalarDbFdwScanCondition *scan_conds,
 				  size_t num_scan_conds)
 {
 	jobject key_builder;
@@ -350,7 +715,10 @@ static jobject get_key_from_conds(ScalarDbFdwScanCondition *scan_conds,
 		ScalarDbFdwScanCondition *cond = &scan_conds[i];
 		jstring key_name_str;
 
-		key_name_str = (*env)->NewStringUTF(env, cond->name);
+		if (names != NULL)
+			key_name_str = names[i];
+		else
+			key_name_str = (*env)->NewStringUTF(env, cond->name);
 		add_datum_value_to_key(key_builder, key_name_str, cond->value,
 				       cond->value_type);
 	}
@@ -358,7 +726,7 @@ static jobject get_key_from_conds(ScalarDbFdwScanCondition *scan_conds,
 	return (*env)->CallObjectMethod(env, key_builder, KeyBuilder_build);
 }
 
-static jobject get_key_for_boundary(List *names, Datum *values,
+static jobject get_key_for_boundary(jstring *names, Datum *values,
 				    List *value_types, size_t num_values)
 {
 	jobject key_builder;
@@ -366,12 +734,10 @@ static jobject get_key_for_boundary(List *names, Datum *values,
 	key_builder = (*env)->CallStaticObjectMethod(env, ScalarDbUtils_class,
 						     ScalarDbUtils_keyBuilder);
 	for (size_t i = 0; i < num_values; i++) {
-		jstring name_str =
-			(*env)->NewStringUTF(env, strVal(list_nth(names, i)));
 		Datum value = values[i];
 		Oid type = list_nth_oid(value_types, i);
 
-		add_datum_value_to_key(key_builder, name_str, value, type);
+		add_datum_value_to_key(key_builder, names[i], value, type);
 	}
 	return (*env)->CallObjectMethod(env, key_builder, KeyBuilder_build);
 }
@@ -444,23 +810,12 @@ static void add_datum_value_to_key(jobject key_builder, jstring name,
 	}
 }
 
-static void apply_column_pruning(jobject buildable_scan, List *attnames,
-				 jmethodID projections_method)
-{
-	if (attnames != NIL) {
-		jobjectArray attrnames_array =
-			convert_string_list_to_jarray_of_string(attnames);
-		buildable_scan = (*env)->CallObjectMethod(env, buildable_scan,
-							  projections_method,
-							  attrnames_array);
-	}
-}
-
 static void apply_clustering_key_boundary(jobject buildable_scan,
-					  ScalarDbFdwScanBoundary *boundary)
+					  ScalarDbFdwScanBoundary *boundary,
+					  jstring *names)
 {
 	if (boundary->num_start_values > 0) {
-		jobject key = get_key_for_boundary(boundary->names,
+		jobject key = get_key_for_boundary(names,
 						   boundary->start_values,
 						   boundary->start_value_types,
 						   boundary->num_start_values);
@@ -470,7 +825,7 @@ static void apply_clustering_key_boundary(jobject buildable_scan,
 	}
 
 	if (boundary->num_end_values > 0) {
-		jobject key = get_key_for_boundary(boundary->names,
+		jobject key = get_key_for_boundary(names,
 						   boundary->end_values,
 						   boundary->end_value_types,
 						   boundary->num_end_values);
@@ -480,8 +835,7 @@ static void apply_clustering_key_boundary(jobject buildable_scan,
 	}
 }
 
-static void apply_orderings(jobject buildable_scan, List *sort_column_names,
-			    List *sort_orders)
+static jobjectArray make_orderings(List *sort_column_names, List *sort_orders)
 {
 	ListCell *lc_name;
 	ListCell *lc_order;
@@ -517,8 +871,82 @@ static void apply_orderings(jobject buildable_scan, List *sort_column_names,
 		(*env)->SetObjectArrayElement(env, orderings, i, ordering);
 		/* (*env)->DeleteLocalRef(env, ordering); */
 	}
-	buildable_scan = (*env)->CallObjectMethod(
-		env, buildable_scan, BuildableScan_orderings, orderings);
+	return orderings;
+}
+
+/*
+ * Returns an array of the given Scan objects, which can be used in place of a
+ * Scan object to start, count or print them as one logical scan. The Scans are
+ * run concurrently and their results are merged in the order of their
+ * orderings, which must be the same.
+ *
+ * The returned object is a global reference, and the given ones are released.
+ */
+extern jobject scalardb_merge_scans(jobject *scans, int num_scans)
+{
+	jobjectArray array;
+	jobject ret;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	clear_exception();
+	array = (*env)->NewObjectArray(env, num_scans, Scan_class, NULL);
+	catch_exception();
+	for (int i = 0; i < num_scans; i++) {
+		(*env)->SetObjectArrayElement(env, array, i, scans[i]);
+		scalardb_release_scan(scans[i]);
+	}
+
+	ret = (*env)->NewGlobalRef(env, array);
+	(*env)->DeleteLocalRef(env, array);
+	return ret;
+}
+
+/*
+ * Return true if the scan is an array of Scan objects made by
+ * scalardb_merge_scans.
+ */
+static bool is_merged_scan(jobject scan)
+{
+	return (*env)->IsInstanceOf(env, scan, ScanArray_class);
+}
+
+/*
+ * Returns a Scan of the index-th range of the given Scan (all) made by the
+ * boundaries returned by scalardb_get_scan_all_split_boundaries(). If index is
+ * negative, the Scans of all the ranges are returned as an array made by
+ * scalardb_merge_scans(), so that they are read concurrently.
+ *
+ * The returned object is a global reference. The given Scan is not released.
+ */
+extern jobject scalardb_split_scan_all(jobject scan, int64 *boundaries,
+				       int num_boundaries, int index)
+{
+	jlongArray boundaries_ary;
+	jobject split;
+	jobject ret;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	boundaries_ary = (*env)->NewLongArray(env, num_boundaries);
+	(*env)->SetLongArrayRegion(env, boundaries_ary, 0, num_boundaries,
+				   (jlong *)boundaries);
+
+	clear_exception();
+	if (index < 0)
+		split = (*env)->CallStaticObjectMethod(
+			env, ScalarDbUtils_class, ScalarDbUtils_splitScanAll,
+			scan, boundaries_ary);
+	else
+		split = (*env)->CallStaticObjectMethod(
+			env, ScalarDbUtils_class, ScalarDbUtils_getScanAllSplit,
+			scan, boundaries_ary, (jint)index);
+	catch_exception();
+
+	ret = (*env)->NewGlobalRef(env, split);
+	(*env)->DeleteLocalRef(env, split);
+	(*env)->DeleteLocalRef(env, boundaries_ary);
+	return ret;
 }
 
 /*
@@ -531,15 +959,109 @@ extern void scalardb_release_scan(jobject scan)
 
 /*
  * Returns Scanner object started from the specified Scan object.
+ *
+ * If sample_percent is less than 100, the Scanner returns only the records of
+ * the partitions sampled with the percentage on the ScalarDB side. If
+ * transaction_aware is true, the Scanner returns the committed values of the
+ * records of a Consensus Commit table and skips the records that have never
+ * been committed. If fetch_size is greater than 0 or adaptive_fetch is true,
+ * the records of a partition key scan are read in pages of at most fetch_size
+ * records, or of the size adjusted to the records if adaptive_fetch is true.
+ */
+extern jobject scalardb_start_scan(jobject scan, double sample_percent,
+				   bool transaction_aware, int fetch_size,
+				   bool adaptive_fetch)
+{
+	jobject scanner;
+	clear_exception();
+	scanner = (*env)->CallStaticObjectMethod(
+		env, ScalarDbUtils_class,
+		is_merged_scan(scan) ? ScalarDbUtils_scanMerged :
+				       ScalarDbUtils_scan,
+		scan, (jdouble)sample_percent, (jboolean)transaction_aware,
+		(jint)fetch_size, (jboolean)adaptive_fetch);
+	catch_exception();
+	return register_scanner(scanner);
+}
+
+/*
+ * Returns Scanner object started from the specified Scan object, which returns
+ * only the records whose columns are equal to all of the filter conditions.
+ * The records are filtered on the ScalarDB side, so the others are never
+ * passed to PostgreSQL.
+ */
+extern jobject scalardb_start_scan_with_filter(
+	jobject scan, ScalarDbFdwScanCondition *filter_conds,
+	size_t num_filter_conds, double sample_percent, bool transaction_aware,
+	int fetch_size, bool adaptive_fetch)
+{
+	jobject filter;
+	jobject scanner;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	filter = get_key_from_conds(NULL, filter_conds, num_filter_conds);
+
+	clear_exception();
+	scanner = (*env)->CallStaticObjectMethod(
+		env, ScalarDbUtils_class,
+		is_merged_scan(scan) ? ScalarDbUtils_scanMergedWithFilter :
+				       ScalarDbUtils_scanWithFilter,
+		scan, filter, (jdouble)sample_percent,
+		(jboolean)transaction_aware, (jint)fetch_size,
+		(jboolean)adaptive_fetch);
+	catch_exception();
+
+	(*env)->DeleteLocalRef(env, filter);
+	return register_scanner(scanner);
+}
+
+/*
+ * Returns the number of records retrieved by the specified Scan object. The
+ * records are counted on the ScalarDB side and are never transferred to
+ * PostgreSQL. Only the records of the sampled partitions are counted if
+ * sample_percent is less than 100, and only the committed records are counted
+ * if transaction_aware is true.
+ */
+extern long scalardb_count(jobject scan, double sample_percent,
+			   bool transaction_aware)
+{
+	jlong count;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	clear_exception();
+	count = (*env)->CallStaticLongMethod(
+		env, ScalarDbUtils_class,
+		is_merged_scan(scan) ? ScalarDbUtils_countMerged :
+				       ScalarDbUtils_count,
+		scan, (jdouble)sample_percent, (jboolean)transaction_aware);
+	catch_exception();
+
+	report_jdbc_counter_failure();
+	return (long)count;
+}
+
+/*
+ * Returns Scanner object started from the specified Scan object of a
+ * Consensus Commit table, which returns the committed values of only the
+ * records committed after committed_at, in milliseconds since the epoch. The
+ * other records are dropped on the ScalarDB side. The Scan must retrieve the
+ * tx_committed_at column.
  */
-extern jobject scalardb_start_scan(jobject scan)
+extern jobject scalardb_start_scan_committed_after(jobject scan,
+						   int64 committed_at)
 {
 	jobject scanner;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
 	clear_exception();
-	scanner = (*env)->CallStaticObjectMethod(env, ScalarDbUtils_class,
-						 ScalarDbUtils_scan, scan);
+	scanner = (*env)->CallStaticObjectMethod(
+		env, ScalarDbUtils_class, ScalarDbUtils_scanCommittedAfter,
+		scan, (jlong)committed_at);
 	catch_exception();
-	return scanner;
+	return register_scanner(scanner);
 }
 
 extern jobject scalardb_scanner_one(jobject scanner)
@@ -551,6 +1073,7 @@ extern jobject scalardb_scanner_one(jobject scanner)
 	clear_exception();
 	(*env)->PushLocalFrame(env, LOCAL_FRAME_CAPACITY);
 	catch_exception();
+	num_result_frames++;
 
 	clear_exception();
 	o = (*env)->CallObjectMethod(env, scanner, Scanner_one);
@@ -568,16 +1091,131 @@ extern void scalardb_scanner_release_result()
 {
 	ereport(DEBUG5, errmsg("entering function %s", __func__));
 	(*env)->PopLocalFrame(env, NULL);
+	num_result_frames--;
 }
 
+/*
+ * Close the Scanner returned by one of the scalardb_start_scan functions and
+ * release the reference to it. The reference is released even if the Scanner
+ * fails to close.
+ */
 extern void scalardb_scanner_close(jobject scanner)
 {
 	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	unregister_scanner(scanner);
+
 	clear_exception();
 	(*env)->CallVoidMethod(env, scanner, Closeable_close);
+	(*env)->DeleteGlobalRef(env, scanner);
 	catch_exception();
+}
+
+/*
+ * Return a global reference to the started Scanner given as a local
+ * reference, and register it to be closed if the current resource owner is
+ * released on abort before the Scanner is closed.
+ */
+static jobject register_scanner(jobject scanner)
+{
+	ScalarDbFdwOpenScanner *entry;
+	MemoryContext oldcxt;
+
+	if (!resource_release_callback_registered) {
+		RegisterResourceReleaseCallback(release_scanners, NULL);
+		resource_release_callback_registered = true;
+	}
 
+	oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+	entry = palloc(sizeof(ScalarDbFdwOpenScanner));
+	entry->scanner = NULL;
+	entry->owner = CurrentResourceOwner;
+	open_scanners = lappend(open_scanners, entry);
+	MemoryContextSwitchTo(oldcxt);
+
+	entry->scanner = (*env)->NewGlobalRef(env, scanner);
 	(*env)->DeleteLocalRef(env, scanner);
+	if (entry->scanner == NULL) {
+		open_scanners = list_delete_ptr(open_scanners, entry);
+		pfree(entry);
+		ereport(ERROR, errcode(ERRCODE_OUT_OF_MEMORY),
+			errmsg("failed to create a global reference to the scanner"));
+	}
+	return entry->scanner;
+}
+
+static void unregister_scanner(jobject scanner)
+{
+	ListCell *lc;
+
+	foreach (lc, open_scanners) {
+		ScalarDbFdwOpenScanner *entry = lfirst(lc);
+
+		if (entry->scanner == scanner) {
+			open_scanners = list_delete_cell(open_scanners, lc);
+			pfree(entry);
+			return;
+		}
+	}
+}
+
+/*
+ * Resource release callback, which closes the Scanners started under the
+ * resource owner being released on abort. On the commit of a subtransaction,
+ * the Scanners still open are passed to the parent resource owner, and the
+ * ones still open at the top-level commit are closed with a warning, since
+ * they have been leaked.
+ *
+ * The local frames left by the aborted fetches of Results are popped on the
+ * top-level abort.
+ */
+static void release_scanners(ResourceReleasePhase phase, bool isCommit,
+			     bool isTopLevel, void *arg)
+{
+	ResourceOwner parent;
+	ListCell *lc;
+
+	if (phase != RESOURCE_RELEASE_AFTER_LOCKS)
+		return;
+
+	if (!isCommit && isTopLevel) {
+		while (num_result_frames > 0) {
+			(*env)->PopLocalFrame(env, NULL);
+			num_result_frames--;
+		}
+	}
+
+	parent = ResourceOwnerGetParent(CurrentResourceOwner);
+	foreach (lc, open_scanners) {
+		ScalarDbFdwOpenScanner *entry = lfirst(lc);
+
+		if (entry->owner != CurrentResourceOwner)
+			continue;
+
+		if (isCommit && parent != NULL) {
+			entry->owner = parent;
+			continue;
+		}
+		if (isCommit)
+			ereport(WARNING,
+				errmsg("ScalarDB scanner was not closed before commit"));
+
+		close_scanner_quietly(entry->scanner);
+		open_scanners = foreach_delete_current(open_scanners, lc);
+		pfree(entry);
+	}
+}
+
+/*
+ * Close the Scanner and release the reference to it without raising an error,
+ * since this is called during abort.
+ */
+static void close_scanner_quietly(jobject scanner)
+{
+	(*env)->CallVoidMethod(env, scanner, Closeable_close);
+	if ((*env)->ExceptionCheck(env))
+		(*env)->ExceptionClear(env);
+	(*env)->DeleteGlobalRef(env, scanner);
 }
 
 extern int scalardb_list_size(jobject list)
@@ -626,6 +1264,43 @@ extern jobject scalardb_iterator_next(jobject iterator)
 	return (*env)->CallObjectMethod(env, iterator, Iterator_next);
 }
 
+/*
+ * Create a dictionary for the values of a TEXT column. The values are kept in
+ * the current memory context.
+ */
+extern ScalarDbTextDictionary *scalardb_text_dictionary_create(void)
+{
+	ScalarDbTextDictionary *dictionary;
+	jobject obj;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	dictionary = (ScalarDbTextDictionary *)palloc0(
+		sizeof(ScalarDbTextDictionary));
+	dictionary->cxt = CurrentMemoryContext;
+	dictionary->max_values = INITIAL_TEXT_DICTIONARY_SIZE;
+	dictionary->values = (text **)palloc(dictionary->max_values *
+					     sizeof(text *));
+
+	clear_exception();
+	obj = (*env)->NewObject(env, TextDictionary_class,
+				TextDictionary_init);
+	catch_exception();
+	dictionary->dictionary = (*env)->NewGlobalRef(env, obj);
+	(*env)->DeleteLocalRef(env, obj);
+
+	return dictionary;
+}
+
+extern void scalardb_text_dictionary_release(ScalarDbTextDictionary *dictionary)
+{
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (dictionary->dictionary != NULL)
+		(*env)->DeleteGlobalRef(env, dictionary->dictionary);
+	dictionary->dictionary = NULL;
+}
+
 extern bool scalardb_result_is_null(jobject result, char *attname)
 {
 	jstring attname_str;
@@ -683,26 +1358,91 @@ extern double scalardb_result_get_double(jobject result, char *attname)
 						attname_str);
 }
 
+/*
+ * Returns the value of the TEXT column. The value is encoded as UTF-8 on the
+ * Java side, so it is not converted from the modified UTF-8 of JNI. The
+ * column must not be NULL.
+ */
 extern text *scalardb_result_get_text(jobject result, char *attname)
 {
-	jstring attname_str;
-	jstring str;
 	ereport(DEBUG5, errmsg("entering function %s", __func__));
-	attname_str = (*env)->NewStringUTF(env, attname);
-	str = (*env)->CallObjectMethod(env, result, Result_getText,
-				       attname_str);
-	return convert_string_to_text(str);
+	return (text *)read_varlena_from_result(result, attname,
+						 ScalarDbUtils_writeText);
 }
 
+/*
+ * Returns the value of the BLOB column. The column must not be NULL.
+ */
 extern bytea *scalardb_result_get_blob(jobject result, char *attname)
+{
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+	return (bytea *)read_varlena_from_result(result, attname,
+						  ScalarDbUtils_writeBlob);
+}
+
+/*
+ * Returns the value of the TEXT column, which must not be NULL, from the
+ * dictionary. Only the code of the value is passed from the JVM if the value
+ * is already in the dictionary, and the value is read as a new one otherwise.
+ * The returned value is owned by the dictionary and must not be modified.
+ *
+ * Once the dictionary is full, it is no longer used if the values are found
+ * in it less often than they are missing from it.
+ */
+extern text *
+scalardb_result_get_text_with_dictionary(jobject result, char *attname,
+					 ScalarDbTextDictionary *dictionary)
 {
 	jstring attname_str;
-	jbyteArray bytes;
+	jint code;
+	text *value;
+
 	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	if (dictionary->dictionary == NULL)
+		return scalardb_result_get_text(result, attname);
+
 	attname_str = (*env)->NewStringUTF(env, attname);
-	bytes = (jbyteArray)(*env)->CallObjectMethod(
-		env, result, Result_getBlobAsBytes, attname_str);
-	return convert_jbyteArray_to_bytea(bytes);
+	clear_exception();
+	code = (*env)->CallIntMethod(env, dictionary->dictionary,
+				     TextDictionary_lookup, result,
+				     attname_str);
+	catch_exception();
+	(*env)->DeleteLocalRef(env, attname_str);
+
+	if (code >= 0) {
+		Assert(code < dictionary->num_values);
+		dictionary->hits++;
+		return dictionary->values[code];
+	}
+
+	value = scalardb_result_get_text(result, attname);
+
+	if (code == TEXT_DICTIONARY_TOO_LONG)
+		return value;
+
+	if (code == TEXT_DICTIONARY_FULL) {
+		if (++dictionary->misses > dictionary->hits)
+			scalardb_text_dictionary_release(dictionary);
+		return value;
+	}
+
+	/* The value has been added with the next code */
+	code = -code - 3;
+	Assert(code == dictionary->num_values);
+	if (code >= dictionary->max_values) {
+		dictionary->max_values *= 2;
+		dictionary->values = (text **)repalloc(
+			dictionary->values,
+			dictionary->max_values * sizeof(text *));
+	}
+	dictionary->values[code] =
+		(text *)MemoryContextAlloc(dictionary->cxt, VARSIZE(value));
+	memcpy(dictionary->values[code], value, VARSIZE(value));
+	dictionary->num_values++;
+	pfree(value);
+
+	return dictionary->values[code];
 }
 
 extern int scalardb_result_columns_size(jobject result)
@@ -718,10 +1458,16 @@ extern int scalardb_result_columns_size(jobject result)
  */
 extern char *scalardb_to_string(jobject obj)
 {
-	jstring str =
-		(jstring)(*env)->CallObjectMethod(env, obj, Object_toString);
-	char *cstr = convert_string_to_cstring(str);
-	return cstr;
+	jstring str;
+
+	/* An array of Scans made by scalardb_merge_scans prints its elements */
+	if (is_merged_scan(obj))
+		str = (jstring)(*env)->CallStaticObjectMethod(
+			env, ScalarDbUtils_class, ScalarDbUtils_toString, obj);
+	else
+		str = (jstring)(*env)->CallObjectMethod(env, obj,
+							Object_toString);
+	return convert_string_to_cstring(str);
 }
 
 /*
@@ -847,6 +1593,229 @@ extern void scalardb_get_secondary_index_names(char *namespace,
 	}
 }
 
+/*
+ * Returns the name of the storage (e.g., "cassandra" or "jdbc") that stores the
+ * tables in the given namespace. In multi-storage configuration, the namespace
+ * mapping is resolved to the underlying storage.
+ */
+extern char *scalardb_get_storage(char *namespace)
+{
+	jstring namespace_str;
+	jstring storage_str;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	namespace_str = (*env)->NewStringUTF(env, namespace);
+
+	clear_exception();
+	storage_str = (jstring)(*env)->CallStaticObjectMethod(
+		env, ScalarDbUtils_class, ScalarDbUtils_getStorage,
+		namespace_str);
+	catch_exception();
+
+	return convert_string_to_cstring(storage_str);
+}
+
+/*
+ * Returns true if Scan (all) with orderings can be executed on the storage of
+ * the given namespace.
+ */
+extern bool scalardb_can_order_scan_all(char *namespace)
+{
+	jstring namespace_str;
+	jboolean b;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	namespace_str = (*env)->NewStringUTF(env, namespace);
+
+	clear_exception();
+	b = (*env)->CallStaticBooleanMethod(env, ScalarDbUtils_class,
+					    ScalarDbUtils_canOrderScanAll,
+					    namespace_str);
+	catch_exception();
+
+	return b == JNI_TRUE;
+}
+
+/*
+ * Returns true if Scan (all) of the table can be split into ranges by
+ * scalardb_get_scan_all_split_boundaries(). Unlike that, this does not read the
+ * table.
+ */
+extern bool scalardb_can_split_scan_all(char *namespace, char *table_name)
+{
+	jstring namespace_str;
+	jstring table_name_str;
+	jboolean b;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	namespace_str = (*env)->NewStringUTF(env, namespace);
+	table_name_str = (*env)->NewStringUTF(env, table_name);
+
+	clear_exception();
+	b = (*env)->CallStaticBooleanMethod(env, ScalarDbUtils_class,
+					    ScalarDbUtils_canSplitScanAll,
+					    namespace_str, table_name_str);
+	catch_exception();
+
+	(*env)->DeleteLocalRef(env, table_name_str);
+	(*env)->DeleteLocalRef(env, namespace_str);
+	return b == JNI_TRUE;
+}
+
+/*
+ * Returns the boundaries that split Scan (all) of the table into at most
+ * num_splits ranges of its first partition key column. The number of the
+ * boundaries is set to num_boundaries, which is 0 if the scan cannot be split
+ * (see ScalarDbUtils.getScanAllSplitBoundaries()).
+ */
+extern int64 *scalardb_get_scan_all_split_boundaries(char *namespace,
+						     char *table_name,
+						     int num_splits,
+						     int *num_boundaries)
+{
+	jstring namespace_str;
+	jstring table_name_str;
+	jlongArray boundaries_ary;
+	int64 *boundaries;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	namespace_str = (*env)->NewStringUTF(env, namespace);
+	table_name_str = (*env)->NewStringUTF(env, table_name);
+
+	clear_exception();
+	boundaries_ary = (jlongArray)(*env)->CallStaticObjectMethod(
+		env, ScalarDbUtils_class,
+		ScalarDbUtils_getScanAllSplitBoundaries, namespace_str,
+		table_name_str, (jint)num_splits);
+	catch_exception();
+
+	report_jdbc_counter_failure();
+
+	*num_boundaries = (*env)->GetArrayLength(env, boundaries_ary);
+	boundaries = palloc(sizeof(int64) * Max(*num_boundaries, 1));
+	(*env)->GetLongArrayRegion(env, boundaries_ary, 0, *num_boundaries,
+				   (jlong *)boundaries);
+
+	(*env)->DeleteLocalRef(env, boundaries_ary);
+	(*env)->DeleteLocalRef(env, table_name_str);
+	(*env)->DeleteLocalRef(env, namespace_str);
+	return boundaries;
+}
+
+/*
+ * Report the last failure of the native queries on the JDBC storages as a
+ * warning. The JVM side does not throw the failures but falls back to counting
+ * the records with ScalarDB or to not splitting the scan, which can be much
+ * slower, e.g., if the JDBC driver cannot connect to the database.
+ */
+static void report_jdbc_counter_failure(void)
+{
+	jstring failure;
+
+	clear_exception();
+	failure = (jstring)(*env)->CallStaticObjectMethod(
+		env, ScalarDbUtils_class, ScalarDbUtils_takeJdbcCounterFailure);
+	catch_exception();
+
+	if (failure == NULL)
+		return;
+
+	ereport(WARNING, errmsg("native query on the JDBC storage failed"),
+		errdetail("%s", convert_string_to_cstring(failure)),
+		errhint("The query continues without it, which can be much slower."));
+}
+
+/*
+ * Collect the statistics of the JVM into stats, which has
+ * SCALARDB_JVM_STATS_NUM elements in the order of JvmStats.collect(). Returns
+ * false if the JVM has not been started in this backend.
+ */
+extern bool scalardb_get_jvm_stats(int64 *stats)
+{
+	jlongArray stats_ary;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	if (JvmStats_class == NULL)
+		return false;
+
+	get_jni_env();
+
+	clear_exception();
+	stats_ary = (jlongArray)(*env)->CallStaticObjectMethod(
+		env, JvmStats_class, JvmStats_collect);
+	catch_exception();
+
+	(*env)->GetLongArrayRegion(env, stats_ary, 0, SCALARDB_JVM_STATS_NUM,
+				   (jlong *)stats);
+	(*env)->DeleteLocalRef(env, stats_ary);
+	return true;
+}
+
+/*
+ * Start a Java Flight Recorder recording of the JVM of this backend with the
+ * given settings. The recording is written to filename when it is stopped.
+ * Returns the output of the JVM.
+ */
+extern char *scalardb_start_flight_recording(char *settings, char *filename)
+{
+	jstring settings_str;
+	jstring filename_str;
+	jstring output;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (FlightRecorder_class == NULL)
+		ereport(ERROR,
+			errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			errmsg("the JVM has not been started in this backend"),
+			errhint("Scan a ScalarDB foreign table first."));
+
+	get_jni_env();
+
+	settings_str = (*env)->NewStringUTF(env, settings);
+	filename_str = (*env)->NewStringUTF(env, filename);
+
+	clear_exception();
+	output = (jstring)(*env)->CallStaticObjectMethod(
+		env, FlightRecorder_class, FlightRecorder_start, settings_str,
+		filename_str);
+	catch_exception();
+
+	(*env)->DeleteLocalRef(env, filename_str);
+	(*env)->DeleteLocalRef(env, settings_str);
+	return convert_string_to_cstring(output);
+}
+
+/*
+ * Stop the Java Flight Recorder recording of the JVM of this backend and write
+ * it to its file. Returns the output of the JVM.
+ */
+extern char *scalardb_stop_flight_recording(void)
+{
+	jstring output;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (FlightRecorder_class == NULL)
+		ereport(ERROR,
+			errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			errmsg("the JVM has not been started in this backend"));
+
+	get_jni_env();
+
+	clear_exception();
+	output = (jstring)(*env)->CallStaticObjectMethod(
+		env, FlightRecorder_class, FlightRecorder_stop);
+	catch_exception();
+
+	return convert_string_to_cstring(output);
+}
+
 static void initialize_jvm(ScalarDbFdwOptions *opts)
 {
 	char *max_heap_size;
@@ -978,7 +1947,30 @@ static void initialize_scalardb_references()
 				    ScalarDbUtils_class, "closeStorage", "()V");
 	register_java_static_method(
 		ScalarDbUtils_scan, ScalarDbUtils_class, "scan",
-		"(Lcom/scalar/db/api/Scan;)Lcom/scalar/db/api/Scanner;");
+		"(Lcom/scalar/db/api/Scan;DZIZ)Lcom/scalar/db/api/Scanner;");
+	register_java_static_method(
+		ScalarDbUtils_scanWithFilter, ScalarDbUtils_class,
+		"scanWithFilter",
+		"(Lcom/scalar/db/api/Scan;Lcom/scalar/db/io/Key;DZIZ)Lcom/scalar/db/api/Scanner;");
+	register_java_static_method(ScalarDbUtils_count, ScalarDbUtils_class,
+				    "count", "(Lcom/scalar/db/api/Scan;DZ)J");
+	register_java_static_method(
+		ScalarDbUtils_scanMerged, ScalarDbUtils_class, "scanMerged",
+		"([Lcom/scalar/db/api/Scan;DZIZ)Lcom/scalar/db/api/Scanner;");
+	register_java_static_method(
+		ScalarDbUtils_scanMergedWithFilter, ScalarDbUtils_class,
+		"scanMergedWithFilter",
+		"([Lcom/scalar/db/api/Scan;Lcom/scalar/db/io/Key;DZIZ)Lcom/scalar/db/api/Scanner;");
+	register_java_static_method(ScalarDbUtils_countMerged,
+				    ScalarDbUtils_class, "countMerged",
+				    "([Lcom/scalar/db/api/Scan;DZ)J");
+	register_java_static_method(
+		ScalarDbUtils_toString, ScalarDbUtils_class, "toString",
+		"([Lcom/scalar/db/api/Scan;)Ljava/lang/String;");
+	register_java_static_method(
+		ScalarDbUtils_scanCommittedAfter, ScalarDbUtils_class,
+		"scanCommittedAfter",
+		"(Lcom/scalar/db/api/Scan;J)Lcom/scalar/db/api/Scanner;");
 	register_java_static_method(
 		ScalarDbUtils_buildableScan, ScalarDbUtils_class,
 		"buildableScan",
@@ -997,6 +1989,12 @@ static void initialize_scalardb_references()
 	register_java_static_method(ScalarDbUtils_getResultColumnsSize,
 				    ScalarDbUtils_class, "getResultColumnsSize",
 				    "(Lcom/scalar/db/api/Result;)I");
+	register_java_static_method(
+		ScalarDbUtils_writeText, ScalarDbUtils_class, "writeText",
+		"(Lcom/scalar/db/api/Result;Ljava/lang/String;Ljava/nio/ByteBuffer;)I");
+	register_java_static_method(
+		ScalarDbUtils_writeBlob, ScalarDbUtils_class, "writeBlob",
+		"(Lcom/scalar/db/api/Result;Ljava/lang/String;Ljava/nio/ByteBuffer;)I");
 	register_java_static_method(
 		ScalarDbUtils_getPartitionKeyNames, ScalarDbUtils_class,
 		"getPartitionKeyNames",
@@ -1013,6 +2011,29 @@ static void initialize_scalardb_references()
 		ScalarDbUtils_getClusteringOrder, ScalarDbUtils_class,
 		"getClusteringOrder",
 		"(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;)I");
+	register_java_static_method(ScalarDbUtils_getStorage,
+				    ScalarDbUtils_class, "getStorage",
+				    "(Ljava/lang/String;)Ljava/lang/String;");
+	register_java_static_method(ScalarDbUtils_getScanAllSplitBoundaries,
+				    ScalarDbUtils_class,
+				    "getScanAllSplitBoundaries",
+				    "(Ljava/lang/String;Ljava/lang/String;I)[J");
+	register_java_static_method(
+		ScalarDbUtils_splitScanAll, ScalarDbUtils_class, "splitScanAll",
+		"(Lcom/scalar/db/api/Scan;[J)[Lcom/scalar/db/api/Scan;");
+	register_java_static_method(
+		ScalarDbUtils_getScanAllSplit, ScalarDbUtils_class,
+		"getScanAllSplit",
+		"(Lcom/scalar/db/api/Scan;[JI)Lcom/scalar/db/api/Scan;");
+	register_java_static_method(ScalarDbUtils_canOrderScanAll,
+				    ScalarDbUtils_class, "canOrderScanAll",
+				    "(Ljava/lang/String;)Z");
+	register_java_static_method(ScalarDbUtils_canSplitScanAll,
+				    ScalarDbUtils_class, "canSplitScanAll",
+				    "(Ljava/lang/String;Ljava/lang/String;)Z");
+	register_java_static_method(ScalarDbUtils_takeJdbcCounterFailure,
+				    ScalarDbUtils_class, "takeJdbcCounterFailure",
+				    "()Ljava/lang/String;");
 
 	// com.scalar.db.api.Result
 	register_java_class(Result_class, "com/scalar/db/api/Result");
@@ -1028,16 +2049,60 @@ static void initialize_scalardb_references()
 				   "(Ljava/lang/String;)F");
 	register_java_class_method(Result_getDouble, Result_class, "getDouble",
 				   "(Ljava/lang/String;)D");
-	register_java_class_method(Result_getText, Result_class, "getText",
-				   "(Ljava/lang/String;)Ljava/lang/String;");
-	register_java_class_method(Result_getBlobAsBytes, Result_class,
-				   "getBlobAsBytes", "(Ljava/lang/String;)[B");
+
+	// TextDictionary
+	register_java_class(
+		TextDictionary_class,
+		"com/scalar/db/analytics/postgresql/TextDictionary");
+	register_java_class_method(TextDictionary_init, TextDictionary_class,
+				   "<init>", "()V");
+	register_java_class_method(
+		TextDictionary_lookup, TextDictionary_class, "lookup",
+		"(Lcom/scalar/db/api/Result;Ljava/lang/String;)I");
+
+	// JvmStats
+	register_java_class(JvmStats_class,
+			    "com/scalar/db/analytics/postgresql/JvmStats");
+	register_java_static_method(JvmStats_collect, JvmStats_class, "collect",
+				    "()[J");
+
+	// FlightRecorder
+	register_java_class(
+		FlightRecorder_class,
+		"com/scalar/db/analytics/postgresql/FlightRecorder");
+	register_java_static_method(
+		FlightRecorder_start, FlightRecorder_class, "start",
+		"(Ljava/lang/String;Ljava/lang/String;)Ljava/lang/String;");
+	register_java_static_method(FlightRecorder_stop, FlightRecorder_class,
+				    "stop", "()Ljava/lang/String;");
+
+	// Interrupts
+	register_java_class(Interrupts_class,
+			    "com/scalar/db/analytics/postgresql/Interrupts");
+	{
+		JNINativeMethod methods[] = {
+			{ "isPending", "()Z", (void *)interrupts_is_pending },
+		};
+
+		if ((*env)->RegisterNatives(env, Interrupts_class, methods,
+					    lengthof(methods)) != JNI_OK)
+			ereport(ERROR,
+				errmsg("%s.isPending cannot be registered",
+				       get_class_name(Interrupts_class)));
+	}
+	register_java_class(
+		ScalarDbFdwCanceledException_class,
+		"com/scalar/db/analytics/postgresql/ScalarDbFdwCanceledException");
 
 	// com.scalar.db.api.Scanner
 	register_java_class(Scanner_class, "com/scalar/db/api/Scanner");
 	register_java_class_method(Scanner_one, Scanner_class, "one",
 				   "()Ljava/util/Optional;");
 
+	// com.scalar.db.api.Scan
+	register_java_class(Scan_class, "com/scalar/db/api/Scan");
+	register_java_class(ScanArray_class, "[Lcom/scalar/db/api/Scan;");
+
 	// com.scalar.db.api.ScanBuilder$BuildableScan
 	register_java_class(BuildableScan_class,
 			    "Lcom/scalar/db/api/ScanBuilder$BuildableScan;");
@@ -1053,6 +2118,9 @@ static void initialize_scalardb_references()
 	register_java_class_method(
 		BuildableScan_orderings, BuildableScan_class, "orderings",
 		"([Lcom/scalar/db/api/Scan$Ordering;)Lcom/scalar/db/api/ScanBuilder$BuildableScan;");
+	register_java_class_method(
+		BuildableScan_limit, BuildableScan_class, "limit",
+		"(I)Lcom/scalar/db/api/ScanBuilder$BuildableScan;");
 	register_java_class_method(BuildableScan_build, BuildableScan_class,
 				   "build", "()Lcom/scalar/db/api/Scan;");
 
@@ -1064,6 +2132,10 @@ static void initialize_scalardb_references()
 		BuildableScanWithIndex_projections,
 		BuildableScanWithIndex_class, "projections",
 		"([Ljava/lang/String;)Lcom/scalar/db/api/ScanBuilder$BuildableScanWithIndex;");
+	register_java_class_method(
+		BuildableScanWithIndex_limit, BuildableScanWithIndex_class,
+		"limit",
+		"(I)Lcom/scalar/db/api/ScanBuilder$BuildableScanWithIndex;");
 	register_java_class_method(BuildableScanWithIndex_build,
 				   BuildableScanWithIndex_class, "build",
 				   "()Lcom/scalar/db/api/Scan;");
@@ -1075,6 +2147,9 @@ static void initialize_scalardb_references()
 		BuildableScanAll_projections, BuildableScanAll_class,
 		"projections",
 		"([Ljava/lang/String;)Lcom/scalar/db/api/ScanBuilder$BuildableScanAll;");
+	register_java_class_method(
+		BuildableScanAll_orderings, BuildableScanAll_class, "orderings",
+		"([Lcom/scalar/db/api/Scan$Ordering;)Lcom/scalar/db/api/ScanBuilder$BuildableScanAll;");
 	register_java_class_method(BuildableScanAll_build,
 				   BuildableScanAll_class, "build",
 				   "()Lcom/scalar/db/api/Scan;");
@@ -1175,11 +2250,37 @@ static void clear_exception()
 	(*env)->ExceptionClear(env);
 }
 
+/*
+ * Implementation of Interrupts.isPending. The JVM calls this on the thread of
+ * the backend while the backend waits for a remote operation, so the flags of
+ * the interrupts can be read as usual.
+ */
+static jboolean JNICALL interrupts_is_pending(JNIEnv *jni_env, jclass class)
+{
+	return INTERRUPTS_PENDING_CONDITION() && INTERRUPTS_CAN_BE_PROCESSED();
+}
+
 static void catch_exception()
 {
 	if ((*env)->ExceptionCheck(env)) {
 		jthrowable exc = (*env)->ExceptionOccurred(env);
-		char *msg = scalardb_to_string(exc);
+		char *msg;
+
+		/*
+		 * The remote operation has been abandoned for a pending
+		 * interrupt, e.g., a query cancel or statement_timeout, which
+		 * is handled here to report the usual error.
+		 */
+		if ((*env)->IsInstanceOf(env, exc,
+					 ScalarDbFdwCanceledException_class)) {
+			(*env)->ExceptionClear(env);
+			(*env)->DeleteLocalRef(env, exc);
+			CHECK_FOR_INTERRUPTS();
+			ereport(ERROR, errcode(ERRCODE_QUERY_CANCELED),
+				errmsg("canceling the remote operation of ScalarDB"));
+		}
+
+		msg = scalardb_to_string(exc);
 		ereport(ERROR, errcode(ERRCODE_FDW_ERROR),
 			errmsg("Exception occurred in JVM: %s", msg));
 	}
@@ -1204,47 +2305,90 @@ static char *convert_string_to_cstring(jstring java_string)
 	return ret;
 }
 
-static text *convert_string_to_text(jstring java_string)
+/*
+ * Read the value of the column into a varlena. The value is written into
+ * the buffer shared with the JVM by write_method, and copied once from it.
+ */
+static struct varlena *read_varlena_from_result(jobject result, char *attname,
+						jmethodID write_method)
 {
-	text *ret = NULL;
-
-	if (!((*env)->IsInstanceOf(env, java_string, String_class))) {
-		ereport(ERROR, errmsg("Not an instance of String class"));
-	}
-
-	if (java_string != NULL) {
-		const char *str = (char *)(*env)->GetStringUTFChars(
-			env, (jstring)java_string, 0);
-
-		jsize nbytes = (*env)->GetStringUTFLength(env, java_string);
+	jstring attname_str;
+	jint len;
+	struct varlena *ret;
 
-		ret = (bytea *)palloc(nbytes + VARHDRSZ);
-		SET_VARSIZE(ret, nbytes + VARHDRSZ);
-		memcpy(VARDATA(ret), str, nbytes);
+	if (value_buffer == NULL)
+		enlarge_value_buffer(INITIAL_VALUE_BUFFER_SIZE);
 
-		(*env)->ReleaseStringUTFChars(env, (jstring)java_string, str);
-		(*env)->DeleteLocalRef(env, java_string);
+	attname_str = (*env)->NewStringUTF(env, attname);
+	for (;;) {
+		clear_exception();
+		len = (*env)->CallStaticIntMethod(env, ScalarDbUtils_class,
+						  write_method, result,
+						  attname_str,
+						  value_buffer_obj);
+		catch_exception();
+		if (len >= 0)
+			break;
+		/* The buffer is too small. -len bytes are required */
+		enlarge_value_buffer(-(Size)len);
 	}
+	(*env)->DeleteLocalRef(env, attname_str);
+
+	ret = (struct varlena *)palloc(len + VARHDRSZ);
+	SET_VARSIZE(ret, len + VARHDRSZ);
+	memcpy(VARDATA(ret), value_buffer, len);
 	return ret;
 }
 
-static bytea *convert_jbyteArray_to_bytea(jbyteArray bytes)
+/*
+ * Enlarge the buffer shared with the JVM to at least size bytes.
+ */
+static void enlarge_value_buffer(Size size)
 {
-	bytea *ret = NULL;
-
-	if (bytes != NULL) {
-		jbyte *elems = (*env)->GetByteArrayElements(env, bytes, 0);
+	Size new_size = Max(value_buffer_size, INITIAL_VALUE_BUFFER_SIZE);
+	jobject buffer;
+
+	while (new_size < size)
+		new_size *= 2;
+	if (new_size > MaxAllocSize - VARHDRSZ)
+		new_size = MaxAllocSize - VARHDRSZ;
+	if (new_size < size)
+		ereport(ERROR,
+			errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+			errmsg("value of %zu bytes is too large", size));
 
-		jsize len = (*env)->GetArrayLength(env, bytes);
-		size_t nbytes = sizeof(jbyte) * len;
+	free_value_buffer();
 
-		ret = (bytea *)palloc(nbytes + VARHDRSZ);
-		SET_VARSIZE(ret, nbytes + VARHDRSZ);
-		memcpy(VARDATA(ret), elems, nbytes);
+	value_buffer = MemoryContextAlloc(TopMemoryContext, new_size);
+	value_buffer_size = new_size;
+	buffer = (*env)->NewDirectByteBuffer(env, value_buffer, new_size);
+	value_buffer_obj = (*env)->NewGlobalRef(env, buffer);
+	(*env)->DeleteLocalRef(env, buffer);
+}
 
-		(*env)->ReleaseByteArrayElements(env, bytes, elems, JNI_ABORT);
+static void free_value_buffer(void)
+{
+	if (value_buffer_obj != NULL) {
+		(*env)->DeleteGlobalRef(env, value_buffer_obj);
+		value_buffer_obj = NULL;
 	}
-	return ret;
+	if (value_buffer != NULL)
+		pfree(value_buffer);
+	value_buffer = NULL;
+	value_buffer_size = 0;
+}
+
+/*
+ * Free the buffer shared with the JVM if it has been enlarged for a large
+ * value, so that the backend does not keep the memory for the largest value
+ * it has ever read. The next value is read into a buffer of the initial size.
+ */
+extern void scalardb_shrink_value_buffer(void)
+{
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (value_buffer_size > INITIAL_VALUE_BUFFER_SIZE)
+		free_value_buffer();
 }
 
 /*
@@ -75,27 +75,53 @@ typedef struct {
 	List *is_equals;
 } ScalarDbFdwScanBoundary;
 
+/*
+ * Dictionary of the distinct values of a TEXT column read by a scan. See
+ * scalardb_result_get_text_with_dictionary.
+ */
+typedef struct ScalarDbTextDictionary ScalarDbTextDictionary;
+
 extern void scalardb_initialize(ScalarDbFdwOptions *opts);
 
 extern jobject scalardb_scan_all(char *namespace, char *table_name,
-				 List *attnames);
+				 List *attnames, List *sort_column_names,
+				 List *sort_orders);
 extern jobject scalardb_scan(char *namespace, char *table_name, List *attnames,
 			     ScalarDbFdwScanCondition *scan_conds,
 			     size_t scan_conds_len,
 			     ScalarDbFdwScanBoundary *boundary,
-			     List *sort_column_names, List *sort_orders);
+			     List *sort_column_names, List *sort_orders,
+			     int limit);
 extern jobject scalardb_scan_with_index(char *namespace, char *table_name,
 					List *attnames,
 					ScalarDbFdwScanCondition *scan_conds,
-					size_t scan_conds_len);
+					size_t scan_conds_len, int limit);
+
+extern jobject scalardb_merge_scans(jobject *scans, int num_scans);
+extern jobject scalardb_split_scan_all(jobject scan, int64 *boundaries,
+				       int num_boundaries, int index);
 
 extern void scalardb_release_scan(jobject scan);
 
-extern jobject scalardb_start_scan(jobject scan);
+extern jobject scalardb_start_scan(jobject scan, double sample_percent,
+				   bool transaction_aware, int fetch_size,
+				   bool adaptive_fetch);
+
+extern jobject scalardb_start_scan_with_filter(
+	jobject scan, ScalarDbFdwScanCondition *filter_conds,
+	size_t num_filter_conds, double sample_percent, bool transaction_aware,
+	int fetch_size, bool adaptive_fetch);
+
+extern long scalardb_count(jobject scan, double sample_percent,
+			   bool transaction_aware);
+
+extern jobject scalardb_start_scan_committed_after(jobject scan,
+						   int64 committed_at);
 
 extern jobject scalardb_scanner_one(jobject scanner);
 extern void scalardb_scanner_release_result(void);
 extern void scalardb_scanner_close(jobject scanner);
+extern void scalardb_shrink_value_buffer(void);
 
 extern int scalardb_list_size(jobject list);
 extern jobject scalardb_list_iterator(jobject list);
@@ -106,6 +132,9 @@ extern jobject scalardb_iterator_next(jobject iterator);
 extern bool scalardb_optional_is_present(jobject optional);
 extern jobject scalardb_optional_get(jobject optional);
 
+extern ScalarDbTextDictionary *scalardb_text_dictionary_create(void);
+extern void scalardb_text_dictionary_release(ScalarDbTextDictionary *dictionary);
+
 extern bool scalardb_result_is_null(jobject result, char *attname);
 extern bool scalardb_result_get_boolean(jobject result, char *attname);
 extern int scalardb_result_get_int(jobject result, char *attname);
@@ -114,6 +143,9 @@ extern float scalardb_result_get_float(jobject result, char *attname);
 extern double scalardb_result_get_double(jobject result, char *attname);
 extern text *scalardb_result_get_text(jobject result, char *attname);
 extern bytea *scalardb_result_get_blob(jobject result, char *attname);
+extern text *
+scalardb_result_get_text_with_dictionary(jobject result, char *attname,
+					 ScalarDbTextDictionary *dictionary);
 extern int scalardb_result_columns_size(jobject result);
 
 extern void scalardb_get_paritition_key_names(char *namespace, char *table_name,
@@ -126,6 +158,22 @@ extern void scalardb_get_secondary_index_names(char *namespace,
 					       char *table_name,
 					       List **secondary_index_names);
 
+extern char *scalardb_get_storage(char *namespace);
+extern bool scalardb_can_order_scan_all(char *namespace);
+extern bool scalardb_can_split_scan_all(char *namespace, char *table_name);
+extern int64 *scalardb_get_scan_all_split_boundaries(char *namespace,
+						     char *table_name,
+						     int num_splits,
+						     int *num_boundaries);
+
+/* Number of the statistics returned by scalardb_get_jvm_stats */
+#define SCALARDB_JVM_STATS_NUM 11
+
+extern bool scalardb_get_jvm_stats(int64 *stats);
+
+extern char *scalardb_start_flight_recording(char *settings, char *filename);
+extern char *scalardb_stop_flight_recording(void);
+
 extern char *scalardb_to_string(jobject scan);
 
 #endif
@@ -0,0 +1,180 @@
+--
+-- Copyright 2023 Scalar, Inc.
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+-- http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+--
+CREATE FUNCTION scalardb_fdw_calibrate_costs(
+    foreign_table regclass,
+    cost_unit_ms float8 DEFAULT 0.1,
+    samples integer DEFAULT 3,
+    OUT fdw_startup_cost float8,
+    OUT fdw_round_trip_cost float8,
+    OUT fdw_tuple_cost float8)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+-- Number of records of each partition of the foreign tables, saved by ANALYZE.
+-- partition_key is NULL for the entry of the average of the other partitions.
+-- The partition key values are the data of the tables, so the statistics are
+-- read through the scalardb_fdw_partition_stats view.
+CREATE TABLE scalardb_fdw_partition_statistic (
+    relid oid NOT NULL,
+    partition_key text[],
+    row_count float8 NOT NULL
+);
+
+CREATE INDEX ON scalardb_fdw_partition_statistic (relid);
+
+-- The partition statistics of the foreign tables that the user can read
+CREATE VIEW scalardb_fdw_partition_stats WITH (security_barrier) AS
+SELECT relid, partition_key, row_count
+FROM scalardb_fdw_partition_statistic
+WHERE has_table_privilege(relid, 'SELECT');
+
+GRANT SELECT ON scalardb_fdw_partition_stats TO PUBLIC;
+
+CREATE FUNCTION scalardb_fdw_changes(foreign_table anyelement, committed_after bigint)
+RETURNS SETOF anyelement
+AS 'MODULE_PATHNAME'
+LANGUAGE C;
+
+-- Watermarks of the incremental copies of the transaction-aware foreign tables
+-- into the local tables, in milliseconds since the epoch.
+CREATE TABLE scalardb_fdw_materializations (
+    foreign_table oid NOT NULL,
+    local_table oid NOT NULL,
+    committed_at bigint NOT NULL,
+    PRIMARY KEY (foreign_table, local_table)
+);
+
+-- The watermarks are saved by scalardb_fdw_materialize as the owner of the
+-- table, so the other users can only read them
+GRANT SELECT ON scalardb_fdw_materializations TO PUBLIC;
+
+-- Remove the partition statistics and the watermarks of the dropped tables
+CREATE FUNCTION scalardb_fdw_drop_tables()
+RETURNS event_trigger
+LANGUAGE plpgsql SECURITY DEFINER
+SET search_path = pg_catalog, pg_temp
+AS $$
+DECLARE
+    schema name;
+    dropped oid[];
+BEGIN
+    SELECT n.nspname INTO schema
+    FROM pg_extension e JOIN pg_namespace n ON n.oid = e.extnamespace
+    WHERE e.extname = 'scalardb_fdw';
+    SELECT array_agg(objid) INTO dropped
+    FROM pg_event_trigger_dropped_objects()
+    WHERE classid = 'pg_class'::regclass AND objsubid = 0;
+    IF schema IS NULL OR dropped IS NULL THEN
+        RETURN;
+    END IF;
+    EXECUTE format('DELETE FROM %I.scalardb_fdw_partition_statistic WHERE relid = ANY ($1)', schema)
+    USING dropped;
+    EXECUTE format('DELETE FROM %I.scalardb_fdw_materializations WHERE foreign_table = ANY ($1) OR local_table = ANY ($1)', schema)
+    USING dropped;
+END
+$$;
+
+REVOKE ALL ON FUNCTION scalardb_fdw_drop_tables() FROM PUBLIC;
+
+CREATE EVENT TRIGGER scalardb_fdw_drop_tables ON sql_drop
+EXECUTE FUNCTION scalardb_fdw_drop_tables();
+
+CREATE FUNCTION scalardb_fdw_materialize(
+    foreign_table regclass,
+    local_table regclass,
+    incremental boolean DEFAULT true)
+RETURNS bigint
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+-- Statistics of the JVM embedded in this backend. Sizes are in bytes, and
+-- heap_max is NULL if the maximum heap size is undefined.
+CREATE FUNCTION scalardb_fdw_jvm_stats(
+    OUT pid integer,
+    OUT heap_used bigint,
+    OUT heap_committed bigint,
+    OUT heap_max bigint,
+    OUT non_heap_used bigint,
+    OUT non_heap_committed bigint,
+    OUT gc_count bigint,
+    OUT gc_time_ms bigint,
+    OUT threads bigint,
+    OUT daemon_threads bigint,
+    OUT peak_threads bigint,
+    OUT open_scanners bigint)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+-- Statistics of the JVMs last reported by all the backends through shared
+-- memory, which requires scalardb_fdw in shared_preload_libraries.
+CREATE FUNCTION scalardb_fdw_jvm_stats_all(
+    OUT pid integer,
+    OUT heap_used bigint,
+    OUT heap_committed bigint,
+    OUT heap_max bigint,
+    OUT non_heap_used bigint,
+    OUT non_heap_committed bigint,
+    OUT gc_count bigint,
+    OUT gc_time_ms bigint,
+    OUT threads bigint,
+    OUT daemon_threads bigint,
+    OUT peak_threads bigint,
+    OUT open_scanners bigint,
+    OUT reported_at timestamptz)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+-- Cluster-wide totals of the JVM statistics of the backends
+CREATE VIEW scalardb_fdw_jvm_stats_cluster AS
+SELECT count(*) AS backends,
+       sum(heap_used) AS heap_used,
+       sum(heap_committed) AS heap_committed,
+       max(heap_used) AS max_heap_used,
+       sum(heap_max) AS heap_max,
+       sum(non_heap_used) AS non_heap_used,
+       sum(gc_count) AS gc_count,
+       sum(gc_time_ms) AS gc_time_ms,
+       sum(threads) AS threads,
+       sum(open_scanners) AS open_scanners,
+       min(reported_at) AS oldest_report
+FROM scalardb_fdw_jvm_stats_all();
+
+-- Start a Java Flight Recorder recording of the JVM of the backend with the
+-- given pid, or of this backend if pid is NULL, and return the file under the
+-- data directory the recording is written to when it is stopped. Other
+-- backends require scalardb_fdw in shared_preload_libraries, and they handle
+-- the request asynchronously when they next use a foreign table.
+CREATE FUNCTION scalardb_fdw_start_flight_recording(
+    pid integer DEFAULT NULL,
+    settings text DEFAULT 'profile')
+RETURNS text
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+REVOKE ALL ON FUNCTION scalardb_fdw_start_flight_recording(integer, text) FROM PUBLIC;
+
+-- Stop the recording and return the file it is written to. For another
+-- backend, the file of the last recording requested of it is returned without
+-- waiting for the backend to stop the recording.
+CREATE FUNCTION scalardb_fdw_stop_flight_recording(pid integer DEFAULT NULL)
+RETURNS text
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+REVOKE ALL ON FUNCTION scalardb_fdw_stop_flight_recording(integer) FROM PUBLIC;
@@ -17,13 +17,19 @@
 #include "lib/stringinfo.h"
 #include "postgres.h"
 
+#include "access/parallel.h"
 #include "access/reloptions.h"
+#include "access/sysattr.h"
 #include "access/table.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_collation_d.h"
 #include "catalog/pg_type_d.h"
 #include "commands/explain.h"
+#include "commands/vacuum.h"
 #include "fmgr.h"
 #include "foreign/fdwapi.h"
 #include "funcapi.h"
+#include "miscadmin.h"
 #include "nodes/pathnodes.h"
 #include "nodes/nodes.h"
 #include "nodes/pg_list.h"
@@ -31,26 +37,75 @@
 #include "nodes/value.h"
 #include "nodes/execnodes.h"
 #include "nodes/nodeFuncs.h"
+#include "optimizer/clauses.h"
 #include "optimizer/cost.h"
 #include "optimizer/optimizer.h"
 #include "optimizer/pathnode.h"
+#include "optimizer/paths.h"
 #include "optimizer/planmain.h"
+#include "optimizer/restrictinfo.h"
+#include "optimizer/tlist.h"
 #include "parser/parsetree.h"
 #include "parser/parse_node.h"
+#include "port/atomics.h"
+#include "portability/instr_time.h"
+#include "storage/shm_toc.h"
+#include "utils/acl.h"
+#include "utils/array.h"
 #include "utils/palloc.h"
 #include "utils/rel.h"
 #include "utils/lsyscache.h"
+#include "utils/datum.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/ruleutils.h"
+#include "utils/sampling.h"
+#include "utils/typcache.h"
+#include "utils/tuplestore.h"
 
 #include "scalardb_fdw.h"
 #include "scalardb.h"
+#include "aggregate.h"
 #include "column_metadata.h"
 #include "condition.h"
 #include "option.h"
 #include "cost.h"
+#include "flight_recorder.h"
+#include "jvm_stats.h"
+#include "materialize.h"
+#include "partition_stats.h"
 #include "pathkeys.h"
+#include "prefilter.h"
+#include "result_cache.h"
 
 PG_MODULE_MAGIC;
 
+/* Minimum duration in milliseconds of the remote scans to be logged */
+static int log_min_duration = -1;
+
+/*
+ * Local conditions of the scan evaluated on the columns they refer to before
+ * the other columns of each result are retrieved.
+ */
+typedef struct {
+	/* Integer list of attribute numbers referred to by the conditions */
+	List *attrs;
+	/* Conditions taken over from the executor and their expressions */
+	ExprState *qual;
+	List *clauses;
+	ExprContext *econtext;
+	/* Virtual slot that holds the columns the conditions refer to */
+	TupleTableSlot *slot;
+} ScalarDbFdwLateFilter;
+
+/*
+ * State of a parallel Scan (all) shared by the processes in the DSM segment
+ */
+typedef struct {
+	/* Index of the next range to be read */
+	pg_atomic_uint32 next_split;
+} ScalarDbFdwSplitState;
+
 /*
  * FDW-specific information for ForeignScanState.fdw_state.
  */
@@ -69,6 +124,14 @@ typedef struct {
 	int boundary_end_inclusive;
 	List *sort_column_names;
 	List *sort_orders;
+	List *aggregate_types;
+	List *aggregate_column_names;
+	List *aggregate_sort_column_names;
+	List *aggregate_sort_orders;
+	List *filter_column_names;
+	int filter_expr_offset;
+	bool is_parameterized;
+	List *prefilter_list;
 
 	/* List of retrieved attribute names, coverted from attrs_to_retrieve */
 	List *attnames;
@@ -77,24 +140,107 @@ typedef struct {
 	/* attribute datatype conversion metadata */
 	AttInMetadata *attinmeta;
 
+	/* Expressions for the conditions and their states */
+	List *fdw_exprs;
+	List *fdw_expr_states;
+
 	/* Array of Conditions for ScalarDB Scan */
 	ScalarDbFdwScanCondition *scan_conds;
 	/* number of conditions in scan_conds */
 	size_t num_scan_conds;
 	/* Clusteirng key boundary for ScalarDB Scan */
 	ScalarDbFdwScanBoundary *boundary;
+	/* Array of local conditions evaluated before forming tuples */
+	ScalarDbFdwPrefilter *prefilters;
+	/* number of conditions in prefilters */
+	int num_prefilters;
+	/* Local conditions evaluated before the other columns are retrieved */
+	ScalarDbFdwLateFilter *late_filter;
+	/*
+	 * Dictionaries of the retrieved TEXT columns indexed by attribute
+	 * number - 1. NULL for the other columns.
+	 */
+	ScalarDbTextDictionary **text_dictionaries;
+	/*
+	 * Expression context whose per-tuple memory holds the values of each
+	 * result while the local conditions are evaluated. NULL if there are no
+	 * such conditions.
+	 */
+	ExprContext *result_econtext;
+	/* Array of Conditions to filter the records of Scan on the ScalarDB side */
+	ScalarDbFdwScanCondition *filter_conds;
+	/* number of conditions in filter_conds */
+	size_t num_filter_conds;
+	/* Memory context of the conditions, replaced when they are evaluated */
+	MemoryContext conds_cxt;
+	/* Whether the parameters have changed since the conditions were evaluated */
+	bool params_changed;
+
+	/*
+	 * Boundaries that split Scan (all) into ranges. If the scan is parallel
+	 * aware, each process claims the ranges one by one from split_state, or
+	 * from next_split without parallel workers. Otherwise, the ranges are
+	 * merged into one Scan.
+	 */
+	int64 *split_boundaries;
+	int num_split_boundaries;
+	bool parallel_aware;
+	ScalarDbFdwSplitState *split_state;
+	int next_split;
 
 	/* Java instance of com.scalar.db.api.Scan.*/
 	jobject scan;
 	/* Java instance of com.scalar.db.api.Scanner */
 	jobject scanner;
+
+	/* Whether the tuple of the aggregates has been returned */
+	bool aggregates_returned;
+
+	/* Key of the results in the result cache. NULL if they are not cached */
+	char *cache_key;
+	/* Results read from the result cache and the offset of the next one */
+	char *cached_results;
+	Size cached_results_len;
+	Size cached_results_pos;
+	/* Tuple returned from cached_results */
+	HeapTupleData cached_tuple;
+	/* Results of the Scan to be cached. NULL if they are too large */
+	StringInfo results_to_cache;
+
+	/*
+	 * Tuples fetched by the Scan, which are replayed on rescans with the
+	 * same conditions. NULL if rescans are not expected.
+	 */
+	Tuplestorestate *rescan_tuples;
+	/* Whether rescan_tuples holds all tuples of the Scan */
+	bool rescan_tuples_complete;
+	/* Whether the tuples are being replayed from rescan_tuples */
+	bool replaying;
+	/* Slot to read the tuples from rescan_tuples */
+	TupleTableSlot *rescan_slot;
+
+	/*
+	 * Statistics of the remote scan to be logged by log_min_duration, which
+	 * are collected only if log_scan is true. The remote time is spent
+	 * waiting for ScalarDB, and the decode time converting the results into
+	 * tuples.
+	 */
+	bool log_scan;
+	instr_time remote_time;
+	instr_time decode_time;
+	uint64 rows_fetched;
+	uint64 bytes_fetched;
 } ScalarDbFdwScanState;
 
 enum ScanFdwPathPrivateIndex {
 	/* List of String that contains column names to be used to sort the foreign relation */
 	ScanFdwPathPrivateSortColumnNames,
 	/* List of ScalarDbFdwClusteringKeyOrder to sort the foreign relation */
-	ScanFdwPathPrivateSortOrders
+	ScanFdwPathPrivateSortOrders,
+	/* List of RestrictInfo of the secondary index condition used for Scan */
+	ScanFdwPathPrivateIndexConds,
+	/* List of RestrictInfo of the conditions evaluated on the ScalarDB side to filter the records */
+	ScanFdwPathPrivateFilterConds
 };
 
 enum ScanFdwPrivateIndex {
@@ -119,7 +265,25 @@ enum ScanFdwPrivateIndex {
 	/* List of String that contains column names to be used to srot the foreign relation */
 	ScanFdwPrivateSortColumnNames,
 	/* List of ScalarDbFdwClusteringKeyOrder to sort the foreign relation */
-	ScanFdwPrivateSortOrders
+	ScanFdwPrivateSortOrders,
+	/* Integer list of ScalarDbFdwAggregateType computed on the ScalarDB side */
+	ScanFdwPrivateAggregateTypes,
+	/* List of String that contains the column name used by each aggregate */
+	ScanFdwPrivateAggregateColumnNames,
+	/* List of List of String that contains column names to sort the scan of each aggregate */
+	ScanFdwPrivateAggregateSortColumnNames,
+	/* List of List of ScalarDbFdwClusteringKeyOrder to sort the scan of each aggregate */
+	ScanFdwPrivateAggregateSortOrders,
+	/* List of String that contains column names of the conditions filtered on the ScalarDB side */
+	ScanFdwPrivateFilterColumnNames,
+	/* Index offset in fdw_exprs where the expressions for filter conditions start */
+	ScanFdwPrivateFilterExprOffset,
+	/* Boolean indicates whether fdw_exprs refer to parameters supplied by the outer relation */
+	ScanFdwPrivateIsParameterized,
+	/* List of local conditions evaluated before forming tuples. See extract_prefilters */
+	ScanFdwPrivatePrefilters,
+	/* List of Const of int8 that holds the boundaries that split Scan (all) */
+	ScanFdwPrivateSplitBoundaries
 };
 
 static void get_target_list(PlannerInfo *root, RelOptInfo *baserel,
@@ -132,7 +296,72 @@ static Datum convert_result_column_to_datum(jobject result, char *attname,
 					    Oid atttypid);
 
 static HeapTuple make_tuple_from_result(jobject result, Relation rel,
-					List *attrs_to_retrieve);
+					List *attrs_to_retrieve,
+					ScalarDbFdwPrefilter *prefilters,
+					int num_prefilters,
+					ScalarDbFdwLateFilter *late_filter,
+					ScalarDbTextDictionary **dictionaries);
+static void retrieve_result_column(jobject result, TupleDesc tupdesc,
+				   int attnum,
+				   ScalarDbTextDictionary **dictionaries,
+				   Datum *values, bool *nulls);
+static ScalarDbTextDictionary **make_text_dictionaries(TupleDesc tupdesc,
+						       List *attrs_to_retrieve);
+static ScalarDbFdwLateFilter *make_late_filter(ForeignScanState *node,
+					       List *attrs_to_retrieve);
+static bool contain_param_walker(Node *node, void *context);
+static bool contain_exec_param_walker(Node *node, void *context);
+static bool evaluate_late_filter(ScalarDbFdwLateFilter *late_filter,
+				 Datum *values, bool *nulls, int natts);
+
+static int scalardb_acquire_sample_rows(Relation relation, int elevel,
+					HeapTuple *rows, int targrows,
+					double *totalrows,
+					double *totaldeadrows);
+
+static void add_secondary_index_paths(PlannerInfo *root, RelOptInfo *baserel);
+
+static void add_parameterized_paths(PlannerInfo *root, RelOptInfo *baserel);
+
+static List *get_split_boundaries(ScalarDbFdwPlanState *fdw_private);
+static void add_partial_split_path(PlannerInfo *root, RelOptInfo *baserel,
+				   double rows, Cost startup_cost,
+				   Cost total_cost);
+
+static bool ec_member_matches_key(PlannerInfo *root, RelOptInfo *rel,
+				  EquivalenceClass *ec, EquivalenceMember *em,
+				  void *arg);
+
+static bool evaluate_scan_conds(ScalarDbFdwScanState *fdw_state,
+				ExprContext *econtext);
+static void prepare_scan(ScalarDbFdwScanState *fdw_state,
+			 ExprContext *econtext);
+
+static jobject build_scan(ScalarDbFdwScanState *fdw_state, List *attnames,
+			  List *sort_column_names, List *sort_orders, int limit);
+static jobject build_partition_key_scans(ScalarDbFdwScanState *fdw_state,
+					 List *attnames,
+					 List *sort_column_names,
+					 List *sort_orders, int limit);
+static int sort_unique_values(Datum *values, int num_values, Oid type);
+static int compare_values(const void *a, const void *b, void *arg);
+
+static jobject start_scan(ScalarDbFdwScanState *fdw_state);
+static jobject start_scan_of(ScalarDbFdwScanState *fdw_state, jobject scan);
+static jobject start_next_split(ScalarDbFdwScanState *fdw_state);
+static void reset_scan_stats(ScalarDbFdwScanState *fdw_state);
+static void accumulate_time(instr_time *total, instr_time *start);
+static void close_scanner(ScalarDbFdwScanState *fdw_state);
+static void log_scan_if_slow(ScalarDbFdwScanState *fdw_state);
+
+static char *make_result_cache_key(ScalarDbFdwScanState *fdw_state);
+static void append_result_to_cache(ScalarDbFdwScanState *fdw_state,
+				   HeapTuple tuple);
+static TupleTableSlot *next_cached_result(ScalarDbFdwScanState *fdw_state,
+					  TupleTableSlot *slot);
+
+static HeapTuple make_tuple_from_aggregates(ScalarDbFdwScanState *fdw_state,
+					    TupleDesc tupdesc);
 
 static ScalarDbFdwScanCondition *
 prepare_scan_conds(ExprContext *econtext, List *fdw_expr, List *fdw_expr_states,
@@ -141,12 +370,27 @@ static ScalarDbFdwScanBoundary *prepare_scan_boundary(
 	ExprContext *econtext, List *fdw_expr, List *fdw_expr_states,
 	List *column_names, size_t start_expr_offset, bool start_inclusive,
 	size_t end_expr_offset, bool end_inclusive, List *is_equals);
+static Datum copy_cond_value(Datum value, Oid value_type);
+static bool cond_value_equal(Datum value1, Datum value2, Oid value_type);
+static bool scan_conds_equal(ScalarDbFdwScanCondition *conds1,
+			     ScalarDbFdwScanCondition *conds2,
+			     size_t num_conds);
+static bool scan_boundaries_equal(ScalarDbFdwScanBoundary *boundary1,
+				  ScalarDbFdwScanBoundary *boundary2);
 
 static char *scan_conds_to_string(ScalarDbFdwScanCondition *scan_conds,
 				  size_t num_conds);
 static char *scan_start_boundary_to_string(ScalarDbFdwScanBoundary *boundary);
 static char *scan_end_boundary_to_string(ScalarDbFdwScanBoundary *boundary);
 static char *sort_to_string(List *sort_column_names, List *sort_orders);
+static char *scan_type_to_string(ScalarDbFdwScanType scan_type);
+static char *bound_keys_to_string(ScalarDbFdwScanState *fdw_state);
+static char *aggregates_to_string(List *aggregate_types,
+				  List *aggregate_column_names);
+static void explain_parameterized_conds(ForeignScanState *node,
+					ExplainState *es);
+static void append_deparsed_cond(StringInfo str, char *name, char *op,
+				 Expr *expr, List *context);
 
 /*
  * FDW callback routines
@@ -173,10 +417,50 @@ static void scalardbEndForeignScan(ForeignScanState *node);
 static void scalardbExplainForeignScan(ForeignScanState *node,
 				       ExplainState *es);
 
+static void scalardbGetForeignUpperPaths(PlannerInfo *root,
+					 UpperRelationKind stage,
+					 RelOptInfo *input_rel,
+					 RelOptInfo *output_rel, void *extra);
+
 static bool scalardbAnalyzeForeignTable(Relation relation,
 					AcquireSampleRowsFunc *func,
 					BlockNumber *totalpages);
 
+static bool scalardbIsForeignScanParallelSafe(PlannerInfo *root,
+					      RelOptInfo *rel,
+					      RangeTblEntry *rte);
+static Size scalardbEstimateDSMForeignScan(ForeignScanState *node,
+					   ParallelContext *pcxt);
+static void scalardbInitializeDSMForeignScan(ForeignScanState *node,
+					     ParallelContext *pcxt,
+					     void *coordinate);
+static void scalardbReInitializeDSMForeignScan(ForeignScanState *node,
+					       ParallelContext *pcxt,
+					       void *coordinate);
+static void scalardbInitializeWorkerForeignScan(ForeignScanState *node,
+						shm_toc *toc,
+						void *coordinate);
+
+void _PG_init(void);
+
+/*
+ * Module load callback
+ */
+void _PG_init(void)
+{
+	DefineCustomIntVariable(
+		"scalardb_fdw.log_min_duration",
+		"Sets the minimum execution time above which the remote scans of ScalarDB are logged.",
+		"The execution time is the time spent waiting for ScalarDB and converting the results. Zero logs all the scans, and -1 disables logging.",
+		&log_min_duration, -1, -1, INT_MAX, PGC_SUSET, GUC_UNIT_MS,
+		NULL, NULL, NULL);
+
+	init_materialize();
+	init_result_cache();
+	init_jvm_stats();
+	init_flight_recorder();
+}
+
 PG_FUNCTION_INFO_V1(scalardb_fdw_handler);
 
 Datum scalardb_fdw_handler(PG_FUNCTION_ARGS)
@@ -195,8 +479,20 @@ Datum scalardb_fdw_handler(PG_FUNCTION_ARGS)
 	/* Support functions for EXPLAIN */
 	routine->ExplainForeignScan = scalardbExplainForeignScan;
 
+	/* Support functions for upper relation push-down */
+	routine->GetForeignUpperPaths = scalardbGetForeignUpperPaths;
+
 	/* Support functions for ANALYZE */
 	routine->AnalyzeForeignTable = scalardbAnalyzeForeignTable;
+
+	/* Support functions for parallel Scan (all) */
+	routine->IsForeignScanParallelSafe = scalardbIsForeignScanParallelSafe;
+	routine->EstimateDSMForeignScan = scalardbEstimateDSMForeignScan;
+	routine->InitializeDSMForeignScan = scalardbInitializeDSMForeignScan;
+	routine->ReInitializeDSMForeignScan =
+		scalardbReInitializeDSMForeignScan;
+	routine->InitializeWorkerForeignScan =
+		scalardbInitializeWorkerForeignScan;
 	PG_RETURN_POINTER(routine);
 }
 
@@ -218,10 +514,82 @@ static void scalardbGetForeignRelSize(PlannerInfo *root, RelOptInfo *baserel,
 			    fdw_private->options.table_name,
 			    &fdw_private->column_metadata);
 
+	/*
+	 * The values of the secondary indexes of a transaction-aware table may be
+	 * the ones written by in-flight transactions, so the index scans could
+	 * miss the committed records. Treat the indexed columns as regular ones.
+	 */
+	if (fdw_private->options.transaction_aware) {
+		fdw_private->column_metadata.secondary_index_names = NIL;
+		fdw_private->column_metadata.secondary_index_attnums = NIL;
+	}
+
+	fdw_private->can_order_scan_all =
+		scalardb_can_order_scan_all(fdw_private->options.namespace);
+
+	get_scan_costs(scalardb_get_storage(fdw_private->options.namespace),
+		       &fdw_private->options, &fdw_private->scan_costs);
+
+	/* 
+	 * Separate baserestrictinfo into three groups:
+	 * 1. remote_conds: conditions that will be pushed down to ScalarDB
+	 * 2. local_conds: conditions that will be evaluated locally
+	 * 3. boundary: conditions that will be pushed down to ScalarDB to used to determine
+	 *              clustering key boudnary.
+	 */
+	determine_remote_conds(baserel, baserel->baserestrictinfo,
+			       &fdw_private->column_metadata,
+			       &fdw_private->remote_conds,
+			       &fdw_private->local_conds,
+			       &fdw_private->boundary, &fdw_private->scan_type,
+			       &fdw_private->secondary_index_conds);
+
 	/* Estimate relation size */
 	estimate_size(root, baserel);
 }
 
+/*
+ * Return the boundaries that split Scan (all) of the table into at most
+ * scan_all_splits ranges as a List of Const of int8, or NIL if the Scan cannot
+ * be split. The boundaries are taken from the current values of the table, so
+ * they are computed when planned and kept in the plan, which makes all the
+ * processes of a parallel scan read the same ranges.
+ *
+ * Taking the boundaries runs a query of the minimum and maximum values on the
+ * storage, so they are computed only when a path or plan that splits the Scan
+ * is made, and cached in fdw_private.
+ */
+static List *get_split_boundaries(ScalarDbFdwPlanState *fdw_private)
+{
+	ScalarDbFdwOptions *options = &fdw_private->options;
+	int64 *boundaries;
+	int num_boundaries;
+	List *ret = NIL;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (fdw_private->split_boundaries_computed)
+		return fdw_private->split_boundaries;
+	fdw_private->split_boundaries_computed = true;
+
+	if (fdw_private->scan_type != SCALARDB_SCAN_ALL ||
+	    options->scan_all_splits <= 1)
+		return NIL;
+
+	boundaries = scalardb_get_scan_all_split_boundaries(
+		options->namespace, options->table_name,
+		options->scan_all_splits, &num_boundaries);
+	for (int i = 0; i < num_boundaries; i++)
+		ret = lappend(ret, makeConst(INT8OID, -1, InvalidOid,
+					     sizeof(int64),
+					     Int64GetDatum(boundaries[i]),
+					     false, FLOAT8PASSBYVAL));
+	pfree(boundaries);
+
+	fdw_private->split_boundaries = ret;
+	return ret;
+}
+
 /*
  * scalardbGetForeignPaths
  *		Create possible access paths for a scan on the foreign table
@@ -240,19 +608,6 @@ static void scalardbGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel,
 
 	ereport(DEBUG3, errmsg("entering function %s", __func__));
 
-	/* 
-	 * Separate baserestrictinfo into three groups:
-	 * 1. remote_conds: conditions that will be pushed down to ScalarDB
-	 * 2. local_conds: conditions that will be evaluated locally
-	 * 3. boundary: conditions that will be pushed down to ScalarDB to used to determine
-	 *              clustering key boudnary.
-	 */
-	determine_remote_conds(baserel, baserel->baserestrictinfo,
-			       &fdw_private->column_metadata,
-			       &fdw_private->remote_conds,
-			       &fdw_private->local_conds,
-			       &fdw_private->boundary, &fdw_private->scan_type);
-
 	/*
 	 * Identify which attributes will need to be retrieved from the remote
 	 * server. These include all attrs needed for attrs used in the local_conds.
@@ -268,6 +623,28 @@ static void scalardbGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel,
 			       &fdw_private->attrs_used);
 	}
 
+	/*
+	 * Any of the secondary index conditions can be evaluated locally,
+	 * depending on the index chosen for the path.
+	 */
+	foreach(lc, fdw_private->secondary_index_conds) {
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+
+		pull_varattnos((Node *)rinfo->clause, baserel->relid,
+			       &fdw_private->attrs_used);
+	}
+
+	/*
+	 * Add paths that push down join clauses as parameters supplied by the
+	 * outer relation of a nested loop.
+	 */
+	add_parameterized_paths(root, baserel);
+
+	if (fdw_private->scan_type == SCALARDB_SCAN_SECONDARY_INDEX) {
+		add_secondary_index_paths(root, baserel);
+		return;
+	}
+
 	/* Estimate costs */
 	estimate_costs(root, baserel, fdw_private->remote_conds, &rows,
 		       &startup_cost, &total_cost);
@@ -285,11 +662,70 @@ static void scalardbGetForeignPaths(PlannerInfo *root, RelOptInfo *baserel,
 				       NIL); /* no fdw_private */
 	add_path(baserel, (Path *)path);
 
-	/* Sorting is supported only for partition key scan */
-	if (fdw_private->scan_type == SCALARDB_SCAN_PARTITION_KEY) {
-		add_paths_with_pathkeys_for_rel(root, baserel,
-						&fdw_private->column_metadata);
+	/*
+	 * Add a partial path whose ranges of Scan (all) are shared among
+	 * parallel workers.
+	 */
+	if (baserel->consider_parallel && baserel->lateral_relids == NULL &&
+	    max_parallel_workers_per_gather > 0 &&
+	    get_split_boundaries(fdw_private) != NIL)
+		add_partial_split_path(root, baserel, rows, startup_cost,
+				       total_cost);
+
+	/*
+	 * Add paths sorted on the ScalarDB side. Whether sorting can be pushed
+	 * down depends on the scan type and the storage.
+	 */
+	add_paths_with_pathkeys_for_rel(root, baserel,
+					&fdw_private->column_metadata);
+}
+
+/*
+ * Add a parallel-aware path of Scan (all) split by split_boundaries. Each
+ * participant of the parallel scan claims the next range that no one has read
+ * yet, so the work is divided in the same way as the core divides that of a
+ * parallel sequential scan.
+ */
+static void add_partial_split_path(PlannerInfo *root, RelOptInfo *baserel,
+				   double rows, Cost startup_cost,
+				   Cost total_cost)
+{
+	ScalarDbFdwPlanState *fdw_private =
+		(ScalarDbFdwPlanState *)baserel->fdw_private;
+	ForeignPath *path;
+	int num_splits = list_length(fdw_private->split_boundaries) + 1;
+	int parallel_workers;
+	double divisor;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	parallel_workers = Min(num_splits - 1, max_parallel_workers_per_gather);
+	if (parallel_workers <= 0)
+		return;
+
+	/* Same as get_parallel_divisor() in costsize.c */
+	divisor = parallel_workers;
+	if (parallel_leader_participation) {
+		double leader_contribution = 1.0 - (0.3 * parallel_workers);
+
+		if (leader_contribution > 0)
+			divisor += leader_contribution;
 	}
+
+	path = create_foreignscan_path(root, baserel,
+				       NULL, /* default pathtarget */
+				       clamp_row_est(rows / divisor),
+				       startup_cost,
+				       startup_cost +
+					       (total_cost - startup_cost) /
+						       divisor,
+				       NIL, /* no pathkeys */
+				       NULL, /* no required_outer */
+				       NULL, /* no extra plan */
+				       NIL); /* no fdw_private */
+	path->path.parallel_aware = true;
+	path->path.parallel_workers = parallel_workers;
+	add_partial_path(baserel, (Path *)path);
 }
 
 static ForeignScan *scalardbGetForeignPlan(PlannerInfo *root,
@@ -299,12 +735,17 @@ static ForeignScan *scalardbGetForeignPlan(PlannerInfo *root,
 					   List *scan_clauses, Plan *outer_plan)
 {
 	ScalarDbFdwPlanState *fdw_private;
+	RelOptInfo *scanrel;
+	Index scan_relid;
 	ListCell *lc;
 	List *attrs_to_retrieve = NIL;
+	List *fdw_scan_tlist = NIL;
 
 	List *remote_exprs = NIL;
 	List *local_exprs = NIL;
+	List *local_rinfos = NIL;
 	List *fdw_recheck_quals = NIL;
+	List *prefilters = NIL;
 
 	List *fdw_private_for_scan = NIL;
 
@@ -314,9 +755,85 @@ static ForeignScan *scalardbGetForeignPlan(PlannerInfo *root,
 	List *sort_column_names = NIL;
 	List *sort_orders = NIL;
 
+	List *aggregate_types = NIL;
+	List *aggregate_column_names = NIL;
+	List *aggregate_sort_column_names = NIL;
+	List *aggregate_sort_orders = NIL;
+
+	List *remote_conds;
+	List *filter_conds = NIL;
+	List *filter_column_names = NIL;
+	int filter_expr_offset;
+	ScalarDbFdwScanType scan_type;
+	ScalarDbFdwClusteringKeyBoundary *boundary;
+	bool is_parameterized;
+
 	ereport(DEBUG3, errmsg("entering function %s", __func__));
 
 	fdw_private = (ScalarDbFdwPlanState *)baserel->fdw_private;
+	remote_conds = fdw_private->remote_conds;
+	scan_type = fdw_private->scan_type;
+	boundary = &fdw_private->boundary;
+
+	if (IS_UPPER_REL(baserel)) {
+		/*
+		 * The aggregates are computed over the scan of the input
+		 * relation, all of whose conditions are pushed down (see
+		 * add_foreign_grouping_paths). The output of the scan is the
+		 * aggregates themselves.
+		 */
+		scanrel = fdw_private->input_rel;
+		scan_clauses = scanrel->baserestrictinfo;
+		scan_relid = 0;
+		fdw_scan_tlist = add_to_flat_tlist(NIL, baserel->reltarget->exprs);
+
+		aggregate_types =
+			(List *)list_nth(best_path->fdw_private,
+					 ScanFdwUpperPathPrivateAggregateTypes);
+		aggregate_column_names = (List *)list_nth(
+			best_path->fdw_private,
+			ScanFdwUpperPathPrivateAggregateColumnNames);
+		aggregate_sort_column_names = (List *)list_nth(
+			best_path->fdw_private,
+			ScanFdwUpperPathPrivateAggregateSortColumnNames);
+		aggregate_sort_orders = (List *)list_nth(
+			best_path->fdw_private,
+			ScanFdwUpperPathPrivateAggregateSortOrders);
+	} else {
+		scanrel = baserel;
+		scan_relid = baserel->relid;
+
+		if (best_path->path.param_info) {
+			/*
+			 * The conditions are determined again with the join
+			 * clauses of the parameterization in the same way as
+			 * add_parameterized_paths.
+			 */
+			List *local_conds = NIL;
+			List *secondary_index_conds = NIL;
+
+			remote_conds = NIL;
+			boundary = palloc0(
+				sizeof(ScalarDbFdwClusteringKeyBoundary));
+			determine_remote_conds(
+				baserel,
+				list_concat_copy(
+					best_path->path.param_info->ppi_clauses,
+					baserel->baserestrictinfo),
+				&fdw_private->column_metadata, &remote_conds,
+				&local_conds, boundary, &scan_type,
+				&secondary_index_conds);
+		} else if (list_length(best_path->fdw_private) >
+			   ScanFdwPathPrivateIndexConds) {
+			/* The secondary index condition is chosen for each path */
+			remote_conds = (List *)list_nth(
+				best_path->fdw_private,
+				ScanFdwPathPrivateIndexConds);
+			filter_conds = (List *)list_nth(
+				best_path->fdw_private,
+				ScanFdwPathPrivateFilterConds);
+		}
+	}
 
 	/*
 	 * In a base-relation scan, we must apply the given scan_clauses.
@@ -342,22 +859,22 @@ static ForeignScan *scalardbGetForeignPlan(PlannerInfo *root,
 		if (rinfo->pseudoconstant)
 			continue;
 
-		if (list_member_ptr(fdw_private->remote_conds, rinfo)) {
+		if (list_member_ptr(remote_conds, rinfo)) {
 			remote_exprs = lappend(remote_exprs, rinfo->clause);
 
-			split_condition_expr(baserel,
+			split_condition_expr(scanrel,
 					     &fdw_private->column_metadata,
 					     rinfo->clause, &left, &left_name,
 					     &right);
 			fdw_exprs = lappend(fdw_exprs, right);
 			condition_key_names =
 				lappend(condition_key_names, left_name);
-		} else if (list_member_ptr(fdw_private->boundary.conds,
-					   rinfo)) {
+		} else if (list_member_ptr(boundary->conds, rinfo)) {
 			remote_exprs = lappend(remote_exprs, rinfo->clause);
-		} else if (list_member_ptr(fdw_private->local_conds, rinfo))
+		} else if (list_member_ptr(fdw_private->local_conds, rinfo)) {
 			local_exprs = lappend(local_exprs, rinfo->clause);
-		else
+			local_rinfos = lappend(local_rinfos, rinfo);
+		} else
 			/* join clauses */
 			local_exprs = lappend(local_exprs, rinfo->clause);
 	}
@@ -366,38 +883,59 @@ static ForeignScan *scalardbGetForeignPlan(PlannerInfo *root,
 	 * For a base-relation scan, we have to support EPQ recheck, which
 	 * should recheck all the remote quals.
 	 */
-	fdw_recheck_quals = remote_exprs;
+	if (scan_relid > 0) {
+		fdw_recheck_quals = remote_exprs;
+
+		get_target_list(root, baserel, fdw_private->attrs_used,
+				&attrs_to_retrieve);
+
+		prefilters = extract_prefilters(baserel, local_rinfos);
+	}
+
+	/*
+	 * The conditions filtered on the ScalarDB side are still evaluated
+	 * locally, so they are not added to remote_exprs.
+	 */
+	filter_expr_offset = list_length(fdw_exprs);
+	foreach(lc, filter_conds) {
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		Var *left;
+		String *left_name;
+		Expr *right;
 
-	get_target_list(root, baserel, fdw_private->attrs_used,
-			&attrs_to_retrieve);
+		split_condition_expr(scanrel, &fdw_private->column_metadata,
+				     rinfo->clause, &left, &left_name, &right);
+		fdw_exprs = lappend(fdw_exprs, right);
+		filter_column_names = lappend(filter_column_names, left_name);
+	}
 
 	fdw_private_for_scan = list_make3(attrs_to_retrieve,
 					  condition_key_names,
-					  makeInteger(fdw_private->scan_type));
+					  makeInteger(scan_type));
 
 	/* 
 	 * Put information on the clustering key boudnary
 	*/
 	fdw_private_for_scan =
-		lappend(fdw_private_for_scan, fdw_private->boundary.names);
+		lappend(fdw_private_for_scan, boundary->names);
 	fdw_private_for_scan =
-		lappend(fdw_private_for_scan, fdw_private->boundary.is_equals);
+		lappend(fdw_private_for_scan, boundary->is_equals);
 
 	/* Start boundary */
 	fdw_private_for_scan = lappend(fdw_private_for_scan,
 				       makeInteger(list_length(fdw_exprs)));
-	fdw_exprs = list_concat(fdw_exprs, fdw_private->boundary.start_exprs);
+	fdw_exprs = list_concat(fdw_exprs, boundary->start_exprs);
 	fdw_private_for_scan =
 		lappend(fdw_private_for_scan,
-			makeBoolean(fdw_private->boundary.start_inclusive));
+			makeBoolean(boundary->start_inclusive));
 
 	/* End boudnary */
 	fdw_private_for_scan = lappend(fdw_private_for_scan,
 				       makeInteger(list_length(fdw_exprs)));
-	fdw_exprs = list_concat(fdw_exprs, fdw_private->boundary.end_exprs);
+	fdw_exprs = list_concat(fdw_exprs, boundary->end_exprs);
 	fdw_private_for_scan =
 		lappend(fdw_private_for_scan,
-			makeBoolean(fdw_private->boundary.end_inclusive));
+			makeBoolean(boundary->end_inclusive));
 	/*
 	 * Put information on the sorting pushed-down
 	 */
@@ -412,11 +950,55 @@ static ForeignScan *scalardbGetForeignPlan(PlannerInfo *root,
 	fdw_private_for_scan = lappend(fdw_private_for_scan, sort_column_names);
 	fdw_private_for_scan = lappend(fdw_private_for_scan, sort_orders);
 
+	/*
+	 * Put information on the aggregates pushed-down
+	 */
+	fdw_private_for_scan = lappend(fdw_private_for_scan, aggregate_types);
+	fdw_private_for_scan =
+		lappend(fdw_private_for_scan, aggregate_column_names);
+	fdw_private_for_scan =
+		lappend(fdw_private_for_scan, aggregate_sort_column_names);
+	fdw_private_for_scan =
+		lappend(fdw_private_for_scan, aggregate_sort_orders);
+
+	/*
+	 * Put information on the filter conditions
+	 */
+	fdw_private_for_scan =
+		lappend(fdw_private_for_scan, filter_column_names);
+	fdw_private_for_scan = lappend(fdw_private_for_scan,
+				       makeInteger(filter_expr_offset));
+
+	/*
+	 * The conditions change for each rescan if they refer to the outer
+	 * relation of a parameterized path, or to the parameters set by the
+	 * outer plan, e.g. of a correlated subquery, which a path that is not
+	 * parameterized can also have. The parameters of the query itself do
+	 * not change during the execution.
+	 */
+	is_parameterized = best_path->path.param_info != NULL ||
+			   contain_exec_param_walker((Node *)fdw_exprs, NULL);
+	fdw_private_for_scan =
+		lappend(fdw_private_for_scan, makeBoolean(is_parameterized));
+
+	fdw_private_for_scan = lappend(fdw_private_for_scan, prefilters);
+
+	/*
+	 * Split Scan (all) only for base relations. The aggregates are counted
+	 * over the whole table.
+	 */
+	fdw_private_for_scan = lappend(
+		fdw_private_for_scan,
+		scan_relid > 0 && scan_type == SCALARDB_SCAN_ALL &&
+				!is_parameterized ?
+			get_split_boundaries(fdw_private) :
+			NIL);
+
 	return make_foreignscan(
 		tlist, local_exprs,
-		baserel->relid, /* For base relations, set scan_relid as the relid of the relation. */
+		scan_relid, /* For base relations, set scan_relid as the relid of the relation. */
 		fdw_exprs, fdw_private_for_scan, /* private state */
-		NIL, /* no custom tlist */
+		fdw_scan_tlist, /* custom tlist only for aggregates */
 		fdw_recheck_quals, /* remote quals */
 		outer_plan);
 }
@@ -427,7 +1009,9 @@ static void scalardbBeginForeignScan(ForeignScanState *node, int eflags)
 	ForeignScan *fsplan;
 	RangeTblEntry *rte;
 	ScalarDbFdwScanState *fdw_state;
-	List *fdw_expr_states;
+	Index rtindex;
+	List *split_boundaries;
+	ListCell *lc;
 
 	ereport(DEBUG3, errmsg("entering function %s", __func__));
 
@@ -435,7 +1019,15 @@ static void scalardbBeginForeignScan(ForeignScanState *node, int eflags)
 
 	fsplan = (ForeignScan *)node->ss.ps.plan;
 
-	rte = rt_fetch(fsplan->scan.scanrelid, estate->es_range_table);
+	/*
+	 * For aggregates pushed down, scanrelid is 0 and the foreign table is
+	 * the only member of fs_relids.
+	 */
+	if (fsplan->scan.scanrelid > 0)
+		rtindex = fsplan->scan.scanrelid;
+	else
+		rtindex = bms_next_member(fsplan->fs_relids, -1);
+	rte = rt_fetch(rtindex, estate->es_range_table);
 
 	fdw_state =
 		(ScalarDbFdwScanState *)palloc0(sizeof(ScalarDbFdwScanState));
@@ -443,6 +1035,13 @@ static void scalardbBeginForeignScan(ForeignScanState *node, int eflags)
 
 	get_scalardb_fdw_options(rte->relid, &fdw_state->options);
 
+	/*
+	 * Parallel workers and cached plans do not go through the planner
+	 * functions of this backend.
+	 */
+	scalardb_initialize(&fdw_state->options);
+	process_flight_recording_request();
+
 	/* Get private info created by planner functions. */
 	fdw_state->attrs_to_retrieve = (List *)list_nth(
 		fsplan->fdw_private, ScanFdwPrivateAttrsToRetrieve);
@@ -477,121 +1076,610 @@ static void scalardbBeginForeignScan(ForeignScanState *node, int eflags)
 	fdw_state->sort_orders =
 		(List *)list_nth(fsplan->fdw_private, ScanFdwPrivateSortOrders);
 
-	/* Get info we'll need for input data conversion. */
-	fdw_state->rel = node->ss.ss_currentRelation;
-	fdw_state->attinmeta =
-		TupleDescGetAttInMetadata(RelationGetDescr(fdw_state->rel));
+	fdw_state->aggregate_types = (List *)list_nth(
+		fsplan->fdw_private, ScanFdwPrivateAggregateTypes);
+
+	fdw_state->aggregate_column_names = (List *)list_nth(
+		fsplan->fdw_private, ScanFdwPrivateAggregateColumnNames);
+
+	fdw_state->aggregate_sort_column_names = (List *)list_nth(
+		fsplan->fdw_private, ScanFdwPrivateAggregateSortColumnNames);
+
+	fdw_state->aggregate_sort_orders = (List *)list_nth(
+		fsplan->fdw_private, ScanFdwPrivateAggregateSortOrders);
 
-	get_attnames(fdw_state->attinmeta->tupdesc,
-		     fdw_state->attrs_to_retrieve, &fdw_state->attnames);
+	fdw_state->filter_column_names = (List *)list_nth(
+		fsplan->fdw_private, ScanFdwPrivateFilterColumnNames);
+
+	fdw_state->filter_expr_offset = intVal(
+		list_nth(fsplan->fdw_private, ScanFdwPrivateFilterExprOffset));
+
+	fdw_state->is_parameterized = boolVal(
+		list_nth(fsplan->fdw_private, ScanFdwPrivateIsParameterized));
+
+	fdw_state->prefilter_list = (List *)list_nth(fsplan->fdw_private,
+						     ScanFdwPrivatePrefilters);
+
+	split_boundaries = (List *)list_nth(fsplan->fdw_private,
+					    ScanFdwPrivateSplitBoundaries);
+	fdw_state->num_split_boundaries = list_length(split_boundaries);
+	if (fdw_state->num_split_boundaries > 0) {
+		int i = 0;
+
+		fdw_state->split_boundaries = (int64 *)palloc(
+			sizeof(int64) * fdw_state->num_split_boundaries);
+		foreach(lc, split_boundaries) {
+			fdw_state->split_boundaries[i++] =
+				DatumGetInt64(lfirst_node(Const, lc)->constvalue);
+		}
+	}
+	fdw_state->parallel_aware = node->ss.ps.plan->parallel_aware;
+
+	/*
+	 * Get info we'll need for input data conversion. There is no relation
+	 * to be scanned for aggregates.
+	 */
+	fdw_state->rel = node->ss.ss_currentRelation;
+	if (fdw_state->rel) {
+		fdw_state->attinmeta = TupleDescGetAttInMetadata(
+			RelationGetDescr(fdw_state->rel));
+
+		get_attnames(fdw_state->attinmeta->tupdesc,
+			     fdw_state->attrs_to_retrieve,
+			     &fdw_state->attnames);
+
+		fdw_state->prefilters = make_prefilters(
+			fdw_state->prefilter_list,
+			RelationGetDescr(fdw_state->rel),
+			&fdw_state->num_prefilters);
+
+		if (fdw_state->num_prefilters > 0 ||
+		    fdw_state->options.late_materialization)
+			fdw_state->result_econtext = CreateExprContext(estate);
+
+		if (fdw_state->options.late_materialization)
+			fdw_state->late_filter = make_late_filter(
+				node, fdw_state->attrs_to_retrieve);
+
+		fdw_state->text_dictionaries = make_text_dictionaries(
+			RelationGetDescr(fdw_state->rel),
+			fdw_state->attrs_to_retrieve);
+	}
 
 	/* Prepare conditions for Scan */
-	fdw_expr_states =
+	fdw_state->fdw_exprs = fsplan->fdw_exprs;
+	fdw_state->fdw_expr_states =
 		ExecInitExprList(fsplan->fdw_exprs, (PlanState *)node);
-	fdw_state->num_scan_conds = fdw_state->boundary_start_expr_offset;
-	fdw_state->scan_conds = prepare_scan_conds(
-		node->ss.ps.ps_ExprContext, fsplan->fdw_exprs, fdw_expr_states,
-		fdw_state->condition_key_names, fdw_state->num_scan_conds);
+	fdw_state->num_scan_conds = fdw_state->filter_expr_offset;
+	fdw_state->num_filter_conds = fdw_state->boundary_start_expr_offset -
+				      fdw_state->filter_expr_offset;
 
-	/* Instanciate Scan object of ScalarDb*/
-	switch (fdw_state->scan_type) {
-	case SCALARDB_SCAN_ALL:
-		fdw_state->scan = scalardb_scan_all(
-			fdw_state->options.namespace,
-			fdw_state->options.table_name, fdw_state->attnames);
-		break;
-	case SCALARDB_SCAN_PARTITION_KEY: {
-		fdw_state->boundary = prepare_scan_boundary(
-			node->ss.ps.ps_ExprContext, fsplan->fdw_exprs,
-			fdw_expr_states, fdw_state->boundary_column_names,
+	fdw_state->scanner = NULL;
+
+	/*
+	 * Keep the fetched tuples to replay them if rescans with the same
+	 * conditions are expected, e.g. for the inner side of a nested loop or
+	 * a correlated subquery.
+	 */
+	if (fdw_state->aggregate_types == NIL && !fdw_state->parallel_aware &&
+	    ((eflags & EXEC_FLAG_REWIND) || fdw_state->is_parameterized)) {
+		fdw_state->rescan_tuples =
+			tuplestore_begin_heap(false, false, work_mem);
+		fdw_state->rescan_slot = ExecInitExtraTupleSlot(
+			estate, node->ss.ss_ScanTupleSlot->tts_tupleDescriptor,
+			&TTSOpsMinimalTuple);
+	}
+
+	/*
+	 * The parameters supplied by the outer relation are not available until
+	 * the scan is iterated, so the Scan is prepared then.
+	 */
+	if (fdw_state->is_parameterized) {
+		fdw_state->params_changed = true;
+		return;
+	}
+
+	evaluate_scan_conds(fdw_state, node->ss.ps.ps_ExprContext);
+	prepare_scan(fdw_state, node->ss.ps.ps_ExprContext);
+}
+
+/*
+ * Evaluate the conditions of the Scan. The values are copied into a memory
+ * context that lives until the conditions are evaluated again, since the
+ * values of the parameters are owned by the outer plan.
+ *
+ * Returns false if the values are the same as the previous ones, in which
+ * case the previous conditions are kept.
+ */
+static bool evaluate_scan_conds(ScalarDbFdwScanState *fdw_state,
+				ExprContext *econtext)
+{
+	MemoryContext conds_cxt;
+	MemoryContext oldcontext;
+	ScalarDbFdwScanCondition *scan_conds;
+	ScalarDbFdwScanCondition *filter_conds = NULL;
+	ScalarDbFdwScanBoundary *boundary = NULL;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	conds_cxt = AllocSetContextCreate(econtext->ecxt_per_query_memory,
+					  "scalardb_fdw scan conditions",
+					  ALLOCSET_SMALL_SIZES);
+	oldcontext = MemoryContextSwitchTo(conds_cxt);
+
+	scan_conds = prepare_scan_conds(econtext, fdw_state->fdw_exprs,
+					fdw_state->fdw_expr_states,
+					fdw_state->condition_key_names,
+					fdw_state->num_scan_conds);
+
+	if (fdw_state->num_filter_conds > 0)
+		filter_conds = prepare_scan_conds(
+			econtext,
+			list_copy_tail(fdw_state->fdw_exprs,
+				       fdw_state->filter_expr_offset),
+			list_copy_tail(fdw_state->fdw_expr_states,
+				       fdw_state->filter_expr_offset),
+			fdw_state->filter_column_names,
+			fdw_state->num_filter_conds);
+
+	if (fdw_state->scan_type == SCALARDB_SCAN_PARTITION_KEY)
+		boundary = prepare_scan_boundary(
+			econtext, fdw_state->fdw_exprs,
+			fdw_state->fdw_expr_states,
+			fdw_state->boundary_column_names,
 			fdw_state->boundary_start_expr_offset,
 			fdw_state->boundary_start_inclusive,
 			fdw_state->boundary_end_expr_offset,
 			fdw_state->boundary_end_inclusive,
 			fdw_state->boundary_is_equals);
-		fdw_state->scan = scalardb_scan(
-			fdw_state->options.namespace,
-			fdw_state->options.table_name, fdw_state->attnames,
-			fdw_state->scan_conds, fdw_state->num_scan_conds,
-			fdw_state->boundary, fdw_state->sort_column_names,
-			fdw_state->sort_orders);
-		break;
-	}
-	case SCALARDB_SCAN_SECONDARY_INDEX:
-		fdw_state->scan = scalardb_scan_with_index(
-			fdw_state->options.namespace,
-			fdw_state->options.table_name, fdw_state->attnames,
-			fdw_state->scan_conds, fdw_state->num_scan_conds);
-		break;
-	}
 
-	ereport(DEBUG5, errmsg("ScalarDB Scan %s",
-			       scalardb_to_string(fdw_state->scan)));
+	MemoryContextSwitchTo(oldcontext);
 
-	fdw_state->scanner = NULL;
+	if (fdw_state->conds_cxt != NULL &&
+	    scan_conds_equal(scan_conds, fdw_state->scan_conds,
+			     fdw_state->num_scan_conds) &&
+	    scan_conds_equal(filter_conds, fdw_state->filter_conds,
+			     fdw_state->num_filter_conds) &&
+	    scan_boundaries_equal(boundary, fdw_state->boundary)) {
+		MemoryContextDelete(conds_cxt);
+		return false;
+	}
+
+	if (fdw_state->conds_cxt != NULL)
+		MemoryContextDelete(fdw_state->conds_cxt);
+	fdw_state->conds_cxt = conds_cxt;
+	fdw_state->scan_conds = scan_conds;
+	fdw_state->filter_conds = filter_conds;
+	fdw_state->boundary = boundary;
+	return true;
 }
 
-static TupleTableSlot *scalardbIterateForeignScan(ForeignScanState *node)
+/*
+ * Build the Scan with the evaluated conditions.
+ */
+static void prepare_scan(ScalarDbFdwScanState *fdw_state, ExprContext *econtext)
 {
-	ScalarDbFdwScanState *fdw_state;
-	TupleTableSlot *slot;
-	jobject result_optional;
-	jobject result;
-	HeapTuple tuple;
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
 
-	ereport(DEBUG4, errmsg("entering function %s", __func__));
+	/* Scans for aggregates are built for each aggregate when iterated */
+	if (fdw_state->aggregate_types != NIL)
+		return;
 
-	fdw_state = (ScalarDbFdwScanState *)node->fdw_state;
-	slot = node->ss.ss_ScanTupleSlot;
+	/* Instanciate Scan object of ScalarDb*/
+	fdw_state->scan = build_scan(fdw_state, fdw_state->attnames,
+				     fdw_state->sort_column_names,
+				     fdw_state->sort_orders, 0);
 
-	if (!fdw_state->scanner) {
-		fdw_state->scanner = scalardb_start_scan(fdw_state->scan);
+	/*
+	 * Without the workers of a parallel scan, the ranges of the split Scan
+	 * (all) are read concurrently as a merged scan.
+	 */
+	if (fdw_state->num_split_boundaries > 0 && !fdw_state->parallel_aware) {
+		jobject split_scans = scalardb_split_scan_all(
+			fdw_state->scan, fdw_state->split_boundaries,
+			fdw_state->num_split_boundaries, -1);
+
+		scalardb_release_scan(fdw_state->scan);
+		fdw_state->scan = split_scans;
 	}
 
-	result_optional = scalardb_scanner_one(fdw_state->scanner);
+	ereport(DEBUG5, errmsg("ScalarDB Scan %s",
+			       scalardb_to_string(fdw_state->scan)));
 
-	if (!scalardb_optional_is_present(result_optional)) {
-		return ExecClearTuple(slot);
+	/* Only the results of partition key scans are cached */
+	fdw_state->cache_key = NULL;
+	if (fdw_state->options.result_cache_ttl > 0 &&
+	    fdw_state->scan_type == SCALARDB_SCAN_PARTITION_KEY &&
+	    get_result_cache_max_entry_size() > 0) {
+		MemoryContext oldcontext = MemoryContextSwitchTo(
+			econtext->ecxt_per_query_memory);
+
+		fdw_state->cache_key = make_result_cache_key(fdw_state);
+		MemoryContextSwitchTo(oldcontext);
 	}
+}
 
-	result = scalardb_optional_get(result_optional);
-	tuple = make_tuple_from_result(result, fdw_state->rel,
-				       fdw_state->attrs_to_retrieve);
+/*
+ * Make the key that identifies the results of the Scan in the result cache.
+ * The text of the Scan contains the projections, the partition key, the
+ * clustering key boundary, the orderings and the limit. The local conditions
+ * evaluated before forming tuples are also part of the key, and so is the
+ * configuration of ScalarDB, which ALTER SERVER can change. The cached tuples
+ * are formed with the tuple descriptor of the foreign table, so the type of
+ * each attribute is also part of the key, and the results cached before ALTER
+ * FOREIGN TABLE changes the columns are never read.
+ */
+static char *make_result_cache_key(ScalarDbFdwScanState *fdw_state)
+{
+	TupleDesc tupdesc = RelationGetDescr(fdw_state->rel);
+	StringInfoData key;
+
+	initStringInfo(&key);
+	appendStringInfo(&key, "%s %s %s %g %d %s %s",
+			 fdw_state->options.config_file_path,
+			 scalardb_to_string(fdw_state->scan),
+			 scan_conds_to_string(fdw_state->filter_conds,
+					      fdw_state->num_filter_conds),
+			 fdw_state->options.sample_percent,
+			 fdw_state->options.transaction_aware,
+			 nodeToString(fdw_state->prefilter_list),
+			 fdw_state->late_filter ?
+				 nodeToString(fdw_state->late_filter->clauses) :
+				 "");
+	for (int i = 0; i < tupdesc->natts; i++) {
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
 
-	scalardb_scanner_release_result();
+		if (attr->attisdropped)
+			appendStringInfoString(&key, " -");
+		else
+			appendStringInfo(&key, " %u:%d", attr->atttypid,
+					 attr->atttypmod);
+	}
+	return key.data;
+}
 
-	ExecStoreHeapTuple(tuple, slot, false);
+/*
+ * Append the tuple to the results to be cached. Each tuple is saved as its
+ * length followed by its data, both aligned. The results are dropped if they
+ * exceed the maximum size of a cache entry.
+ */
+static void append_result_to_cache(ScalarDbFdwScanState *fdw_state,
+				   HeapTuple tuple)
+{
+	StringInfo buf = fdw_state->results_to_cache;
+	Size len = MAXALIGN(sizeof(uint32)) + MAXALIGN(tuple->t_len);
+
+	if (buf->len + len > get_result_cache_max_entry_size()) {
+		pfree(buf->data);
+		pfree(buf);
+		fdw_state->results_to_cache = NULL;
+		return;
+	}
 
-	return slot;
+	enlargeStringInfo(buf, len);
+	memset(buf->data + buf->len, 0, len);
+	memcpy(buf->data + buf->len, &tuple->t_len, sizeof(uint32));
+	memcpy(buf->data + buf->len + MAXALIGN(sizeof(uint32)), tuple->t_data,
+	       tuple->t_len);
+	buf->len += len;
 }
 
-static void scalardbReScanForeignScan(ForeignScanState *node)
+/*
+ * Store the next tuple of the results read from the result cache in the slot.
+ */
+static TupleTableSlot *next_cached_result(ScalarDbFdwScanState *fdw_state,
+					  TupleTableSlot *slot)
 {
-	ScalarDbFdwScanState *fdw_state;
+	HeapTuple tuple = &fdw_state->cached_tuple;
+	char *data = fdw_state->cached_results + fdw_state->cached_results_pos;
 
-	ereport(DEBUG3, errmsg("entering function %s", __func__));
+	if (fdw_state->cached_results_pos >= fdw_state->cached_results_len)
+		return ExecClearTuple(slot);
 
-	fdw_state = (ScalarDbFdwScanState *)node->fdw_state;
-	if (fdw_state->scanner)
-		scalardb_scanner_close(fdw_state->scanner);
+	memcpy(&tuple->t_len, data, sizeof(uint32));
+	tuple->t_data = (HeapTupleHeader)(data + MAXALIGN(sizeof(uint32)));
+	ItemPointerSetInvalid(&tuple->t_self);
+	tuple->t_tableOid = InvalidOid;
+	fdw_state->cached_results_pos +=
+		MAXALIGN(sizeof(uint32)) + MAXALIGN(tuple->t_len);
 
-	fdw_state->scanner = scalardb_start_scan(fdw_state->scan);
+	ExecStoreHeapTuple(tuple, slot, false);
+	return slot;
 }
 
-static void scalardbEndForeignScan(ForeignScanState *node)
+static TupleTableSlot *scalardbIterateForeignScan(ForeignScanState *node)
 {
 	ScalarDbFdwScanState *fdw_state;
+	TupleTableSlot *slot;
+	jobject result_optional;
+	jobject result;
+	HeapTuple tuple;
+	MemoryContext oldcontext = NULL;
+	instr_time start;
 
-	ereport(DEBUG3, errmsg("entering function %s", __func__));
+	ereport(DEBUG4, errmsg("entering function %s", __func__));
 
-	fdw_state = (ScalarDbFdwScanState *)node->fdw_state;
+	process_flight_recording_request();
+
+	fdw_state = (ScalarDbFdwScanState *)node->fdw_state;
+	slot = node->ss.ss_ScanTupleSlot;
+	INSTR_TIME_SET_ZERO(start);
+
+	/* Aggregates without GROUP BY return exactly one tuple */
+	if (fdw_state->aggregate_types != NIL) {
+		if (fdw_state->aggregates_returned)
+			return ExecClearTuple(slot);
+
+		/* The scans of all the aggregates are logged as one */
+		reset_scan_stats(fdw_state);
+		if (fdw_state->log_scan)
+			INSTR_TIME_SET_CURRENT(start);
+
+		tuple = make_tuple_from_aggregates(fdw_state,
+						   slot->tts_tupleDescriptor);
+		fdw_state->aggregates_returned = true;
+
+		if (fdw_state->log_scan) {
+			accumulate_time(&fdw_state->remote_time, &start);
+			fdw_state->rows_fetched = 1;
+			fdw_state->bytes_fetched = tuple->t_len;
+		}
+		log_scan_if_slow(fdw_state);
+
+		ExecStoreHeapTuple(tuple, slot, false);
+		return slot;
+	}
+
+	/*
+	 * Rebuild the Scan only if the values of the parameters have changed.
+	 * Otherwise, the tuples already fetched are replayed if all of them
+	 * have been kept.
+	 */
+	if (fdw_state->params_changed) {
+		fdw_state->params_changed = false;
+		if (evaluate_scan_conds(fdw_state,
+					node->ss.ps.ps_ExprContext)) {
+			if (fdw_state->scan)
+				scalardb_release_scan(fdw_state->scan);
+			fdw_state->scan = NULL;
+			if (fdw_state->rescan_tuples)
+				tuplestore_clear(fdw_state->rescan_tuples);
+			fdw_state->rescan_tuples_complete = false;
+		} else if (fdw_state->rescan_tuples_complete) {
+			tuplestore_rescan(fdw_state->rescan_tuples);
+			fdw_state->replaying = true;
+		}
+	}
+
+	if (fdw_state->replaying) {
+		if (!tuplestore_gettupleslot(fdw_state->rescan_tuples, true,
+					     false, fdw_state->rescan_slot))
+			return ExecClearTuple(slot);
+		return ExecCopySlot(slot, fdw_state->rescan_slot);
+	}
+
+	if (!fdw_state->scan)
+		prepare_scan(fdw_state, node->ss.ps.ps_ExprContext);
+
+	if (!fdw_state->scanner && !fdw_state->cached_results) {
+		oldcontext =
+			MemoryContextSwitchTo(node->ss.ps.state->es_query_cxt);
+
+		/* Serve the cached results without accessing ScalarDB */
+		if (fdw_state->cache_key &&
+		    lookup_result_cache(RelationGetRelid(fdw_state->rel),
+					fdw_state->cache_key,
+					&fdw_state->cached_results,
+					&fdw_state->cached_results_len)) {
+			fdw_state->cached_results_pos = 0;
+		} else {
+			fdw_state->scanner = start_scan(fdw_state);
+			if (fdw_state->cache_key)
+				fdw_state->results_to_cache = makeStringInfo();
+		}
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	if (fdw_state->cached_results) {
+		slot = next_cached_result(fdw_state, slot);
+		if (fdw_state->rescan_tuples) {
+			if (TupIsNull(slot))
+				fdw_state->rescan_tuples_complete = true;
+			else
+				tuplestore_puttupleslot(
+					fdw_state->rescan_tuples, slot);
+		}
+		return slot;
+	}
+
+	/*
+	 * The values of the results that do not satisfy the local conditions
+	 * are discarded with the per-tuple memory of result_econtext. The
+	 * returned tuple lives there until the next call.
+	 */
+	if (fdw_state->result_econtext)
+		oldcontext = MemoryContextSwitchTo(
+			fdw_state->result_econtext->ecxt_per_tuple_memory);
+
+	for (;;) {
+		if (fdw_state->result_econtext)
+			ResetExprContext(fdw_state->result_econtext);
+
+		/* All the ranges of a parallel scan have been claimed */
+		if (!fdw_state->scanner) {
+			tuple = NULL;
+			break;
+		}
+
+		if (fdw_state->log_scan)
+			INSTR_TIME_SET_CURRENT(start);
+
+		result_optional = scalardb_scanner_one(fdw_state->scanner);
+
+		if (fdw_state->log_scan)
+			accumulate_time(&fdw_state->remote_time, &start);
+
+		if (!scalardb_optional_is_present(result_optional)) {
+			scalardb_scanner_release_result();
+			if (fdw_state->parallel_aware) {
+				scalardb_scanner_close(fdw_state->scanner);
+				if (fdw_state->log_scan)
+					accumulate_time(&fdw_state->remote_time,
+							&start);
+				fdw_state->scanner =
+					start_next_split(fdw_state);
+				continue;
+			}
+			close_scanner(fdw_state);
+			tuple = NULL;
+			break;
+		}
+
+		result = scalardb_optional_get(result_optional);
+		tuple = make_tuple_from_result(result, fdw_state->rel,
+					       fdw_state->attrs_to_retrieve,
+					       fdw_state->prefilters,
+					       fdw_state->num_prefilters,
+					       fdw_state->late_filter,
+					       fdw_state->text_dictionaries);
+
+		scalardb_scanner_release_result();
+
+		if (fdw_state->log_scan) {
+			accumulate_time(&fdw_state->decode_time, &start);
+			fdw_state->rows_fetched++;
+			if (tuple != NULL)
+				fdw_state->bytes_fetched += tuple->t_len;
+		}
+
+		if (tuple != NULL)
+			break;
+
+		InstrCountFiltered1(node, 1);
+	}
+
+	if (fdw_state->result_econtext)
+		MemoryContextSwitchTo(oldcontext);
+
+	if (tuple == NULL) {
+		log_scan_if_slow(fdw_state);
+		if (fdw_state->rescan_tuples)
+			fdw_state->rescan_tuples_complete = true;
+		if (fdw_state->results_to_cache) {
+			store_result_cache(RelationGetRelid(fdw_state->rel),
+					   fdw_state->cache_key,
+					   fdw_state->results_to_cache->data,
+					   fdw_state->results_to_cache->len,
+					   fdw_state->options.result_cache_ttl);
+			pfree(fdw_state->results_to_cache->data);
+			pfree(fdw_state->results_to_cache);
+			fdw_state->results_to_cache = NULL;
+		}
+		return ExecClearTuple(slot);
+	}
+
+	if (fdw_state->results_to_cache)
+		append_result_to_cache(fdw_state, tuple);
+	if (fdw_state->rescan_tuples)
+		tuplestore_puttuple(fdw_state->rescan_tuples, tuple);
+
+	ExecStoreHeapTuple(tuple, slot, false);
+
+	return slot;
+}
+
+static void scalardbReScanForeignScan(ForeignScanState *node)
+{
+	ScalarDbFdwScanState *fdw_state;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	fdw_state = (ScalarDbFdwScanState *)node->fdw_state;
+
+	if (fdw_state->aggregate_types != NIL) {
+		fdw_state->aggregates_returned = false;
+		return;
+	}
+
+	close_scanner(fdw_state);
+	log_scan_if_slow(fdw_state);
+
+	/* The results are looked up in the result cache again */
+	if (fdw_state->cached_results)
+		pfree(fdw_state->cached_results);
+	fdw_state->cached_results = NULL;
+	if (fdw_state->results_to_cache) {
+		pfree(fdw_state->results_to_cache->data);
+		pfree(fdw_state->results_to_cache);
+	}
+	fdw_state->results_to_cache = NULL;
+
+	fdw_state->replaying = false;
+	fdw_state->next_split = 0;
+
+	/* The tuples fetched by a scan that has not finished are discarded */
+	if (fdw_state->rescan_tuples && !fdw_state->rescan_tuples_complete)
+		tuplestore_clear(fdw_state->rescan_tuples);
+
+	/*
+	 * If the parameters supplied by the outer relation may have changed,
+	 * the conditions are evaluated again when iterated.
+	 */
+	if (fdw_state->is_parameterized && node->ss.ps.chgParam != NULL) {
+		fdw_state->params_changed = true;
+		return;
+	}
+
+	if (fdw_state->rescan_tuples_complete) {
+		tuplestore_rescan(fdw_state->rescan_tuples);
+		fdw_state->replaying = true;
+		return;
+	}
+
+	/*
+	 * The cached results are looked up when iterated. The ranges of a
+	 * parallel scan are claimed after the DSM segment is reinitialized.
+	 */
+	if (fdw_state->scan && !fdw_state->cache_key &&
+	    !fdw_state->parallel_aware)
+		fdw_state->scanner = start_scan(fdw_state);
+}
+
+static void scalardbEndForeignScan(ForeignScanState *node)
+{
+	ScalarDbFdwScanState *fdw_state;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	fdw_state = (ScalarDbFdwScanState *)node->fdw_state;
+
+	/* Close the scanner if open, to prevent accumulation of scanner */
+	close_scanner(fdw_state);
+
+	/* A scan stopped before the end, e.g. by LIMIT, is logged here */
+	log_scan_if_slow(fdw_state);
 
 	if (fdw_state->scan)
 		scalardb_release_scan(fdw_state->scan);
 
-	/* Close the scanner if open, to prevent accumulation of scanner */
-	if (fdw_state->scanner)
-		scalardb_scanner_close(fdw_state->scanner);
+	/* The buffer enlarged for large values is not kept across scans */
+	scalardb_shrink_value_buffer();
+
+	if (fdw_state->rescan_tuples)
+		tuplestore_end(fdw_state->rescan_tuples);
+
+	if (fdw_state->text_dictionaries) {
+		TupleDesc tupdesc = RelationGetDescr(fdw_state->rel);
+
+		for (int i = 0; i < tupdesc->natts; i++) {
+			if (fdw_state->text_dictionaries[i])
+				scalardb_text_dictionary_release(
+					fdw_state->text_dictionaries[i]);
+		}
+	}
+
+	process_flight_recording_request();
+	report_jvm_stats(false);
 
 	// TODO: consider whether DistributedStorage should be closed
 	// here
@@ -608,23 +1696,44 @@ static void scalardbExplainForeignScan(ForeignScanState *node, ExplainState *es)
 			    es);
 	ExplainPropertyText("ScalarDB Table", fdw_state->options.table_name,
 			    es);
+	if (fdw_state->options.sample_percent < 100)
+		ExplainPropertyText("ScalarDB Sample Percent",
+				    psprintf("%g",
+					     fdw_state->options.sample_percent),
+				    es);
+	if (fdw_state->options.transaction_aware)
+		ExplainPropertyBool("ScalarDB Transaction Aware", true, es);
+	if (fdw_state->options.result_cache_ttl > 0 &&
+	    fdw_state->scan_type == SCALARDB_SCAN_PARTITION_KEY &&
+	    get_result_cache_max_entry_size() > 0)
+		ExplainPropertyInteger("ScalarDB Result Cache TTL", NULL,
+				       fdw_state->options.result_cache_ttl, es);
+	if (fdw_state->late_filter)
+		ExplainPropertyBool("ScalarDB Late Materialization", true, es);
+	if (fdw_state->options.fetch_size > 0)
+		ExplainPropertyInteger("ScalarDB Fetch Size", NULL,
+				       fdw_state->options.fetch_size, es);
+	if (fdw_state->options.adaptive_fetch)
+		ExplainPropertyBool("ScalarDB Adaptive Fetch", true, es);
 	if (es->verbose) {
-		char *scan_type_str = NULL;
-		switch (fdw_state->scan_type) {
-		case SCALARDB_SCAN_ALL:
-			scan_type_str = "all";
-			break;
-		case SCALARDB_SCAN_PARTITION_KEY:
-			scan_type_str = "partition key";
-			break;
-		case SCALARDB_SCAN_SECONDARY_INDEX:
-			scan_type_str = "secondary index";
-			break;
-		}
-
-		ExplainPropertyText("ScalarDB Scan Type", scan_type_str, es);
-
-		if (fdw_state->num_scan_conds > 0) {
+		ExplainPropertyText("ScalarDB Scan Type",
+				    scan_type_to_string(fdw_state->scan_type),
+				    es);
+
+		if (fdw_state->num_split_boundaries > 0)
+			ExplainPropertyInteger(
+				"ScalarDB Scan Splits", NULL,
+				fdw_state->num_split_boundaries + 1, es);
+
+		/*
+		 * The values of the conditions of a parameterized scan change
+		 * for each rescan, so the expressions are shown instead.
+		 */
+		if (fdw_state->is_parameterized)
+			explain_parameterized_conds(node, es);
+
+		if (!fdw_state->is_parameterized &&
+		    fdw_state->num_scan_conds > 0) {
 			char *scan_conds_str =
 				scan_conds_to_string(fdw_state->scan_conds,
 						     fdw_state->num_scan_conds);
@@ -633,7 +1742,17 @@ static void scalardbExplainForeignScan(ForeignScanState *node, ExplainState *es)
 					    scan_conds_str, es);
 		}
 
-		if (fdw_state->boundary != NULL) {
+		if (fdw_state->num_filter_conds > 0) {
+			char *filter_conds_str = scan_conds_to_string(
+				fdw_state->filter_conds,
+				fdw_state->num_filter_conds);
+
+			ExplainPropertyText("ScalarDB Scan Filter",
+					    filter_conds_str, es);
+		}
+
+		if (!fdw_state->is_parameterized &&
+		    fdw_state->boundary != NULL) {
 			if (fdw_state->boundary->num_start_values > 0) {
 				char *start_boundary_str =
 					scan_start_boundary_to_string(
@@ -659,6 +1778,14 @@ static void scalardbExplainForeignScan(ForeignScanState *node, ExplainState *es)
 					    sort_str, es);
 		}
 
+		if (fdw_state->aggregate_types) {
+			char *aggregates_str = aggregates_to_string(
+				fdw_state->aggregate_types,
+				fdw_state->aggregate_column_names);
+			ExplainPropertyText("ScalarDB Aggregates",
+					    aggregates_str, es);
+		}
+
 		if (list_length(fdw_state->attnames) > 0)
 			ExplainPropertyText("ScalarDB Scan Attribute",
 					    nodeToString(fdw_state->attnames),
@@ -670,7 +1797,594 @@ static bool scalardbAnalyzeForeignTable(Relation relation,
 					AcquireSampleRowsFunc *func,
 					BlockNumber *totalpages)
 {
-	return false;
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	*func = scalardb_acquire_sample_rows;
+	/* ScalarDB has no notion of pages */
+	*totalpages = 1;
+
+	return true;
+}
+
+/*
+ * Scan (all) can be read by parallel workers only if it is split into ranges,
+ * since each range is read by one of the participants of the parallel scan.
+ * Whether the table can be split is checked without reading it, so that the
+ * boundaries are not taken for the tables whose Scan is never split.
+ */
+static bool scalardbIsForeignScanParallelSafe(PlannerInfo *root,
+					      RelOptInfo *rel,
+					      RangeTblEntry *rte)
+{
+	ScalarDbFdwOptions options;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	get_scalardb_fdw_options(rte->relid, &options);
+	if (options.scan_all_splits <= 1)
+		return false;
+
+	scalardb_initialize(&options);
+	return scalardb_can_split_scan_all(options.namespace,
+					   options.table_name);
+}
+
+static Size scalardbEstimateDSMForeignScan(ForeignScanState *node,
+					   ParallelContext *pcxt)
+{
+	return sizeof(ScalarDbFdwSplitState);
+}
+
+static void scalardbInitializeDSMForeignScan(ForeignScanState *node,
+					     ParallelContext *pcxt,
+					     void *coordinate)
+{
+	ScalarDbFdwScanState *fdw_state =
+		(ScalarDbFdwScanState *)node->fdw_state;
+	ScalarDbFdwSplitState *split_state =
+		(ScalarDbFdwSplitState *)coordinate;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	pg_atomic_init_u32(&split_state->next_split, 0);
+	fdw_state->split_state = split_state;
+}
+
+static void scalardbReInitializeDSMForeignScan(ForeignScanState *node,
+					       ParallelContext *pcxt,
+					       void *coordinate)
+{
+	ScalarDbFdwSplitState *split_state =
+		(ScalarDbFdwSplitState *)coordinate;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	pg_atomic_write_u32(&split_state->next_split, 0);
+}
+
+static void scalardbInitializeWorkerForeignScan(ForeignScanState *node,
+						shm_toc *toc,
+						void *coordinate)
+{
+	ScalarDbFdwScanState *fdw_state =
+		(ScalarDbFdwScanState *)node->fdw_state;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	fdw_state->split_state = (ScalarDbFdwSplitState *)coordinate;
+}
+
+/*
+ * Acquire a random sample of the records of the foreign table for ANALYZE.
+ *
+ * All the records are read with Scan (all) and sampled by reservoir sampling.
+ * While reading them, the records of each partition are counted and saved as
+ * the partition statistics, which are used to estimate the rows of partition
+ * key scans of skewed partitions. sample_percent is ignored so that the
+ * statistics describe the whole table, from which the estimates of the sampled
+ * scans are derived.
+ */
+static int scalardb_acquire_sample_rows(Relation relation, int elevel,
+					HeapTuple *rows, int targrows,
+					double *totalrows,
+					double *totaldeadrows)
+{
+	TupleDesc tupdesc = RelationGetDescr(relation);
+	ScalarDbFdwOptions opts;
+	List *attrs_to_retrieve = NIL;
+	List *attnames = NIL;
+	List *partition_key_names = NIL;
+	Oid *partition_key_types;
+	Oid *partition_key_typoutputs;
+	char **partition_key_values;
+	ScalarDbFdwPartitionStats *stats = NULL;
+	ReservoirStateData rstate;
+	MemoryContext anl_cxt = CurrentMemoryContext;
+	MemoryContext temp_cxt;
+	double samplerows = 0;
+	double rowstoskip = -1;
+	int numrows = 0;
+	jobject scan;
+	jobject scanner;
+	ListCell *lc;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	get_scalardb_fdw_options(RelationGetRelid(relation), &opts);
+	scalardb_initialize(&opts);
+
+	for (int i = 1; i <= tupdesc->natts; i++) {
+		if (!TupleDescAttr(tupdesc, i - 1)->attisdropped)
+			attrs_to_retrieve = lappend_int(attrs_to_retrieve, i);
+	}
+	get_attnames(tupdesc, attrs_to_retrieve, &attnames);
+
+	/*
+	 * Partitions are counted only if all the partition key columns are
+	 * defined in the foreign table.
+	 */
+	scalardb_get_paritition_key_names(opts.namespace, opts.table_name,
+					  &partition_key_names);
+	partition_key_types =
+		palloc(sizeof(Oid) * list_length(partition_key_names));
+	partition_key_typoutputs =
+		palloc(sizeof(Oid) * list_length(partition_key_names));
+	partition_key_values =
+		palloc(sizeof(char *) * list_length(partition_key_names));
+	foreach(lc, partition_key_names) {
+		int i = foreach_current_index(lc);
+		AttrNumber attnum = get_attnum(RelationGetRelid(relation),
+					       strVal(lfirst(lc)));
+		bool typisvarlena;
+
+		if (attnum == InvalidAttrNumber)
+			break;
+		partition_key_types[i] =
+			TupleDescAttr(tupdesc, attnum - 1)->atttypid;
+		getTypeOutputInfo(partition_key_types[i],
+				  &partition_key_typoutputs[i], &typisvarlena);
+	}
+	if (lc == NULL)
+		stats = begin_partition_stats(list_length(partition_key_names));
+
+	temp_cxt = AllocSetContextCreate(CurrentMemoryContext,
+					 "scalardb_fdw temporary data",
+					 ALLOCSET_SMALL_SIZES);
+
+	reservoir_init_selection_state(&rstate, targrows);
+
+	scan = scalardb_scan_all(opts.namespace, opts.table_name, attnames, NIL,
+				 NIL);
+	scanner = scalardb_start_scan(scan, 100, opts.transaction_aware, 0,
+				      false);
+	for (;;) {
+		jobject result_optional;
+		jobject result;
+		int pos = -1;
+
+		vacuum_delay_point();
+
+		result_optional = scalardb_scanner_one(scanner);
+		if (!scalardb_optional_is_present(result_optional)) {
+			scalardb_scanner_release_result();
+			break;
+		}
+		result = scalardb_optional_get(result_optional);
+
+		MemoryContextSwitchTo(temp_cxt);
+
+		if (stats) {
+			foreach(lc, partition_key_names) {
+				int i = foreach_current_index(lc);
+
+				partition_key_values[i] = OidOutputFunctionCall(
+					partition_key_typoutputs[i],
+					convert_result_column_to_datum(
+						result, strVal(lfirst(lc)),
+						partition_key_types[i]));
+			}
+			MemoryContextSwitchTo(anl_cxt);
+			count_partition(stats, partition_key_values);
+		}
+
+		/*
+		 * The first targrows records are sampled as they are. Then,
+		 * each record replaces a random sample with the probability
+		 * given by the reservoir sampling, as in postgres_fdw.
+		 */
+		if (numrows < targrows) {
+			pos = numrows++;
+		} else {
+			if (rowstoskip < 0)
+				rowstoskip = reservoir_get_next_S(
+					&rstate, samplerows, targrows);
+			if (rowstoskip <= 0) {
+				pos = (int)(targrows *
+					    sampler_random_fract(
+						    &rstate.randstate));
+				heap_freetuple(rows[pos]);
+			}
+			rowstoskip -= 1;
+		}
+		samplerows += 1;
+
+		if (pos >= 0) {
+			HeapTuple tuple;
+
+			MemoryContextSwitchTo(temp_cxt);
+			tuple = make_tuple_from_result(result, relation,
+						       attrs_to_retrieve, NULL,
+						       0, NULL, NULL);
+			MemoryContextSwitchTo(anl_cxt);
+			rows[pos] = heap_copytuple(tuple);
+		}
+
+		MemoryContextSwitchTo(anl_cxt);
+		MemoryContextReset(temp_cxt);
+		scalardb_scanner_release_result();
+	}
+	scalardb_scanner_close(scanner);
+	scalardb_release_scan(scan);
+	scalardb_shrink_value_buffer();
+	MemoryContextDelete(temp_cxt);
+
+	*totalrows = samplerows;
+	*totaldeadrows = 0;
+
+	if (stats)
+		save_partition_stats(RelationGetRelid(relation), stats);
+
+	ereport(elevel,
+		(errmsg("\"%s\": table contains %.0f rows, %d rows in sample",
+			RelationGetRelationName(relation), samplerows,
+			numrows)));
+
+	return numrows;
+}
+
+PG_FUNCTION_INFO_V1(scalardb_fdw_changes);
+
+/*
+ * Return the records of the transaction-aware foreign table whose row type is
+ * the type of the first argument, committed after committed_after in
+ * milliseconds since the epoch.
+ *
+ * The records are filtered by tx_committed_at on the ScalarDB side, so only
+ * the changed ones are passed to PostgreSQL. They are still read from the
+ * storage since ScalarDB cannot filter records by the commit time.
+ */
+Datum scalardb_fdw_changes(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+	Oid relid;
+	int64 committed_after;
+	AclResult aclresult;
+	ScalarDbFdwOptions opts;
+	Relation rel;
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	List *attrs_to_retrieve = NIL;
+	List *attnames = NIL;
+	MemoryContext oldcontext;
+	MemoryContext temp_cxt;
+	jobject volatile scan = NULL;
+	jobject volatile scanner = NULL;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo) ||
+	    !(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	if (PG_ARGISNULL(1))
+		ereport(ERROR,
+			(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+			 errmsg("committed_after must not be null")));
+	committed_after = PG_GETARG_INT64(1);
+
+	relid = get_typ_typrelid(get_fn_expr_argtype(fcinfo->flinfo, 0));
+	if (!OidIsValid(relid) ||
+	    get_rel_relkind(relid) != RELKIND_FOREIGN_TABLE)
+		ereport(ERROR,
+			(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+			 errmsg("the first argument must be of the row type of a foreign table")));
+
+	aclresult = pg_class_aclcheck(relid, GetUserId(), ACL_SELECT);
+	if (aclresult != ACLCHECK_OK)
+		aclcheck_error(aclresult, OBJECT_FOREIGN_TABLE,
+			       get_rel_name(relid));
+
+	get_scalardb_fdw_options(relid, &opts);
+	if (opts.namespace == NULL || opts.table_name == NULL)
+		ereport(ERROR,
+			(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+			 errmsg("\"%s\" is not a foreign table of scalardb_fdw",
+				get_rel_name(relid))));
+	if (!opts.transaction_aware)
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("\"%s\" is not a transaction-aware foreign table",
+				get_rel_name(relid)),
+			 errhint("Set the transaction_aware option of the foreign table.")));
+
+	scalardb_initialize(&opts);
+
+	rel = table_open(relid, AccessShareLock);
+
+	oldcontext =
+		MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	tupdesc = CreateTupleDescCopy(RelationGetDescr(rel));
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(oldcontext);
+
+	for (int i = 1; i <= tupdesc->natts; i++) {
+		if (!TupleDescAttr(tupdesc, i - 1)->attisdropped)
+			attrs_to_retrieve = lappend_int(attrs_to_retrieve, i);
+	}
+	get_attnames(tupdesc, attrs_to_retrieve, &attnames);
+	attnames = lappend(attnames, makeString("tx_committed_at"));
+
+	temp_cxt = AllocSetContextCreate(CurrentMemoryContext,
+					 "scalardb_fdw temporary data",
+					 ALLOCSET_SMALL_SIZES);
+
+	/* The scanner is closed if the scan is canceled or fails */
+	PG_TRY();
+	{
+		scan = scalardb_scan_all(opts.namespace, opts.table_name,
+					 attnames, NIL, NIL);
+		scanner = scalardb_start_scan_committed_after(scan,
+							      committed_after);
+		for (;;) {
+			jobject result_optional;
+
+			CHECK_FOR_INTERRUPTS();
+
+			result_optional = scalardb_scanner_one(scanner);
+			if (!scalardb_optional_is_present(result_optional)) {
+				scalardb_scanner_release_result();
+				break;
+			}
+
+			oldcontext = MemoryContextSwitchTo(temp_cxt);
+			tuplestore_puttuple(
+				tupstore,
+				make_tuple_from_result(
+					scalardb_optional_get(result_optional),
+					rel, attrs_to_retrieve, NULL, 0, NULL,
+					NULL));
+			MemoryContextSwitchTo(oldcontext);
+			MemoryContextReset(temp_cxt);
+			scalardb_scanner_release_result();
+		}
+	}
+	PG_FINALLY();
+	{
+		if (scanner != NULL)
+			scalardb_scanner_close(scanner);
+		if (scan != NULL)
+			scalardb_release_scan(scan);
+	}
+	PG_END_TRY();
+	scalardb_shrink_value_buffer();
+	MemoryContextDelete(temp_cxt);
+
+	table_close(rel, AccessShareLock);
+
+	return (Datum)0;
+}
+
+/*
+ * scalardbGetForeignUpperPaths
+ *		Add paths for post-join operations like aggregation
+ */
+static void scalardbGetForeignUpperPaths(PlannerInfo *root,
+					 UpperRelationKind stage,
+					 RelOptInfo *input_rel,
+					 RelOptInfo *output_rel, void *extra)
+{
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	/*
+	 * Only aggregation directly over a scan of a foreign table is
+	 * supported. Skip if this output relation has already been processed.
+	 */
+	if (stage != UPPERREL_GROUP_AGG || output_rel->fdw_private ||
+	    input_rel->reloptkind != RELOPT_BASEREL || !input_rel->fdw_private)
+		return;
+
+	add_foreign_grouping_paths(root, input_rel, output_rel);
+}
+
+/*
+ * Add a path for each condition on a secondary index, each of which uses the
+ * index of the condition for the Scan with index.
+ *
+ * The records read by the index are filtered by the conditions on the other
+ * secondary indexes on the ScalarDB side where possible, so that only the
+ * intersection of the indexes is passed to PostgreSQL. The planner chooses the
+ * cheapest path, which is the one with the most selective index.
+ */
+static void add_secondary_index_paths(PlannerInfo *root, RelOptInfo *baserel)
+{
+	ScalarDbFdwPlanState *fdw_private =
+		(ScalarDbFdwPlanState *)baserel->fdw_private;
+	ListCell *lc;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	foreach(lc, fdw_private->secondary_index_conds) {
+		RestrictInfo *index_cond = lfirst_node(RestrictInfo, lc);
+		List *filter_conds = NIL;
+		ForeignPath *path;
+		Cost startup_cost;
+		Cost total_cost;
+		double rows;
+		ListCell *lc2;
+
+		foreach(lc2, fdw_private->secondary_index_conds) {
+			RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc2);
+
+			if (rinfo != index_cond &&
+			    is_filterable_condition(
+				    baserel, &fdw_private->column_metadata,
+				    rinfo->clause))
+				filter_conds = lappend(filter_conds, rinfo);
+		}
+
+		estimate_index_scan_costs(root, baserel, index_cond,
+					  filter_conds, &rows, &startup_cost,
+					  &total_cost);
+
+		path = create_foreignscan_path(
+			root, baserel, NULL, /* default pathtarget */
+			rows, startup_cost, total_cost,
+			NIL, /* no pathkeys */
+			baserel->lateral_relids, NULL, /* no extra plan */
+			list_make4(NIL, NIL, list_make1(index_cond),
+				   filter_conds));
+		add_path(baserel, (Path *)path);
+	}
+}
+
+/*
+ * Add parameterized paths that push down the join clauses on the partition key
+ * or a secondary index. With such a path on the inner side of a nested loop,
+ * each row of the outer relation drives a Scan with the key, so only the
+ * records that can match are transferred instead of scanning all the records
+ * and discarding most of them by the join.
+ */
+static void add_parameterized_paths(PlannerInfo *root, RelOptInfo *baserel)
+{
+	ScalarDbFdwPlanState *fdw_private =
+		(ScalarDbFdwPlanState *)baserel->fdw_private;
+	List *join_conds = NIL;
+	List *param_infos = NIL;
+	ListCell *lc;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	/* A Scan with the partition key already reads only a single partition */
+	if (fdw_private->scan_type == SCALARDB_SCAN_PARTITION_KEY)
+		return;
+
+	foreach(lc, baserel->joininfo) {
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+
+		if (join_clause_is_movable_to(rinfo, baserel) &&
+		    is_shippable_join_condition(
+			    baserel, &fdw_private->column_metadata, rinfo))
+			join_conds = lappend(join_conds, rinfo);
+	}
+
+	/* Join clauses derived from equivalence classes are not in joininfo */
+	if (baserel->has_eclass_joins) {
+		List *ec_conds = generate_implied_equalities_for_column(
+			root, baserel, ec_member_matches_key,
+			(void *)&fdw_private->column_metadata,
+			baserel->lateral_referencers);
+
+		foreach(lc, ec_conds) {
+			RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+
+			if (join_clause_is_movable_to(rinfo, baserel) &&
+			    is_shippable_join_condition(
+				    baserel, &fdw_private->column_metadata,
+				    rinfo))
+				join_conds = lappend(join_conds, rinfo);
+		}
+	}
+
+	foreach(lc, join_conds) {
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		Relids required_outer;
+		ParamPathInfo *param_info;
+		List *remote_conds = NIL;
+		List *local_conds = NIL;
+		List *secondary_index_conds = NIL;
+		ScalarDbFdwClusteringKeyBoundary boundary = { 0 };
+		ScalarDbFdwScanType scan_type;
+		ForeignPath *path;
+		Cost startup_cost;
+		Cost total_cost;
+		double rows;
+
+		required_outer = bms_union(rinfo->clause_relids,
+					   baserel->lateral_relids);
+		required_outer = bms_del_member(required_outer, baserel->relid);
+
+		/* The clauses may share the same parameterization */
+		param_info = get_baserel_parampathinfo(root, baserel,
+						       required_outer);
+		if (list_member_ptr(param_infos, param_info))
+			continue;
+		param_infos = lappend(param_infos, param_info);
+
+		/*
+		 * Determine the conditions with all the join clauses of the
+		 * parameterization. They come first so that the secondary index
+		 * in the join clauses is preferred. This must be consistent
+		 * with scalardbGetForeignPlan.
+		 */
+		determine_remote_conds(
+			baserel,
+			list_concat_copy(param_info->ppi_clauses,
+					 baserel->baserestrictinfo),
+			&fdw_private->column_metadata, &remote_conds,
+			&local_conds, &boundary, &scan_type,
+			&secondary_index_conds);
+
+		if (scan_type == SCALARDB_SCAN_ALL)
+			continue;
+
+		if (scan_type == SCALARDB_SCAN_SECONDARY_INDEX)
+			estimate_index_scan_costs(root, baserel,
+						  linitial(remote_conds), NIL,
+						  &rows, &startup_cost,
+						  &total_cost);
+		else
+			estimate_costs(root, baserel, remote_conds, &rows,
+				       &startup_cost, &total_cost);
+
+		path = create_foreignscan_path(root, baserel,
+					       NULL, /* default pathtarget */
+					       param_info->ppi_rows,
+					       startup_cost, total_cost,
+					       NIL, /* no pathkeys */
+					       required_outer,
+					       NULL, /* no extra plan */
+					       NIL); /* no fdw_private */
+		add_path(baserel, (Path *)path);
+	}
+}
+
+/*
+ * Callback for generate_implied_equalities_for_column. Returns true if the
+ * member of the equivalence class is a partition key or a secondary index of
+ * the foreign table.
+ */
+static bool ec_member_matches_key(PlannerInfo *root, RelOptInfo *rel,
+				  EquivalenceClass *ec, EquivalenceMember *em,
+				  void *arg)
+{
+	ScalarDbFdwColumnMetadata *column_metadata =
+		(ScalarDbFdwColumnMetadata *)arg;
+	Var *var;
+
+	if (!is_foreign_table_var(em->em_expr, rel))
+		return false;
+
+	var = (Var *)em->em_expr;
+
+	return list_member_int(column_metadata->partition_key_attnums,
+			       var->varattno) ||
+	       list_member_int(column_metadata->secondary_index_attnums,
+			       var->varattno);
 }
 
 /*
@@ -720,70 +2434,294 @@ static void get_target_list(PlannerInfo *root, RelOptInfo *baserel,
 	table_close(rel, NoLock);
 }
 
-/* 
- * Get a List of attribute name Strings from the given List of attribute numbers.
+/* 
+ * Get a List of attribute name Strings from the given List of attribute numbers.
+ */
+static void get_attnames(TupleDesc tupdesc, List *attrs_to_retrieve,
+			 List **attnames)
+{
+	ListCell *lc;
+	FormData_pg_attribute *attr;
+	char *attname;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	foreach(lc, attrs_to_retrieve) {
+		int i = lfirst_int(lc);
+
+		if (i > 0) {
+			/* ordinary column */
+			Assert(i <= tupdesc->natts);
+			attr = TupleDescAttr(tupdesc, i - 1);
+			attname = NameStr(attr->attname);
+			*attnames = lappend(*attnames,
+					    makeString(pstrdup(attname)));
+		}
+	}
+}
+
+/*
+ * Make a tuple from the result. If the columns of the result do not satisfy
+ * any of the prefilters, which are evaluated as soon as their columns are
+ * retrieved, or the conditions of late_filter, which are evaluated once the
+ * columns they refer to are retrieved, NULL is returned without retrieving
+ * the other columns.
+ */
+static HeapTuple make_tuple_from_result(jobject result, Relation rel,
+					List *attrs_to_retrieve,
+					ScalarDbFdwPrefilter *prefilters,
+					int num_prefilters,
+					ScalarDbFdwLateFilter *late_filter,
+					ScalarDbTextDictionary **dictionaries)
+{
+	TupleDesc tupdesc;
+	Datum *values;
+	bool *nulls;
+	bool *retrieved = NULL;
+	ListCell *lc;
+	char *attname;
+	HeapTuple tuple;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	tupdesc = RelationGetDescr(rel);
+
+	values = (Datum *)palloc0(tupdesc->natts * sizeof(Datum));
+	nulls = (bool *)palloc(tupdesc->natts * sizeof(bool));
+
+	/* Initialize to nulls for any columns not present in result */
+	memset(nulls, true, tupdesc->natts * sizeof(bool));
+
+	if (num_prefilters > 0)
+		retrieved = (bool *)palloc0(tupdesc->natts * sizeof(bool));
+
+	for (int k = 0; k < num_prefilters; k++) {
+		int i = prefilters[k].attnum;
+
+		/* The value is not needed for IS NULL and IS NOT NULL */
+		if (!retrieved[i - 1] &&
+		    (prefilters[k].type == SCALARDB_PREFILTER_IS_NULL ||
+		     prefilters[k].type == SCALARDB_PREFILTER_IS_NOT_NULL)) {
+			attname = NameStr(tupdesc->attrs[i - 1].attname);
+			nulls[i - 1] = scalardb_result_is_null(result, attname);
+		} else if (!retrieved[i - 1]) {
+			retrieve_result_column(result, tupdesc, i, dictionaries,
+					       values, nulls);
+			retrieved[i - 1] = true;
+		}
+
+		if (!evaluate_prefilter(&prefilters[k], values[i - 1],
+					nulls[i - 1])) {
+			pfree(values);
+			pfree(nulls);
+			pfree(retrieved);
+			return NULL;
+		}
+	}
+
+	if (late_filter != NULL) {
+		if (retrieved == NULL)
+			retrieved =
+				(bool *)palloc0(tupdesc->natts * sizeof(bool));
+
+		foreach(lc, late_filter->attrs) {
+			int i = lfirst_int(lc);
+
+			if (retrieved[i - 1])
+				continue;
+
+			retrieve_result_column(result, tupdesc, i, dictionaries,
+					       values, nulls);
+			retrieved[i - 1] = true;
+		}
+
+		if (!evaluate_late_filter(late_filter, values, nulls,
+					  tupdesc->natts)) {
+			pfree(values);
+			pfree(nulls);
+			pfree(retrieved);
+			return NULL;
+		}
+	}
+
+	foreach(lc, attrs_to_retrieve) {
+		int i = lfirst_int(lc);
+
+		if (i > 0 && retrieved != NULL && retrieved[i - 1])
+			continue;
+
+		if (i > 0) {
+			/* ordinary column */
+			Assert(i <= tupdesc->natts);
+			retrieve_result_column(result, tupdesc, i, dictionaries,
+					       values, nulls);
+		}
+	}
+
+	tuple = heap_form_tuple(tupdesc, values, nulls);
+
+	return tuple;
+}
+
+/*
+ * Retrieve the column of the result into values and nulls. The values of TEXT
+ * columns are read through their dictionaries if dictionaries is given.
+ */
+static void retrieve_result_column(jobject result, TupleDesc tupdesc,
+				   int attnum,
+				   ScalarDbTextDictionary **dictionaries,
+				   Datum *values, bool *nulls)
+{
+	Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
+	char *attname = NameStr(attr->attname);
+
+	nulls[attnum - 1] = scalardb_result_is_null(result, attname);
+	if (nulls[attnum - 1])
+		return;
+
+	if (dictionaries != NULL && dictionaries[attnum - 1] != NULL)
+		values[attnum - 1] =
+			PointerGetDatum(scalardb_result_get_text_with_dictionary(
+				result, attname, dictionaries[attnum - 1]));
+	else
+		values[attnum - 1] = convert_result_column_to_datum(
+			result, attname, attr->atttypid);
+}
+
+/*
+ * Make the dictionaries of the retrieved TEXT columns, which last as long as
+ * the scan. Returns NULL if no TEXT column is retrieved.
  */
-static void get_attnames(TupleDesc tupdesc, List *attrs_to_retrieve,
-			 List **attnames)
+static ScalarDbTextDictionary **make_text_dictionaries(TupleDesc tupdesc,
+						       List *attrs_to_retrieve)
 {
+	ScalarDbTextDictionary **dictionaries = NULL;
 	ListCell *lc;
-	FormData_pg_attribute *attr;
-	char *attname;
 
-	ereport(DEBUG5, errmsg("entering function %s", __func__));
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
 
 	foreach(lc, attrs_to_retrieve) {
 		int i = lfirst_int(lc);
 
-		if (i > 0) {
-			/* ordinary column */
-			Assert(i <= tupdesc->natts);
-			attr = TupleDescAttr(tupdesc, i - 1);
-			attname = NameStr(attr->attname);
-			*attnames = lappend(*attnames,
-					    makeString(pstrdup(attname)));
-		}
+		if (i <= 0 || TupleDescAttr(tupdesc, i - 1)->atttypid != TEXTOID)
+			continue;
+
+		if (dictionaries == NULL)
+			dictionaries = (ScalarDbTextDictionary **)palloc0(
+				tupdesc->natts * sizeof(ScalarDbTextDictionary *));
+		dictionaries[i - 1] = scalardb_text_dictionary_create();
 	}
+
+	return dictionaries;
 }
 
-static HeapTuple make_tuple_from_result(jobject result, Relation rel,
-					List *attrs_to_retrieve)
+/*
+ * Take over the local conditions of the scan from the executor, so that they
+ * are evaluated before the columns they do not refer to are retrieved.
+ *
+ * Returns NULL if the conditions cannot be evaluated that way or refer to all
+ * the retrieved columns.
+ */
+static ScalarDbFdwLateFilter *make_late_filter(ForeignScanState *node,
+					       List *attrs_to_retrieve)
 {
-	TupleDesc tupdesc;
-	Datum *values;
-	bool *nulls;
+	ScalarDbFdwScanState *fdw_state;
+	ForeignScan *fsplan;
+	List *qual;
+	Bitmapset *attrs = NULL;
+	List *filter_attrs = NIL;
+	int num_attrs = 0;
 	ListCell *lc;
-	FormData_pg_attribute attr;
-	char *attname;
-	HeapTuple tuple;
+	int i;
+	ScalarDbFdwLateFilter *late_filter;
 
-	ereport(DEBUG5, errmsg("entering function %s", __func__));
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
 
-	tupdesc = RelationGetDescr(rel);
+	fdw_state = (ScalarDbFdwScanState *)node->fdw_state;
+	fsplan = (ForeignScan *)node->ss.ps.plan;
+	qual = fsplan->scan.plan.qual;
 
-	values = (Datum *)palloc0(tupdesc->natts * sizeof(Datum));
-	nulls = (bool *)palloc(tupdesc->natts * sizeof(bool));
+	/*
+	 * The conditions are evaluated exactly once for each result, and the
+	 * tuples kept for rescans and in the result cache have already been
+	 * filtered by them, so they must not depend on parameters.
+	 */
+	if (qual == NIL || contain_volatile_functions((Node *)qual) ||
+	    contain_subplans((Node *)qual) ||
+	    contain_param_walker((Node *)qual, NULL))
+		return NULL;
 
-	/* Initialize to nulls for any columns not present in result */
-	memset(nulls, true, tupdesc->natts * sizeof(bool));
+	pull_varattnos((Node *)qual, fsplan->scan.scanrelid, &attrs);
 
-	foreach(lc, attrs_to_retrieve) {
-		int i = lfirst_int(lc);
+	i = -1;
+	while ((i = bms_next_member(attrs, i)) >= 0) {
+		AttrNumber attnum = i + FirstLowInvalidHeapAttributeNumber;
 
-		if (i > 0) {
-			/* ordinary column */
-			Assert(i <= tupdesc->natts);
-			attr = tupdesc->attrs[i - 1];
-			attname = NameStr(attr.attname);
-			nulls[i - 1] = scalardb_result_is_null(result, attname);
-			values[i - 1] = convert_result_column_to_datum(
-				result, attname, attr.atttypid);
-		}
+		/* System columns and whole-row references are not retrieved */
+		if (attnum <= 0)
+			return NULL;
+		filter_attrs = lappend_int(filter_attrs, attnum);
 	}
 
-	tuple = heap_form_tuple(tupdesc, values, nulls);
+	foreach(lc, attrs_to_retrieve) {
+		if (lfirst_int(lc) > 0)
+			num_attrs++;
+	}
+	if (list_length(filter_attrs) >= num_attrs)
+		return NULL;
+
+	late_filter = (ScalarDbFdwLateFilter *)palloc0(
+		sizeof(ScalarDbFdwLateFilter));
+	late_filter->attrs = filter_attrs;
+	late_filter->qual = node->ss.ps.qual;
+	late_filter->clauses = qual;
+	late_filter->econtext = fdw_state->result_econtext;
+	late_filter->slot = ExecInitExtraTupleSlot(
+		node->ss.ps.state,
+		node->ss.ss_ScanTupleSlot->tts_tupleDescriptor,
+		&TTSOpsVirtual);
+
+	/* The executor does not evaluate the conditions again */
+	node->ss.ps.qual = NULL;
+
+	return late_filter;
+}
 
-	return tuple;
+static bool contain_param_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Param))
+		return true;
+	return expression_tree_walker(node, contain_param_walker, context);
+}
+
+static bool contain_exec_param_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Param) && ((Param *)node)->paramkind == PARAM_EXEC)
+		return true;
+	return expression_tree_walker(node, contain_exec_param_walker,
+				      context);
+}
+
+/*
+ * Evaluate the conditions of late_filter on the values of the retrieved
+ * columns.
+ */
+static bool evaluate_late_filter(ScalarDbFdwLateFilter *late_filter,
+				 Datum *values, bool *nulls, int natts)
+{
+	TupleTableSlot *slot = late_filter->slot;
+
+	ExecClearTuple(slot);
+	memcpy(slot->tts_values, values, natts * sizeof(Datum));
+	memcpy(slot->tts_isnull, nulls, natts * sizeof(bool));
+	ExecStoreVirtualTuple(slot);
+
+	late_filter->econtext->ecxt_scantuple = slot;
+	return ExecQual(late_filter->qual, late_filter->econtext);
 }
 
 static Datum convert_result_column_to_datum(jobject result, char *attname,
@@ -800,15 +2738,15 @@ static Datum convert_result_column_to_datum(jobject result, char *attname,
 		return Int32GetDatum(val);
 	}
 	case INT8OID: {
-		int val = scalardb_result_get_bigint(result, attname);
+		int64 val = scalardb_result_get_bigint(result, attname);
 		return Int64GetDatum(val);
 	}
 	case FLOAT4OID: {
-		int val = scalardb_result_get_float(result, attname);
+		float4 val = scalardb_result_get_float(result, attname);
 		return Float4GetDatum(val);
 	}
 	case FLOAT8OID: {
-		int val = scalardb_result_get_double(result, attname);
+		float8 val = scalardb_result_get_double(result, attname);
 		return Float8GetDatum(val);
 	}
 	case TEXTOID: {
@@ -824,6 +2762,406 @@ static Datum convert_result_column_to_datum(jobject result, char *attname,
 	}
 }
 
+/*
+ * Build a ScalarDB Scan of the scan type with the conditions in fdw_state.
+ *
+ * `limit` is applied only to partition key scan, which is the only scan that
+ * reads a limited number of records.
+ */
+static jobject build_scan(ScalarDbFdwScanState *fdw_state, List *attnames,
+			  List *sort_column_names, List *sort_orders, int limit)
+{
+	switch (fdw_state->scan_type) {
+	case SCALARDB_SCAN_ALL:
+		return scalardb_scan_all(fdw_state->options.namespace,
+					 fdw_state->options.table_name,
+					 attnames, sort_column_names,
+					 sort_orders);
+	case SCALARDB_SCAN_PARTITION_KEY:
+		for (size_t i = 0; i < fdw_state->num_scan_conds; i++) {
+			if (type_is_array(fdw_state->scan_conds[i].value_type))
+				return build_partition_key_scans(
+					fdw_state, attnames, sort_column_names,
+					sort_orders, limit);
+		}
+		return scalardb_scan(fdw_state->options.namespace,
+				     fdw_state->options.table_name, attnames,
+				     fdw_state->scan_conds,
+				     fdw_state->num_scan_conds,
+				     fdw_state->boundary, sort_column_names,
+				     sort_orders, limit);
+	case SCALARDB_SCAN_SECONDARY_INDEX:
+		return scalardb_scan_with_index(fdw_state->options.namespace,
+						fdw_state->options.table_name,
+						attnames, fdw_state->scan_conds,
+						fdw_state->num_scan_conds, 0);
+	default:
+		elog(ERROR, "unexpected scan type: %d", fdw_state->scan_type);
+	}
+}
+
+/*
+ * Build a Scan for each combination of the values of the partition key IN
+ * lists and merge them into one Scan whose results are in the order of
+ * sort_column_names. NULL values in the lists match no records, so they are
+ * skipped, and the duplicated values are read only once.
+ */
+static jobject build_partition_key_scans(ScalarDbFdwScanState *fdw_state,
+					 List *attnames,
+					 List *sort_column_names,
+					 List *sort_orders, int limit)
+{
+	size_t num_conds = fdw_state->num_scan_conds;
+	ScalarDbFdwScanCondition *conds;
+	Datum **values;
+	int *num_values;
+	int *indexes;
+	jobject *scans;
+	int num_scans = 1;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	conds = palloc(sizeof(ScalarDbFdwScanCondition) * num_conds);
+	memcpy(conds, fdw_state->scan_conds,
+	       sizeof(ScalarDbFdwScanCondition) * num_conds);
+	values = palloc0(sizeof(Datum *) * num_conds);
+	num_values = palloc0(sizeof(int) * num_conds);
+	indexes = palloc0(sizeof(int) * num_conds);
+
+	for (size_t i = 0; i < num_conds; i++) {
+		Oid elemtype = get_element_type(conds[i].value_type);
+		int16 typlen;
+		bool typbyval;
+		char typalign;
+		Datum *elems;
+		bool *nulls;
+		int num_elems;
+
+		if (!OidIsValid(elemtype))
+			continue;
+
+		get_typlenbyvalalign(elemtype, &typlen, &typbyval, &typalign);
+		deconstruct_array(DatumGetArrayTypeP(conds[i].value), elemtype,
+				  typlen, typbyval, typalign, &elems, &nulls,
+				  &num_elems);
+
+		values[i] = palloc(sizeof(Datum) * Max(num_elems, 1));
+		for (int j = 0; j < num_elems; j++) {
+			if (!nulls[j])
+				values[i][num_values[i]++] = elems[j];
+		}
+		num_values[i] =
+			sort_unique_values(values[i], num_values[i], elemtype);
+		conds[i].value_type = elemtype;
+		num_scans *= num_values[i];
+	}
+
+	scans = palloc(sizeof(jobject) * Max(num_scans, 1));
+	for (int n = 0; n < num_scans; n++) {
+		for (size_t i = 0; i < num_conds; i++) {
+			if (values[i] != NULL)
+				conds[i].value = values[i][indexes[i]];
+		}
+
+		scans[n] = scalardb_scan(fdw_state->options.namespace,
+					 fdw_state->options.table_name,
+					 attnames, conds, num_conds,
+					 fdw_state->boundary, sort_column_names,
+					 sort_orders, limit);
+
+		/* Advance to the next combination like an odometer */
+		for (size_t i = num_conds; i > 0; i--) {
+			if (values[i - 1] == NULL)
+				continue;
+			if (++indexes[i - 1] < num_values[i - 1])
+				break;
+			indexes[i - 1] = 0;
+		}
+	}
+
+	return scalardb_merge_scans(scans, num_scans);
+}
+
+/*
+ * Sort the values of the given type and remove the duplicated ones. Returns
+ * the number of the remaining values. Text values are compared in binary
+ * order, which is enough to find the equal ones.
+ */
+static int sort_unique_values(Datum *values, int num_values, Oid type)
+{
+	TypeCacheEntry *typentry;
+	int n = 0;
+
+	if (num_values <= 1)
+		return num_values;
+
+	typentry = lookup_type_cache(type, TYPECACHE_CMP_PROC_FINFO);
+	if (!OidIsValid(typentry->cmp_proc_finfo.fn_oid))
+		return num_values;
+
+	qsort_arg(values, num_values, sizeof(Datum), compare_values,
+		  &typentry->cmp_proc_finfo);
+	for (int i = 0; i < num_values; i++) {
+		if (n == 0 || compare_values(&values[n - 1], &values[i],
+					     &typentry->cmp_proc_finfo) != 0)
+			values[n++] = values[i];
+	}
+	return n;
+}
+
+static int compare_values(const void *a, const void *b, void *arg)
+{
+	return DatumGetInt32(FunctionCall2Coll((FmgrInfo *)arg, C_COLLATION_OID,
+					       *(const Datum *)a,
+					       *(const Datum *)b));
+}
+
+/*
+ * Start the Scan. If there are conditions to be filtered on the ScalarDB side,
+ * only the records that satisfy them are returned by the Scanner.
+ */
+static jobject start_scan(ScalarDbFdwScanState *fdw_state)
+{
+	/* The statistics of the splits of a parallel scan are summed up */
+	reset_scan_stats(fdw_state);
+
+	if (fdw_state->parallel_aware)
+		return start_next_split(fdw_state);
+
+	return start_scan_of(fdw_state, fdw_state->scan);
+}
+
+static jobject start_scan_of(ScalarDbFdwScanState *fdw_state, jobject scan)
+{
+	jobject scanner;
+	instr_time start;
+
+	INSTR_TIME_SET_ZERO(start);
+	if (fdw_state->log_scan)
+		INSTR_TIME_SET_CURRENT(start);
+
+	if (fdw_state->num_filter_conds > 0)
+		scanner = scalardb_start_scan_with_filter(
+			scan, fdw_state->filter_conds,
+			fdw_state->num_filter_conds,
+			fdw_state->options.sample_percent,
+			fdw_state->options.transaction_aware,
+			fdw_state->options.fetch_size,
+			fdw_state->options.adaptive_fetch);
+	else
+		scanner = scalardb_start_scan(
+			scan, fdw_state->options.sample_percent,
+			fdw_state->options.transaction_aware,
+			fdw_state->options.fetch_size,
+			fdw_state->options.adaptive_fetch);
+
+	if (fdw_state->log_scan)
+		accumulate_time(&fdw_state->remote_time, &start);
+	return scanner;
+}
+
+/*
+ * Start the scan of the next range of the split Scan (all) that no other
+ * participant of the parallel scan has claimed. Returns NULL if all the ranges
+ * have been claimed.
+ */
+static jobject start_next_split(ScalarDbFdwScanState *fdw_state)
+{
+	int split;
+	jobject scan;
+	jobject scanner;
+
+	ereport(DEBUG3, errmsg("entering function %s", __func__));
+
+	/*
+	 * Without the DSM segment, e.g. when the plan is executed without
+	 * workers, this process reads all the ranges.
+	 */
+	if (fdw_state->split_state)
+		split = (int)pg_atomic_fetch_add_u32(
+			&fdw_state->split_state->next_split, 1);
+	else
+		split = fdw_state->next_split++;
+
+	if (split > fdw_state->num_split_boundaries)
+		return NULL;
+
+	scan = scalardb_split_scan_all(fdw_state->scan,
+				       fdw_state->split_boundaries,
+				       fdw_state->num_split_boundaries, split);
+	scanner = start_scan_of(fdw_state, scan);
+	scalardb_release_scan(scan);
+	return scanner;
+}
+
+/* Start collecting the statistics of a scan if log_min_duration is enabled */
+static void reset_scan_stats(ScalarDbFdwScanState *fdw_state)
+{
+	fdw_state->log_scan = log_min_duration >= 0;
+	if (fdw_state->log_scan) {
+		INSTR_TIME_SET_ZERO(fdw_state->remote_time);
+		INSTR_TIME_SET_ZERO(fdw_state->decode_time);
+		fdw_state->rows_fetched = 0;
+		fdw_state->bytes_fetched = 0;
+	}
+}
+
+/* Add the time elapsed since start to total, and restart it from now */
+static void accumulate_time(instr_time *total, instr_time *start)
+{
+	instr_time now;
+
+	INSTR_TIME_SET_CURRENT(now);
+	INSTR_TIME_ACCUM_DIFF(*total, now, *start);
+	*start = now;
+}
+
+/*
+ * Close the Scanner if open. The time to close it is counted in the remote
+ * time of the scan.
+ */
+static void close_scanner(ScalarDbFdwScanState *fdw_state)
+{
+	instr_time start;
+
+	if (!fdw_state->scanner)
+		return;
+
+	INSTR_TIME_SET_ZERO(start);
+	if (fdw_state->log_scan)
+		INSTR_TIME_SET_CURRENT(start);
+
+	scalardb_scanner_close(fdw_state->scanner);
+	fdw_state->scanner = NULL;
+
+	if (fdw_state->log_scan)
+		accumulate_time(&fdw_state->remote_time, &start);
+}
+
+/*
+ * Log the remote scan with its statistics if it has taken log_min_duration or
+ * longer. Each scan is logged once, after it has returned the last result and
+ * been closed, or when it is rescanned or ended before that. The scans of the
+ * aggregates computed on the ScalarDB side are logged together.
+ */
+static void log_scan_if_slow(ScalarDbFdwScanState *fdw_state)
+{
+	double remote_ms;
+	double decode_ms;
+	char *scan_str;
+
+	if (!fdw_state->log_scan)
+		return;
+	fdw_state->log_scan = false;
+
+	remote_ms = INSTR_TIME_GET_MILLISEC(fdw_state->remote_time);
+	decode_ms = INSTR_TIME_GET_MILLISEC(fdw_state->decode_time);
+	if (remote_ms + decode_ms < log_min_duration)
+		return;
+
+	if (fdw_state->aggregate_types != NIL)
+		scan_str = psprintf(
+			"aggregates %s",
+			aggregates_to_string(fdw_state->aggregate_types,
+					     fdw_state->aggregate_column_names));
+	else
+		scan_str = scalardb_to_string(fdw_state->scan);
+
+	ereport(LOG,
+		errmsg("duration: %.3f ms  ScalarDB scan of %s.%s",
+		       remote_ms + decode_ms, fdw_state->options.namespace,
+		       fdw_state->options.table_name),
+		errdetail_internal(
+			"Scan Type: %s, Rows: " UINT64_FORMAT
+			", Bytes: " UINT64_FORMAT
+			", Remote Time: %.3f ms, Decode Time: %.3f ms\n"
+			"Bound Keys: %s\n"
+			"Scan: %s",
+			scan_type_to_string(fdw_state->scan_type),
+			fdw_state->rows_fetched, fdw_state->bytes_fetched,
+			remote_ms, decode_ms, bound_keys_to_string(fdw_state),
+			scan_str));
+}
+
+/*
+ * Compute the aggregates on the ScalarDB side and make a tuple of them.
+ *
+ * COUNT(*) counts the records of the scan without retrieving them. MIN and
+ * MAX read the first record of the scan ordered by the aggregated column.
+ */
+static HeapTuple make_tuple_from_aggregates(ScalarDbFdwScanState *fdw_state,
+					    TupleDesc tupdesc)
+{
+	Datum *values;
+	bool *nulls;
+	ListCell *lc;
+
+	ereport(DEBUG5, errmsg("entering function %s", __func__));
+
+	values = (Datum *)palloc0(tupdesc->natts * sizeof(Datum));
+	nulls = (bool *)palloc(tupdesc->natts * sizeof(bool));
+	memset(nulls, true, tupdesc->natts * sizeof(bool));
+
+	foreach(lc, fdw_state->aggregate_types) {
+		int i = foreach_current_index(lc);
+		ScalarDbFdwAggregateType type =
+			(ScalarDbFdwAggregateType)lfirst_int(lc);
+		String *column_name =
+			list_nth(fdw_state->aggregate_column_names, i);
+		List *attnames = list_make1(column_name);
+		jobject scan;
+
+		switch (type) {
+		case SCALARDB_AGGREGATE_COUNT:
+			scan = build_scan(fdw_state, attnames, NIL, NIL, 0);
+			values[i] = Int64GetDatum(scalardb_count(
+				scan, fdw_state->options.sample_percent,
+				fdw_state->options.transaction_aware));
+			nulls[i] = false;
+			break;
+		case SCALARDB_AGGREGATE_MIN:
+		case SCALARDB_AGGREGATE_MAX: {
+			jobject scanner;
+			jobject result_optional;
+
+			scan = build_scan(
+				fdw_state, attnames,
+				list_nth(fdw_state->aggregate_sort_column_names,
+					 i),
+				list_nth(fdw_state->aggregate_sort_orders, i),
+				1);
+			scanner = scalardb_start_scan(
+				scan, fdw_state->options.sample_percent,
+				fdw_state->options.transaction_aware, 0, false);
+			result_optional = scalardb_scanner_one(scanner);
+
+			/* The result is NULL if there is no record */
+			if (scalardb_optional_is_present(result_optional)) {
+				jobject result =
+					scalardb_optional_get(result_optional);
+				char *attname = strVal(column_name);
+
+				nulls[i] = scalardb_result_is_null(result,
+								   attname);
+				if (!nulls[i])
+					values[i] = convert_result_column_to_datum(
+						result, attname,
+						TupleDescAttr(tupdesc, i)
+							->atttypid);
+			}
+			scalardb_scanner_release_result();
+			scalardb_scanner_close(scanner);
+			break;
+		}
+		default:
+			elog(ERROR, "unexpected aggregate type: %d", type);
+		}
+		scalardb_release_scan(scan);
+	}
+
+	return heap_form_tuple(tupdesc, values, nulls);
+}
+
 /* 
  * Prepare the scan conditions for the ScalarDB Scan by evaluating the fdw_expr.
  */
@@ -851,8 +3189,11 @@ static ScalarDbFdwScanCondition *prepare_scan_conds(ExprContext *econtext,
 		expr_value = ExecEvalExpr(expr_state, econtext, &isNull);
 
 		scan_conds[i].name = name;
-		scan_conds[i].value = isNull ? (Datum)NULL : expr_value;
 		scan_conds[i].value_type = exprType((Node *)expr);
+		scan_conds[i].value =
+			isNull ? (Datum)NULL :
+				 copy_cond_value(expr_value,
+						 scan_conds[i].value_type);
 	}
 	return scan_conds;
 }
@@ -889,7 +3230,9 @@ static ScalarDbFdwScanBoundary *prepare_scan_boundary(
 
 		expr_value = ExecEvalExpr(expr_state, econtext, &isNull);
 		boundary->start_values[i - start_expr_offset] =
-			isNull ? (Datum)NULL : expr_value;
+			isNull ? (Datum)NULL :
+				 copy_cond_value(expr_value,
+						 exprType((Node *)expr));
 		boundary->start_value_types = lappend_oid(
 			boundary->start_value_types, exprType((Node *)expr));
 	}
@@ -907,7 +3250,9 @@ static ScalarDbFdwScanBoundary *prepare_scan_boundary(
 
 		expr_value = ExecEvalExpr(expr_state, econtext, &isNull);
 		boundary->end_values[i - end_expr_offset] =
-			isNull ? (Datum)NULL : expr_value;
+			isNull ? (Datum)NULL :
+				 copy_cond_value(expr_value,
+						 exprType((Node *)expr));
 		boundary->end_value_types = lappend_oid(
 			boundary->end_value_types, exprType((Node *)expr));
 	}
@@ -915,6 +3260,68 @@ static ScalarDbFdwScanBoundary *prepare_scan_boundary(
 	return boundary;
 }
 
+/*
+ * Copy the value of a condition into the current memory context.
+ */
+static Datum copy_cond_value(Datum value, Oid value_type)
+{
+	int16 typlen;
+	bool typbyval;
+
+	get_typlenbyval(value_type, &typlen, &typbyval);
+	return datumCopy(value, typbyval, typlen);
+}
+
+/*
+ * Return true if the values of a condition are equal. The values are compared
+ * as binary, so equal values in different representations are regarded as
+ * different.
+ */
+static bool cond_value_equal(Datum value1, Datum value2, Oid value_type)
+{
+	int16 typlen;
+	bool typbyval;
+
+	get_typlenbyval(value_type, &typlen, &typbyval);
+	if (!typbyval && (value1 == (Datum)NULL || value2 == (Datum)NULL))
+		return value1 == value2;
+	return datumIsEqual(value1, value2, typbyval, typlen);
+}
+
+static bool scan_conds_equal(ScalarDbFdwScanCondition *conds1,
+			     ScalarDbFdwScanCondition *conds2,
+			     size_t num_conds)
+{
+	for (size_t i = 0; i < num_conds; i++) {
+		if (!cond_value_equal(conds1[i].value, conds2[i].value,
+				      conds1[i].value_type))
+			return false;
+	}
+	return true;
+}
+
+static bool scan_boundaries_equal(ScalarDbFdwScanBoundary *boundary1,
+				  ScalarDbFdwScanBoundary *boundary2)
+{
+	if (boundary1 == NULL || boundary2 == NULL)
+		return boundary1 == boundary2;
+
+	for (size_t i = 0; i < boundary1->num_start_values; i++) {
+		if (!cond_value_equal(
+			    boundary1->start_values[i],
+			    boundary2->start_values[i],
+			    list_nth_oid(boundary1->start_value_types, i)))
+			return false;
+	}
+	for (size_t i = 0; i < boundary1->num_end_values; i++) {
+		if (!cond_value_equal(
+			    boundary1->end_values[i], boundary2->end_values[i],
+			    list_nth_oid(boundary1->end_value_types, i)))
+			return false;
+	}
+	return true;
+}
+
 static char *scan_conds_to_string(ScalarDbFdwScanCondition *scan_conds,
 				  size_t num_scan_conds)
 {
@@ -937,7 +3344,14 @@ static char *scan_conds_to_string(ScalarDbFdwScanCondition *scan_conds,
 
 		appendStringInfo(&str, "%s = ", scan_cond->name);
 
-		if (scan_cond->value_type == BOOLOID) {
+		if (type_is_array(scan_cond->value_type)) {
+			/* IN list of a partition key */
+			getTypeOutputInfo(scan_cond->value_type, &typefnoid,
+					  &isvarlena);
+			appendStringInfo(&str, "ANY ('%s')",
+					 OidOutputFunctionCall(
+						 typefnoid, scan_cond->value));
+		} else if (scan_cond->value_type == BOOLOID) {
 			appendStringInfoString(
 				&str, DatumGetBool(scan_cond->value) ? "true" :
 								       "false");
@@ -1099,3 +3513,175 @@ static char *sort_to_string(List *sort_column_names, List *sort_orders)
 	}
 	return str.data;
 }
+
+static char *scan_type_to_string(ScalarDbFdwScanType scan_type)
+{
+	switch (scan_type) {
+	case SCALARDB_SCAN_ALL:
+		return "all";
+	case SCALARDB_SCAN_PARTITION_KEY:
+		return "partition key";
+	case SCALARDB_SCAN_SECONDARY_INDEX:
+		return "secondary index";
+	}
+	return NULL;
+}
+
+/*
+ * Show the keys of the conditions and the clustering key boundary of the scan
+ * with their current values, or "none" for Scan (all).
+ */
+static char *bound_keys_to_string(ScalarDbFdwScanState *fdw_state)
+{
+	StringInfoData str;
+	ScalarDbFdwScanBoundary *boundary = fdw_state->boundary;
+
+	initStringInfo(&str);
+	if (fdw_state->num_scan_conds > 0)
+		appendStringInfoString(
+			&str, scan_conds_to_string(fdw_state->scan_conds,
+						   fdw_state->num_scan_conds));
+	if (boundary != NULL && boundary->num_start_values > 0)
+		appendStringInfo(&str, "%s%s", str.len > 0 ? " AND " : "",
+				 scan_start_boundary_to_string(boundary));
+	if (boundary != NULL && boundary->num_end_values > 0)
+		appendStringInfo(&str, "%s%s", str.len > 0 ? " AND " : "",
+				 scan_end_boundary_to_string(boundary));
+	if (str.len == 0)
+		appendStringInfoString(&str, "none");
+	return str.data;
+}
+
+static char *aggregates_to_string(List *aggregate_types,
+				  List *aggregate_column_names)
+{
+	StringInfoData str;
+	ListCell *lc_type;
+	ListCell *lc_name;
+
+	ereport(DEBUG4, errmsg("entering function %s", __func__));
+
+	initStringInfo(&str);
+	forboth(lc_type, aggregate_types, lc_name, aggregate_column_names)
+	{
+		ScalarDbFdwAggregateType type =
+			(ScalarDbFdwAggregateType)lfirst_int(lc_type);
+
+		if (foreach_current_index(lc_type) > 0) {
+			appendStringInfoString(&str, ", ");
+		}
+
+		switch (type) {
+		case SCALARDB_AGGREGATE_COUNT:
+			appendStringInfoString(&str, "count(*)");
+			break;
+		case SCALARDB_AGGREGATE_MIN:
+			appendStringInfo(&str, "min(%s)",
+					 strVal(lfirst(lc_name)));
+			break;
+		case SCALARDB_AGGREGATE_MAX:
+			appendStringInfo(&str, "max(%s)",
+					 strVal(lfirst(lc_name)));
+			break;
+		}
+	}
+	return str.data;
+}
+
+/*
+ * Show the conditions of a parameterized scan with their expressions, which
+ * refer to the parameters supplied by the outer relation.
+ */
+static void explain_parameterized_conds(ForeignScanState *node,
+					ExplainState *es)
+{
+	ScalarDbFdwScanState *fdw_state =
+		(ScalarDbFdwScanState *)node->fdw_state;
+	List *context;
+	StringInfoData str;
+	int num_start_values = fdw_state->boundary_end_expr_offset -
+			       fdw_state->boundary_start_expr_offset;
+	int num_end_values = list_length(fdw_state->fdw_exprs) -
+			     fdw_state->boundary_end_expr_offset;
+
+	ereport(DEBUG4, errmsg("entering function %s", __func__));
+
+	context = set_deparse_context_plan(es->deparse_cxt, node->ss.ps.plan,
+					   NIL);
+
+	if (fdw_state->num_scan_conds > 0) {
+		initStringInfo(&str);
+		for (int i = 0; i < fdw_state->num_scan_conds; i++) {
+			if (i > 0)
+				appendStringInfoString(&str, " AND ");
+			append_deparsed_cond(
+				&str,
+				strVal(list_nth(fdw_state->condition_key_names,
+						i)),
+				"=", list_nth(fdw_state->fdw_exprs, i), context);
+		}
+		ExplainPropertyText("ScalarDB Scan Condition", str.data, es);
+	}
+
+	if (num_start_values > 0) {
+		initStringInfo(&str);
+		for (int i = 0; i < num_start_values; i++) {
+			char *op;
+
+			if (boolVal(list_nth(fdw_state->boundary_is_equals, i)))
+				op = "=";
+			else if (fdw_state->boundary_start_inclusive)
+				op = ">=";
+			else
+				op = ">";
+
+			if (i > 0)
+				appendStringInfoString(&str, " AND ");
+			append_deparsed_cond(
+				&str,
+				strVal(list_nth(fdw_state->boundary_column_names,
+						i)),
+				op,
+				list_nth(fdw_state->fdw_exprs,
+					 fdw_state->boundary_start_expr_offset +
+						 i),
+				context);
+		}
+		ExplainPropertyText("ScalarDB Scan Start", str.data, es);
+	}
+
+	if (num_end_values > 0) {
+		initStringInfo(&str);
+		for (int i = 0; i < num_end_values; i++) {
+			char *op;
+
+			if (boolVal(list_nth(fdw_state->boundary_is_equals, i)))
+				op = "=";
+			else if (fdw_state->boundary_end_inclusive)
+				op = "<=";
+			else
+				op = "<";
+
+			if (i > 0)
+				appendStringInfoString(&str, " AND ");
+			append_deparsed_cond(
+				&str,
+				strVal(list_nth(fdw_state->boundary_column_names,
+						i)),
+				op,
+				list_nth(fdw_state->fdw_exprs,
+					 fdw_state->boundary_end_expr_offset +
+						 i),
+				context);
+		}
+		ExplainPropertyText("ScalarDB Scan End", str.data, es);
+	}
+}
+
+static void append_deparsed_cond(StringInfo str, char *name, char *op,
+				 Expr *expr, List *context)
+{
+	appendStringInfo(str, "%s %s %s", name, op,
+			 deparse_expression((Node *)expr, context, false,
+					    false));
+}
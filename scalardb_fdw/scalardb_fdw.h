@@ -20,6 +20,7 @@
 #include "postgres.h"
 
 #include "condition.h"
+#include "cost.h"
 #include "option.h"
 
 /*
@@ -40,9 +41,27 @@ typedef struct {
 	ScalarDbFdwClusteringKeyBoundary boundary;
 	/* Type of Scan executed on the ScalarDB side. This must be consistent with the condtitions in remote_conds */
 	ScalarDbFdwScanType scan_type;
+	/* All conditions on the secondary indexes. Each of them is a candidate for the Scan with index */
+	List *secondary_index_conds;
 
 	/* set of the column metadata of the table*/
 	ScalarDbFdwColumnMetadata column_metadata;
+
+	/* Whether the storage can sort the results of Scan (all) across partitions */
+	bool can_order_scan_all;
+	/* Cost parameters of the storage, overridden by the options */
+	ScalarDbFdwScanCosts scan_costs;
+
+	/*
+	 * Boundaries that split Scan (all) into ranges read concurrently or by
+	 * parallel workers. List of Const of int8. NIL if the Scan is not split.
+	 * Computed on demand by get_split_boundaries()
+	 */
+	List *split_boundaries;
+	bool split_boundaries_computed;
+
+	/* Relation whose scan the aggregates are computed over. Set only for upper relations */
+	RelOptInfo *input_rel;
 } ScalarDbFdwPlanState;
 
 #endif
@@ -172,6 +172,21 @@ explain verbose select * from double_test where index = 1.0;
 explain verbose select * from text_test where index = '1';
 explain verbose select * from blob_test where index = E'\\xDEADBEEF';
 
+-- Test choosing one of the secondary indexes and filtering by the others on the ScalarDB side
+CREATE FOREIGN TABLE multi_index_test (
+    pk int,
+    ck int,
+    index1 int,
+    index2 int
+) SERVER scalardb OPTIONS (
+    namespace 'postgresns',
+    table_name 'multi_index_test'
+);
+explain (verbose, costs off) select * from multi_index_test where index1 = 1 and index2 = 1;
+-- The most selective index is chosen by the number of distinct values of the columns
+ALTER FOREIGN TABLE multi_index_test ALTER COLUMN index2 SET (n_distinct = -1);
+explain (verbose, costs off) select * from multi_index_test where index1 = 1 and index2 = 1;
+
 -- Test filtering push-down for boolean conditions
 explain verbose select * from boolean_test where pk;
 explain verbose select * from boolean_test where not pk;
@@ -230,9 +245,9 @@ select * from postgresns_test where p_pk = 1 AND p_ck1 = 1 AND p_ck2 > 0 AND p_c
 -- 
 -- Test sort push-down
 --
--- Sorting can be pushed down only for partition key scan
+-- Sorting can be pushed down for partition key scan, and for Scan (all) of a storage that can sort it
 explain verbose select * from int_test where pk = 1 order by ck; --OK
-explain verbose select * from int_test order by ck; --NG
+explain verbose select * from int_test order by ck; --OK
 explain verbose select * from int_test where index = 1 order by ck; --NG
 
 -- Whole ORDER BY clause must be able to be represented as clustering key orderings
@@ -247,9 +262,320 @@ explain verbose select * from postgresns_test where p_pk = 1 order by p_ck1 DESC
 explain verbose select * from postgresns_test where p_pk = 1 order by p_ck1 ASC, p_ck2 ASC; -- OK
 explain verbose select * from postgresns_test where p_pk = 1 order by p_ck1 DESC, p_ck2 DESC; -- OK
 explain verbose select * from postgresns_test where p_pk = 1 order by p_ck1 ASC, p_ck2 DESC; -- NG
+-- Text clustering keys are sorted on the ScalarDB side only with the "C" collation
+CREATE FOREIGN TABLE text_c_test (
+    pk text,
+    ck text COLLATE "C",
+    index text,
+    col text
+) SERVER scalardb OPTIONS (
+    namespace 'postgresns',
+    table_name 'text_test'
+);
+explain (verbose, costs off) select * from text_c_test where pk = '1' order by ck; -- OK
+explain (verbose, costs off) select * from text_c_test where pk = '1' order by ck desc; -- OK
+DROP FOREIGN TABLE text_c_test;
+-- ORDER BY on the clustering keys following the ones fixed by equality conditions is pushed down
+explain (verbose, costs off) select p_pk, p_ck1, p_ck2 from postgresns_test where p_pk = 1 and p_ck1 = 1 order by p_ck2; -- OK
+explain (verbose, costs off) select p_pk, p_ck1, p_ck2 from postgresns_test where p_pk = 1 and p_ck1 = 1 order by p_ck2 desc; -- OK
 
 -- Columns that are required to evaluate WHERE clause locally at PostgreSQL side must be returned from the remote server
 -- - ForeignScan on cassandrans_test must return c_boolean_col
 explain verbose select p_pk from postgresns_test inner join cassandrans_test on p_pk = c_pk where c_boolean_col;
 -- - The query must return 1 row
 select p_pk from postgresns_test inner join cassandrans_test on p_pk = c_pk where c_boolean_col;
+
+--
+-- Test aggregate push-down
+--
+-- COUNT(*) can be pushed down to any type of Scan
+explain (verbose, costs off) select count(*) from postgresns_test;
+select count(*) from postgresns_test;
+explain (verbose, costs off) select count(*) from cassandrans_test where c_pk = 1;
+select count(*) from cassandrans_test where c_pk = 1;
+-- MIN and MAX can be pushed down only on the first clustering key that is not fixed by equality conditions
+explain (verbose, costs off) select min(p_ck1), max(p_ck1) from postgresns_test where p_pk = 1; --OK
+select min(p_ck1), max(p_ck1) from postgresns_test where p_pk = 1;
+explain (verbose, costs off) select max(p_ck2) from postgresns_test where p_pk = 1 AND p_ck1 = 1; --OK
+select max(p_ck2) from postgresns_test where p_pk = 1 AND p_ck1 = 1;
+explain (verbose, costs off) select max(p_ck2) from postgresns_test where p_pk = 1; --NG
+-- The same aggregates appearing more than once are computed once
+explain (verbose, costs off) select count(*), max(p_ck1), count(*), max(p_ck1) from postgresns_test where p_pk = 1;
+select count(*), max(p_ck1), count(*), max(p_ck1) from postgresns_test where p_pk = 1;
+-- Aggregates must not be pushed down if any condition is evaluated locally
+explain (verbose, costs off) select count(*) from postgresns_test where p_int_col = 1; --NG
+select count(*) from postgresns_test where p_int_col = 1;
+
+--
+-- Test join push-down with parameterized paths
+--
+CREATE TABLE local_keys (k int);
+INSERT INTO local_keys VALUES (1);
+ANALYZE local_keys;
+SET enable_hashjoin = off;
+SET enable_mergejoin = off;
+-- The partition key is bound to the value of the outer relation for each rescan
+explain (verbose, costs off) select * from local_keys join postgresns_test on p_pk = k;
+select k, p_pk, p_ck1, p_ck2 from local_keys join postgresns_test on p_pk = k;
+RESET enable_hashjoin;
+RESET enable_mergejoin;
+DROP TABLE local_keys;
+
+--
+-- Test cost parameters
+--
+-- The defaults of the storage can be overridden by the server options
+ALTER SERVER scalardb OPTIONS (ADD fdw_startup_cost '50', ADD fdw_tuple_cost '0.1');
+explain select * from boolean_test where pk;
+-- and the table options take precedence over the server options
+ALTER FOREIGN TABLE boolean_test OPTIONS (ADD fdw_startup_cost '100', ADD fdw_round_trip_cost '0');
+explain select * from boolean_test where pk;
+ALTER FOREIGN TABLE boolean_test OPTIONS (DROP fdw_startup_cost, DROP fdw_round_trip_cost);
+ALTER SERVER scalardb OPTIONS (DROP fdw_startup_cost, DROP fdw_tuple_cost);
+-- The cost parameters must be non-negative numbers
+ALTER FOREIGN TABLE boolean_test OPTIONS (ADD fdw_tuple_cost '-1');
+ALTER FOREIGN TABLE boolean_test OPTIONS (ADD fdw_tuple_cost 'abc');
+-- The cost parameters can be measured against the storage
+select fdw_startup_cost >= 0 AND fdw_round_trip_cost >= 0 AND fdw_tuple_cost >= 0 AS calibrated
+from scalardb_fdw_calibrate_costs('postgresns_test', samples => 1);
+-- The rows of a Scan can be estimated by counting the records on the storage
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD use_remote_estimate 'true');
+explain select * from postgresns_test where p_pk = 1;
+ALTER FOREIGN TABLE postgresns_test OPTIONS (DROP use_remote_estimate);
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD remote_estimate_cache_ttl '-1');
+-- ANALYZE counts the records of each partition to estimate the rows of partition key scans
+ANALYZE postgresns_test;
+select partition_key, row_count from scalardb_fdw_partition_stats where relid = 'postgresns_test'::regclass;
+-- The partition statistics are visible only to the users that can read the foreign table
+CREATE ROLE regress_partition_stats_reader;
+SET ROLE regress_partition_stats_reader;
+select count(*) from scalardb_fdw_partition_stats where relid = 'postgresns_test'::regclass;
+select count(*) from scalardb_fdw_partition_statistic;
+RESET ROLE;
+DROP ROLE regress_partition_stats_reader;
+-- The partition statistics of a dropped foreign table are removed
+CREATE FOREIGN TABLE analyze_drop_test (
+    p_pk int,
+    p_ck1 int
+) SERVER scalardb OPTIONS (
+    namespace 'postgresns',
+    table_name 'postgresns_test'
+);
+ANALYZE analyze_drop_test;
+select 'analyze_drop_test'::regclass::oid as dropped_relid \gset
+select count(*) from scalardb_fdw_partition_statistic where relid = :dropped_relid;
+DROP FOREIGN TABLE analyze_drop_test;
+select count(*) from scalardb_fdw_partition_statistic where relid = :dropped_relid;
+explain select * from postgresns_test where p_pk = 1;
+-- Scans return only the records of the partitions sampled on the ScalarDB side
+ALTER FOREIGN TABLE int_test OPTIONS (ADD sample_percent '10');
+explain select * from int_test;
+ALTER FOREIGN TABLE int_test OPTIONS (DROP sample_percent);
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD sample_percent '50');
+select p_pk from postgresns_test;
+ALTER FOREIGN TABLE postgresns_test OPTIONS (SET sample_percent '70');
+select p_pk from postgresns_test;
+ALTER FOREIGN TABLE postgresns_test OPTIONS (DROP sample_percent);
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD sample_percent '0');
+-- Scans of transaction-aware tables return the committed values of the records
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD transaction_aware 'true');
+select p_pk from postgresns_test;
+select count(*) from postgresns_test;
+ALTER FOREIGN TABLE postgresns_test OPTIONS (DROP transaction_aware);
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD transaction_aware 'maybe');
+-- Copy the records of a foreign table into a local table
+CREATE TABLE postgresns_test_local (LIKE postgresns_test, PRIMARY KEY (p_pk, p_ck1, p_ck2));
+select scalardb_fdw_materialize('postgresns_test', 'postgresns_test_local');
+select p_pk, p_ck1, p_ck2, p_text_col from postgresns_test_local;
+-- Tables that are not transaction-aware are copied entirely every time
+select scalardb_fdw_materialize('postgresns_test', 'postgresns_test_local');
+select count(*) from scalardb_fdw_materializations;
+select * from scalardb_fdw_changes(NULL::postgresns_test, 0);
+select scalardb_fdw_materialize('postgresns_test_local', 'postgresns_test_local');
+-- Incremental copies of transaction-aware tables upsert the records committed after the watermark
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD transaction_aware 'true');
+select scalardb_fdw_materialize('postgresns_test', 'postgresns_test_local');
+select count(*) from scalardb_fdw_materializations;
+UPDATE postgresns_test_local SET p_text_col = 'stale';
+UPDATE scalardb_fdw_materializations SET committed_at = 9223372036854775807;
+select scalardb_fdw_materialize('postgresns_test', 'postgresns_test_local');
+select p_pk, p_text_col from postgresns_test_local;
+UPDATE scalardb_fdw_materializations SET committed_at = 1;
+select scalardb_fdw_materialize('postgresns_test', 'postgresns_test_local');
+select p_pk, p_text_col from postgresns_test_local;
+select committed_at > 1 as advanced from scalardb_fdw_materializations;
+-- Users that can read the foreign table and write the local table can copy it
+CREATE ROLE regress_materialize_user;
+GRANT SELECT ON postgresns_test TO regress_materialize_user;
+GRANT SELECT, INSERT, UPDATE ON postgresns_test_local TO regress_materialize_user;
+SET ROLE regress_materialize_user;
+select scalardb_fdw_materialize('postgresns_test', 'postgresns_test_local') >= 0 as copied;
+select count(*) from scalardb_fdw_materializations;
+UPDATE scalardb_fdw_materializations SET committed_at = 1;
+RESET ROLE;
+DROP OWNED BY regress_materialize_user;
+DROP ROLE regress_materialize_user;
+-- The watermarks of a dropped table are removed
+DROP TABLE postgresns_test_local;
+select count(*) from scalardb_fdw_materializations;
+ALTER FOREIGN TABLE postgresns_test OPTIONS (DROP transaction_aware);
+-- The results of partition key scans can be cached in shared memory
+-- The regression tests do not preload the library, so the cache is not used
+-- here and only the option is checked
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD result_cache_ttl '60');
+select p_pk, p_text_col from postgresns_test where p_pk = 1;
+select p_pk, p_text_col from postgresns_test where p_pk = 1;
+ALTER FOREIGN TABLE postgresns_test OPTIONS (DROP result_cache_ttl);
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD result_cache_ttl '-1');
+-- Generic plans of prepared statements rebind only the key values of the Scan
+SET plan_cache_mode = force_generic_plan;
+PREPARE lookup_test(int) AS select p_pk, p_text_col from postgresns_test where p_pk = $1;
+EXECUTE lookup_test(1);
+EXECUTE lookup_test(2);
+EXECUTE lookup_test(1);
+DEALLOCATE lookup_test;
+RESET plan_cache_mode;
+-- Rescans with the same parameter values replay the tuples already fetched
+select x, (select p_text_col from postgresns_test where p_pk = x) from (values (1), (1), (2), (1)) v(x);
+-- Simple local conditions are evaluated before the tuples are formed
+select p_pk from postgresns_test where p_bigint_col >= 1 and 1.5 > p_double_col and p_boolean_col and p_text_col is not null;
+select p_pk from postgresns_test where p_int_col < 1;
+select p_pk from postgresns_test where p_float_col <> 0 or p_int_col = 2;
+select p_pk from postgresns_test where not p_boolean_col;
+select p_pk from postgresns_test where p_blob_col is null;
+-- Local conditions can be evaluated before the other columns are retrieved
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD late_materialization 'true');
+explain (costs off) select p_pk, p_blob_col from postgresns_test where p_text_col like 'te%';
+select p_pk, p_blob_col from postgresns_test where p_text_col like 'te%';
+select p_pk, p_blob_col from postgresns_test where p_text_col like 'x%';
+ALTER FOREIGN TABLE postgresns_test OPTIONS (DROP late_materialization);
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD late_materialization 'maybe');
+-- Partition key IN lists are read by concurrent Scans whose results are merged
+explain (verbose, costs off) select p_pk, p_ck1 from postgresns_test where p_pk in (1, 2) order by p_ck1;
+select p_pk, p_ck1 from postgresns_test where p_pk in (1, 2, null) order by p_ck1;
+select count(*) from postgresns_test where p_pk in (1, 2);
+-- Scan (all) is split only if the storage can filter it by ranges
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD scan_all_splits '4');
+select p_pk, p_ck1 from postgresns_test;
+-- Scan (all) of a storage that cannot filter it by ranges is not read by
+-- parallel workers
+ALTER FOREIGN TABLE cassandrans_test OPTIONS (ADD scan_all_splits '4');
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+explain (costs off) select c_pk, c_ck1 from cassandrans_test;
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+ALTER FOREIGN TABLE cassandrans_test OPTIONS (DROP scan_all_splits);
+ALTER FOREIGN TABLE postgresns_test OPTIONS (DROP scan_all_splits);
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD scan_all_splits '-1');
+CREATE FOREIGN TABLE multi_row_test (
+    pk int,
+    ck int,
+    col int,
+    text_col text
+) SERVER scalardb OPTIONS (
+    namespace 'postgresns',
+    table_name 'multi_row_test'
+);
+-- Each record of a table of multiple partitions is read from exactly one of the ranges
+ALTER FOREIGN TABLE multi_row_test OPTIONS (ADD scan_all_splits '4');
+SET max_parallel_workers_per_gather = 0;
+explain (verbose, costs off) select pk, ck from multi_row_test;
+select count(col), sum(col) from multi_row_test;
+select pk, count(ck) from multi_row_test group by pk order by pk;
+RESET max_parallel_workers_per_gather;
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+select count(col), sum(col) from multi_row_test;
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+ALTER FOREIGN TABLE multi_row_test OPTIONS (DROP scan_all_splits);
+-- Scan (all) is sorted by the storage, in any direction of each key column
+explain (verbose, costs off) select pk, ck, col from multi_row_test order by ck desc, pk;
+select pk, ck, col from multi_row_test order by ck desc, pk;
+-- The duplicated values of partition key IN lists are read only once
+select pk, count(ck) from multi_row_test where pk in (3, 1, 3, null, 1) group by pk order by pk;
+select count(*) from multi_row_test where pk in (2, 2);
+CREATE FOREIGN TABLE text_value_test (
+    pk int,
+    ck int,
+    text_col text
+) SERVER scalardb OPTIONS (
+    namespace 'postgresns',
+    table_name 'text_value_test'
+);
+-- The TEXT values are read correctly after the dictionary of the values is full
+select count(*), count(distinct text_col), sum(length(text_col)), md5(string_agg(text_col, ',' order by ck)) from text_value_test where pk = 1;
+-- The values too long to be added to the dictionary are read correctly
+select count(*), count(distinct text_col), sum(length(text_col)), md5(string_agg(text_col, ',' order by ck)) from text_value_test where pk = 2;
+-- Values larger than the initial buffer of the values and non-ASCII values are read correctly
+select ck, length(text_col), octet_length(text_col), md5(text_col) from text_value_test where pk = 3 order by ck;
+select text_col = 'héllo wörld ✓ 日本語 😀' as equal from text_value_test where pk = 3 and ck = 2;
+-- The buffer enlarged for a large value is freed at the end of each scan and enlarged again
+select md5(text_col) from text_value_test where pk = 3 and ck = 1;
+-- A merge join of partition key scans uses the clustering order without a local Sort
+SET enable_hashjoin = off;
+SET enable_nestloop = off;
+explain (verbose, costs off) select a.ck, a.col, b.col from multi_row_test a join multi_row_test b on a.ck = b.ck where a.pk = 1 and b.pk = 2;
+select a.ck, a.col, b.col from multi_row_test a join multi_row_test b on a.ck = b.ck where a.pk = 1 and b.pk = 2;
+RESET enable_hashjoin;
+RESET enable_nestloop;
+-- Partition key scans are read in pages of fetch_size records
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD fetch_size '1', ADD adaptive_fetch 'true');
+explain (costs off) select p_pk, p_ck1 from postgresns_test where p_pk = 1;
+select p_pk, p_ck1 from postgresns_test where p_pk = 1;
+select p_pk, p_ck1 from postgresns_test where p_pk = 1 order by p_ck1 desc;
+ALTER FOREIGN TABLE postgresns_test OPTIONS (DROP fetch_size, DROP adaptive_fetch);
+ALTER FOREIGN TABLE postgresns_test OPTIONS (ADD fetch_size '-1');
+-- Pages of a partition of multiple records continue after the last record of the previous page
+ALTER FOREIGN TABLE multi_row_test OPTIONS (ADD fetch_size '2');
+select ck, col from multi_row_test where pk = 2;
+select ck, col from multi_row_test where pk = 2 order by ck desc;
+select ck, col from multi_row_test where pk = 2 and ck >= 2 order by ck desc limit 3;
+ALTER FOREIGN TABLE multi_row_test OPTIONS (SET fetch_size '3', ADD adaptive_fetch 'true');
+select ck, col from multi_row_test where pk = 2 order by ck desc;
+ALTER FOREIGN TABLE multi_row_test OPTIONS (DROP fetch_size, DROP adaptive_fetch);
+-- Tables of multiple clustering key columns are not read in pages, so no record is skipped
+CREATE FOREIGN TABLE multi_ck_test (
+    pk int,
+    ck1 int,
+    ck2 int,
+    col int
+) SERVER scalardb OPTIONS (
+    namespace 'postgresns',
+    table_name 'multi_ck_test',
+    fetch_size '2'
+);
+select ck1, ck2, col from multi_ck_test where pk = 1;
+select ck1, ck2, col from multi_ck_test where pk = 1 order by ck1 desc, ck2 desc;
+select ck1, ck2, col from multi_ck_test where pk = 1 and ck1 >= 2;
+DROP FOREIGN TABLE multi_ck_test;
+-- Statistics of the JVM of this backend
+select pid = pg_backend_pid() as pid, heap_used > 0 as heap_used, heap_committed >= heap_used as heap_committed, threads >= daemon_threads as threads, open_scanners >= 0 as open_scanners from scalardb_fdw_jvm_stats();
+-- A canceled query stops waiting for the remote scans, and the backend can scan again
+SET statement_timeout = '1ms';
+select count(*) from multi_row_test a, multi_row_test b, multi_row_test c, multi_row_test d;
+RESET statement_timeout;
+select count(*), sum(col) from multi_row_test;
+-- Flight recordings accept only the settings shipped with the JVM
+select scalardb_fdw_start_flight_recording(settings => 'unknown');
+select scalardb_fdw_start_flight_recording(settings => NULL);
+select scalardb_fdw_stop_flight_recording();
+-- Recordings of other backends require the library in shared_preload_libraries
+select scalardb_fdw_start_flight_recording(pid => 0);
+select scalardb_fdw_stop_flight_recording(pid => 0);
+-- Remote scans that take log_min_duration or longer are logged. Only the
+-- SQLSTATE of the log messages is shown, since they contain the durations.
+SET client_min_messages = log;
+\set VERBOSITY sqlstate
+SET scalardb_fdw.log_min_duration = '1h';
+select p_pk, p_ck1 from postgresns_test where p_pk = 1;
+SET scalardb_fdw.log_min_duration = 0;
+select p_pk, p_ck1 from postgresns_test where p_pk = 1;
+-- The aggregates computed by ScalarDB are logged
+select count(*) from multi_row_test where pk = 2;
+-- A scan stopped by LIMIT is logged when it is ended
+select ck from multi_row_test where pk = 1 limit 2;
+RESET scalardb_fdw.log_min_duration;
+\set VERBOSITY default
+RESET client_min_messages;
@@ -25,6 +25,7 @@ import com.scalar.db.io.Key;
 import com.scalar.db.service.TransactionFactory;
 import java.nio.file.Path;
 import java.nio.file.Paths;
+import java.util.Collections;
 import org.slf4j.Logger;
 import org.slf4j.LoggerFactory;
 
@@ -44,6 +45,15 @@ public class TestDataLoader {
   private static final String DOUBLE_TEST_TABLE = "double_test";
   private static final String TEXT_TEST_TABLE = "text_test";
   private static final String BLOB_TEST_TABLE = "blob_test";
+  private static final String MULTI_INDEX_TEST_TABLE = "multi_index_test";
+  private static final String MULTI_ROW_TEST_TABLE = "multi_row_test";
+  private static final int MULTI_ROW_TEST_PARTITIONS = 4;
+  private static final int MULTI_ROW_TEST_RECORDS_PER_PARTITION = 5;
+  private static final String TEXT_VALUE_TEST_TABLE = "text_value_test";
+  private static final int TEXT_VALUE_TEST_DISTINCT_VALUES = 1100;
+  private static final int TEXT_VALUE_TEST_RECORDS = 1200;
+  private static final String MULTI_CK_TEST_TABLE = "multi_ck_test";
+  private static final int MULTI_CK_TEST_VALUES_PER_CK = 3;
 
   public static void main(String... args) {
     if (args.length != 1) {
@@ -82,6 +92,10 @@ public class TestDataLoader {
       createDoubleTestTable(admin);
       createTextTestTable(admin);
       createBlobTestTable(admin);
+      createMultiIndexTestTable(admin);
+      createMultiRowTestTable(admin);
+      createTextValueTestTable(admin);
+      createMultiCkTestTable(admin);
     } finally {
       admin.close();
     }
@@ -340,6 +354,94 @@ public class TestDataLoader {
     admin.createTable(POSTGRES_NAMESPACE, BLOB_TEST_TABLE, tableMetadata, true);
   }
 
+  private static void createMultiIndexTestTable(DistributedTransactionAdmin admin)
+      throws ExecutionException {
+    if (admin.tableExists(POSTGRES_NAMESPACE, MULTI_INDEX_TEST_TABLE)) {
+      logger.info("postgresns.multi_index_test already exists. Truncating it");
+      admin.truncateTable(POSTGRES_NAMESPACE, MULTI_INDEX_TEST_TABLE);
+      return;
+    }
+
+    DataType type = DataType.INT;
+
+    logger.info("Creating postgresns.multi_index_test table");
+    TableMetadata tableMetadata =
+        TableMetadata.newBuilder()
+            .addColumn("pk", type)
+            .addColumn("ck", type)
+            .addColumn("index1", type)
+            .addColumn("index2", type)
+            .addPartitionKey("pk")
+            .addClusteringKey("ck")
+            .addSecondaryIndex("index1")
+            .addSecondaryIndex("index2")
+            .build();
+    admin.createTable(POSTGRES_NAMESPACE, MULTI_INDEX_TEST_TABLE, tableMetadata, true);
+  }
+
+  private static void createMultiRowTestTable(DistributedTransactionAdmin admin)
+      throws ExecutionException {
+    if (admin.tableExists(POSTGRES_NAMESPACE, MULTI_ROW_TEST_TABLE)) {
+      logger.info("postgresns.multi_row_test already exists. Truncating it");
+      admin.truncateTable(POSTGRES_NAMESPACE, MULTI_ROW_TEST_TABLE);
+      return;
+    }
+
+    logger.info("Creating postgresns.multi_row_test table");
+    TableMetadata tableMetadata =
+        TableMetadata.newBuilder()
+            .addColumn("pk", DataType.INT)
+            .addColumn("ck", DataType.INT)
+            .addColumn("col", DataType.INT)
+            .addColumn("text_col", DataType.TEXT)
+            .addPartitionKey("pk")
+            .addClusteringKey("ck")
+            .build();
+    admin.createTable(POSTGRES_NAMESPACE, MULTI_ROW_TEST_TABLE, tableMetadata, true);
+  }
+
+  private static void createTextValueTestTable(DistributedTransactionAdmin admin)
+      throws ExecutionException {
+    if (admin.tableExists(POSTGRES_NAMESPACE, TEXT_VALUE_TEST_TABLE)) {
+      logger.info("postgresns.text_value_test already exists. Truncating it");
+      admin.truncateTable(POSTGRES_NAMESPACE, TEXT_VALUE_TEST_TABLE);
+      return;
+    }
+
+    logger.info("Creating postgresns.text_value_test table");
+    TableMetadata tableMetadata =
+        TableMetadata.newBuilder()
+            .addColumn("pk", DataType.INT)
+            .addColumn("ck", DataType.INT)
+            .addColumn("text_col", DataType.TEXT)
+            .addPartitionKey("pk")
+            .addClusteringKey("ck")
+            .build();
+    admin.createTable(POSTGRES_NAMESPACE, TEXT_VALUE_TEST_TABLE, tableMetadata, true);
+  }
+
+  private static void createMultiCkTestTable(DistributedTransactionAdmin admin)
+      throws ExecutionException {
+    if (admin.tableExists(POSTGRES_NAMESPACE, MULTI_CK_TEST_TABLE)) {
+      logger.info("postgresns.multi_ck_test already exists. Truncating it");
+      admin.truncateTable(POSTGRES_NAMESPACE, MULTI_CK_TEST_TABLE);
+      return;
+    }
+
+    logger.info("Creating postgresns.multi_ck_test table");
+    TableMetadata tableMetadata =
+        TableMetadata.newBuilder()
+            .addColumn("pk", DataType.INT)
+            .addColumn("ck1", DataType.INT)
+            .addColumn("ck2", DataType.INT)
+            .addColumn("col", DataType.INT)
+            .addPartitionKey("pk")
+            .addClusteringKey("ck1")
+            .addClusteringKey("ck2")
+            .build();
+    admin.createTable(POSTGRES_NAMESPACE, MULTI_CK_TEST_TABLE, tableMetadata, true);
+  }
+
   private static void loadTestData(TransactionFactory factory) throws TransactionException {
     DistributedTransactionManager manager = factory.getTransactionManager();
     DistributedTransaction tx = manager.start();
@@ -347,6 +449,9 @@ public class TestDataLoader {
       loadCassandraTestData(tx);
       loadPostgresTestData(tx);
       loadPostgresNullTestData(tx);
+      loadMultiRowTestData(tx);
+      loadTextValueTestData(tx);
+      loadMultiCkTestData(tx);
       tx.commit();
     } catch (CrudException | CommitException e) {
       tx.rollback();
@@ -403,4 +508,83 @@ public class TestDataLoader {
             .build();
     tx.put(put);
   }
+
+  /**
+   * Loads the records of multiple partitions, each of which has multiple records, to test the scans
+   * that are split, paged or merged. The value of col is pk * 10 + ck.
+   */
+  private static void loadMultiRowTestData(DistributedTransaction tx) throws CrudException {
+    logger.info("Loading postgresns.multi_row_test table data");
+    for (int pk = 1; pk <= MULTI_ROW_TEST_PARTITIONS; pk++) {
+      for (int ck = 1; ck <= MULTI_ROW_TEST_RECORDS_PER_PARTITION; ck++) {
+        int col = pk * 10 + ck;
+        Put put =
+            Put.newBuilder()
+                .namespace(POSTGRES_NAMESPACE)
+                .table(MULTI_ROW_TEST_TABLE)
+                .partitionKey(Key.ofInt("pk", pk))
+                .clusteringKey(Key.ofInt("ck", ck))
+                .intValue("col", col)
+                .textValue("text_col", "t" + col)
+                .build();
+        tx.put(put);
+      }
+    }
+  }
+
+  /**
+   * Loads the TEXT values to test the dictionaries of the values. Partition 1 has more distinct
+   * values than a dictionary can hold, and the value of each record is "v" + ck % 1100. Partition
+   * 2 has a value too long to be added to a dictionary, 300 'l's, in the odd ck and "short" in the
+   * even ck. Partition 3 has a value larger than the initial buffer of the values, 30000 U+3042
+   * characters in 90000 bytes, a non-ASCII value that has a supplementary character, and an ASCII
+   * value.
+   */
+  private static void loadTextValueTestData(DistributedTransaction tx) throws CrudException {
+    logger.info("Loading postgresns.text_value_test table data");
+    for (int ck = 1; ck <= TEXT_VALUE_TEST_RECORDS; ck++) {
+      putTextValue(tx, 1, ck, "v" + ck % TEXT_VALUE_TEST_DISTINCT_VALUES);
+    }
+    String longValue = String.join("", Collections.nCopies(300, "l"));
+    for (int ck = 1; ck <= 6; ck++) {
+      putTextValue(tx, 2, ck, ck % 2 == 1 ? longValue : "short");
+    }
+    putTextValue(tx, 3, 1, String.join("", Collections.nCopies(30000, "\u3042")));
+    putTextValue(tx, 3, 2, "h\u00e9llo w\u00f6rld \u2713 \u65e5\u672c\u8a9e \uD83D\uDE00");
+    putTextValue(tx, 3, 3, "ascii");
+  }
+
+  private static void putTextValue(DistributedTransaction tx, int pk, int ck, String value)
+      throws CrudException {
+    Put put =
+        Put.newBuilder()
+            .namespace(POSTGRES_NAMESPACE)
+            .table(TEXT_VALUE_TEST_TABLE)
+            .partitionKey(Key.ofInt("pk", pk))
+            .clusteringKey(Key.ofInt("ck", ck))
+            .textValue("text_col", value)
+            .build();
+    tx.put(put);
+  }
+
+  /**
+   * Loads the records of a partition of a table with two clustering key columns, ck1 and ck2, each
+   * from 1 to 3. The value of col is ck1 * 10 + ck2.
+   */
+  private static void loadMultiCkTestData(DistributedTransaction tx) throws CrudException {
+    logger.info("Loading postgresns.multi_ck_test table data");
+    for (int ck1 = 1; ck1 <= MULTI_CK_TEST_VALUES_PER_CK; ck1++) {
+      for (int ck2 = 1; ck2 <= MULTI_CK_TEST_VALUES_PER_CK; ck2++) {
+        Put put =
+            Put.newBuilder()
+                .namespace(POSTGRES_NAMESPACE)
+                .table(MULTI_CK_TEST_TABLE)
+                .partitionKey(Key.ofInt("pk", 1))
+                .clusteringKey(Key.of("ck1", ck1, "ck2", ck2))
+                .intValue("col", ck1 * 10 + ck2)
+                .build();
+        tx.put(put);
+      }
+    }
+  }
 }
@@ -18,6 +18,7 @@ package com.scalar.db.analytics.postgresql.schemaimporter
 import com.scalar.db.api.DistributedStorageAdmin
 import com.scalar.db.api.TableMetadata
 import com.scalar.db.io.DataType
+import com.scalar.db.transaction.consensuscommit.ConsensusCommitUtils
 import mu.KotlinLogging
 
 private val logger = KotlinLogging.logger {}
@@ -42,11 +43,20 @@ class CreateForeignTables(
                         ?: throw IllegalArgumentException(
                             "Table metadata not found: $ns.$tableName",
                         )
-                val foreignTableName = escapeTableName(ns, tableName)
-                val columnDefinitions = getForeignTableColumnDefinitions(metadata)
-                val options = getForeignTableOptions(ns, tableName, storageForNamespace)
+                // scalardb_fdw resolves the committed values by itself, so the foreign table is
+                // exposed directly without the transaction metadata columns
+                val transactionAware =
+                    useScalarDBFdw(storageForNamespace) &&
+                        ConsensusCommitUtils.isTransactionTableMetadata(metadata)
+                val foreignTableName = escapeTableName(ns, tableName, storageForNamespace)
+                val columnDefinitions = getForeignTableColumnDefinitions(metadata, transactionAware)
+                val options = getForeignTableOptions(ns, tableName, storageForNamespace, transactionAware)
                 val serverName = escapeIdentifier(storageForNamespace.serverName)
 
+                if (useScalarDBFdw(storageForNamespace)) {
+                    dropObjectsOfOlderImport(ns, tableName)
+                }
+
                 logger.info { "Creating foreign table: $foreignTableName for $serverName" }
                 ctx.useStatement {
                     executeUpdateWithLogging(
@@ -65,21 +75,71 @@ class CreateForeignTables(
         }
     }
 
-    private fun escapeTableName(schema: String, table: String): String =
-        "${escapeIdentifier(schema)}.${escapeIdentifier("_$table")}"
+    /**
+     * Drops the raw foreign table `_<table>` and the view `<table>` over it, which older versions
+     * created for the tables of scalardb_fdw. Otherwise, the view would remain in place of the
+     * transaction-aware foreign table. The objects are dropped without CASCADE, so the import fails
+     * if the user has created objects that depend on them.
+     */
+    private fun dropObjectsOfOlderImport(
+        schema: String,
+        table: String,
+    ) {
+        val viewName = "${escapeIdentifier(schema)}.${escapeIdentifier(table)}"
+        val rawTableName = "${escapeIdentifier(schema)}.${escapeIdentifier("_$table")}"
+
+        logger.info { "Dropping view $viewName and foreign table $rawTableName if they exist" }
+        ctx.useStatement {
+            executeUpdateWithLogging(
+                it,
+                logger,
+                """
+                    |DO $$
+                    |BEGIN
+                    |    IF EXISTS (SELECT FROM pg_class WHERE oid = to_regclass('${escapeLiteral(viewName)}') AND relkind = 'v') THEN
+                    |        DROP VIEW $viewName;
+                    |    END IF;
+                    |    IF EXISTS (SELECT FROM pg_class WHERE oid = to_regclass('${escapeLiteral(rawTableName)}') AND relkind = 'f') THEN
+                    |        DROP FOREIGN TABLE $rawTableName;
+                    |    END IF;
+                    |END
+                    |$$;
+                    """
+                    .trimMargin(),
+            )
+        }
+    }
+
+    private fun escapeTableName(
+        schema: String,
+        table: String,
+        storage: ScalarDBStorage.SingleStorage,
+    ): String =
+        if (useScalarDBFdw(storage)) {
+            "${escapeIdentifier(schema)}.${escapeIdentifier(table)}"
+        } else {
+            "${escapeIdentifier(schema)}.${escapeIdentifier("_$table")}"
+        }
 
     private fun getForeignTableColumnDefinitions(
         metadata: TableMetadata,
+        transactionAware: Boolean,
         indent: String = "    ",
-    ): String = getColumnInfoList(metadata).joinToString(",\n") { (col, typ) -> "$indent${escapeIdentifier(col)} $typ" }
+    ): String =
+        getColumnInfoList(metadata, transactionAware).joinToString(",\n") { (col, typ) ->
+            "$indent${escapeIdentifier(col)} $typ"
+        }
 
     private fun getColumnInfoList(
         metadata: TableMetadata,
+        transactionAware: Boolean,
     ): List<Pair<String, String>> =
-        metadata.columnNames.map { col ->
-            val typ = metadata.getColumnDataType(col)
-            col to getPgType(typ)
-        }
+        metadata.columnNames
+            .filter { !transactionAware || !ConsensusCommitUtils.isTransactionMetaColumn(it, metadata) }
+            .map { col ->
+                val typ = metadata.getColumnDataType(col)
+                col to getPgType(typ)
+            }
 
     private fun getPgType(typ: DataType): String =
         when (typ) {
@@ -96,9 +156,10 @@ class CreateForeignTables(
         namespace: String,
         tableName: String,
         storage: ScalarDBStorage.SingleStorage,
+        transactionAware: Boolean,
     ): Set<String> =
         if (useScalarDBFdw(storage)) {
-            getForeignTableOptionsForScalarDBFdw(namespace, tableName)
+            getForeignTableOptionsForScalarDBFdw(namespace, tableName, transactionAware)
         } else {
             getForeignTableOptionsForNativeFdw(namespace, tableName, storage)
         }
@@ -121,5 +182,9 @@ class CreateForeignTables(
     private fun getForeignTableOptionsForScalarDBFdw(
         namespace: String,
         tableName: String,
-    ): Set<String> = setOf("namespace '${escapeLiteral(namespace)}'", "table_name '${escapeLiteral(tableName)}'")
+        transactionAware: Boolean,
+    ): Set<String> {
+        val options = setOf("namespace '${escapeLiteral(namespace)}'", "table_name '${escapeLiteral(tableName)}'")
+        return if (transactionAware) options + "transaction_aware 'true'" else options
+    }
 }
@@ -27,11 +27,22 @@ private val escapedBeforeStateColumn: String = escapeIdentifier(Attribute.BEFORE
 class CreateViews(
     private val ctx: DatabaseContext,
     private val namespaces: Set<String>,
+    private val storage: ScalarDBStorage,
     private val admin: DistributedStorageAdmin,
 ) {
 
     fun run() {
         for (ns in namespaces) {
+            val storageForNamespace: ScalarDBStorage.SingleStorage =
+                when (storage) {
+                    is ScalarDBStorage.MultiStorage -> storage.getStorageForNamespace(ns)
+                    is ScalarDBStorage.SingleStorage -> storage
+                }
+            // The foreign tables of scalardb_fdw are transaction-aware, so no view is needed
+            if (useScalarDBFdw(storageForNamespace)) {
+                continue
+            }
+
             for (tableName in admin.getNamespaceTableNames(ns)) {
                 val metadata =
                     admin.getTableMetadata(ns, tableName)
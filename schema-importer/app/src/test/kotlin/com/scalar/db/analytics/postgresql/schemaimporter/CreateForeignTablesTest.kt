@@ -189,15 +189,16 @@ class CreateForeignTablesTest {
     }
 
     @Test
-    fun `run should create a foreign table including log data for cosmos storage`() {
+    fun `run should create a transaction-aware foreign table for cosmos storage`() {
         val config = mockk<DatabaseConfig>()
         val storage = ScalarDBStorage.Cosmos(config)
         CreateForeignTables(ctx, setOf("ns_for_cosmos"), storage, admin).run()
 
         verify {
+            statement.executeUpdate(dropObjectsOfOlderImport("ns_for_cosmos", "cosmos_table"))
             statement.executeUpdate(
                 """
-                |CREATE FOREIGN TABLE IF NOT EXISTS "ns_for_cosmos"."_cosmos_table" (
+                |CREATE FOREIGN TABLE IF NOT EXISTS "ns_for_cosmos"."cosmos_table" (
                 |    "pk" int,
                 |    "ck1" int,
                 |    "ck2" int,
@@ -207,26 +208,9 @@ class CreateForeignTablesTest {
                 |    "float_col" float,
                 |    "double_col" double precision,
                 |    "text_col" text,
-                |    "blob_col" bytea,
-                |    "tx_id" text,
-                |    "tx_state" int,
-                |    "tx_version" int,
-                |    "tx_prepared_at" bigint,
-                |    "tx_committed_at" bigint,
-                |    "before_tx_id" text,
-                |    "before_tx_state" int,
-                |    "before_tx_version" int,
-                |    "before_tx_prepared_at" bigint,
-                |    "before_tx_committed_at" bigint,
-                |    "before_boolean_col" int,
-                |    "before_int_col" int,
-                |    "before_bigint_col" bigint,
-                |    "before_float_col" float,
-                |    "before_double_col" double precision,
-                |    "before_text_col" text,
-                |    "before_blob_col" bytea
+                |    "blob_col" bytea
                 |) SERVER "cosmos"
-                |OPTIONS (namespace 'ns_for_cosmos', table_name 'cosmos_table');
+                |OPTIONS (namespace 'ns_for_cosmos', table_name 'cosmos_table', transaction_aware 'true');
                 """
                     .trimMargin(),
             )
@@ -236,15 +220,16 @@ class CreateForeignTablesTest {
     }
 
     @Test
-    fun `run should create a foreign table including log data for dynamodb storage`() {
+    fun `run should create a transaction-aware foreign table for dynamodb storage`() {
         val config = mockk<DatabaseConfig>()
         val storage = ScalarDBStorage.DynamoDB(config)
         CreateForeignTables(ctx, setOf("ns_for_dynamodb"), storage, admin).run()
 
         verify {
+            statement.executeUpdate(dropObjectsOfOlderImport("ns_for_dynamodb", "dynamodb_table"))
             statement.executeUpdate(
                 """
-                |CREATE FOREIGN TABLE IF NOT EXISTS "ns_for_dynamodb"."_dynamodb_table" (
+                |CREATE FOREIGN TABLE IF NOT EXISTS "ns_for_dynamodb"."dynamodb_table" (
                 |    "pk" int,
                 |    "ck1" int,
                 |    "ck2" int,
@@ -254,26 +239,9 @@ class CreateForeignTablesTest {
                 |    "float_col" float,
                 |    "double_col" double precision,
                 |    "text_col" text,
-                |    "blob_col" bytea,
-                |    "tx_id" text,
-                |    "tx_state" int,
-                |    "tx_version" int,
-                |    "tx_prepared_at" bigint,
-                |    "tx_committed_at" bigint,
-                |    "before_tx_id" text,
-                |    "before_tx_state" int,
-                |    "before_tx_version" int,
-                |    "before_tx_prepared_at" bigint,
-                |    "before_tx_committed_at" bigint,
-                |    "before_boolean_col" int,
-                |    "before_int_col" int,
-                |    "before_bigint_col" bigint,
-                |    "before_float_col" float,
-                |    "before_double_col" double precision,
-                |    "before_text_col" text,
-                |    "before_blob_col" bytea
+                |    "blob_col" bytea
                 |) SERVER "dynamodb"
-                |OPTIONS (namespace 'ns_for_dynamodb', table_name 'dynamodb_table');
+                |OPTIONS (namespace 'ns_for_dynamodb', table_name 'dynamodb_table', transaction_aware 'true');
                 """
                     .trimMargin(),
             )
@@ -391,9 +359,10 @@ class CreateForeignTablesTest {
                 """
                     .trimMargin(),
             )
+            statement.executeUpdate(dropObjectsOfOlderImport("ns_for_cosmos", "cosmos_table"))
             statement.executeUpdate(
                 """
-                |CREATE FOREIGN TABLE IF NOT EXISTS "ns_for_cosmos"."_cosmos_table" (
+                |CREATE FOREIGN TABLE IF NOT EXISTS "ns_for_cosmos"."cosmos_table" (
                 |    "pk" int,
                 |    "ck1" int,
                 |    "ck2" int,
@@ -403,32 +372,16 @@ class CreateForeignTablesTest {
                 |    "float_col" float,
                 |    "double_col" double precision,
                 |    "text_col" text,
-                |    "blob_col" bytea,
-                |    "tx_id" text,
-                |    "tx_state" int,
-                |    "tx_version" int,
-                |    "tx_prepared_at" bigint,
-                |    "tx_committed_at" bigint,
-                |    "before_tx_id" text,
-                |    "before_tx_state" int,
-                |    "before_tx_version" int,
-                |    "before_tx_prepared_at" bigint,
-                |    "before_tx_committed_at" bigint,
-                |    "before_boolean_col" int,
-                |    "before_int_col" int,
-                |    "before_bigint_col" bigint,
-                |    "before_float_col" float,
-                |    "before_double_col" double precision,
-                |    "before_text_col" text,
-                |    "before_blob_col" bytea
+                |    "blob_col" bytea
                 |) SERVER "cosmos"
-                |OPTIONS (namespace 'ns_for_cosmos', table_name 'cosmos_table');
+                |OPTIONS (namespace 'ns_for_cosmos', table_name 'cosmos_table', transaction_aware 'true');
                 """
                     .trimMargin(),
             )
+            statement.executeUpdate(dropObjectsOfOlderImport("ns_for_dynamodb", "dynamodb_table"))
             statement.executeUpdate(
                 """
-                |CREATE FOREIGN TABLE IF NOT EXISTS "ns_for_dynamodb"."_dynamodb_table" (
+                |CREATE FOREIGN TABLE IF NOT EXISTS "ns_for_dynamodb"."dynamodb_table" (
                 |    "pk" int,
                 |    "ck1" int,
                 |    "ck2" int,
@@ -438,26 +391,9 @@ class CreateForeignTablesTest {
                 |    "float_col" float,
                 |    "double_col" double precision,
                 |    "text_col" text,
-                |    "blob_col" bytea,
-                |    "tx_id" text,
-                |    "tx_state" int,
-                |    "tx_version" int,
-                |    "tx_prepared_at" bigint,
-                |    "tx_committed_at" bigint,
-                |    "before_tx_id" text,
-                |    "before_tx_state" int,
-                |    "before_tx_version" int,
-                |    "before_tx_prepared_at" bigint,
-                |    "before_tx_committed_at" bigint,
-                |    "before_boolean_col" int,
-                |    "before_int_col" int,
-                |    "before_bigint_col" bigint,
-                |    "before_float_col" float,
-                |    "before_double_col" double precision,
-                |    "before_text_col" text,
-                |    "before_blob_col" bytea
+                |    "blob_col" bytea
                 |) SERVER "dynamodb"
-                |OPTIONS (namespace 'ns_for_dynamodb', table_name 'dynamodb_table');
+                |OPTIONS (namespace 'ns_for_dynamodb', table_name 'dynamodb_table', transaction_aware 'true');
                 """
                     .trimMargin(),
             )
@@ -465,4 +401,22 @@ class CreateForeignTablesTest {
         }
         confirmVerified(statement)
     }
+
+    private fun dropObjectsOfOlderImport(
+        schema: String,
+        table: String,
+    ): String =
+        """
+        |DO $$
+        |BEGIN
+        |    IF EXISTS (SELECT FROM pg_class WHERE oid = to_regclass('"$schema"."$table"') AND relkind = 'v') THEN
+        |        DROP VIEW "$schema"."$table";
+        |    END IF;
+        |    IF EXISTS (SELECT FROM pg_class WHERE oid = to_regclass('"$schema"."_$table"') AND relkind = 'f') THEN
+        |        DROP FOREIGN TABLE "$schema"."_$table";
+        |    END IF;
+        |END
+        |$$;
+        """
+            .trimMargin()
 }
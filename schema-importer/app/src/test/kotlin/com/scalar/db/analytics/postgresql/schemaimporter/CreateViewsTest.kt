@@ -18,11 +18,13 @@ package com.scalar.db.analytics.postgresql.schemaimporter
 import com.scalar.db.api.DistributedStorageAdmin
 import com.scalar.db.api.Scan
 import com.scalar.db.api.TableMetadata
+import com.scalar.db.config.DatabaseConfig
 import com.scalar.db.io.DataType
 import io.mockk.confirmVerified
 import io.mockk.every
 import io.mockk.impl.annotations.MockK
 import io.mockk.junit5.MockKExtension
+import io.mockk.mockk
 import io.mockk.verify
 import org.junit.jupiter.api.extension.ExtendWith
 import java.sql.Connection
@@ -93,7 +95,9 @@ class CreateViewsTest {
 
     @Test
     fun `run should create view for jdbc storage`() {
-        CreateViews(ctx, setOf("ns_for_jdbc"), admin).run()
+        val config = mockk<DatabaseConfig>()
+        val storage = ScalarDBStorage.Jdbc(config)
+        CreateViews(ctx, setOf("ns_for_jdbc"), storage, admin).run()
         verify {
             statement.executeUpdate(
                 """
@@ -121,7 +125,9 @@ class CreateViewsTest {
 
     @Test
     fun `run should create view for cassandra storage`() {
-        CreateViews(ctx, setOf("ns_for_cassandra"), admin).run()
+        val config = mockk<DatabaseConfig>()
+        val storage = ScalarDBStorage.Cassandra(config)
+        CreateViews(ctx, setOf("ns_for_cassandra"), storage, admin).run()
         verify {
             statement.executeUpdate(
                 """
@@ -148,63 +154,46 @@ class CreateViewsTest {
     }
 
     @Test
-    fun `run should create view for cosmos storage`() {
-        CreateViews(ctx, setOf("ns_for_cosmos"), admin).run()
-        verify {
-            statement.executeUpdate(
-                """
-                |CREATE OR REPLACE VIEW "ns_for_cosmos"."cosmos_table" AS
-                |SELECT
-                |    "pk",
-                |    "ck1",
-                |    "ck2",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "boolean_col" ELSE "before_boolean_col" END AS "boolean_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "int_col" ELSE "before_int_col" END AS "int_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "bigint_col" ELSE "before_bigint_col" END AS "bigint_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "float_col" ELSE "before_float_col" END AS "float_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "double_col" ELSE "before_double_col" END AS "double_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "text_col" ELSE "before_text_col" END AS "text_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "blob_col" ELSE "before_blob_col" END AS "blob_col"
-                |FROM "ns_for_cosmos"."_cosmos_table"
-                |WHERE "tx_state" = 3 OR "tx_state" IS NULL OR "before_tx_state" = 3;
-                """
-                    .trimMargin(),
-            )
-            statement.close()
-        }
+    fun `run should not create view for cosmos storage`() {
+        val config = mockk<DatabaseConfig>()
+        val storage = ScalarDBStorage.Cosmos(config)
+        CreateViews(ctx, setOf("ns_for_cosmos"), storage, admin).run()
         confirmVerified(statement)
     }
 
     @Test
-    fun `run should create view for dynamodb storage`() {
-        CreateViews(ctx, setOf("ns_for_dynamodb"), admin).run()
-        verify {
-            statement.executeUpdate(
-                """
-                |CREATE OR REPLACE VIEW "ns_for_dynamodb"."dynamodb_table" AS
-                |SELECT
-                |    "pk",
-                |    "ck1",
-                |    "ck2",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "boolean_col" ELSE "before_boolean_col" END AS "boolean_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "int_col" ELSE "before_int_col" END AS "int_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "bigint_col" ELSE "before_bigint_col" END AS "bigint_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "float_col" ELSE "before_float_col" END AS "float_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "double_col" ELSE "before_double_col" END AS "double_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "text_col" ELSE "before_text_col" END AS "text_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "blob_col" ELSE "before_blob_col" END AS "blob_col"
-                |FROM "ns_for_dynamodb"."_dynamodb_table"
-                |WHERE "tx_state" = 3 OR "tx_state" IS NULL OR "before_tx_state" = 3;
-                """
-                    .trimMargin(),
-            )
-            statement.close()
-        }
+    fun `run should not create view for dynamodb storage`() {
+        val config = mockk<DatabaseConfig>()
+        val storage = ScalarDBStorage.DynamoDB(config)
+        CreateViews(ctx, setOf("ns_for_dynamodb"), storage, admin).run()
         confirmVerified(statement)
     }
 
     @Test
     fun `run should create required views for multi storage`() {
+        val jdbcConfig = mockk<DatabaseConfig>()
+        val cassandraConfig = mockk<DatabaseConfig>()
+        val cosmosConfig = mockk<DatabaseConfig>()
+        val dynamodbConfig = mockk<DatabaseConfig>()
+
+        val storages =
+            mapOf(
+                "jdbc" to ScalarDBStorage.Jdbc(jdbcConfig),
+                "cassandra" to ScalarDBStorage.Cassandra(cassandraConfig),
+                "cosmos" to ScalarDBStorage.Cosmos(cosmosConfig),
+                "dynamodb" to ScalarDBStorage.DynamoDB(dynamodbConfig),
+            )
+
+        val namespaceStorageMap =
+            mapOf(
+                "ns_for_jdbc" to "jdbc",
+                "ns_for_cassandra" to "cassandra",
+                "ns_for_cosmos" to "cosmos",
+                "ns_for_dynamodb" to "dynamodb",
+            )
+
+        val storage = ScalarDBStorage.MultiStorage(storages, namespaceStorageMap)
+
         CreateViews(
             ctx,
             setOf(
@@ -213,6 +202,7 @@ class CreateViewsTest {
                 "ns_for_cosmos",
                 "ns_for_dynamodb",
             ),
+            storage,
             admin,
         )
             .run()
@@ -255,44 +245,6 @@ class CreateViewsTest {
                 """
                     .trimMargin(),
             )
-            statement.executeUpdate(
-                """
-                |CREATE OR REPLACE VIEW "ns_for_cosmos"."cosmos_table" AS
-                |SELECT
-                |    "pk",
-                |    "ck1",
-                |    "ck2",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "boolean_col" ELSE "before_boolean_col" END AS "boolean_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "int_col" ELSE "before_int_col" END AS "int_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "bigint_col" ELSE "before_bigint_col" END AS "bigint_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "float_col" ELSE "before_float_col" END AS "float_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "double_col" ELSE "before_double_col" END AS "double_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "text_col" ELSE "before_text_col" END AS "text_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "blob_col" ELSE "before_blob_col" END AS "blob_col"
-                |FROM "ns_for_cosmos"."_cosmos_table"
-                |WHERE "tx_state" = 3 OR "tx_state" IS NULL OR "before_tx_state" = 3;
-                """
-                    .trimMargin(),
-            )
-            statement.executeUpdate(
-                """
-                |CREATE OR REPLACE VIEW "ns_for_dynamodb"."dynamodb_table" AS
-                |SELECT
-                |    "pk",
-                |    "ck1",
-                |    "ck2",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "boolean_col" ELSE "before_boolean_col" END AS "boolean_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "int_col" ELSE "before_int_col" END AS "int_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "bigint_col" ELSE "before_bigint_col" END AS "bigint_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "float_col" ELSE "before_float_col" END AS "float_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "double_col" ELSE "before_double_col" END AS "double_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "text_col" ELSE "before_text_col" END AS "text_col",
-                |    CASE WHEN "tx_state" = 3 OR "tx_state" IS NULL THEN "blob_col" ELSE "before_blob_col" END AS "blob_col"
-                |FROM "ns_for_dynamodb"."_dynamodb_table"
-                |WHERE "tx_state" = 3 OR "tx_state" IS NULL OR "before_tx_state" = 3;
-                """
-                    .trimMargin(),
-            )
             statement.close()
         }
         confirmVerified(statement)